@@ -0,0 +1,43 @@
+/**
+ * @file analizador.h
+ * @brief analizador de lineas IRC en su sitio, sin copiar ni reservar memoria
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef ANALIZADOR_H
+#define ANALIZADOR_H
+
+#include "config.h"
+#include "arena.h"
+
+#define ANALIZADOR_OK 0
+#define ANALIZADOR_ERROR -1
+
+#define MAX_PARAMS_IRC 15 /**< Parametros de una linea, el ultimo puede ser el final (RFC 2812, 2.3.1) */
+
+typedef struct _Vista {
+
+	char *ptr; /**< Comienzo dentro de la linea, NULL si no esta */
+	size_t len;
+
+} Vista, *pVista;
+
+typedef struct _LineaIRC {
+
+	char *linea; /**< Linea analizada, con su CRLF */
+	Vista prefijo; /**< Sin los dos puntos */
+	Vista comando;
+	Vista params[MAX_PARAMS_IRC]; /**< Incluye el final como ultimo parametro */
+	int numParams;
+	Vista final; /**< Parametro final, el que puede llevar espacios, ptr NULL si no hay */
+
+} LineaIRC, *pLineaIRC;
+
+status analizarLinea(char *linea, size_t len, pLineaIRC l);
+
+int vistaIgual(Vista v, char *cadena);
+
+char *copiarVista(pArena arena, Vista v);
+
+#endif /* ANALIZADOR_H */
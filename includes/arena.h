@@ -0,0 +1,57 @@
+/**
+ * @file arena.h
+ * @brief arena de memoria de cada hilo para los temporales de un comando
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "config.h"
+
+#define ARENA_OK 0
+#define ARENA_ERROR -1
+
+#define TAM_ARENA 16384 /**< Bloque inicial de la arena de cada hilo */
+#define ALINEACION_ARENA 16 /**< Alineacion de cada reserva, potencia de 2 */
+
+typedef struct _BloqueArena {
+
+	struct _BloqueArena *siguiente;
+	char datos[]; /**< Se reserva ALINEACION_ARENA de mas para alinear el comienzo */
+
+} BloqueArena, *pBloqueArena;
+
+typedef struct _Arena {
+
+	char *base; /**< Bloque principal, del que sale todo en regimen estacionario */
+	size_t tam;
+	size_t usado;
+	pBloqueArena desbordes; /**< Reservas que no cupieron en la base, se liberan al reiniciar */
+	size_t desbordado; /**< Bytes pedidos fuera de la base desde el ultimo reinicio */
+
+	unsigned long reservas; /**< Reservas servidas por la arena */
+	unsigned long reservasHeap; /**< Veces que la arena ha tenido que pedir memoria al heap */
+
+} Arena, *pArena;
+
+pthread_key_t claveArena; /**< Arena de cada hilo, se libera al terminar el hilo */
+
+status inicializarArenas(void);
+
+pArena arenaHilo(void);
+
+void *reservarArena(pArena arena, size_t tam);
+
+char *duplicarArena(pArena arena, const char *cadena);
+
+void reiniciarArena(pArena arena);
+
+unsigned long reservasHeapHilo(void);
+
+void liberarArena(void *arena);
+
+void liberarArenas(void);
+
+#endif /* ARENA_H */
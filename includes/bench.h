@@ -0,0 +1,156 @@
+/**
+ * @file bench.h
+ * @brief utilidades comunes a los programas de medida
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <time.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "config.h"
+#include "conexiones.h"
+#include "canales.h"
+
+#include <redes2/irc.h>
+
+/**
+ * @brief Devuelve los nanosegundos entre dos instantes
+ *
+ * @synopsis
+ * @code
+ * 	long long nanosegundos(struct timespec *inicio, struct timespec *fin)
+ * @endcode
+ *
+ * @param[in] inicio instante inicial
+ * @param[in] fin instante final
+ *
+ * @return los nanosegundos transcurridos
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+static inline long long nanosegundos(struct timespec *inicio, struct timespec *fin){
+	return (long long)(fin->tv_sec - inicio->tv_sec) * 1000000000LL + (fin->tv_nsec - inicio->tv_nsec);
+}
+
+/**
+ * @brief Conecta usuarios por socketpair, registrados en el TAD y en la tabla de conexiones
+ *
+ * El usuario i se llama prefijo seguido de i; el servidor escribe en su
+ * extremo de servidor[i], no bloqueante, y se lee lo recibido de clientes[i].
+ *
+ * @synopsis
+ * @code
+ * 	int crearUsuarios(char *prefijo, int n, int *servidor, int *clientes)
+ * @endcode
+ *
+ * @param[in] prefijo prefijo del nick de cada usuario
+ * @param[in] n usuarios a crear
+ * @param[out] servidor extremo del servidor de cada usuario
+ * @param[out] clientes extremo de lectura de cada usuario
+ *
+ * @return los usuarios creados, menos de n si se acaban los descriptores
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+static inline int crearUsuarios(char *prefijo, int n, int *servidor, int *clientes){
+	int i, par[2];
+	char nombre[32];
+
+	for(i = 0; i < n; i++){
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, par) < 0 || par[0] >= maxConexiones){
+			fprintf(stderr, "Solo se han podido crear %d usuarios, revisa ulimit -n\n", i);
+			break;
+		}
+		fcntl(par[0], F_SETFL, fcntl(par[0], F_GETFL) | O_NONBLOCK);
+		servidor[i] = par[0];
+		clientes[i] = par[1];
+
+		snprintf(nombre, sizeof(nombre), "%s%d", prefijo, i);
+		IRCTADUser_New(nombre, nombre, nombre, NULL, "localhost", "127.0.0.1", par[0]);
+		registrarConexion(par[0], NULL);
+	}
+
+	return i;
+}
+
+/**
+ * @brief Saca de los canales, del TAD y de la tabla a los usuarios de crearUsuarios y cierra sus sockets
+ *
+ * @synopsis
+ * @code
+ * 	void liberarUsuarios(char *prefijo, int n, int *servidor, int *clientes)
+ * @endcode
+ *
+ * @param[in] prefijo prefijo del nick de cada usuario
+ * @param[in] n usuarios creados
+ * @param[in] servidor extremo del servidor de cada usuario
+ * @param[in] clientes extremo de lectura de cada usuario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+static inline void liberarUsuarios(char *prefijo, int n, int *servidor, int *clientes){
+	int i;
+	char nombre[32];
+
+	for(i = 0; i < n; i++){
+		snprintf(nombre, sizeof(nombre), "%s%d", prefijo, i);
+		salirTodosCanales(servidor[i]);
+		IRCTAD_Quit(nombre);
+		liberarConexion(servidor[i]);
+		close(servidor[i]);
+		close(clientes[i]);
+	}
+}
+
+/**
+ * @brief Vacia lo que han recibido los usuarios para que no se llenen los sockets
+ *
+ * @synopsis
+ * @code
+ * 	long vaciarUsuarios(int *clientes, int n)
+ * @endcode
+ *
+ * @param[in] clientes extremo de lectura de cada usuario
+ * @param[in] n numero de usuarios
+ *
+ * @return los bytes leidos
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+static inline long vaciarUsuarios(int *clientes, int n){
+	char buffer[8192];
+	ssize_t leido;
+	long total = 0;
+	int i;
+
+	for(i = 0; i < n; i++){
+		while((leido = recv(clientes[i], buffer, sizeof(buffer), MSG_DONTWAIT)) > 0){
+			total += leido;
+		}
+	}
+
+	return total;
+}
+
+#endif /* BENCH_H */
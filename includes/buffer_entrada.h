@@ -0,0 +1,38 @@
+/**
+ * @file buffer_entrada.h
+ * @brief buffer de entrada por conexion que reensambla lineas terminadas en CRLF
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef BUFFER_ENTRADA_H
+#define BUFFER_ENTRADA_H
+
+#include "config.h"
+
+#define ENTRADA_OK 0
+#define ENTRADA_ERROR -1
+
+#define MAX_LINEA_IRC 512 /**< Longitud maxima de una linea IRC incluido el CRLF (RFC 2812) */
+#define TAM_ENTRADA_INICIAL 64 /**< Capacidad inicial del buffer, crece hasta MAX_LINEA_IRC */
+
+typedef struct _BufferEntrada {
+
+	char *datos; /**< Linea incompleta recibida a la espera de su fin de linea */
+	size_t len;
+	size_t cap;
+
+} BufferEntrada, *pBufferEntrada;
+
+unsigned long lineasTruncadas; /**< Lineas recortadas por superar MAX_LINEA_IRC */
+unsigned long lineasNulas; /**< Lineas descartadas por contener un '\\0' */
+
+void vaciarBufferEntrada(pBufferEntrada buffer);
+
+void liberarBufferEntrada(pBufferEntrada buffer);
+
+status annadirPendiente(pBufferEntrada buffer, char *datos, size_t len);
+
+char *ensamblarLineas(pBufferEntrada buffer, char *lectura, size_t tam, size_t *len);
+
+#endif /* BUFFER_ENTRADA_H */
@@ -0,0 +1,82 @@
+/**
+ * @file canales.h
+ * @brief indice de miembros de cada canal por descriptor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef CANALES_H
+#define CANALES_H
+
+#include "config.h"
+#include "epocas.h"
+#include "arena.h"
+
+#define CANAL_OK 0
+#define CANAL_ERROR -1
+
+#define TAM_TABLA_CANALES 1024 /**< Cubetas de la tabla de canales, potencia de 2 */
+#define MIEMBROS_INICIAL 8 /**< Capacidad con la que nace la lista de canales de una conexion */
+#define PARTICIONES_CANALES 64 /**< Cerrojos por defecto de la tabla, potencia de 2 */
+#define MAX_PARTICIONES_CANALES TAM_TABLA_CANALES /**< Como mucho un cerrojo por cubeta */
+#define LOTE_VECINOS 32 /**< Canales de una conexion que se copian de una vez al avisar a sus vecinos */
+
+typedef struct _Miembros {
+
+	int num;
+	int fds[]; /**< Descriptores de las conexiones unidas al canal */
+
+} Miembros, *pMiembros;
+
+typedef struct _Canal {
+
+	char *nombre; /**< Nombre del canal, se compara sin distinguir mayusculas */
+	pMiembros miembros; /**< Instantanea publicada, no se modifica: se sustituye y se retira por epocas */
+	unsigned int cubeta; /**< Cubeta de tablaCanales, fija la particion que lo protege */
+	char *clave; /**< Ultima clave fijada con +k, el TAD no la devuelve y el relevo la necesita */
+	struct _Canal *siguiente; /**< Siguiente canal de la misma cubeta */
+
+} Canal, *pCanal;
+
+typedef struct _EnlaceCanal {
+
+	pCanal canal; /**< Canal al que esta unida la conexion */
+	unsigned int particion; /**< Particion del canal, para bloquearla sin tocar el canal */
+
+} EnlaceCanal, *pEnlaceCanal;
+
+typedef struct _MarcasVecinos {
+
+	unsigned int generacion; /**< Difusion en curso del hilo */
+	unsigned int marcas[]; /**< Ultima difusion que ha llegado a cada descriptor */
+
+} MarcasVecinos, *pMarcasVecinos;
+
+pCanal tablaCanales[TAM_TABLA_CANALES];
+pthread_mutex_t locksCanales[MAX_PARTICIONES_CANALES]; /**< Serializan los cambios de las cubetas de cada particion, los lectores no los toman */
+unsigned int particionesCanales; /**< Particiones en uso, potencia de 2 */
+pthread_key_t claveVecinos; /**< Marcas de cada hilo, se liberan al terminar el hilo */
+
+status inicializarCanales(unsigned int particiones);
+
+status unirCanal(char *nombre, int fd);
+
+status salirCanal(char *nombre, int fd);
+
+void salirTodosCanales(int fd);
+
+void cerrarRetirado(void *fd);
+
+void cerrarTrasLectores(int fd);
+
+int difundirCanal(char *nombre, char *mensaje, size_t len, int excluido);
+
+int listarMiembrosCanal(char *nombre, pArena arena, int **fds);
+
+int difundirVecinos(int fd, char *mensaje, size_t len);
+
+status fijarClaveCanal(char *nombre, char *clave);
+
+void liberarCanales(void);
+
+#endif /* CANALES_H */
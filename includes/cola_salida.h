@@ -0,0 +1,74 @@
+/**
+ * @file cola_salida.h
+ * @brief cola de salida no bloqueante de cada conexion
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef COLA_SALIDA_H
+#define COLA_SALIDA_H
+
+#include "config.h"
+
+#define SALIDA_OK 0
+#define SALIDA_ERROR -1
+
+#define TAM_BLOQUE_SALIDA 4096 /**< Tamanno minimo de cada bloque, los mensajes cortos se agrupan */
+#define MAX_IOV_SALIDA 64 /**< Bloques enviados en cada llamada a sendmsg */
+#define DEFAULT_MAX_SALIDA (1024 * 1024) /**< Bytes pendientes por conexion antes de expulsarla */
+#define MENSAJE_EXPULSION "ERROR :Closing Link: SendQ exceeded\r\n"
+
+struct _Conexion;
+
+typedef struct _MensajeCompartido {
+
+	int referencias; /**< Bloques que lo tienen encolado mas quien lo creo */
+	size_t len;
+	char datos[]; /**< No se modifica una vez creado */
+
+} MensajeCompartido, *pMensajeCompartido;
+
+typedef struct _BloqueSalida {
+
+	struct _BloqueSalida *sig;
+	pMensajeCompartido compartido; /**< Mensaje encolado por referencia, NULL si los datos estan en el bloque */
+	size_t cap; /**< 0 en los bloques con mensaje compartido */
+	size_t len; /**< Bytes escritos en el bloque */
+	size_t enviado; /**< Bytes del bloque ya enviados al socket */
+	char datos[];
+
+} BloqueSalida, *pBloqueSalida;
+
+typedef struct _ColaSalida {
+
+	pBloqueSalida primero;
+	pBloqueSalida ultimo;
+	size_t bytes; /**< Bytes pendientes de enviar */
+	short esperando; /**< El reactor espera a que el socket admita escritura */
+	short error; /**< Error de escritura o conexion cerrandose, no se admiten mas datos */
+	short expulsada; /**< Limite superado, solo se envia lo pendiente antes de cerrar */
+
+} ColaSalida, *pColaSalida;
+
+size_t maxSalida; /**< Limite de bytes pendientes por conexion, 0 sin limite */
+unsigned long expulsionesSalida; /**< Conexiones expulsadas por superar maxSalida */
+size_t picoSalida; /**< Mayor cola de salida observada en bytes */
+unsigned long compartidosSalida; /**< Mensajes encolados por referencia en lugar de copiados */
+
+void reiniciarColaSalida(pColaSalida cola);
+
+size_t copiarSalida(pColaSalida cola, char *destino);
+
+status encolarSalida(struct _Conexion *conexion, char *mensaje, size_t len);
+
+pMensajeCompartido crearMensajeCompartido(char *mensaje, size_t len);
+
+void soltarMensajeCompartido(pMensajeCompartido compartido);
+
+status encolarCompartido(struct _Conexion *conexion, pMensajeCompartido compartido);
+
+int enviarPendiente(struct _Conexion *conexion);
+
+void cerrarColaSalida(struct _Conexion *conexion);
+
+#endif /* COLA_SALIDA_H */
@@ -14,6 +14,11 @@
 
 #define CON_OK 0
 #define CON_ERROR -1
+#define CON_LLENO -2 /**< Se ha alcanzado el limite de conexiones sin registrar */
+
+#define DEFAULT_MAX_TEMPORALES 4096 /**< Conexiones sin registrar admitidas a la vez */
+#define DEFAULT_PLAZO_REGISTRO 60 /**< Segundos desde que se acepta para hacer NICK y USER */
+#define DEFAULT_INACTIVIDAD_REGISTRO 30 /**< Segundos sin enviar nada que se le permiten antes de registrarse */
 
 typedef struct _TempUser {
 
@@ -21,20 +26,21 @@ typedef struct _TempUser {
 	char * nick;
 	char *host;
 	char IP[INET6_ADDRSTRLEN];
-	struct _TempUser * previous; /**< Puntero al usuario anterior */
-	struct _TempUser * next; /**< Puntero al usuario siguiente */
 
 } TempUser, *pTempUser;
 
-pTempUser usuarioPrimero; /**< Almacenamos el primer y ultimo usuario de manera global */
-pTempUser usuarioUltimo;
-
-pthread_mutex_t mutexTempUser; /**< Semaforo para trabajar con usuarios temporales */
+int maxTemporales; /**< Limite de conexiones sin registrar, 0 sin limite */
+unsigned long numTemporales; /**< Conexiones aceptadas que aun no han hecho USER */
+unsigned long rechazadasTemporales; /**< Conexiones cerradas por superar maxTemporales */
+int plazoRegistro; /**< Segundos para registrarse, 0 sin limite */
+int inactividadRegistro; /**< Segundos sin enviar nada antes de registrarse, 0 sin limite */
 
 status newTempUser(int socket,  char *ip, char *host);
 
 status setNickTemporal(pTempUser usuario, char* nick);
 
+status setHostTemporal(int socket, char *ip, char *host);
+
 pTempUser pullTempUser(int socket);
 
 status deleteTempUser(int socket);
@@ -0,0 +1,59 @@
+/**
+ * @file conexiones.h
+ * @brief tabla de conexiones del servidor indexada por descriptor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef CONEXIONES_H
+#define CONEXIONES_H
+
+#include "config.h"
+#include "buffer_entrada.h"
+#include "cola_salida.h"
+#include "sesiones.h"
+#include "conexion_temp.h"
+#include "rueda.h"
+
+#define CONEX_OK 0
+#define CONEX_ERROR -1
+
+#define LIMITE_DESCRIPTORES 65536 /**< Limite de descriptores que se pide al arrancar si el sistema lo permite */
+
+struct _Reactor;
+struct _EnlaceCanal;
+
+typedef struct _Conexion {
+
+	int fd; /**< Descriptor de la conexion, -1 si la entrada esta libre */
+	struct _Reactor *reactor; /**< Reactor que posee la conexion de principio a fin */
+	BufferEntrada entrada; /**< Linea incompleta entre dos lecturas */
+	pthread_mutex_t mutex; /**< Serializa las escrituras y el uso del objeto SSL */
+	short handshake; /**< 1 mientras no termina el handshake SSL, la salida solo se encola */
+	ColaSalida salida; /**< Datos pendientes de enviar al cliente */
+	pTempUser temporal; /**< Usuario aun sin registrar, NULL desde el USER */
+	pSesion sesion; /**< Usuario registrado en la conexion, NULL hasta el USER */
+	struct _EnlaceCanal *canales; /**< Canales del indice a los que esta unida, protegidos por mutex */
+	int numCanales;
+	int capCanales;
+	Temporizador vigilancia; /**< Temporizador de la conexion en la rueda de su reactor */
+	unsigned long aceptada; /**< Tick de la rueda en el que se acepto */
+	unsigned long actividad; /**< Tick de la rueda en el que se recibio algo por ultima vez */
+	unsigned long ping; /**< Tick en el que se le mando PING, 0 si no se espera respuesta */
+
+} Conexion, *pConexion;
+
+pConexion tablaConexiones; /**< Una entrada por descriptor posible */
+int maxConexiones;
+
+status inicializarConexiones(void);
+
+pConexion obtenerConexion(int fd);
+
+status registrarConexion(int fd, struct _Reactor *reactor);
+
+void liberarConexion(int fd);
+
+void liberarConexiones(void);
+
+#endif /* CONEXIONES_H */
@@ -18,7 +18,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <stdint.h>
 #include <sys/time.h>
 #include <signal.h>
 
@@ -27,8 +28,15 @@
 #define DEFAULT_PORT 6667
 #define DEFAULT_PORT_SSL 6669
 #define MAX_BUFFER 1024
+#define TAM_LECTURA 16384 /**< Bytes leidos de un socket en cada llamada */
+#define MAX_EVENTOS 64 /**< Eventos maximos devueltos por cada epoll_wait */
 
-#define ALARMPINGPONG 20
+#ifndef ESPERA_PING
+#define ESPERA_PING 60 /**< Segundos sin recibir nada de un cliente antes de mandarle PING */
+#endif
+#ifndef PLAZO_PONG
+#define PLAZO_PONG 30 /**< Segundos que tiene para contestar al PING antes de cerrarle */
+#endif
 
 #define SERV_OK 0
 #define SERV_ERROR -1
@@ -43,15 +51,11 @@ typedef int status;
 
 char abspath[1024];
 
-pthread_mutex_t mutexDescr; /**< Semaforo para trabajar con los descriptores */
-
 int running; /**< Para poder parar el while(running) de lanzar servidor desde fuera */
 
-short offensive;
+int senalFD; /**< signalfd por el que SIGINT y SIGTERM llegan al reactor 0 */
 
-fd_set activeFD;
-
-pid_t pid;
+short offensive;
 
 void daemonizar(char *servicio, int logLevel);
 
@@ -59,24 +63,10 @@ void cerrarDescriptores(void);
 
 void abrirLog(char * identificacion, int logLevel);
 
-void manejadorSIGUSR1(int signal);
-
-void manejadorSIGALRM(int sennal);
-
 status inicializarServidor(void);
 
 void cerrarServidor(void);
 
-void manejadorSigint(int signal);
-
-status inicializarFD(int sckt);
-
-status addFd(int sckt);
-
-status deleteFd(int sckt);
-
-status setReadFD(fd_set * readFD);
-
 status lanzarServidor(unsigned int puerto, short pingpong);
 
 status lanzarServidorSSL(unsigned int puerto, short pingpong);
@@ -0,0 +1,21 @@
+/**
+ * @file despacho.h
+ * @brief despacho de comandos por verbo empaquetado, generado de crea_comandos()
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef DESPACHO_H
+#define DESPACHO_H
+
+#include "config.h"
+#include "analizador.h"
+
+#define DESPACHO_DESCONOCIDO -1 /**< Verbo sin manejador propio */
+#define DESPACHO_NUMERICO -2 /**< Respuesta numerica de tres cifras */
+
+#define MAX_VERBO 8 /**< Letras que caben en la palabra empaquetada */
+
+long despacharComando(Vista verbo);
+
+#endif /* DESPACHO_H */
@@ -0,0 +1,61 @@
+/**
+ * @file epocas.h
+ * @brief liberacion diferida por epocas de estructuras que se leen sin cerrojos
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef EPOCAS_H
+#define EPOCAS_H
+
+#include "config.h"
+
+#define EPOCA_OK 0
+#define EPOCA_ERROR -1
+
+#define MAX_HILOS_EPOCA 1024 /**< Hilos que pueden estar a la vez dentro de una epoca */
+#define EPOCA_FUERA 0 /**< Valor de la ranura de un hilo que no esta leyendo */
+#define TAM_LINEA_CACHE 64
+
+typedef struct _RanuraEpoca {
+
+	unsigned long epoca; /**< Epoca en la que entro el hilo, EPOCA_FUERA si no esta leyendo */
+	int ocupada; /**< La ranura pertenece a un hilo vivo */
+	char relleno[TAM_LINEA_CACHE - sizeof(unsigned long) - sizeof(int)]; /**< Cada ranura en su linea de cache */
+
+} RanuraEpoca;
+
+typedef struct _Retirado {
+
+	void *ptr;
+	void (*liberar)(void *);
+	unsigned long epoca; /**< Epoca global cuando dejo de ser alcanzable */
+	struct _Retirado *siguiente;
+
+} Retirado, *pRetirado;
+
+unsigned long epocaGlobal; /**< Empieza en 1, solo avanza cuando ningun lector se ha quedado atras */
+RanuraEpoca ranurasEpoca[MAX_HILOS_EPOCA];
+int numRanurasEpoca; /**< Ranuras que se han llegado a usar, las demas no se miran */
+pthread_key_t claveEpoca; /**< Ranura de cada hilo, se libera al terminar el hilo */
+
+pRetirado retiradosEpoca; /**< Estructuras pendientes de liberar */
+pthread_mutex_t mutexEpocas;
+unsigned long pendientesEpoca;
+unsigned long liberadosEpoca;
+
+status inicializarEpocas(void);
+
+status entrarEpoca(void);
+
+void salirEpoca(void);
+
+status retirarEpoca(void *ptr, void (*liberar)(void *));
+
+void recogerEpoca(void);
+
+void esperarEpoca(void);
+
+void liberarEpocas(void);
+
+#endif /* EPOCAS_H */
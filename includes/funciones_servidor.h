@@ -14,6 +14,7 @@
 
 #include "config.h"
 #include "red_servidor.h"
+#include "analizador.h"
 
 #define COM_OK 0
 #define COM_ERROR -1
@@ -29,11 +30,20 @@ typedef struct _datosMensaje {
 	int sckfd;
 	char * msg;
 	size_t len;
+	pLineaIRC linea; /**< Linea que se esta atendiendo, ya analizada */
 } DatosMensaje, *pDatosMensaje;
 
+typedef struct _ReservasComando {
+	unsigned long veces; /**< Comandos atendidos */
+	unsigned long arena; /**< Reservas servidas por la arena del hilo */
+	unsigned long heap; /**< Reservas al heap, de la arena o de todo el hilo con CONTAR_RESERVAS */
+} ReservasComando;
+
 typedef status (*ArrayComandos)(char*, pDatosMensaje);
 
 ArrayComandos comandos[IRC_MAX_COMMANDS]; /**< Declaramos el array de comandos con el numero maximo de comandos */
+char *nombresComandos[IRC_MAX_COMMANDS]; /**< Nombre de cada comando atendido, para las estadisticas */
+ReservasComando reservasComandos[IRC_MAX_COMMANDS];
 
 void liberarEstructuras(void);
 
@@ -41,16 +51,18 @@ void *manejaMensaje(void* pdesc);
 
 status procesaComando(char *comando, pDatosMensaje datos);
 
+pLineaIRC lineaComando(char *comando, pDatosMensaje datos, pLineaIRC local);
+
 status nuevaConexion(int desc, struct sockaddr_in * address);
 
 status cerrarConexion(int socket);
 
+pDatosMensaje crearDatosMensaje(int sckfd, char *msg, size_t len);
+
 void liberaDatosMensaje(pDatosMensaje datos);
 
 status liberarUserData(char *user, char *nick, char *real, char *host, char *IP, char *away);
 
-status rutinaPingPong(void);
-
 status crea_comandos(void);
 
 status nick(char* comando, pDatosMensaje datos);
@@ -87,8 +99,12 @@ status motd(char* comando, pDatosMensaje datos);
 
 status who(char* comando, pDatosMensaje datos);
 
+status stats(char* comando, pDatosMensaje datos);
+
 status comandoVacio(char* comando, pDatosMensaje datos);
 
-void enviarMensajeACanal(int sckfd, char *mensaje, char *canal, char * nickorigin);
+int socketDeNick(char *nick);
+
+void enviarMensajeACanal(int sckfd, char *mensaje, size_t len, char *canal, char * nickorigin, int excluido);
 
 #endif /* FUNCIONES_SERVIDOR_H */
@@ -0,0 +1,72 @@
+/**
+ * @file pool.h
+ * @brief pool fijo de hilos trabajadores con cola acotada de mensajes
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <time.h>
+
+#include "config.h"
+#include "funciones_servidor.h"
+
+#define DEFAULT_HILOS 8 /**< Hilos trabajadores por defecto */
+#define DEFAULT_COLA 1024 /**< Capacidad por defecto de la cola de trabajos */
+
+#define POOL_OK 0
+#define POOL_ERROR -1
+
+typedef struct _ThPool {
+
+	pthread_t *hilos; /**< Hilos trabajadores */
+	int nHilos;
+
+	pDatosMensaje *cola; /**< Cola circular de trabajos pendientes */
+	struct timespec *encolado; /**< Instante en que se encolo cada trabajo */
+	int capacidad;
+	int cabeza;
+	int num;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t noVacia; /**< Avisa a los trabajadores de que hay trabajo */
+	pthread_cond_t noLlena; /**< Avisa al productor de que hay hueco */
+	short activo;
+
+	unsigned long encolados; /**< Estadisticas de la cola */
+	unsigned long procesados;
+	unsigned long bloqueos; /**< Veces que el productor espero por cola llena */
+	int maxProfundidad;
+	long long esperaTotalNs;
+	long long esperaMaxNs;
+
+} ThPool, *pThPool;
+
+typedef struct _EstadisticasPool {
+	int hilos;
+	int capacidad;
+	int profundidad;
+	int maxProfundidad;
+	unsigned long encolados;
+	unsigned long procesados;
+	unsigned long bloqueos;
+	long long esperaMediaUs;
+	long long esperaMaxUs;
+} EstadisticasPool, *pEstadisticasPool;
+
+pThPool thpool; /**< Pool de hilos del servidor */
+
+int hilosPool; /**< Parametros del pool fijados desde la linea de comandos */
+int colaPool;
+
+pThPool crearPool(int nHilos, int capacidad);
+
+status encolarTrabajo(pThPool pool, pDatosMensaje datos);
+
+status estadisticasPool(pThPool pool, pEstadisticasPool est);
+
+void destruirPool(pThPool pool);
+
+#endif /* POOL_H */
@@ -0,0 +1,128 @@
+/**
+ * @file reactor.h
+ * @brief reactores epoll del servidor, uno por hilo
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <netinet/in.h>
+
+#include "config.h"
+#include "conexiones.h"
+
+#define DEFAULT_REACTORES 1 /**< Reactores por defecto */
+
+#define REACTOR_OK 0
+#define REACTOR_ERROR -1
+
+#define LOTE_CADUCADAS 256 /**< Conexiones que un reactor cierra por caducidad cada vez que avanza su rueda */
+
+#define PLAZO_PARADA 5 /**< Segundos que se espera a que se vacien las colas de salida al parar */
+
+/* Fases de la parada, del servidor y de cada reactor */
+#define PARADA_NO 0
+#define PARADA_PEDIDA 1 /**< No se aceptan conexiones ni se pasan mensajes al pool */
+#define PARADA_VACIANDO 2 /**< Pool terminado, se avisa a los clientes y se vacian sus colas */
+#define PARADA_TERMINADA 3 /**< El reactor ha cerrado todas sus conexiones */
+
+#define MENSAJE_PARADA "ERROR :Closing Link: Server shutting down\r\n"
+#define MENSAJE_PING "PING :" SERVICIO "\r\n"
+#define MENSAJE_CAIDA_PING "ERROR :Closing Link: Ping timeout\r\n"
+#define MENSAJE_CADUCA_REGISTRO "ERROR :Closing Link: Registration timeout\r\n"
+#define MENSAJE_CADUCA_INACTIVIDAD "ERROR :Closing Link: Idle timeout\r\n"
+
+/* Motivos por los que la vigilancia cierra una conexion */
+#define CADUCA_REGISTRO 0
+#define CADUCA_INACTIVIDAD 1
+#define CADUCA_PING 2
+#define NUM_CADUCIDADES 3
+
+typedef struct _Reactor {
+
+	int id;
+	pthread_t hilo;
+	int epollFD; /**< Instancia epoll con las conexiones del reactor */
+	int eventoFD; /**< eventfd con el que otros hilos despiertan al reactor */
+	int epollSalida; /**< Instancia epoll, anidada en epollFD, con las conexiones que esperan para escribir */
+	int sckt; /**< Socket de escucha del reactor */
+	short propio; /**< 1 si el socket de escucha es propio (SO_REUSEPORT) */
+	struct _Anillo *anillo; /**< Estado io_uring, NULL si el reactor usa epoll */
+	int relojFD; /**< timerfd que marca cada segundo un tick de la rueda */
+	Rueda rueda; /**< Temporizadores de las conexiones del reactor */
+	int caducadas[NUM_CADUCIDADES]; /**< Conexiones cerradas en el lote actual, por motivo */
+	int lote; /**< Conexiones cerradas en el lote actual */
+	int parada; /**< Fase de la parada en la que esta el reactor */
+	unsigned long plazoParada; /**< Tick en el que se cierran las conexiones aunque no se hayan vaciado */
+	unsigned long plazoRelevo; /**< Tick en el que se abandona el relevo si el nuevo binario no esta listo */
+
+} Reactor, *pReactor;
+
+pReactor reactores; /**< Array de reactores del servidor */
+int numReactores; /**< Numero de reactores fijado desde la linea de comandos */
+short usarUring; /**< 1 para usar io_uring en lugar de epoll si esta disponible */
+short pingActivo; /**< 1 si se manda PING a las conexiones inactivas (-p) */
+unsigned long pingsEnviados; /**< PING mandados a conexiones inactivas */
+unsigned long caidasPing; /**< Conexiones cerradas por no contestar al PING */
+unsigned long caducadasRegistro; /**< Conexiones cerradas por no registrarse a tiempo */
+unsigned long caducadasInactividad; /**< Conexiones cerradas por no enviar nada antes de registrarse */
+unsigned long lotesCaducadas; /**< Lotes de conexiones cerradas por caducidad */
+unsigned long aplazadasCaducadas; /**< Cierres que no cupieron en su lote y pasaron al siguiente tick */
+int estadoParada; /**< Fase de la parada del servidor */
+int reactoresParados; /**< Reactores que ya no pasan mensajes al pool */
+
+status inicializarFD(pReactor reactor, int sckt, short propio);
+
+status inicializarReactor(pReactor reactor, int sckt, short propio);
+
+status inicializarReloj(pReactor reactor);
+
+void avanzarReloj(pReactor reactor);
+
+unsigned long primeraVigilancia(unsigned long ahora);
+
+unsigned long caducarConexion(pConexion conexion, int motivo, unsigned long ahora);
+
+unsigned long vigilarConexion(pTemporizador temporizador, unsigned long ahora);
+
+status addFd(int sckt);
+
+status rearmarFd(int sckt);
+
+status armarEscritura(int sckt);
+
+status deleteFd(int sckt);
+
+void avanzarHandshake(pConexion conexion);
+
+void despertarServidor(void);
+
+void pararServidor(void);
+
+void pedirParada(void);
+
+void vigilarRelevo(pReactor reactor);
+
+void atenderRelevo(pReactor reactor);
+
+void atenderSenal(void);
+
+void dejarDeAceptar(pReactor reactor);
+
+void avisarParada(pReactor reactor);
+
+int vaciarConexiones(pReactor reactor);
+
+void avanzarParada(pReactor reactor);
+
+void aceptarConexiones(pReactor reactor);
+
+void *bucleReactor(void *arg);
+
+void vaciarTrasRelevo(int lanzados);
+
+status lanzarReactores(unsigned int puerto, short pingpong);
+
+#endif /* REACTOR_H */
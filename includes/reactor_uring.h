@@ -0,0 +1,98 @@
+/**
+ * @file reactor_uring.h
+ * @brief reactores del servidor sobre io_uring (compilar con make IO_URING=1)
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef REACTOR_URING_H
+#define REACTOR_URING_H
+
+#include <liburing.h>
+
+#include "reactor.h"
+#include "funciones_servidor.h"
+
+#define ENTRADAS_URING 1024 /**< Tamanno de la cola de envio de cada anillo */
+#define BUFFERS_URING 128 /**< Buffers de recepcion de TAM_LECTURA por reactor, potencia de 2 */
+#define GRUPO_BUFFERS_URING 0 /**< Identificador del grupo de buffers de recepcion */
+#define MAX_PENDIENTES_URING 64 /**< Mensajes encolados por conexion antes de pausar la recepcion */
+
+/* Tipos de operacion codificados en el user_data de cada peticion */
+#define OP_ACEPTAR 1
+#define OP_RECIBIR 2
+#define OP_AVISO 3
+#define OP_CANCELAR 4
+#define OP_ESCRIBIR 5
+#define OP_RELOJ 6
+#define OP_SENAL 7
+
+#define DATO_URING(tipo, gen, fd) (((__u64)(tipo) << 56) | ((__u64)((gen) & 0xffffff) << 32) | (__u64)(unsigned int)(fd))
+#define TIPO_DATO_URING(d) ((int)((d) >> 56))
+#define GEN_DATO_URING(d) ((unsigned int)(((d) >> 32) & 0xffffff))
+#define FD_DATO_URING(d) ((int)((d) & 0xffffffff))
+
+/* Avisos que los trabajadores dejan al reactor */
+#define AVISO_REARMAR 1
+#define AVISO_CERRAR 2
+#define AVISO_ESCRIBIR 3
+
+typedef struct _MensajeUring {
+
+	pDatosMensaje datos;
+	struct _MensajeUring *sig;
+
+} MensajeUring, *pMensajeUring;
+
+/* Estado de cada descriptor dentro de un reactor; los trabajadores solo tocan
+   ocupado y los pendientes, con el mutex del anillo */
+typedef struct _EstadoUring {
+
+	unsigned int generacion; /**< Distingue completados de una conexion anterior con el mismo descriptor */
+	short activo; /**< La conexion pertenece al reactor y no se ha cerrado */
+	short recibiendo; /**< Hay una recepcion multishot armada en el kernel */
+	short escribiendo; /**< Hay un poll armado esperando a que el socket admita escritura */
+	short ocupado; /**< Hay un mensaje de la conexion en un trabajador */
+	short fin; /**< El cliente ha cerrado, se cierra al terminar el trabajador */
+	short pausado; /**< Recepcion cancelada por exceso de mensajes pendientes */
+	int nPendientes;
+	pMensajeUring primero; /**< Mensajes recibidos a la espera de que termine el trabajador */
+	pMensajeUring ultimo;
+
+} EstadoUring, *pEstadoUring;
+
+typedef struct _Aviso {
+
+	int fd;
+	short tipo;
+
+} Aviso, *pAviso;
+
+typedef struct _Anillo {
+
+	struct io_uring ring;
+	struct io_uring_buf_ring *bufRing; /**< Anillo de buffers que el kernel elige en cada recepcion */
+	char *buffers;
+	pEstadoUring estados; /**< Estado por descriptor de las conexiones del reactor */
+	pthread_mutex_t mutex; /**< Protege los avisos y los mensajes pendientes de cada conexion */
+	pAviso avisos; /**< Avisos de los trabajadores pendientes de procesar */
+	int nAvisos;
+	int capAvisos;
+
+} Anillo, *pAnillo;
+
+status inicializarUring(pReactor reactor, int sckt, short propio);
+
+void liberarUring(pReactor reactor);
+
+status addFdUring(pReactor reactor, int sckt);
+
+status rearmarUring(pReactor reactor, int sckt);
+
+status avisarReactorUring(pReactor reactor, int sckt, short tipo);
+
+void dejarDeAceptarUring(pReactor reactor);
+
+void *bucleReactorUring(void *arg);
+
+#endif /* REACTOR_URING_H */
@@ -15,17 +15,27 @@
 
 #include "config.h"
 
-#define MAX_QUEUE 15
+#define DEFAULT_BACKLOG 4096 /**< Conexiones pendientes de accept, el kernel lo limita a somaxconn */
 #define PING_TIME 30 /**< Tiempo maximo entre pings */
 
 #define RED_ERROR -1
 #define RED_OK 0
 
+int backlogEscucha; /**< Conexiones pendientes de accept fijado desde la linea de comandos */
+
+status crearSocketEscucha(int * sckfd, unsigned short port, short compartido);
+
 status crearSocketTCP(int * sckfd, unsigned short port);
 
+status crearSocketTCPCompartido(int * sckfd, unsigned short port);
+
 status aceptarConexion(int sockval,int *sckfd, struct sockaddr_in * address);
 
+status aceptarConexionNoBloqueante(int sockval,int *sckfd, struct sockaddr_in * address);
+
 status enviar(int sockfd, char *mensaje);
 
+status enviarDatos(int sockfd, char *mensaje, size_t len);
+
 #endif /* RED_SERVIDOR_H */
 
@@ -0,0 +1,82 @@
+/**
+ * @file relevo.h
+ * @brief relevo en caliente del binario pasando los sockets al nuevo proceso
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef RELEVO_H
+#define RELEVO_H
+
+#include "config.h"
+
+#define RELEVO_OK 0
+#define RELEVO_ERROR -1
+
+#define MAGIA_RELEVO 0x4952434cu /**< Identifica la cabecera del relevo */
+#define MAX_FDS_RELEVO 64 /**< Descriptores que viajan en cada paquete SCM_RIGHTS */
+#define TAM_PAQUETE_RELEVO 32768 /**< Bytes de estado por paquete */
+#define PLAZO_RELEVO 10 /**< Segundos que cada proceso espera al otro */
+#define MENSAJE_LISTO "LISTO" /**< El nuevo proceso esta inicializado y espera el estado */
+#define MENSAJE_HECHO "HECHO" /**< El nuevo proceso ha restaurado el estado y atiende a los clientes */
+
+/* Tipos de conexion en el estado */
+#define RELEVO_TEMPORAL 0
+#define RELEVO_REGISTRADA 1
+
+typedef struct _CabeceraRelevo {
+
+	uint32_t magia;
+	int32_t numEscuchas; /**< Sockets de escucha, los primeros descriptores que se envian */
+	int32_t numConexiones; /**< Conexiones de clientes, detras de los de escucha */
+	uint64_t tamEstado; /**< Bytes de estado serializado que siguen a los descriptores */
+
+} CabeceraRelevo;
+
+typedef struct _SerieRelevo {
+
+	char *datos;
+	size_t len;
+	size_t cap;
+	size_t pos; /**< Siguiente byte a leer al deserializar */
+	short error; /**< Falta memoria al escribir o datos al leer */
+
+} SerieRelevo, *pSerieRelevo;
+
+typedef struct _Relevo {
+
+	int socket; /**< Extremo del socketpair con el otro proceso */
+	int numEscuchas;
+	int numConexiones;
+	int *fds; /**< Descriptores recibidos: primero los de escucha y despues los de las conexiones */
+	int *anteriores; /**< Numero que tenia cada descriptor en el proceso anterior */
+	SerieRelevo estado;
+
+} Relevo, *pRelevo;
+
+char **argvServidor; /**< argv con el que se lanzo el servidor, para relanzar el binario */
+int relevoFD; /**< Extremo heredado del proceso anterior, -1 si se arranca en frio */
+short relevoPedido; /**< SIGUSR2 ha lanzado un nuevo binario que espera el estado */
+int socketRelevo; /**< Extremo del proceso anterior, -1 sin relevo en marcha */
+pid_t pidRelevo; /**< Nuevo binario lanzado con SIGUSR2, -1 si no hay ninguno */
+pRelevo relevo; /**< Estado recibido del proceso anterior, NULL si se arranca en frio */
+
+void cerrarHeredados(int conservar);
+
+status lanzarRelevo(void);
+
+status confirmarRelevo(void);
+
+void abandonarRelevo(void);
+
+status entregarRelevo(void);
+
+status recibirRelevo(int socket);
+
+int escuchaRelevo(int i);
+
+status restaurarRelevo(int inicializados);
+
+void liberarRelevo(void);
+
+#endif /* RELEVO_H */
@@ -0,0 +1,80 @@
+/**
+ * @file resolvedor.h
+ * @brief resolucion inversa de las IPs de los clientes en segundo plano
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef RESOLVEDOR_H
+#define RESOLVEDOR_H
+
+#include <time.h>
+#include <netinet/in.h>
+
+#include "config.h"
+
+#define DEFAULT_HILOS_DNS 4 /**< Hilos que resuelven en paralelo */
+#define COLA_DNS 4096 /**< Peticiones en espera, si se llena los clientes se quedan con su IP */
+#define TAM_CACHE_DNS 4096 /**< Entradas de la cache, potencia de 2 */
+#define TTL_DNS 300 /**< Segundos que se guarda un nombre resuelto */
+#define TTL_DNS_NEGATIVO 60 /**< Segundos que se recuerda que una IP no tiene nombre */
+#define TIMEOUT_DNS 5 /**< Segundos tras los que el cliente se queda con su IP */
+#define MAX_HOST_DNS 256
+
+#define DNS_OK 0
+#define DNS_ERROR -1
+
+typedef struct _PeticionDNS {
+
+	int fd;
+	struct in_addr addr;
+	struct timespec inicio;
+
+} PeticionDNS, *pPeticionDNS;
+
+typedef struct _EntradaDNS {
+
+	in_addr_t addr;
+	time_t caduca; /**< 0 si la entrada esta libre */
+	char host[MAX_HOST_DNS]; /**< Vacio si la IP no tiene nombre */
+
+} EntradaDNS, *pEntradaDNS;
+
+typedef struct _Resolvedor {
+
+	pthread_t *hilos;
+	int nHilos;
+
+	PeticionDNS cola[COLA_DNS]; /**< Cola circular de peticiones pendientes */
+	int cabeza;
+	int num;
+	pthread_mutex_t mutex;
+	pthread_cond_t noVacia;
+	short activo;
+
+	EntradaDNS cache[TAM_CACHE_DNS]; /**< Cache de correspondencia directa por IP */
+	pthread_mutex_t mutexCache;
+
+	struct sockaddr_in servidor; /**< Servidor DNS propio, si se ha fijado */
+	short propio;
+
+	unsigned long resueltas; /**< Estadisticas del resolvedor */
+	unsigned long sinNombre;
+	unsigned long caducadas;
+	unsigned long aciertosCache;
+	unsigned long descartadas;
+
+} Resolvedor, *pResolvedor;
+
+pResolvedor resolvedor; /**< Resolvedor del servidor, NULL si los clientes se quedan con su IP */
+char *servidorDNS; /**< Servidor DNS fijado desde la linea de comandos, ip[:puerto] */
+
+pResolvedor crearResolvedor(int nHilos, char *servidor);
+
+short buscarCacheDNS(pResolvedor r, struct in_addr addr, char *host, size_t tam);
+
+status pedirResolucion(pResolvedor r, int fd, struct in_addr addr);
+
+void destruirResolvedor(pResolvedor r);
+
+#endif /* RESOLVEDOR_H */
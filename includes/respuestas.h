@@ -0,0 +1,110 @@
+/**
+ * @file respuestas.h
+ * @brief formateo de las respuestas frecuentes del servidor sin reservar memoria
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef RESPUESTAS_H
+#define RESPUESTAS_H
+
+#include "config.h"
+#include "buffer_entrada.h"
+
+#define MAX_RESPUESTA MAX_LINEA_IRC /**< Una respuesta es una linea IRC, CRLF incluido */
+
+/* Numericas de error que se formatean aqui (RFC 2812, 5.2) */
+#define RESP_NOSUCHNICK 401
+#define RESP_NOSUCHCHANNEL 403
+#define RESP_NOORIGIN 409
+#define RESP_NOTEXTTOSEND 412
+#define RESP_UNKNOWNCOMMAND 421
+#define RESP_NONICKNAMEGIVEN 431
+#define RESP_NOTONCHANNEL 442
+#define RESP_NOTREGISTERED 451
+#define RESP_NEEDMOREPARAMS 461
+#define RESP_CHANOPRIVSNEEDED 482
+
+#define CABECERA_SERVICIO ":" SERVICIO " " /**< Prefijo de las respuestas del propio servidor */
+
+typedef struct _Respuesta {
+
+	size_t len; /**< Bytes escritos, sin contar el '\\0' */
+	short truncada; /**< Algun campo no cabia y se ha recortado */
+	char datos[MAX_RESPUESTA + 1];
+
+} Respuesta, *pRespuesta;
+
+unsigned long respuestasTruncadas; /**< Respuestas recortadas para no pasar de MAX_RESPUESTA */
+
+/**
+ * @brief Escribe bytes en la respuesta, dejando sitio para el CRLF
+ */
+static inline void escribirRespuesta(pRespuesta r, const char *datos, size_t len){
+	size_t libre = MAX_RESPUESTA - 2 - r->len;
+
+	if(len > libre){
+		len = libre;
+		r->truncada = 1;
+	}
+	memcpy(r->datos + r->len, datos, len);
+	r->len += len;
+}
+
+/**
+ * @brief Escribe una cadena en la respuesta, nada si es NULL
+ */
+static inline void escribirCadena(pRespuesta r, const char *cadena){
+
+	if(cadena != NULL){
+		escribirRespuesta(r, cadena, strlen(cadena));
+	}
+}
+
+/** Los literales se escriben con su longitud calculada al compilar */
+#define ESCRIBIR_LITERAL(r, literal) escribirRespuesta((r), (literal), sizeof(literal) - 1)
+
+/** Empieza una respuesta del servidor con su numerica, p.ej. INICIAR_NUMERICA(r, "353") */
+#define INICIAR_NUMERICA(r, numerica) do { \
+		(r)->len = 0; \
+		(r)->truncada = 0; \
+		ESCRIBIR_LITERAL((r), CABECERA_SERVICIO numerica " "); \
+	} while(0)
+
+void iniciarRespuesta(pRespuesta r, char *prefijo);
+
+size_t terminarRespuesta(pRespuesta r);
+
+size_t respuestaError(pRespuesta r, int numerica, char *nick, char *parametro);
+
+size_t respuestaPrivmsg(pRespuesta r, char *prefijo, char *destino, char *texto);
+
+size_t respuestaPong(pRespuesta r, char *destino, char *origen);
+
+size_t respuestaJoin(pRespuesta r, char *prefijo, char *canal);
+
+size_t respuestaPart(pRespuesta r, char *prefijo, char *canal, char *texto);
+
+size_t respuestaQuit(pRespuesta r, char *prefijo, char *texto);
+
+size_t respuestaNick(pRespuesta r, char *prefijo, char *nick);
+
+size_t respuestaNamReply(pRespuesta r, char *nick, char *canal, char *nombres, size_t len);
+
+size_t respuestaEndOfNames(pRespuesta r, char *nick, char *canal);
+
+size_t respuestaWhoReply(pRespuesta r, char *nick, char *canal, char *user, char *host, char *nickMiembro, char *real);
+
+size_t respuestaEndOfWho(pRespuesta r, char *nick, char *mascara);
+
+size_t respuestaList(pRespuesta r, char *nick, char *canal, char *visibles, char *topic);
+
+size_t respuestaListEnd(pRespuesta r, char *nick);
+
+status enviarRespuesta(int sckfd, pRespuesta r);
+
+status enviarError(int sckfd, int numerica, char *nick, char *parametro);
+
+status enviarNombres(int sckfd, char *nick, char *canal, char *nombres);
+
+#endif /* RESPUESTAS_H */
@@ -0,0 +1,56 @@
+/**
+ * @file rueda.h
+ * @brief rueda jerarquica de temporizadores de cada reactor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef RUEDA_H
+#define RUEDA_H
+
+#include "config.h"
+
+#define RUEDA_OK 0
+#define RUEDA_ERROR -1
+
+#define BITS_RUEDA 6 /**< Cada nivel tiene 2^BITS_RUEDA ranuras */
+#define RANURAS_RUEDA (1 << BITS_RUEDA)
+#define MASCARA_RUEDA (RANURAS_RUEDA - 1)
+#define NIVELES_RUEDA 4 /**< Con ticks de un segundo la rueda alcanza unos 194 dias */
+#define ALCANCE_RUEDA (1UL << (BITS_RUEDA * NIVELES_RUEDA)) /**< Ticks maximos hasta un vencimiento */
+
+struct _Temporizador;
+
+/** Se llama al vencer, con el mutex de la rueda cogido; devuelve el nuevo vencimiento o 0 */
+typedef unsigned long (*DisparoTemporizador)(struct _Temporizador *temporizador, unsigned long ahora);
+
+typedef struct _Temporizador {
+
+	struct _Temporizador *sig;
+	struct _Temporizador **pant; /**< Puntero que apunta a este temporizador, NULL si no esta programado */
+	unsigned long vence; /**< Tick en el que vence */
+
+} Temporizador, *pTemporizador;
+
+typedef struct _Rueda {
+
+	pthread_mutex_t mutex; /**< La rueda la avanza su reactor, pero cualquier hilo puede cancelar */
+	unsigned long ahora; /**< Ultimo tick procesado */
+	pTemporizador ranuras[NIVELES_RUEDA][RANURAS_RUEDA];
+	DisparoTemporizador disparo;
+	unsigned long programados; /**< Temporizadores en la rueda */
+	unsigned long disparados; /**< Temporizadores vencidos desde que se creo */
+
+} Rueda, *pRueda;
+
+status inicializarRueda(pRueda rueda, DisparoTemporizador disparo);
+
+void programarTemporizador(pRueda rueda, pTemporizador temporizador, unsigned long vence);
+
+void cancelarTemporizador(pRueda rueda, pTemporizador temporizador);
+
+void avanzarRueda(pRueda rueda, unsigned long ticks);
+
+void liberarRueda(pRueda rueda);
+
+#endif /* RUEDA_H */
@@ -0,0 +1,46 @@
+/**
+ * @file sesiones.h
+ * @brief identidad registrada de cada conexion, indexada por descriptor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#ifndef SESIONES_H
+#define SESIONES_H
+
+#include "config.h"
+
+#define SESION_OK 0
+#define SESION_ERROR -1
+
+#define SESION_AWAY 0x01 /**< El usuario ha marcado AWAY */
+
+typedef struct _Sesion {
+
+	long id; /**< Identificador del usuario en el TAD */
+	char *user;
+	char *nick;
+	char *real;
+	char *host;
+	char *IP;
+	char *away; /**< Mensaje de AWAY, NULL si no esta ausente */
+	char *prefijo; /**< Prefijo con el que se firman sus mensajes, ya formateado */
+	int flags;
+
+} Sesion, *pSesion;
+
+status abrirSesion(int fd);
+
+pSesion obtenerSesion(int fd);
+
+long leerSesion(int fd, long *id, char **user, char **nick, char **real, char **host, char **IP, char **away);
+
+char *prefijoSesion(int fd);
+
+status cambiarNickSesion(int fd, char *nick);
+
+status cambiarAwaySesion(int fd, char *away);
+
+void liberarSesion(pSesion sesion);
+
+#endif /* SESIONES_H */
@@ -12,15 +12,23 @@
 
 #define SSL_ERR -1
 #define SSL_OK 0
+#define SSL_LEER 1 /**< El handshake espera a que el socket tenga datos */
+#define SSL_ESCRIBIR 2 /**< El handshake espera a que el socket admita escritura */
 
 int ssl_active;
 
 int inicializar_nivel_SSL();
+
+int descriptor_valido_SSL(int sckfd);
  
 int fijar_contexto_SSL(const char *pcert, const char *pkey);
  
 int conectar_canal_seguro_SSL(int sckfd);
  
+int iniciar_canal_seguro_SSL(int sckfd);
+ 
+int avanzar_handshake_SSL(int sckfd);
+ 
 int aceptar_canal_seguro_SSL(int sckfd);
  
 int evaluar_post_conectar_SSL(int sckfd);
@@ -29,6 +37,8 @@ int enviar_datos_SSL(int sckfd, void* mensaje, int tam);
  
 int recibir_datos_SSL(int sckfd, void* mensaje, int max);
 
+int reintentar_SSL(int sckfd, int ret);
+
 void cerrar_canal_SSL(int sckfd);
 
 void liberar_nivel_SSL();
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Compara los backends epoll e io_uring del servidor en loopback
+# Uso: misc/bench_backends.bash [opciones de bench_carga]
+# Para medir io_uring el servidor debe compilarse con make IO_URING=1
+
+pushd `dirname $0`/.. > /dev/null
+BASEPATH=`pwd -P`
+popd > /dev/null
+
+SERVIDOR="$BASEPATH/servidor"
+BENCH="$BASEPATH/bench_carga"
+PUERTO=${PUERTO:-6690}
+REACTORES=${REACTORES:-1}
+
+for backend in epoll io_uring; do
+
+	flags="-P $PUERTO -r $REACTORES"
+	if [ "$backend" = "io_uring" ]; then
+		flags="$flags -u"
+	fi
+
+	$SERVIDOR $flags > /dev/null 2>&1 &
+	pid=$!
+	sleep 1
+
+	echo "== $backend"
+	$BENCH -P $PUERTO "$@"
+
+	kill -INT $pid 2> /dev/null
+	wait $pid 2> /dev/null
+done
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# Genera el despacho de comandos a partir de los registrados en crea_comandos()
+# Uso: misc/gen_despacho.bash srclib/funciones_servidor.c > includes/despacho_gen.h
+#
+# Cada verbo (como mucho 8 letras) se empaqueta en una palabra de 64 bits,
+# el primer caracter en el byte bajo, y se compara por longitud y palabra.
+
+FUENTE=${1:-srclib/funciones_servidor.c}
+
+# Verbos con manejador propio, en el orden en que se registran
+VERBOS=`sed -n '/^status crea_comandos/,/^}/p' "$FUENTE" \
+	| grep -o 'comandos\[[A-Z][A-Z]*\] *= *[a-z_][a-z_]*' \
+	| sed 's/comandos\[\([A-Z]*\)\].*/\1/'`
+
+if [ -z "$VERBOS" ]; then
+	echo "gen_despacho: no hay comandos registrados en $FUENTE" >&2
+	exit 1
+fi
+
+echo "/* Generado por misc/gen_despacho.bash a partir de crea_comandos(), no editar */"
+echo
+echo "#ifndef DESPACHO_GEN_H"
+echo "#define DESPACHO_GEN_H"
+echo
+echo "static inline long verboGenerado(unsigned long long palabra, size_t len){"
+echo
+echo "	switch(len){"
+
+for len in 1 2 3 4 5 6 7 8; do
+	casos=""
+	for verbo in $VERBOS; do
+		if [ ${#verbo} -ne $len ]; then
+			continue
+		fi
+		palabra=0
+		for ((i = 0; i < len; i++)); do
+			c=`printf '%d' "'${verbo:$i:1}"`
+			palabra=$(( palabra | (c << (8 * i)) ))
+		done
+		casos="$casos`printf '\t\t\t\tcase 0x%xULL: return %s;' $palabra $verbo`\n"
+	done
+	if [ -n "$casos" ]; then
+		printf '\t\tcase %d:\n\t\t\tswitch(palabra){\n%b\t\t\t}\n\t\t\tbreak;\n' $len "$casos"
+	fi
+done
+
+echo "	}"
+echo
+echo "	return -1;"
+echo "}"
+echo
+echo "#endif /* DESPACHO_GEN_H */"
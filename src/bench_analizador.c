@@ -0,0 +1,323 @@
+/**
+ * @file bench_analizador.c
+ * @brief mide las lineas por segundo que analiza la libreria IRC y el analizador propio
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+*/
+
+/**
+ * @defgroup BenchAnalizador BenchAnalizador
+ *
+ * <hr>
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "../includes/config.h"
+#include "../includes/bench.h"
+#include "../includes/analizador.h"
+#include "../includes/buffer_entrada.h"
+
+#include <redes2/irc.h>
+
+#define BENCH_LINEAS 100000
+#define BENCH_RONDAS 10
+
+/**
+ * @addtogroup BenchAnalizador
+ * Genera un corpus con la mezcla de trafico de un servidor con canales
+ * concurridos (sobre todo PRIVMSG a canales, algo de privados, PING y PONG,
+ * JOIN, PART, WHO, MODE, NICK y QUIT) y lo analiza de dos formas:
+ *
+ * - libreria: IRC_UnPipelineCommands, IRC_CommandQuery y el IRCParse_* de
+ *   cada comando, liberando lo que devuelven, como hacia manejaMensaje. El
+ *   servidor nunca analizo los PONG, asi que para ellos solo se consulta el
+ *   comando.
+ * - analizador: analizarLinea en su sitio sobre las lineas terminadas en
+ *   CRLF y '\\0', como las entrega ensamblarLineas.
+ *
+ * <hr>
+ */
+
+typedef struct _Plantilla {
+	int peso; /**< Lineas de cada 100 del corpus */
+	char *formato; /**< Recibe dos enteros: un usuario y un canal o un testigo */
+} Plantilla;
+
+static Plantilla corpus[] = {
+	{55, "PRIVMSG #canal%d :mensaje %d al canal con unas cuantas palabras de relleno"},
+	{10, "PRIVMSG usuario%d :mensaje privado %d"},
+	{10, "PING :LAG%d%d"},
+	{5, "PONG :servidor%d.%d"},
+	{5, "JOIN #canal%d%d"},
+	{4, "PART #canal%d :me voy %d"},
+	{3, "WHO #canal%d%d"},
+	{3, "MODE #canal%d +o usuario%d"},
+	{3, "NICK usuario%d_%d"},
+	{2, "QUIT :cliente %d cerrado %d"},
+};
+
+/**
+ * @ingroup BenchAnalizador
+ *
+ * @brief Genera el corpus en los dos formatos
+ *
+ * @synopsis
+ * @code
+ * 	status generarCorpus(int lineas, char **crlf, size_t *lenCrlf, char **nulos, size_t *lenNulos)
+ * @endcode
+ *
+ * @param[in] lineas lineas del corpus
+ * @param[out] crlf lineas seguidas terminadas en CRLF, para la libreria
+ * @param[out] lenCrlf longitud de crlf
+ * @param[out] nulos lineas terminadas en CRLF y '\\0', para el analizador
+ * @param[out] lenNulos longitud de nulos
+ *
+ * @return ANALIZADOR_OK si todo va bien. ANALIZADOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status generarCorpus(int lineas, char **crlf, size_t *lenCrlf, char **nulos, size_t *lenNulos){
+	char linea[MAX_LINEA_IRC];
+	unsigned int semilla = 1234;
+	int i, j, tirada, n;
+
+	*crlf = (char *) malloc((size_t) lineas * MAX_LINEA_IRC + 1);
+	*nulos = (char *) malloc((size_t) lineas * (MAX_LINEA_IRC + 1) + 1);
+	if(*crlf == NULL || *nulos == NULL){
+		free(*crlf);
+		free(*nulos);
+		return ANALIZADOR_ERROR;
+	}
+	*lenCrlf = *lenNulos = 0;
+
+	for(i = 0; i < lineas; i++){
+		tirada = rand_r(&semilla) % 100;
+		for(j = 0; tirada >= corpus[j].peso; j++){
+			tirada -= corpus[j].peso;
+		}
+
+		n = snprintf(linea, sizeof(linea) - 2, corpus[j].formato, rand_r(&semilla) % 64, i);
+		linea[n++] = '\r';
+		linea[n++] = '\n';
+
+		memcpy(*crlf + *lenCrlf, linea, n);
+		*lenCrlf += n;
+		memcpy(*nulos + *lenNulos, linea, n);
+		*lenNulos += n;
+		(*nulos)[(*lenNulos)++] = '\0';
+	}
+	(*crlf)[*lenCrlf] = '\0';
+
+	return ANALIZADOR_OK;
+}
+
+/**
+ * @ingroup BenchAnalizador
+ *
+ * @brief Analiza el corpus con la libreria IRC
+ *
+ * @synopsis
+ * @code
+ * 	long analizarLibreria(char *msg)
+ * @endcode
+ *
+ * @param[in] msg lineas terminadas en CRLF
+ *
+ * @return lineas analizadas
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+long analizarLibreria(char *msg){
+	char *next, *comando;
+	char *prefijo, *a, *b, *c;
+	long lineas = 0;
+
+	next = msg;
+	while(next != NULL){
+		next = IRC_UnPipelineCommands(next, &comando);
+		if(comando == NULL){
+			break;
+		}
+		prefijo = a = b = c = NULL;
+
+		switch(IRC_CommandQuery(comando)){
+			case PRIVMSG:
+				IRCParse_Privmsg(comando, &prefijo, &a, &b);
+				break;
+			case PING:
+				IRCParse_Ping(comando, &prefijo, &a, &b, &c);
+				break;
+			case JOIN:
+				IRCParse_Join(comando, &prefijo, &a, &b, &c);
+				break;
+			case PART:
+				IRCParse_Part(comando, &prefijo, &a, &b);
+				break;
+			case WHO:
+				IRCParse_Who(comando, &prefijo, &a, &b);
+				break;
+			case MODE:
+				IRCParse_Mode(comando, &prefijo, &a, &b, &c);
+				break;
+			case NICK:
+				IRCParse_Nick(comando, &prefijo, &a, &b);
+				break;
+			case QUIT:
+				IRCParse_Quit(comando, &prefijo, &a);
+				break;
+		}
+
+		if(prefijo) free(prefijo);
+		if(a) free(a);
+		if(b) free(b);
+		if(c) free(c);
+		free(comando);
+		lineas++;
+	}
+
+	return lineas;
+}
+
+/**
+ * @ingroup BenchAnalizador
+ *
+ * @brief Analiza el corpus en su sitio
+ *
+ * @synopsis
+ * @code
+ * 	long analizarPropio(char *msg, size_t len)
+ * @endcode
+ *
+ * @param[in] msg lineas terminadas en CRLF y '\\0'
+ * @param[in] len longitud de msg
+ *
+ * @return lineas analizadas
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+long analizarPropio(char *msg, size_t len){
+	LineaIRC linea;
+	char *comando, *fin;
+	size_t lenLinea;
+	long lineas = 0, params = 0;
+
+	fin = msg + len;
+	for(comando = msg; comando < fin; comando += lenLinea + 1){
+		lenLinea = strlen(comando);
+		if(analizarLinea(comando, lenLinea, &linea) == ANALIZADOR_OK){
+			params += linea.numParams;
+		}
+		lineas++;
+	}
+
+	/* Que el compilador no pueda descartar el analisis */
+	if(params < 0){
+		printf("%ld\n", params);
+	}
+
+	return lineas;
+}
+
+/**
+ * @ingroup BenchAnalizador
+ *
+ * @brief Imprime por stderr la ayuda de usuario
+ *
+ * @synopsis
+ * @code
+ * 	void usage(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void usage(void){
+	fprintf(stderr, "usage: [-h] --lineas <n> --rondas <n>\n");
+	fprintf(stderr, " -l --lineas <n>\tLineas del corpus (por defecto %d)\n", BENCH_LINEAS);
+	fprintf(stderr, " -r --rondas <n>\tVeces que se analiza el corpus (por defecto %d)\n", BENCH_RONDAS);
+}
+
+int main(int argc, char *argv[]){
+
+	int c, i, index = 0;
+	int lineas = BENCH_LINEAS, rondas = BENCH_RONDAS;
+	char *crlf, *nulos;
+	size_t lenCrlf, lenNulos;
+	struct timespec inicio, fin;
+	long long antes, despues;
+	long analizadas = 0;
+
+	static struct option long_options[] =
+        {
+          {"lineas",  required_argument, 0, 'l'},
+          {"rondas",  required_argument, 0, 'r'},
+          {0, 0, 0, 0}
+        };
+
+	while ((c = getopt_long (argc, argv, "hl:r:", long_options, &index)) != -1){
+		switch (c) {
+			case 'l':
+				lineas = atoi(optarg);
+				break;
+			case 'r':
+				rondas = atoi(optarg);
+				break;
+			default:
+				usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(lineas <= 0 || rondas <= 0){
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	if(generarCorpus(lineas, &crlf, &lenCrlf, &nulos, &lenNulos) != ANALIZADOR_OK){
+		fprintf(stderr, "No se ha podido reservar el corpus\n");
+		exit(EXIT_FAILURE);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < rondas; i++){
+		analizadas += analizarLibreria(crlf);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	antes = nanosegundos(&inicio, &fin);
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < rondas; i++){
+		analizadas -= analizarPropio(nulos, lenNulos);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	despues = nanosegundos(&inicio, &fin);
+
+	printf("lineas=%d rondas=%d bytes=%zu\n", lineas, rondas, lenCrlf);
+	printf("libreria:   %12.0f lineas/s %8.1f ns/linea\n", (double) lineas * rondas / ((double) antes / 1000000000.0), (double) antes / ((double) lineas * rondas));
+	printf("analizador: %12.0f lineas/s %8.1f ns/linea\n", (double) lineas * rondas / ((double) despues / 1000000000.0), (double) despues / ((double) lineas * rondas));
+	if(analizadas != 0){
+		printf("Aviso: la libreria y el analizador no han separado las mismas lineas\n");
+	}
+
+	free(crlf);
+	free(nulos);
+
+	exit(EXIT_SUCCESS);
+}
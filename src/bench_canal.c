@@ -0,0 +1,196 @@
+/**
+ * @file bench_canal.c
+ * @brief mide lo que cuesta difundir una linea a un canal con muchos miembros
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+*/
+
+/**
+ * @defgroup BenchCanal BenchCanal
+ *
+ * <hr>
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "../includes/config.h"
+#include "../includes/bench.h"
+#include "../includes/funciones_servidor.h"
+#include "../includes/red_servidor.h"
+#include "../includes/conexiones.h"
+#include "../includes/canales.h"
+
+#include <redes2/irc.h>
+
+#define BENCH_MIEMBROS 5000
+#define BENCH_MENSAJES 20
+#define BENCH_CANAL "#bench"
+#define BENCH_LINEA ":bench0!bench0@localhost PRIVMSG #bench :linea de prueba del canal\r\n"
+
+/**
+ * @addtogroup BenchCanal
+ * Une a un canal miembros conectados por socketpair, registrados en el TAD y
+ * en la tabla de conexiones, y compara por mensaje la difusion que hacia el
+ * servidor (lista de nicks del TAD y busqueda del socket de cada nick) con
+ * la difusion por el indice de miembros del canal.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup BenchCanal
+ *
+ * @brief Difunde una linea a un canal como lo hacia el servidor, a traves del TAD
+ *
+ * @synopsis
+ * @code
+ * 	void difundirTAD(char *canal, char *mensaje, char *nickorigin)
+ * @endcode
+ *
+ * @param[in] canal canal al que enviar el mensaje
+ * @param[in] mensaje mensaje a enviar
+ * @param[in] nickorigin nick que no lo recibe
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void difundirTAD(char *canal, char *mensaje, char *nickorigin){
+	char **lista = NULL;
+	long num = 0;
+	long i;
+
+	if(IRCTAD_ListNicksOnChannelArray(canal, &lista, &num) != IRC_OK){
+		return;
+	}
+
+	for(i=0; i<num; i++) {
+		if(nickorigin && !strcmp(nickorigin, lista[i])){
+			continue;
+		}
+		enviar(socketDeNick(lista[i]), mensaje);
+	}
+
+	if(lista){
+		for(i=0; i<num; i++){
+			if(lista[i]) free(lista[i]);
+		}
+		free(lista);
+	}
+}
+
+/**
+ * @ingroup BenchCanal
+ *
+ * @brief Imprime por stderr la ayuda de usuario
+ *
+ * @synopsis
+ * @code
+ * 	void usage(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void usage(void){
+	fprintf(stderr, "usage: [-h] --miembros <n> --mensajes <n>\n");
+	fprintf(stderr, " -m --miembros <n>\tMiembros del canal (por defecto %d)\n", BENCH_MIEMBROS);
+	fprintf(stderr, " -n --mensajes <n>\tLineas difundidas con cada metodo (por defecto %d)\n", BENCH_MENSAJES);
+}
+
+int main(int argc, char *argv[]){
+
+	int c, i, index = 0, nMiembros = BENCH_MIEMBROS, mensajes = BENCH_MENSAJES;
+	int *servidor = NULL, *clientes = NULL, unidos = 0;
+	char nombre[32];
+	struct timespec inicio, fin;
+	long long antes, despues;
+	long bytesAntes, bytesDespues;
+
+	static struct option long_options[] =
+        {
+          {"miembros",  required_argument, 0, 'm'},
+          {"mensajes",  required_argument, 0, 'n'},
+          {0, 0, 0, 0}
+        };
+
+	while ((c = getopt_long (argc, argv, "hm:n:", long_options, &index)) != -1){
+		switch (c) {
+			case 'm':
+				nMiembros = atoi(optarg);
+				break;
+			case 'n':
+				mensajes = atoi(optarg);
+				break;
+			default:
+				usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(inicializarConexiones() < 0 || inicializarEpocas() != EPOCA_OK || inicializarCanales(PARTICIONES_CANALES) != CANAL_OK){
+		fprintf(stderr, "No se han podido reservar las tablas de conexiones y canales\n");
+		exit(EXIT_FAILURE);
+	}
+
+	servidor = (int *) malloc(nMiembros * sizeof(int));
+	clientes = (int *) malloc(nMiembros * sizeof(int));
+	if(servidor == NULL || clientes == NULL){
+		fprintf(stderr, "No se ha podido reservar memoria\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Cada miembro es un socketpair: el servidor escribe en un extremo y se lee del otro */
+	nMiembros = crearUsuarios("bench", nMiembros, servidor, clientes);
+	for(i = 0; i < nMiembros; i++){
+		snprintf(nombre, sizeof(nombre), "bench%d", i);
+		if(IRCTAD_Join(BENCH_CANAL, nombre, NULL, NULL) == IRC_OK && unirCanal(BENCH_CANAL, servidor[i]) == CANAL_OK){
+			unidos++;
+		}
+	}
+
+	if(unidos == 0){
+		fprintf(stderr, "No se ha podido unir ningun miembro al canal\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Antes: lista de nicks del TAD y, por cada uno, su socket */
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < mensajes; i++){
+		difundirTAD(BENCH_CANAL, BENCH_LINEA, "bench0");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	antes = nanosegundos(&inicio, &fin);
+	bytesAntes = vaciarUsuarios(clientes, nMiembros);
+
+	/* Despues: se recorre el array de descriptores del canal */
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < mensajes; i++){
+		difundirCanal(BENCH_CANAL, BENCH_LINEA, sizeof(BENCH_LINEA) - 1, servidor[0]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	despues = nanosegundos(&inicio, &fin);
+	bytesDespues = vaciarUsuarios(clientes, nMiembros);
+
+	printf("miembros=%d mensajes=%d\n", unidos, mensajes);
+	printf("TAD:    %10.1f us/mensaje %8.1f ns/miembro\n", (double) antes / mensajes / 1000.0, (double) antes / ((double) mensajes * unidos));
+	printf("indice: %10.1f us/mensaje %8.1f ns/miembro\n", (double) despues / mensajes / 1000.0, (double) despues / ((double) mensajes * unidos));
+	if(bytesAntes != bytesDespues){
+		printf("Aviso: los miembros no han recibido lo mismo (%ld y %ld bytes)\n", bytesAntes, bytesDespues);
+	}
+
+	liberarUsuarios("bench", nMiembros, servidor, clientes);
+	liberarCanales();
+	liberarEpocas();
+	liberarConexiones();
+	free(servidor);
+	free(clientes);
+
+	exit(EXIT_SUCCESS);
+}
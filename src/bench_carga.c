@@ -0,0 +1,649 @@
+/**
+ * @file bench_carga.c
+ * @brief generador de carga en loopback para medir el servidor IRC
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+*/
+
+/**
+ * @defgroup BenchCarga BenchCarga
+ *
+ * <hr>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "../includes/bench.h"
+
+#define BENCH_HOST "127.0.0.1"
+#define BENCH_PUERTO 6667
+#define BENCH_CLIENTES 50
+#define BENCH_MENSAJES 2000
+#define BENCH_VENTANA 8
+#define BENCH_LINEA 512
+#define BENCH_TIMEOUT_MS 10000
+
+#define MENSAJE_BENCH "PING bench\r\n"
+
+/**
+ * @addtogroup BenchCarga
+ * Abre varios clientes contra el servidor y mide cuantas lineas por segundo
+ * contesta y con que latencia. Cada cliente mantiene una ventana de lineas
+ * enviadas sin respuesta y cuenta una respuesta por cada linea recibida.
+ * Con -A mide en cambio una tormenta de conexiones: todos los clientes
+ * conectan a la vez y se mide cuanto tarda cada uno en recibir su primera
+ * respuesta, o el 001 con -R.
+ *
+ * <hr>
+ */
+
+typedef struct _ClienteBench {
+
+	int fd;
+	short registrado;
+	int enviados;
+	int recibidos;
+	struct timespec *envios; /**< Instante de envio de las lineas en vuelo */
+	char linea[BENCH_LINEA];
+	int lenLinea;
+
+} ClienteBench, *pClienteBench;
+
+typedef struct _ConexionBench {
+
+	int fd;
+	short conectado;
+	struct timespec inicio; /**< Instante del connect */
+	char linea[BENCH_LINEA];
+	int lenLinea;
+
+} ConexionBench, *pConexionBench;
+
+int nMensajes = BENCH_MENSAJES;
+int ventana = BENCH_VENTANA;
+long long *latencias; /**< Latencia en ns de cada respuesta */
+long nLatencias;
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Imprime por stderr la ayuda de usuario
+ *
+ * @synopsis
+ * @code
+ * 	void usage(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void usage(void){
+	fprintf(stderr, "usage: bench_carga [-RA] -H <host> -P <puerto> -c <clientes> -n <mensajes> -v <ventana>\n");
+	fprintf(stderr, " -H --host <host>\tIP del servidor (por defecto %s)\n", BENCH_HOST);
+	fprintf(stderr, " -P --port <puerto>\tPuerto del servidor (por defecto %d)\n", BENCH_PUERTO);
+	fprintf(stderr, " -c --clientes <n>\tConexiones simultaneas (por defecto %d)\n", BENCH_CLIENTES);
+	fprintf(stderr, " -n --mensajes <n>\tLineas por cliente (por defecto %d)\n", BENCH_MENSAJES);
+	fprintf(stderr, " -v --ventana <n>\tLineas en vuelo por cliente (por defecto %d)\n", BENCH_VENTANA);
+	fprintf(stderr, " -R --registrar\tRegistra cada cliente con NICK/USER antes de medir\n");
+	fprintf(stderr, " -A --aceptar\tMide cuanto tarda el servidor en atender -c conexiones simultaneas\n");
+}
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Funcion de comparacion para qsort
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int compararLL(const void *a, const void *b){
+	long long x = *(const long long *) a, y = *(const long long *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Envia una cadena completa por un socket no bloqueante
+ *
+ * @synopsis
+ * @code
+ * 	int enviarTodo(int fd, const char *msg, size_t len)
+ * @endcode
+ *
+ * @return 0 si todo va bien, -1 en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int enviarTodo(int fd, const char *msg, size_t len){
+	ssize_t n;
+
+	while(len > 0){
+		n = send(fd, msg, len, MSG_NOSIGNAL);
+		if(n < 0){
+			if(errno == EINTR || errno == EAGAIN) continue;
+			return -1;
+		}
+		msg += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Envia lineas hasta llenar la ventana del cliente
+ *
+ * @synopsis
+ * @code
+ * 	int llenarVentana(pClienteBench cli)
+ * @endcode
+ *
+ * @return 0 si todo va bien, -1 en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int llenarVentana(pClienteBench cli){
+
+	while(cli->enviados < nMensajes && cli->enviados - cli->recibidos < ventana){
+		clock_gettime(CLOCK_MONOTONIC, &cli->envios[cli->enviados % ventana]);
+		if(enviarTodo(cli->fd, MENSAJE_BENCH, strlen(MENSAJE_BENCH)) < 0){
+			return -1;
+		}
+		cli->enviados++;
+	}
+
+	return 0;
+}
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Procesa una linea completa recibida por un cliente
+ *
+ * @synopsis
+ * @code
+ * 	int procesarLinea(pClienteBench cli)
+ * @endcode
+ *
+ * @return 1 si el cliente ha terminado, 0 si sigue, -1 en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int procesarLinea(pClienteBench cli){
+	struct timespec ahora;
+
+	/* Hasta el 001 de bienvenida no empezamos a medir */
+	if(!cli->registrado){
+		if(strstr(cli->linea, " 001 ")){
+			cli->registrado = 1;
+			return llenarVentana(cli);
+		}
+		return 0;
+	}
+
+	if(cli->recibidos >= cli->enviados){
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ahora);
+	latencias[nLatencias++] = nanosegundos(&cli->envios[cli->recibidos % ventana], &ahora);
+	cli->recibidos++;
+
+	if(cli->recibidos == nMensajes){
+		return 1;
+	}
+
+	return llenarVentana(cli);
+}
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Abre una conexion TCP no bloqueante con el servidor
+ *
+ * @synopsis
+ * @code
+ * 	int conectar(struct sockaddr_in *addr)
+ * @endcode
+ *
+ * @return el socket, o -1 en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int conectar(struct sockaddr_in *addr){
+	int fd, uno = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0){
+		return -1;
+	}
+
+	if(connect(fd, (struct sockaddr *) addr, sizeof(*addr)) < 0){
+		close(fd);
+		return -1;
+	}
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	return fd;
+}
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Imprime la media y los percentiles de las latencias medidas
+ *
+ * @synopsis
+ * @code
+ * 	void imprimirLatencias(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void imprimirLatencias(void){
+	long long suma = 0;
+	long i;
+
+	qsort(latencias, nLatencias, sizeof(long long), compararLL);
+	for(i = 0; i < nLatencias; i++){
+		suma += latencias[i];
+	}
+
+	printf("latencia_media=%.1fus p50=%.1fus p99=%.1fus max=%.1fus\n",
+		suma / (double) nLatencias / 1000.0,
+		latencias[nLatencias / 2] / 1000.0, latencias[(nLatencias * 99) / 100] / 1000.0,
+		latencias[nLatencias - 1] / 1000.0);
+}
+
+/**
+ * @ingroup BenchCarga
+ *
+ * @brief Conecta todos los clientes a la vez y mide cuanto tarda cada uno en ser atendido
+ *
+ * Los connect no bloqueantes salen todos antes de esperar ninguna
+ * respuesta, de modo que el servidor ve una avalancha como la de una
+ * reconexion masiva. La latencia de cada cliente va desde su connect hasta
+ * su primera linea de respuesta.
+ *
+ * @synopsis
+ * @code
+ * 	int tormentaConexiones(struct sockaddr_in *addr, int n, int registrar)
+ * @endcode
+ *
+ * @param[in] addr direccion del servidor
+ * @param[in] n numero de conexiones
+ * @param[in] registrar 1 para esperar al 001 tras NICK/USER en lugar de a un PING
+ *
+ * @return EXIT_SUCCESS si todas las conexiones son atendidas
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int tormentaConexiones(struct sockaddr_in *addr, int n, int registrar){
+	int i, j, epfd, nfds, err, atendidas = 0, fallidas = 0;
+	socklen_t len;
+	pConexionBench conexiones, con;
+	struct epoll_event ev, eventos[256];
+	struct timespec inicio, fin, ahora;
+	struct rlimit lim;
+	char msg[128], buffer[4096];
+	ssize_t tam;
+
+	/* Cada conexion es un descriptor, pedimos todos los que se permitan */
+	if(getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max){
+		lim.rlim_cur = lim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+
+	conexiones = (pConexionBench) calloc(n, sizeof(ConexionBench));
+	latencias = (long long *) malloc((size_t) n * sizeof(long long));
+	epfd = epoll_create1(0);
+	if(conexiones == NULL || latencias == NULL || epfd < 0){
+		perror("Error inicializando el benchmark");
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+	for(i = 0; i < n; i++){
+		con = &conexiones[i];
+		con->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		if(con->fd < 0){
+			perror("Error creando socket");
+			fallidas += n - i;
+			break;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &con->inicio);
+		if(connect(con->fd, (struct sockaddr *) addr, sizeof(*addr)) < 0 && errno != EINPROGRESS){
+			close(con->fd);
+			con->fd = -1;
+			fallidas++;
+			continue;
+		}
+
+		ev.events = EPOLLOUT;
+		ev.data.ptr = con;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, con->fd, &ev);
+	}
+
+	while(atendidas + fallidas < n){
+
+		nfds = epoll_wait(epfd, eventos, 256, BENCH_TIMEOUT_MS);
+		if(nfds == 0){
+			fprintf(stderr, "Sin respuesta del servidor en %d ms\n", BENCH_TIMEOUT_MS);
+			break;
+		} else if(nfds < 0){
+			continue;
+		}
+
+		for(i = 0; i < nfds; i++){
+			con = (pConexionBench) eventos[i].data.ptr;
+
+			/* Conexion establecida, mandamos la primera peticion */
+			if(!con->conectado){
+				err = 0;
+				len = sizeof(err);
+				getsockopt(con->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+				if(err != 0){
+					epoll_ctl(epfd, EPOLL_CTL_DEL, con->fd, NULL);
+					fallidas++;
+					continue;
+				}
+
+				if(registrar){
+					snprintf(msg, sizeof(msg), "NICK tormenta%ld\r\nUSER tormenta 0 * :bench\r\n", (long)(con - conexiones));
+				} else {
+					snprintf(msg, sizeof(msg), MENSAJE_BENCH);
+				}
+				if(enviarTodo(con->fd, msg, strlen(msg)) < 0){
+					epoll_ctl(epfd, EPOLL_CTL_DEL, con->fd, NULL);
+					fallidas++;
+					continue;
+				}
+
+				con->conectado = 1;
+				ev.events = EPOLLIN;
+				ev.data.ptr = con;
+				epoll_ctl(epfd, EPOLL_CTL_MOD, con->fd, &ev);
+				continue;
+			}
+
+			tam = recv(con->fd, buffer, sizeof(buffer), 0);
+			if(tam <= 0){
+				if(tam < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+				epoll_ctl(epfd, EPOLL_CTL_DEL, con->fd, NULL);
+				fallidas++;
+				continue;
+			}
+
+			for(j = 0; j < tam; j++){
+				if(con->lenLinea < BENCH_LINEA - 1){
+					con->linea[con->lenLinea++] = buffer[j];
+				}
+				if(buffer[j] != '\n'){
+					continue;
+				}
+				con->linea[con->lenLinea] = 0;
+				con->lenLinea = 0;
+
+				/* Registrando solo cuenta la bienvenida */
+				if(registrar && !strstr(con->linea, " 001 ")){
+					continue;
+				}
+
+				clock_gettime(CLOCK_MONOTONIC, &ahora);
+				latencias[nLatencias++] = nanosegundos(&con->inicio, &ahora);
+				epoll_ctl(epfd, EPOLL_CTL_DEL, con->fd, NULL);
+				atendidas++;
+				break;
+			}
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+
+	/* Las conexiones siguen abiertas hasta el final para que sean simultaneas */
+	for(i = 0; i < n; i++){
+		if(conexiones[i].fd >= 0) close(conexiones[i].fd);
+	}
+
+	printf("conexiones=%d atendidas=%d fallidas=%d tiempo=%.3fs\n",
+		n, atendidas, fallidas, nanosegundos(&inicio, &fin) / 1e9);
+
+	if(nLatencias > 0){
+		printf("conexiones/s=%.0f ", atendidas / (nanosegundos(&inicio, &fin) / 1e9));
+		imprimirLatencias();
+	}
+
+	free(latencias);
+	free(conexiones);
+	close(epfd);
+
+	return atendidas == n ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]){
+
+	int c, i, j, index = 0, nClientes = BENCH_CLIENTES, registrar = 0, tormenta = 0;
+	int epfd, nfds, terminados = 0, fallidos = 0, ret;
+	unsigned short puerto = BENCH_PUERTO;
+	char *host = BENCH_HOST;
+	char nick[64], buffer[4096];
+	ssize_t tam;
+	pClienteBench clientes, cli;
+	struct sockaddr_in addr;
+	struct epoll_event ev, eventos[64];
+	struct timespec inicio, fin;
+	double segundos;
+
+	static struct option long_options[] =
+        {
+          {"host",  required_argument, 0, 'H'},
+          {"port",  required_argument, 0, 'P'},
+          {"clientes",  required_argument, 0, 'c'},
+          {"mensajes",  required_argument, 0, 'n'},
+          {"ventana",  required_argument, 0, 'v'},
+          {"registrar",  no_argument,       0, 'R'},
+          {"aceptar",  no_argument,       0, 'A'},
+          {0, 0, 0, 0}
+        };
+
+	while ((c = getopt_long (argc, argv, "RAhH:P:c:n:v:", long_options, &index)) != -1){
+		switch (c) {
+			case 'H':
+				host = optarg;
+				break;
+			case 'P':
+				puerto = atoi(optarg);
+				break;
+			case 'c':
+				nClientes = atoi(optarg);
+				break;
+			case 'n':
+				nMensajes = atoi(optarg);
+				break;
+			case 'v':
+				ventana = atoi(optarg);
+				break;
+			case 'R':
+				registrar = 1;
+				break;
+			case 'A':
+				tormenta = 1;
+				break;
+			default:
+				usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(nClientes <= 0 || nMensajes <= 0 || ventana <= 0){
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(puerto);
+	if(inet_pton(AF_INET, host, &addr.sin_addr) != 1){
+		fprintf(stderr, "IP no valida: %s\n", host);
+		exit(EXIT_FAILURE);
+	}
+
+	if(tormenta){
+		return tormentaConexiones(&addr, nClientes, registrar);
+	}
+
+	clientes = (pClienteBench) calloc(nClientes, sizeof(ClienteBench));
+	latencias = (long long *) malloc((size_t) nClientes * nMensajes * sizeof(long long));
+	epfd = epoll_create1(0);
+	if(clientes == NULL || latencias == NULL || epfd < 0){
+		perror("Error inicializando el benchmark");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Conectamos todos los clientes antes de empezar a medir */
+	for(i = 0; i < nClientes; i++){
+		cli = &clientes[i];
+		cli->envios = (struct timespec *) calloc(ventana, sizeof(struct timespec));
+		cli->fd = conectar(&addr);
+		if(cli->envios == NULL || cli->fd < 0){
+			perror("Error conectando con el servidor");
+			exit(EXIT_FAILURE);
+		}
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = cli;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, cli->fd, &ev);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+	for(i = 0; i < nClientes; i++){
+		cli = &clientes[i];
+		if(registrar){
+			snprintf(nick, sizeof(nick), "NICK bench%d\r\nUSER bench%d 0 * :bench\r\n", i, i);
+			ret = enviarTodo(cli->fd, nick, strlen(nick));
+		} else {
+			cli->registrado = 1;
+			ret = llenarVentana(cli);
+		}
+		if(ret < 0){
+			fallidos++;
+		}
+	}
+
+	while(terminados + fallidos < nClientes){
+
+		nfds = epoll_wait(epfd, eventos, 64, BENCH_TIMEOUT_MS);
+		if(nfds == 0){
+			fprintf(stderr, "Sin respuesta del servidor en %d ms\n", BENCH_TIMEOUT_MS);
+			break;
+		} else if(nfds < 0){
+			continue;
+		}
+
+		for(i = 0; i < nfds; i++){
+			cli = (pClienteBench) eventos[i].data.ptr;
+
+			tam = recv(cli->fd, buffer, sizeof(buffer), 0);
+			if(tam <= 0){
+				if(tam < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+				epoll_ctl(epfd, EPOLL_CTL_DEL, cli->fd, NULL);
+				fallidos++;
+				continue;
+			}
+
+			/* Troceamos en lineas, cada una es una respuesta */
+			for(j = 0; j < tam; j++){
+				if(cli->lenLinea < BENCH_LINEA - 1){
+					cli->linea[cli->lenLinea++] = buffer[j];
+				}
+				if(buffer[j] != '\n'){
+					continue;
+				}
+				cli->linea[cli->lenLinea] = 0;
+				cli->lenLinea = 0;
+
+				ret = procesarLinea(cli);
+				if(ret != 0){
+					epoll_ctl(epfd, EPOLL_CTL_DEL, cli->fd, NULL);
+					if(ret > 0) terminados++;
+					else fallidos++;
+					break;
+				}
+			}
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	segundos = nanosegundos(&inicio, &fin) / 1e9;
+
+	for(i = 0; i < nClientes; i++){
+		close(clientes[i].fd);
+		free(clientes[i].envios);
+	}
+
+	if(nLatencias == 0){
+		fprintf(stderr, "No se ha recibido ninguna respuesta\n");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("clientes=%d ventana=%d respuestas=%ld fallidos=%d tiempo=%.3fs\n",
+		nClientes, ventana, nLatencias, fallidos, segundos);
+	printf("lineas/s=%.0f ", nLatencias / segundos);
+	imprimirLatencias();
+
+	free(latencias);
+	free(clientes);
+	close(epfd);
+
+	return fallidos ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file bench_despacho.c
+ * @brief mide lo que cuesta pasar del verbo de una linea a su comando
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+*/
+
+/**
+ * @defgroup BenchDespacho BenchDespacho
+ *
+ * <hr>
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "../includes/config.h"
+#include "../includes/bench.h"
+#include "../includes/analizador.h"
+#include "../includes/despacho.h"
+#include "../includes/funciones_servidor.h"
+
+#include <redes2/irc.h>
+
+#define BENCH_CONSULTAS 10000000
+
+/**
+ * @addtogroup BenchDespacho
+ * Consulta en bucle los verbos de un trafico tipico, con mayusculas y
+ * minusculas, alguna numerica y algun verbo sin manejador, y compara
+ * IRC_CommandQuery sobre la linea con despacharComando sobre el verbo ya
+ * analizado. Comprueba ademas que los dos llegan al mismo comando.
+ *
+ * <hr>
+ */
+
+static char *lineas[] = {
+	"PRIVMSG #canal :hola\r\n", "PRIVMSG #canal :hola\r\n", "PRIVMSG #canal :hola\r\n",
+	"privmsg usuario :que tal\r\n", "PING :LAG1234\r\n", "PONG :servidor\r\n",
+	"JOIN #canal\r\n", "PART #canal :adios\r\n", "WHO #canal\r\n", "MODE #canal +o nick\r\n",
+	"NICK otro\r\n", "Whois nick\r\n", "TOPIC #canal :nuevo\r\n", "QUIT :me voy\r\n",
+	"NOTICE nick :aviso\r\n", "001 nick :Welcome\r\n", "CAP LS 302\r\n",
+};
+
+#define NUM_LINEAS ((int) (sizeof(lineas) / sizeof(lineas[0])))
+
+/**
+ * @ingroup BenchDespacho
+ *
+ * @brief Lleva el resultado de IRC_CommandQuery al de despacharComando
+ *
+ * Lo que IRC_CommandQuery reconoce pero no tiene manejador acaba igual en
+ * comandoVacio, asi que cuenta como desconocido.
+ *
+ * @synopsis
+ * @code
+ * 	long normalizar(long dev)
+ * @endcode
+ *
+ * @param[in] dev resultado de IRC_CommandQuery
+ *
+ * @return el indice del comando o DESPACHO_DESCONOCIDO
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+long normalizar(long dev){
+
+	if(dev < 0 || dev >= IRC_MAX_COMMANDS || comandos[dev] == comandoVacio){
+		return DESPACHO_DESCONOCIDO;
+	}
+
+	return dev;
+}
+
+/**
+ * @ingroup BenchDespacho
+ *
+ * @brief Imprime por stderr la ayuda de usuario
+ *
+ * @synopsis
+ * @code
+ * 	void usage(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void usage(void){
+	fprintf(stderr, "usage: [-h] --consultas <n>\n");
+	fprintf(stderr, " -n --consultas <n>\tVerbos consultados (por defecto %d)\n", BENCH_CONSULTAS);
+}
+
+int main(int argc, char *argv[]){
+
+	int c, i, index = 0, distintos = 0;
+	int consultas = BENCH_CONSULTAS;
+	LineaIRC analizadas[NUM_LINEAS];
+	struct timespec inicio, fin;
+	long long antes, despues;
+	long suma = 0, dev;
+
+	static struct option long_options[] =
+        {
+          {"consultas",  required_argument, 0, 'n'},
+          {0, 0, 0, 0}
+        };
+
+	while ((c = getopt_long (argc, argv, "hn:", long_options, &index)) != -1){
+		switch (c) {
+			case 'n':
+				consultas = atoi(optarg);
+				break;
+			default:
+				usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(consultas <= 0){
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	/* Solo para saber que comandos tienen manejador */
+	crea_comandos();
+
+	for(i = 0; i < NUM_LINEAS; i++){
+		analizarLinea(lineas[i], strlen(lineas[i]), &analizadas[i]);
+		dev = despacharComando(analizadas[i].comando);
+		if(dev == DESPACHO_NUMERICO){
+			dev = DESPACHO_DESCONOCIDO;
+		}
+		if(normalizar(IRC_CommandQuery(lineas[i])) != dev){
+			printf("Aviso: %.*s no llega al mismo comando\n", (int) analizadas[i].comando.len, analizadas[i].comando.ptr);
+			distintos++;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < consultas; i++){
+		suma += IRC_CommandQuery(lineas[i % NUM_LINEAS]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	antes = nanosegundos(&inicio, &fin);
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < consultas; i++){
+		suma += despacharComando(analizadas[i % NUM_LINEAS].comando);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	despues = nanosegundos(&inicio, &fin);
+
+	printf("consultas=%d verbos=%d distintos=%d (%ld)\n", consultas, NUM_LINEAS, distintos, suma & 1);
+	printf("IRC_CommandQuery: %8.1f ns/consulta\n", (double) antes / consultas);
+	printf("despacharComando: %8.1f ns/consulta\n", (double) despues / consultas);
+
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,270 @@
+/**
+ * @file bench_estado.c
+ * @brief mide la contencion del indice de canales con distintas proporciones de lectores y escritores
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+*/
+
+/**
+ * @defgroup BenchEstado BenchEstado
+ *
+ * <hr>
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "../includes/config.h"
+#include "../includes/bench.h"
+#include "../includes/conexiones.h"
+#include "../includes/canales.h"
+
+#define BENCH_HILOS 4
+#define BENCH_CANALES 256
+#define BENCH_MIEMBROS 16
+#define BENCH_OPERACIONES 200000
+#define PRIMER_FD 64 /**< Descriptores ficticios a partir de este, como si fueran sockets */
+#define BENCH_LINEA ":bench!bench@localhost PRIVMSG #bench0 :linea de prueba\r\n"
+
+/**
+ * @addtogroup BenchEstado
+ * Varios hilos operan a la vez sobre el indice de canales: los lectores
+ * difunden una linea a un canal al azar, como un PRIVMSG, y los escritores
+ * unen o sacan una conexion de un canal al azar, como un JOIN o un PART.
+ * Para cada porcentaje de escritores se compara un unico mutex de
+ * escritores (una particion) con la tabla particionada; los lectores no
+ * toman ninguno y leen las instantaneas de miembros dentro de una epoca.
+ *
+ * Las conexiones no tienen socket y su cola de salida se marca con error,
+ * de modo que se mide el coste de los cerrojos y no el de las escrituras.
+ *
+ * <hr>
+ */
+
+typedef struct _Carga {
+
+	int operaciones; /**< Operaciones de cada hilo */
+	int escritores; /**< Porcentaje de operaciones que son JOIN o PART */
+	int canales;
+	int conexiones;
+	unsigned int semilla;
+
+} Carga, *pCarga;
+
+/**
+ * @ingroup BenchEstado
+ *
+ * @brief Hilo que mezcla difusiones con altas y bajas en canales
+ *
+ * @synopsis
+ * @code
+ * 	void *hiloCarga(void *arg)
+ * @endcode
+ *
+ * @param[in] arg la carga del hilo
+ *
+ * @return NULL
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void *hiloCarga(void *arg){
+	pCarga carga = (pCarga) arg;
+	char nombre[32];
+	int i, fd;
+
+	for(i = 0; i < carga->operaciones; i++){
+		snprintf(nombre, sizeof(nombre), "#bench%d", rand_r(&carga->semilla) % carga->canales);
+
+		if((int) (rand_r(&carga->semilla) % 100) < carga->escritores){
+			fd = PRIMER_FD + rand_r(&carga->semilla) % carga->conexiones;
+			if(salirCanal(nombre, fd) != CANAL_OK){
+				unirCanal(nombre, fd);
+			}
+		} else {
+			difundirCanal(nombre, BENCH_LINEA, sizeof(BENCH_LINEA) - 1, -1);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @ingroup BenchEstado
+ *
+ * @brief Llena el indice, lanza los hilos y devuelve las operaciones por segundo
+ *
+ * @synopsis
+ * @code
+ * 	double medir(unsigned int particiones, int hilos, int escritores, int canales, int miembros, int operaciones)
+ * @endcode
+ *
+ * @param[in] particiones cerrojos del indice de canales
+ * @param[in] hilos hilos concurrentes
+ * @param[in] escritores porcentaje de JOIN y PART
+ * @param[in] canales canales del indice
+ * @param[in] miembros miembros iniciales de cada canal
+ * @param[in] operaciones operaciones de cada hilo
+ *
+ * @return las operaciones por segundo, o -1 si algo falla
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+double medir(unsigned int particiones, int hilos, int escritores, int canales, int miembros, int operaciones){
+	pthread_t *ids;
+	Carga *cargas;
+	struct timespec inicio, fin;
+	char nombre[32];
+	int i, j, conexiones;
+	long long ns;
+
+	conexiones = canales * miembros;
+	if(conexiones > maxConexiones - PRIMER_FD){
+		conexiones = maxConexiones - PRIMER_FD;
+	}
+
+	if(inicializarCanales(particiones) != CANAL_OK){
+		return -1;
+	}
+
+	for(i = 0; i < conexiones; i++){
+		registrarConexion(PRIMER_FD + i, NULL);
+		tablaConexiones[PRIMER_FD + i].salida.error = 1;
+	}
+	for(i = 0; i < canales; i++){
+		snprintf(nombre, sizeof(nombre), "#bench%d", i);
+		for(j = 0; j < miembros; j++){
+			unirCanal(nombre, PRIMER_FD + (i * miembros + j) % conexiones);
+		}
+	}
+
+	ids = (pthread_t *) calloc(hilos, sizeof(pthread_t));
+	cargas = (Carga *) calloc(hilos, sizeof(Carga));
+	if(ids == NULL || cargas == NULL){
+		free(ids);
+		free(cargas);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < hilos; i++){
+		cargas[i].operaciones = operaciones;
+		cargas[i].escritores = escritores;
+		cargas[i].canales = canales;
+		cargas[i].conexiones = conexiones;
+		cargas[i].semilla = 1234 + i;
+		pthread_create(&ids[i], NULL, hiloCarga, &cargas[i]);
+	}
+	for(i = 0; i < hilos; i++){
+		pthread_join(ids[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	ns = nanosegundos(&inicio, &fin);
+
+	for(i = 0; i < conexiones; i++){
+		salirTodosCanales(PRIMER_FD + i);
+		liberarConexion(PRIMER_FD + i);
+	}
+	liberarCanales();
+	free(ids);
+	free(cargas);
+
+	return (double) hilos * operaciones / ((double) ns / 1000000000.0);
+}
+
+/**
+ * @ingroup BenchEstado
+ *
+ * @brief Imprime por stderr la ayuda de usuario
+ *
+ * @synopsis
+ * @code
+ * 	void usage(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void usage(void){
+	fprintf(stderr, "usage: [-h] --hilos <n> --canales <n> --miembros <n> --operaciones <n> --particiones <n>\n");
+	fprintf(stderr, " -t --hilos <n>\tHilos concurrentes (por defecto %d)\n", BENCH_HILOS);
+	fprintf(stderr, " -c --canales <n>\tCanales del indice (por defecto %d)\n", BENCH_CANALES);
+	fprintf(stderr, " -m --miembros <n>\tMiembros iniciales de cada canal (por defecto %d)\n", BENCH_MIEMBROS);
+	fprintf(stderr, " -n --operaciones <n>\tOperaciones de cada hilo (por defecto %d)\n", BENCH_OPERACIONES);
+	fprintf(stderr, " -p --particiones <n>\tParticiones con las que comparar el cerrojo unico (por defecto %d)\n", PARTICIONES_CANALES);
+}
+
+int main(int argc, char *argv[]){
+
+	int c, i, index = 0;
+	int hilos = BENCH_HILOS, canales = BENCH_CANALES, miembros = BENCH_MIEMBROS, operaciones = BENCH_OPERACIONES;
+	unsigned int particiones = PARTICIONES_CANALES;
+	int escritores[] = {0, 1, 10, 50};
+	double global, particionado;
+
+	static struct option long_options[] =
+        {
+          {"hilos",  required_argument, 0, 't'},
+          {"canales",  required_argument, 0, 'c'},
+          {"miembros",  required_argument, 0, 'm'},
+          {"operaciones",  required_argument, 0, 'n'},
+          {"particiones",  required_argument, 0, 'p'},
+          {0, 0, 0, 0}
+        };
+
+	while ((c = getopt_long (argc, argv, "ht:c:m:n:p:", long_options, &index)) != -1){
+		switch (c) {
+			case 't':
+				hilos = atoi(optarg);
+				break;
+			case 'c':
+				canales = atoi(optarg);
+				break;
+			case 'm':
+				miembros = atoi(optarg);
+				break;
+			case 'n':
+				operaciones = atoi(optarg);
+				break;
+			case 'p':
+				particiones = (unsigned int) atoi(optarg);
+				break;
+			default:
+				usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(hilos <= 0 || canales <= 0 || miembros <= 0 || operaciones <= 0){
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	if(inicializarConexiones() < 0 || inicializarEpocas() != EPOCA_OK){
+		fprintf(stderr, "No se ha podido reservar la tabla de conexiones\n");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("hilos=%d canales=%d miembros=%d operaciones=%d\n", hilos, canales, miembros, operaciones);
+	printf("escritores   1 particion  %4u particiones\n", particiones);
+	for(i = 0; i < (int) (sizeof(escritores) / sizeof(escritores[0])); i++){
+		global = medir(1, hilos, escritores[i], canales, miembros, operaciones);
+		particionado = medir(particiones, hilos, escritores[i], canales, miembros, operaciones);
+		printf("%9d%%  %9.0f op/s  %11.0f op/s\n", escritores[i], global, particionado);
+	}
+
+	liberarEpocas();
+	liberarConexiones();
+
+	exit(EXIT_SUCCESS);
+}
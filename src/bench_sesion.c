@@ -0,0 +1,161 @@
+/**
+ * @file bench_sesion.c
+ * @brief mide lo que cuesta a cada comando obtener los datos de su usuario
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+*/
+
+/**
+ * @defgroup BenchSesion BenchSesion
+ *
+ * <hr>
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "../includes/config.h"
+#include "../includes/bench.h"
+#include "../includes/funciones_servidor.h"
+#include "../includes/conexiones.h"
+#include "../includes/sesiones.h"
+
+#include <redes2/irc.h>
+
+#define BENCH_USUARIOS 1000
+#define BENCH_RONDAS 200
+#define PRIMER_FD 16 /**< Descriptores ficticios a partir de este, como si fueran sockets */
+
+/**
+ * @addtogroup BenchSesion
+ * Registra usuarios en el TAD y en la tabla de conexiones sin abrir
+ * sockets y compara, por comando, la consulta que hacia cada comando al TAD
+ * (IRCTADUser_GetData por socket y liberarUserData) con la lectura de la
+ * sesion de la conexion.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup BenchSesion
+ *
+ * @brief Imprime por stderr la ayuda de usuario
+ *
+ * @synopsis
+ * @code
+ * 	void usage(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void usage(void){
+	fprintf(stderr, "usage: [-h] --usuarios <n> --rondas <n>\n");
+	fprintf(stderr, " -u --usuarios <n>\tUsuarios registrados (por defecto %d)\n", BENCH_USUARIOS);
+	fprintf(stderr, " -n --rondas <n>\tConsultas por usuario (por defecto %d)\n", BENCH_RONDAS);
+}
+
+int main(int argc, char *argv[]){
+
+	int c, i, r, index = 0, nUsuarios = BENCH_USUARIOS, rondas = BENCH_RONDAS;
+	int sock, registrados = 0;
+	long id, suma = 0;
+	long creationTS, actionTS;
+	char *user, *nick, *real, *host, *IP, *away;
+	char nombre[32];
+	struct timespec inicio, fin;
+	long long antes, despues;
+
+	static struct option long_options[] =
+        {
+          {"usuarios",  required_argument, 0, 'u'},
+          {"rondas",  required_argument, 0, 'n'},
+          {0, 0, 0, 0}
+        };
+
+	while ((c = getopt_long (argc, argv, "hu:n:", long_options, &index)) != -1){
+		switch (c) {
+			case 'u':
+				nUsuarios = atoi(optarg);
+				break;
+			case 'n':
+				rondas = atoi(optarg);
+				break;
+			default:
+				usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(inicializarConexiones() < 0){
+		fprintf(stderr, "No se ha podido reservar la tabla de conexiones\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(nUsuarios > maxConexiones - PRIMER_FD){
+		nUsuarios = maxConexiones - PRIMER_FD;
+	}
+
+	/* Usuarios registrados como lo haria el comando USER */
+	for(i = 0; i < nUsuarios; i++){
+		sock = PRIMER_FD + i;
+		snprintf(nombre, sizeof(nombre), "bench%d", i);
+		if(IRCTADUser_New(nombre, nombre, nombre, NULL, "localhost", "127.0.0.1", sock) != IRC_OK){
+			continue;
+		}
+		registrarConexion(sock, NULL);
+		if(abrirSesion(sock) == SESION_OK){
+			registrados++;
+		}
+	}
+
+	if(registrados == 0){
+		fprintf(stderr, "No se ha podido registrar ningun usuario\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Antes: cada comando pedia al TAD una copia de los datos de su usuario */
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(r = 0; r < rondas; r++){
+		for(i = 0; i < nUsuarios; i++){
+			id = 0;
+			user = nick = real = host = IP = away = NULL;
+			sock = PRIMER_FD + i;
+			IRCTADUser_GetData(&id, &user, &nick, &real, &host, &IP, &sock, &creationTS, &actionTS, &away);
+			suma += id;
+			liberarUserData(user, nick, real, host, IP, away);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	antes = nanosegundos(&inicio, &fin);
+
+	/* Despues: se leen por puntero de la sesion de la conexion */
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(r = 0; r < rondas; r++){
+		for(i = 0; i < nUsuarios; i++){
+			leerSesion(PRIMER_FD + i, &id, &user, &nick, &real, &host, &IP, &away);
+			suma -= id;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	despues = nanosegundos(&inicio, &fin);
+
+	printf("usuarios=%d rondas=%d consultas=%ld\n", registrados, rondas, (long) nUsuarios * rondas);
+	printf("IRCTADUser_GetData: %8.1f ns/comando\n", (double) antes / ((double) nUsuarios * rondas));
+	printf("leerSesion:         %8.1f ns/comando\n", (double) despues / ((double) nUsuarios * rondas));
+	if(suma != 0){
+		printf("Aviso: la sesion y el TAD no coinciden\n");
+	}
+
+	for(i = 0; i < nUsuarios; i++){
+		snprintf(nombre, sizeof(nombre), "bench%d", i);
+		IRCTAD_Quit(nombre);
+		liberarConexion(PRIMER_FD + i);
+	}
+	liberarConexiones();
+
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,250 @@
+/**
+ * @file bench_vecinos.c
+ * @brief mide lo que cuesta avisar de un QUIT o un NICK a quienes comparten canal
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+*/
+
+/**
+ * @defgroup BenchVecinos BenchVecinos
+ *
+ * <hr>
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "../includes/config.h"
+#include "../includes/bench.h"
+#include "../includes/funciones_servidor.h"
+#include "../includes/red_servidor.h"
+#include "../includes/conexiones.h"
+#include "../includes/canales.h"
+
+#include <redes2/irc.h>
+
+#define BENCH_USUARIOS 5000
+#define BENCH_CANALES 50
+#define BENCH_POR_USUARIO 10
+#define BENCH_MENSAJES 20
+#define BENCH_LINEA ":vecino0!vecino0@localhost QUIT :Abandono el servidor\r\n"
+
+/**
+ * @addtogroup BenchVecinos
+ * Reparte usuarios conectados por socketpair entre canales que se solapan:
+ * el usuario i esta en los canales i, i+1, ... i+porUsuario-1 (modulo el
+ * numero de canales), de modo que muchos comparten varios canales con el
+ * primero. Compara por aviso del primero el QUIT que se hacia a todos los
+ * usuarios del TAD, el envio canal a canal, que repite el mensaje a quien
+ * comparte varios, y la difusion a vecinos con marcas de generacion.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup BenchVecinos
+ *
+ * @brief Avisa a todos los usuarios del TAD como hacia el servidor con PRUEBAS_IRC
+ *
+ * @synopsis
+ * @code
+ * 	void avisarUsuarios(char *mensaje, char *nickorigin)
+ * @endcode
+ *
+ * @param[in] mensaje mensaje a enviar
+ * @param[in] nickorigin nick que no lo recibe
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void avisarUsuarios(char *mensaje, char *nickorigin){
+	char **lista = NULL;
+	long num = 0;
+	long i;
+
+	if(IRCTADUser_GetUserList(&lista, &num) != IRC_OK){
+		return;
+	}
+
+	for(i = 0; i < num; i++){
+		if(strcmp(nickorigin, lista[i])){
+			enviar(socketDeNick(lista[i]), mensaje);
+		}
+	}
+
+	IRCTADUser_FreeList(lista, num);
+}
+
+/**
+ * @ingroup BenchVecinos
+ *
+ * @brief Imprime una linea de resultados
+ *
+ * @synopsis
+ * @code
+ * 	void imprimir(char *metodo, long long ns, long bytes, int mensajes)
+ * @endcode
+ *
+ * @param[in] metodo nombre del metodo
+ * @param[in] ns nanosegundos del metodo
+ * @param[in] bytes bytes que han recibido los usuarios
+ * @param[in] mensajes avisos enviados
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void imprimir(char *metodo, long long ns, long bytes, int mensajes){
+	printf("%-9s %10.1f us/aviso %8ld copias/aviso\n", metodo, (double) ns / mensajes / 1000.0,
+		bytes / (long) (sizeof(BENCH_LINEA) - 1) / mensajes);
+}
+
+/**
+ * @ingroup BenchVecinos
+ *
+ * @brief Imprime por stderr la ayuda de usuario
+ *
+ * @synopsis
+ * @code
+ * 	void usage(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void usage(void){
+	fprintf(stderr, "usage: [-h] --usuarios <n> --canales <n> --por-usuario <n> --mensajes <n>\n");
+	fprintf(stderr, " -u --usuarios <n>\tUsuarios conectados (por defecto %d)\n", BENCH_USUARIOS);
+	fprintf(stderr, " -c --canales <n>\tCanales entre los que se reparten (por defecto %d)\n", BENCH_CANALES);
+	fprintf(stderr, " -p --por-usuario <n>\tCanales de cada usuario (por defecto %d)\n", BENCH_POR_USUARIO);
+	fprintf(stderr, " -n --mensajes <n>\tAvisos enviados con cada metodo (por defecto %d)\n", BENCH_MENSAJES);
+}
+
+int main(int argc, char *argv[]){
+
+	int c, i, k, index = 0, nUsuarios = BENCH_USUARIOS, nCanales = BENCH_CANALES;
+	int porUsuario = BENCH_POR_USUARIO, mensajes = BENCH_MENSAJES;
+	int *servidor = NULL, *clientes = NULL;
+	char nombre[32], canal[32];
+	struct timespec inicio, fin;
+	long long ns;
+	long bytes;
+
+	static struct option long_options[] =
+        {
+          {"usuarios",  required_argument, 0, 'u'},
+          {"canales",  required_argument, 0, 'c'},
+          {"por-usuario",  required_argument, 0, 'p'},
+          {"mensajes",  required_argument, 0, 'n'},
+          {0, 0, 0, 0}
+        };
+
+	while ((c = getopt_long (argc, argv, "hu:c:p:n:", long_options, &index)) != -1){
+		switch (c) {
+			case 'u':
+				nUsuarios = atoi(optarg);
+				break;
+			case 'c':
+				nCanales = atoi(optarg);
+				break;
+			case 'p':
+				porUsuario = atoi(optarg);
+				break;
+			case 'n':
+				mensajes = atoi(optarg);
+				break;
+			default:
+				usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if(nCanales <= 0 || porUsuario <= 0 || mensajes <= 0){
+		usage();
+		exit(EXIT_FAILURE);
+	}
+	if(porUsuario > nCanales){
+		porUsuario = nCanales;
+	}
+
+	if(inicializarConexiones() < 0 || inicializarEpocas() != EPOCA_OK || inicializarCanales(PARTICIONES_CANALES) != CANAL_OK){
+		fprintf(stderr, "No se han podido reservar las tablas de conexiones y canales\n");
+		exit(EXIT_FAILURE);
+	}
+
+	servidor = (int *) malloc(nUsuarios * sizeof(int));
+	clientes = (int *) malloc(nUsuarios * sizeof(int));
+	if(servidor == NULL || clientes == NULL){
+		fprintf(stderr, "No se ha podido reservar memoria\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Cada usuario es un socketpair: el servidor escribe en un extremo y se lee del otro */
+	nUsuarios = crearUsuarios("vecino", nUsuarios, servidor, clientes);
+	for(i = 0; i < nUsuarios; i++){
+		snprintf(nombre, sizeof(nombre), "vecino%d", i);
+		for(k = 0; k < porUsuario; k++){
+			snprintf(canal, sizeof(canal), "#vecinos%d", (i + k) % nCanales);
+			if(IRCTAD_Join(canal, nombre, NULL, NULL) == IRC_OK){
+				unirCanal(canal, servidor[i]);
+			}
+		}
+	}
+
+	if(nUsuarios < 2){
+		fprintf(stderr, "Hacen falta al menos dos usuarios\n");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("usuarios=%d canales=%d por-usuario=%d mensajes=%d\n", nUsuarios, nCanales, porUsuario, mensajes);
+
+	/* Antes: todos los usuarios del TAD, esten o no en sus canales */
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < mensajes; i++){
+		avisarUsuarios(BENCH_LINEA, "vecino0");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	ns = nanosegundos(&inicio, &fin);
+	bytes = vaciarUsuarios(clientes, nUsuarios);
+	imprimir("usuarios", ns, bytes, mensajes);
+
+	/* Canal a canal: quien comparte varios lo recibe varias veces */
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < mensajes; i++){
+		for(k = 0; k < porUsuario; k++){
+			snprintf(canal, sizeof(canal), "#vecinos%d", k % nCanales);
+			difundirCanal(canal, BENCH_LINEA, sizeof(BENCH_LINEA) - 1, servidor[0]);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	ns = nanosegundos(&inicio, &fin);
+	bytes = vaciarUsuarios(clientes, nUsuarios);
+	imprimir("canales", ns, bytes, mensajes);
+
+	/* Vecinos: una vez a cada uno, marcando por generacion */
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	for(i = 0; i < mensajes; i++){
+		difundirVecinos(servidor[0], BENCH_LINEA, sizeof(BENCH_LINEA) - 1);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	ns = nanosegundos(&inicio, &fin);
+	bytes = vaciarUsuarios(clientes, nUsuarios);
+	imprimir("vecinos", ns, bytes, mensajes);
+
+	liberarUsuarios("vecino", nUsuarios, servidor, clientes);
+	liberarCanales();
+	liberarEpocas();
+	liberarConexiones();
+	free(servidor);
+	free(clientes);
+
+	exit(EXIT_SUCCESS);
+}
@@ -17,6 +17,11 @@
 #include "../includes/red_servidor.h"
 
 #include "../includes/ssl.h"
+#include "../includes/pool.h"
+#include "../includes/reactor.h"
+#include "../includes/resolvedor.h"
+#include "../includes/conexion_temp.h"
+#include "../includes/relevo.h"
 
 /**
  * @addtogroup ServidorIRC
@@ -42,12 +47,24 @@
  *<hr>
 */
 void usage(void){
-	fprintf(stderr, "usage: [-sdpoh] --port <puerto>\n");
+	fprintf(stderr, "usage: [-sdpouh] --port <puerto> --workers <hilos> --cola <trabajos> --reactores <n> --sendq <bytes> --backlog <n> --temporales <n> --registro <s> --inactividad <s> --dns <ip[:puerto]>\n");
 	fprintf(stderr, " -s --ssl\tActiva comunicacion con SSL\n");
 	fprintf(stderr, " -d --daemon\tLanza el servidor en modo daemon\n");
 	fprintf(stderr, " -p --ping\tEjecuta el protocolo Ping-Pong\n");
 	fprintf(stderr, " -o --offensive\tEjecuta el motds ofensivos\n");
 	fprintf(stderr, " -P --port <puerto>\tEspecifica puerto a conectar\n");
+	fprintf(stderr, " -w --workers <hilos>\tHilos trabajadores del pool (por defecto %d)\n", DEFAULT_HILOS);
+	fprintf(stderr, " -c --cola <trabajos>\tCapacidad de la cola del pool (por defecto %d)\n", DEFAULT_COLA);
+	fprintf(stderr, " -u --uring\tUsa io_uring en lugar de epoll (make IO_URING=1, kernel 6.0 o superior, sin SSL)\n");
+	fprintf(stderr, " -r --reactores <n>\tBucles epoll, cada uno con su socket de escucha (por defecto %d)\n", DEFAULT_REACTORES);
+	fprintf(stderr, " -b --backlog <n>\tConexiones pendientes de aceptar en cada socket de escucha (por defecto %d)\n", DEFAULT_BACKLOG);
+	fprintf(stderr, " -t --temporales <n>\tConexiones sin registrar admitidas a la vez, 0 sin limite (por defecto %d)\n", DEFAULT_MAX_TEMPORALES);
+	fprintf(stderr, " -R --registro <s>\tSegundos para registrarse tras conectar, 0 sin limite (por defecto %d)\n", DEFAULT_PLAZO_REGISTRO);
+	fprintf(stderr, " -I --inactividad <s>\tSegundos sin enviar nada antes de registrarse, 0 sin limite (por defecto %d)\n", DEFAULT_INACTIVIDAD_REGISTRO);
+	fprintf(stderr, " -q --sendq <bytes>\tBytes sin leer por cliente antes de expulsarlo, 0 sin limite (por defecto %d)\n", DEFAULT_MAX_SALIDA);
+	fprintf(stderr, " -D --dns <ip[:puerto]>\tServidor DNS para resolver los hosts de los clientes (por defecto el del sistema)\n");
+	fprintf(stderr, " -H --relevo <fd>\tUso interno: recibe las conexiones del proceso anterior tras un SIGUSR2\n");
+	fprintf(stderr, "Con SIGUSR2 el servidor se relanza desde su binario sin cerrar las conexiones (sin SSL ni io_uring)\n");
 }
 
 /**
@@ -96,7 +113,7 @@ void welcome(short daemon, short pingpong, short ssl, short offensive, int puert
 	}
 
 	if(pingpong) {
-		printf("Protocolo PING PONG lanzado con retardo de %d segundos\n", ALARMPINGPONG);
+		printf("Protocolo PING PONG lanzado: PING tras %d segundos inactivo, %d segundos para contestar\n", ESPERA_PING, PLAZO_PONG);
 	} else {
 		printf("Utilice flag -p --ping para lanzar la rutina PING-PONG\n");
 	}
@@ -131,12 +148,40 @@ int main(int argc, char *argv[]){
           {"offensive",  no_argument,       0, 'o'},
           {"ping",  no_argument,       0, 'p'},
           {"port",  required_argument, 0, 'P'},
+          {"workers",  required_argument, 0, 'w'},
+          {"cola",  required_argument, 0, 'c'},
+          {"reactores",  required_argument, 0, 'r'},
+          {"uring",  no_argument,       0, 'u'},
+          {"sendq",  required_argument, 0, 'q'},
+          {"backlog",  required_argument, 0, 'b'},
+          {"temporales",  required_argument, 0, 't'},
+          {"registro",  required_argument, 0, 'R'},
+          {"inactividad",  required_argument, 0, 'I'},
+          {"dns",  required_argument, 0, 'D'},
+          {"relevo",  required_argument, 0, 'H'},
+          {0, 0, 0, 0}
         };
 
 	ssl_active = 0;
 	offensive = 0;
+	hilosPool = DEFAULT_HILOS;
+	colaPool = DEFAULT_COLA;
+	numReactores = DEFAULT_REACTORES;
+	usarUring = 0;
+	maxSalida = DEFAULT_MAX_SALIDA;
+	backlogEscucha = DEFAULT_BACKLOG;
+	maxTemporales = DEFAULT_MAX_TEMPORALES;
+	plazoRegistro = DEFAULT_PLAZO_REGISTRO;
+	inactividadRegistro = DEFAULT_INACTIVIDAD_REGISTRO;
+	servidorDNS = NULL;
+	argvServidor = argv;
+	relevoFD = -1;
+	socketRelevo = -1;
+	pidRelevo = -1;
+	relevoPedido = 0;
+	relevo = NULL;
 
-	while ((c = getopt_long (argc, argv, "sdpohP:", long_options, &index)) != -1){
+	while ((c = getopt_long (argc, argv, "sdpouhP:w:c:r:q:b:t:R:I:D:H:", long_options, &index)) != -1){
 		switch (c) {
 			case 's': /* Flag ssl */
 				ssl_active = 1;
@@ -153,6 +198,39 @@ int main(int argc, char *argv[]){
 			case 'P':
 				puerto_definido = atoi(optarg);
 				break;
+			case 'w': /* Hilos del pool */
+				hilosPool = atoi(optarg);
+				break;
+			case 'c': /* Capacidad de la cola del pool */
+				colaPool = atoi(optarg);
+				break;
+			case 'u': /* Backend io_uring */
+				usarUring = 1;
+				break;
+			case 'r': /* Numero de reactores */
+				numReactores = atoi(optarg);
+				break;
+			case 'b': /* Cola de conexiones pendientes */
+				backlogEscucha = atoi(optarg);
+				break;
+			case 't': /* Limite de conexiones sin registrar */
+				maxTemporales = atoi(optarg);
+				break;
+			case 'R': /* Plazo para registrarse */
+				plazoRegistro = atoi(optarg);
+				break;
+			case 'I': /* Inactividad permitida antes de registrarse */
+				inactividadRegistro = atoi(optarg);
+				break;
+			case 'q': /* Limite de la cola de salida de cada cliente */
+				maxSalida = (size_t) strtoul(optarg, NULL, 10);
+				break;
+			case 'D': /* Servidor DNS propio */
+				servidorDNS = optarg;
+				break;
+			case 'H': /* Relevo desde el proceso anterior */
+				relevoFD = atoi(optarg);
+				break;
 			case '?':
 
 			default:
@@ -167,16 +245,27 @@ int main(int argc, char *argv[]){
 	/* Guardamos path desde el que se ha lanzado */
 	getcwd(abspath, 1023);
 
-	/* daemonizamos */
-	if(daemon) {
+	/* En un relevo el proceso ya esta separado del terminal y solo conserva el socket del relevo */
+	if(relevoFD >= 0) {
+		cerrarHeredados(relevoFD);
+		abrirLog(SERVICIO, LOG_INFO);
+	} else if(daemon) {
 		daemonizar(SERVICIO, LOG_INFO);
 	} else {
 		abrirLog(SERVICIO, LOG_INFO);
 	}
 
 	/* Inicializamos */
-	inicializarServidor();
-	
+	if(inicializarServidor() < 0){
+		syslog(LOG_ERR, "Error inicializando el servidor");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Sockets y estado del proceso anterior */
+	if(relevoFD >= 0 && recibirRelevo(relevoFD) < 0){
+		syslog(LOG_ERR, "Error recibiendo el relevo del proceso anterior");
+		exit(EXIT_FAILURE);
+	}
 
 	/* Lanzamos el servidor */
 	if(!ssl_active){
@@ -186,6 +275,7 @@ int main(int argc, char *argv[]){
 	}
 
 	/* Liberamos estructuras */
+	liberarRelevo();
 	cerrarServidor();
 
 	exit(EXIT_SUCCESS);
@@ -0,0 +1,196 @@
+/**
+ * @file analizador.c
+ * @brief analizador de lineas IRC en su sitio, sin copiar ni reservar memoria
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Analizador Analizador
+ *
+ * <hr>
+ */
+
+#include <strings.h>
+
+#include "../includes/analizador.h"
+
+/**
+ * @addtogroup Analizador
+ * Sustituye a IRC_UnPipelineCommands y a los IRCParse_*: una linea se
+ * recorre una sola vez y cada campo queda como un puntero y una longitud
+ * dentro de la propia linea, que no se modifica. Lo que un comando necesite
+ * como cadena terminada en '\\0' lo copia a la arena de su hilo.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Analizador
+ *
+ * @brief Analiza una linea IRC sin copiarla
+ *
+ * Sigue la gramatica de RFC 2812, 2.3.1, tolerando varios espacios
+ * seguidos: [':' prefijo ' '] comando {' ' parametro} [' ' ':' final].
+ * A partir del parametro 15 todo es el final aunque no lleve dos puntos.
+ *
+ * @synopsis
+ * @code
+ * 	status analizarLinea(char *linea, size_t len, pLineaIRC l)
+ * @endcode
+ *
+ * @param[in] linea la linea, con o sin CRLF
+ * @param[in] len longitud de la linea
+ * @param[out] l la linea analizada, cuyas vistas apuntan a linea
+ *
+ * @return ANALIZADOR_OK si todo va bien. ANALIZADOR_ERROR si no hay comando
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status analizarLinea(char *linea, size_t len, pLineaIRC l){
+	char *p, *fin, *campo;
+
+	l->linea = linea;
+	l->prefijo.ptr = l->comando.ptr = l->final.ptr = NULL;
+	l->prefijo.len = l->comando.len = l->final.len = 0;
+	l->numParams = 0;
+
+	if(linea == NULL){
+		return ANALIZADOR_ERROR;
+	}
+
+	/* El fin de linea no forma parte de ningun campo */
+	fin = linea + len;
+	while(fin > linea && (fin[-1] == '\n' || fin[-1] == '\r')){
+		fin--;
+	}
+
+	p = linea;
+	while(p < fin && *p == ' '){
+		p++;
+	}
+
+	if(p < fin && *p == ':'){
+		campo = ++p;
+		while(p < fin && *p != ' '){
+			p++;
+		}
+		l->prefijo.ptr = campo;
+		l->prefijo.len = p - campo;
+		while(p < fin && *p == ' '){
+			p++;
+		}
+	}
+
+	campo = p;
+	while(p < fin && *p != ' '){
+		p++;
+	}
+	if(p == campo){
+		return ANALIZADOR_ERROR;
+	}
+	l->comando.ptr = campo;
+	l->comando.len = p - campo;
+
+	for(;;){
+		while(p < fin && *p == ' '){
+			p++;
+		}
+		if(p == fin){
+			break;
+		}
+
+		/* El final se lleva el resto de la linea, con sus espacios */
+		if(*p == ':' || l->numParams == MAX_PARAMS_IRC - 1){
+			if(*p == ':'){
+				p++;
+			}
+			l->final.ptr = p;
+			l->final.len = fin - p;
+			l->params[l->numParams++] = l->final;
+			break;
+		}
+
+		campo = p;
+		while(p < fin && *p != ' '){
+			p++;
+		}
+		l->params[l->numParams].ptr = campo;
+		l->params[l->numParams].len = p - campo;
+		l->numParams++;
+	}
+
+	return ANALIZADOR_OK;
+}
+
+/**
+ * @ingroup Analizador
+ *
+ * @brief Compara una vista con una cadena sin distinguir mayusculas
+ *
+ * @synopsis
+ * @code
+ * 	int vistaIgual(Vista v, char *cadena)
+ * @endcode
+ *
+ * @param[in] v la vista
+ * @param[in] cadena la cadena
+ *
+ * @return 1 si son iguales, 0 si no
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int vistaIgual(Vista v, char *cadena){
+
+	if(v.ptr == NULL || cadena == NULL){
+		return 0;
+	}
+
+	return strlen(cadena) == v.len && strncasecmp(v.ptr, cadena, v.len) == 0;
+}
+
+/**
+ * @ingroup Analizador
+ *
+ * @brief Copia una vista a la arena como cadena terminada en '\\0'
+ *
+ * @synopsis
+ * @code
+ * 	char *copiarVista(pArena arena, Vista v)
+ * @endcode
+ *
+ * @param[in] arena arena del hilo
+ * @param[in] v la vista
+ *
+ * @return la copia, valida hasta que se reinicie la arena, o NULL si el
+ * campo no esta en la linea o no hay memoria
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char *copiarVista(pArena arena, Vista v){
+	char *copia;
+
+	if(v.ptr == NULL){
+		return NULL;
+	}
+
+	copia = (char *) reservarArena(arena, v.len + 1);
+	if(copia != NULL){
+		memcpy(copia, v.ptr, v.len);
+		copia[v.len] = '\0';
+	}
+
+	return copia;
+}
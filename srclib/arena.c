@@ -0,0 +1,366 @@
+/**
+ * @file arena.c
+ * @brief arena de memoria de cada hilo para los temporales de un comando
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Arena Arena
+ *
+ * <hr>
+ */
+
+#include "../includes/arena.h"
+
+/**
+ * @addtogroup Arena
+ * Cada hilo que atiende comandos tiene una arena: las reservas solo avanzan
+ * un puntero dentro de un bloque y nada se libera por separado. Al terminar
+ * cada comando se reinicia y todo lo reservado deja de ser valido.
+ *
+ * Si un comando pide mas de lo que cabe, lo que sobra se reserva en el heap
+ * y al reiniciar la base crece para que la siguiente vez quepa. En regimen
+ * estacionario un comando no llega al heap.
+ *
+ * Compilando con CONTAR_RESERVAS (make CONTAR_RESERVAS=1) se cuentan ademas
+ * todas las llamadas a malloc, calloc y realloc del hilo, tambien las de
+ * las librerias IRC, para comprobar cuantas quedan en cada comando.
+ *
+ * <hr>
+ */
+
+#ifdef CONTAR_RESERVAS
+static __thread unsigned long llamadasHeap; /**< Reservas al heap hechas por el hilo */
+
+extern void *__libc_malloc(size_t tam);
+extern void *__libc_calloc(size_t num, size_t tam);
+extern void *__libc_realloc(void *ptr, size_t tam);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t tam){
+	llamadasHeap++;
+	return __libc_malloc(tam);
+}
+
+void *calloc(size_t num, size_t tam){
+	llamadasHeap++;
+	return __libc_calloc(num, tam);
+}
+
+void *realloc(void *ptr, size_t tam){
+	llamadasHeap++;
+	return __libc_realloc(ptr, tam);
+}
+
+void free(void *ptr){
+	__libc_free(ptr);
+}
+#endif
+
+#define ALINEAR(tam) (((tam) + ALINEACION_ARENA - 1) & ~((size_t) ALINEACION_ARENA - 1))
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Prepara la clave con la que cada hilo guarda su arena
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarArenas(void)
+ * @endcode
+ *
+ * @return ARENA_OK si todo va bien. ARENA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarArenas(void){
+
+	if(pthread_key_create(&claveArena, liberarArena) != 0){
+		return ARENA_ERROR;
+	}
+
+	return ARENA_OK;
+}
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Devuelve la arena del hilo que llama, creandola la primera vez
+ *
+ * @synopsis
+ * @code
+ * 	pArena arenaHilo(void)
+ * @endcode
+ *
+ * @return la arena, o NULL si no se ha podido crear
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pArena arenaHilo(void){
+	pArena arena;
+
+	arena = (pArena) pthread_getspecific(claveArena);
+	if(arena != NULL){
+		return arena;
+	}
+
+	arena = (pArena) calloc(1, sizeof(Arena));
+	if(arena == NULL){
+		return NULL;
+	}
+
+	/* malloc ya alinea a 16 bytes en las plataformas de 64 bits */
+	arena->base = (char *) malloc(TAM_ARENA);
+	if(arena->base == NULL){
+		free(arena);
+		return NULL;
+	}
+	arena->tam = TAM_ARENA;
+	arena->reservasHeap = 1;
+
+	pthread_setspecific(claveArena, arena);
+
+	return arena;
+}
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Reserva memoria que vive hasta el siguiente reinicio de la arena
+ *
+ * @synopsis
+ * @code
+ * 	void *reservarArena(pArena arena, size_t tam)
+ * @endcode
+ *
+ * @param[in] arena arena del hilo
+ * @param[in] tam bytes a reservar
+ *
+ * @return la memoria, alineada a ALINEACION_ARENA, o NULL si no hay
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void *reservarArena(pArena arena, size_t tam){
+	pBloqueArena bloque;
+	void *ptr;
+
+	if(arena == NULL){
+		return NULL;
+	}
+
+	tam = ALINEAR(tam ? tam : 1);
+	arena->reservas++;
+
+	if(tam <= arena->tam - arena->usado){
+		ptr = arena->base + arena->usado;
+		arena->usado += tam;
+		return ptr;
+	}
+
+	/* No cabe: bloque suelto hasta el reinicio, que hara crecer la base */
+	bloque = (pBloqueArena) malloc(sizeof(BloqueArena) + ALINEACION_ARENA + tam);
+	if(bloque == NULL){
+		return NULL;
+	}
+	arena->reservasHeap++;
+	arena->desbordado += tam;
+	bloque->siguiente = arena->desbordes;
+	arena->desbordes = bloque;
+
+	return (void *) ALINEAR((size_t) bloque->datos);
+}
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Copia una cadena en la arena
+ *
+ * @synopsis
+ * @code
+ * 	char *duplicarArena(pArena arena, const char *cadena)
+ * @endcode
+ *
+ * @param[in] arena arena del hilo
+ * @param[in] cadena cadena a copiar
+ *
+ * @return la copia, o NULL si cadena es NULL o no hay memoria
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char *duplicarArena(pArena arena, const char *cadena){
+	char *copia;
+	size_t len;
+
+	if(cadena == NULL){
+		return NULL;
+	}
+
+	len = strlen(cadena) + 1;
+	copia = (char *) reservarArena(arena, len);
+	if(copia != NULL){
+		memcpy(copia, cadena, len);
+	}
+
+	return copia;
+}
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Descarta todo lo reservado, al terminar un comando
+ *
+ * Si algo no cupo en la base, la base crece hasta lo que se llego a usar.
+ *
+ * @synopsis
+ * @code
+ * 	void reiniciarArena(pArena arena)
+ * @endcode
+ *
+ * @param[in] arena arena del hilo
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void reiniciarArena(pArena arena){
+	pBloqueArena bloque;
+	char *base;
+	size_t tam;
+
+	if(arena == NULL){
+		return;
+	}
+
+	if(arena->desbordes != NULL){
+		while(arena->desbordes != NULL){
+			bloque = arena->desbordes;
+			arena->desbordes = bloque->siguiente;
+			free(bloque);
+		}
+
+		tam = arena->tam;
+		while(tam < arena->usado + arena->desbordado){
+			tam *= 2;
+		}
+
+		base = (char *) malloc(tam);
+		if(base != NULL){
+			free(arena->base);
+			arena->base = base;
+			arena->tam = tam;
+			arena->reservasHeap++;
+		}
+		arena->desbordado = 0;
+	}
+
+	arena->usado = 0;
+}
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Devuelve las reservas al heap hechas hasta ahora por el hilo que llama
+ *
+ * Con CONTAR_RESERVAS son todas las del hilo. Sin el, solo las de su arena.
+ *
+ * @synopsis
+ * @code
+ * 	unsigned long reservasHeapHilo(void)
+ * @endcode
+ *
+ * @return el numero de reservas
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+unsigned long reservasHeapHilo(void){
+#ifdef CONTAR_RESERVAS
+	return llamadasHeap;
+#else
+	pArena arena;
+
+	arena = (pArena) pthread_getspecific(claveArena);
+
+	return arena ? arena->reservasHeap : 0;
+#endif
+}
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Libera una arena, al terminar su hilo
+ *
+ * @synopsis
+ * @code
+ * 	void liberarArena(void *arena)
+ * @endcode
+ *
+ * @param[in] arena la arena
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarArena(void *arena){
+	pArena a = (pArena) arena;
+	pBloqueArena bloque;
+
+	if(a == NULL){
+		return;
+	}
+
+	while(a->desbordes != NULL){
+		bloque = a->desbordes;
+		a->desbordes = bloque->siguiente;
+		free(bloque);
+	}
+	free(a->base);
+	free(a);
+}
+
+/**
+ * @ingroup Arena
+ *
+ * @brief Libera la arena del hilo principal y la clave
+ *
+ * @synopsis
+ * @code
+ * 	void liberarArenas(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarArenas(void){
+
+	liberarArena(pthread_getspecific(claveArena));
+	pthread_setspecific(claveArena, NULL);
+	pthread_key_delete(claveArena);
+}
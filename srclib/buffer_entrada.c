@@ -0,0 +1,268 @@
+/**
+ * @file buffer_entrada.c
+ * @brief buffer de entrada por conexion que reensambla lineas terminadas en CRLF
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup BufferEntrada BufferEntrada
+ *
+ * <hr>
+ */
+
+#include "../includes/buffer_entrada.h"
+
+/**
+ * @addtogroup BufferEntrada
+ * Comprende las funciones del buffer de entrada de cada conexion. Una lectura
+ * puede traer varias lineas y acabar a mitad de otra: solo se entregan las
+ * lineas completas, normalizadas a CRLF y recortadas a MAX_LINEA_IRC, y el
+ * resto se guarda hasta la siguiente lectura. Solo lo usa el reactor
+ * propietario de la conexion.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup BufferEntrada
+ *
+ * @brief Descarta la linea pendiente, conservando la memoria reservada
+ *
+ * @synopsis
+ * @code
+ * 	void vaciarBufferEntrada(pBufferEntrada buffer)
+ * @endcode
+ *
+ * @param[in] buffer el buffer
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void vaciarBufferEntrada(pBufferEntrada buffer){
+	buffer->len = 0;
+}
+
+/**
+ * @ingroup BufferEntrada
+ *
+ * @brief Libera la memoria del buffer
+ *
+ * @synopsis
+ * @code
+ * 	void liberarBufferEntrada(pBufferEntrada buffer)
+ * @endcode
+ *
+ * @param[in] buffer el buffer
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarBufferEntrada(pBufferEntrada buffer){
+	free(buffer->datos);
+	buffer->datos = NULL;
+	buffer->len = 0;
+	buffer->cap = 0;
+}
+
+/**
+ * @ingroup BufferEntrada
+ *
+ * @brief Annade datos a la linea pendiente, creciendo hasta MAX_LINEA_IRC
+ *
+ * Lo que no cabe se descarta: la linea se entregara recortada.
+ *
+ * @synopsis
+ * @code
+ * 	status annadirPendiente(pBufferEntrada buffer, char *datos, size_t len)
+ * @endcode
+ *
+ * @param[in] buffer el buffer
+ * @param[in] datos datos a annadir
+ * @param[in] len numero de bytes
+ *
+ * @return ENTRADA_OK si todo va bien. ENTRADA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status annadirPendiente(pBufferEntrada buffer, char *datos, size_t len){
+	size_t cap;
+	char *nuevo;
+
+	if(buffer->len + len > MAX_LINEA_IRC){
+		len = MAX_LINEA_IRC - buffer->len;
+	}
+
+	if(len == 0){
+		return ENTRADA_OK;
+	}
+
+	if(buffer->len + len > buffer->cap){
+		cap = buffer->cap ? buffer->cap : TAM_ENTRADA_INICIAL;
+		while(cap < buffer->len + len){
+			cap *= 2;
+		}
+		if(cap > MAX_LINEA_IRC){
+			cap = MAX_LINEA_IRC;
+		}
+
+		nuevo = (char *) realloc(buffer->datos, cap);
+		if(nuevo == NULL){
+			syslog(LOG_ERR, "Error reservando buffer de entrada de %zu bytes", cap);
+			return ENTRADA_ERROR;
+		}
+		buffer->datos = nuevo;
+		buffer->cap = cap;
+	}
+
+	memcpy(buffer->datos + buffer->len, datos, len);
+	buffer->len += len;
+
+	return ENTRADA_OK;
+}
+
+/**
+ * @ingroup BufferEntrada
+ *
+ * @brief Copia una linea al mensaje de salida terminada en CRLF y en '\\0'
+ *
+ * Las lineas que contienen un '\\0' se descartan enteras.
+ *
+ * @synopsis
+ * @code
+ * 	void copiarLinea(char *msg, size_t *pos, char *linea, size_t len)
+ * @endcode
+ *
+ * @param[out] msg mensaje de salida
+ * @param[in,out] pos posicion de escritura en msg
+ * @param[in] linea linea sin el '\\n' final
+ * @param[in] len longitud de la linea
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void copiarLinea(char *msg, size_t *pos, char *linea, size_t len){
+
+	/* Aceptamos tanto CRLF como LF solo */
+	while(len > 0 && linea[len-1] == '\r'){
+		len--;
+	}
+
+	/* Las lineas vacias se ignoran (RFC 2812, 2.3.1) */
+	if(len == 0){
+		return;
+	}
+
+	/* El '\0' no puede aparecer en un mensaje (RFC 2812, 2.3.1) y partiria
+	   la linea en varios comandos al recorrer el mensaje, se descarta */
+	if(memchr(linea, '\0', len) != NULL){
+		__sync_fetch_and_add(&lineasNulas, 1);
+		return;
+	}
+
+	if(len > MAX_LINEA_IRC - 2){
+		len = MAX_LINEA_IRC - 2;
+		__sync_fetch_and_add(&lineasTruncadas, 1);
+	}
+
+	memcpy(msg + *pos, linea, len);
+	*pos += len;
+	msg[(*pos)++] = '\r';
+	msg[(*pos)++] = '\n';
+	msg[(*pos)++] = '\0';
+}
+
+/**
+ * @ingroup BufferEntrada
+ *
+ * @brief Une una lectura a la linea pendiente y extrae las lineas completas
+ *
+ * @synopsis
+ * @code
+ * 	char *ensamblarLineas(pBufferEntrada buffer, char *lectura, size_t tam, size_t *len)
+ * @endcode
+ *
+ * @param[in] buffer el buffer de la conexion
+ * @param[in] lectura datos recibidos
+ * @param[in] tam bytes recibidos
+ * @param[out] len longitud del mensaje devuelto
+ *
+ * @return las lineas completas, cada una terminada en CRLF y en '\\0' para
+ * analizarla en su sitio, reservadas con malloc, o NULL si no se ha
+ * completado ninguna. len cuenta tambien los '\\0'
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char *ensamblarLineas(pBufferEntrada buffer, char *lectura, size_t tam, size_t *len){
+	char *ultimo, *inicio, *fin, *nl, *msg;
+	size_t completo, lineas = 0, pos = 0;
+
+	*len = 0;
+
+	/* Sin fin de linea todo queda pendiente */
+	ultimo = (char *) memrchr(lectura, '\n', tam);
+	if(ultimo == NULL){
+		annadirPendiente(buffer, lectura, tam);
+		return NULL;
+	}
+	completo = ultimo - lectura + 1;
+
+	for(nl = lectura; (nl = memchr(nl, '\n', lectura + completo - nl)) != NULL; nl++){
+		lineas++;
+	}
+
+	/* Cada linea crece como mucho un byte al pasar de LF a CRLF y otro por su '\0' */
+	msg = (char *) malloc(buffer->len + completo + 2 * lineas + 1);
+	if(msg == NULL){
+		syslog(LOG_ERR, "Error reservando memoria para lineas recibidas");
+		vaciarBufferEntrada(buffer);
+		return NULL;
+	}
+
+	inicio = lectura;
+	fin = lectura + completo;
+
+	/* La primera linea empieza en lo que quedo pendiente */
+	nl = memchr(inicio, '\n', fin - inicio);
+	if(buffer->len > 0){
+		annadirPendiente(buffer, inicio, nl - inicio);
+		copiarLinea(msg, &pos, buffer->datos, buffer->len);
+		inicio = nl + 1;
+	}
+
+	for(; inicio < fin; inicio = nl + 1){
+		nl = memchr(inicio, '\n', fin - inicio);
+		copiarLinea(msg, &pos, inicio, nl - inicio);
+	}
+
+	/* Lo que sigue al ultimo fin de linea queda para la siguiente lectura */
+	vaciarBufferEntrada(buffer);
+	annadirPendiente(buffer, lectura + completo, tam - completo);
+
+	if(pos == 0){
+		free(msg);
+		return NULL;
+	}
+
+	msg[pos] = '\0';
+	*len = pos;
+
+	return msg;
+}
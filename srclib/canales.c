@@ -0,0 +1,997 @@
+/**
+ * @file canales.c
+ * @brief indice de miembros de cada canal por descriptor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Canales Canales
+ *
+ * <hr>
+ */
+
+#include <ctype.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+#include "../includes/canales.h"
+#include "../includes/conexiones.h"
+#include "../includes/epocas.h"
+
+#define PARTICION(cubeta) ((cubeta) & (particionesCanales - 1))
+
+/**
+ * @addtogroup Canales
+ * Comprende las funciones del indice de canales. El TAD sigue siendo quien
+ * decide quien puede unirse o salir de un canal; este indice guarda ademas
+ * los descriptores de sus miembros para que enviar una linea a un canal sea
+ * recorrer un array, sin pedir al TAD la lista de nicks ni buscar el socket
+ * de cada uno.
+ *
+ * Difundir no toma ningun cerrojo. Cada canal publica sus miembros como
+ * una instantanea inmutable: los JOIN, PART, KICK y QUIT construyen una
+ * nueva, la publican en lugar de la anterior y retiran esta por epocas, que
+ * se libera cuando ningun lector puede seguir recorriendola. Las cadenas de
+ * la tabla se recorren igual, y los canales vacios tambien se retiran.
+ *
+ * Los cambios se serializan con un mutex por particion de cubetas. La lista
+ * de canales de cada conexion se protege con el mutex de la conexion, que
+ * siempre se toma despues del de la particion.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Calcula la cubeta de un canal sin distinguir mayusculas
+ *
+ * @synopsis
+ * @code
+ * 	unsigned int cubetaCanal(char *nombre)
+ * @endcode
+ *
+ * @param[in] nombre nombre del canal
+ *
+ * @return la cubeta en tablaCanales
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+unsigned int cubetaCanal(char *nombre){
+	unsigned int h = 2166136261u;
+
+	for(; *nombre; nombre++){
+		h = (h ^ (unsigned char) tolower((unsigned char) *nombre)) * 16777619u;
+	}
+
+	return h & (TAM_TABLA_CANALES - 1);
+}
+
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Busca un canal en la tabla, dentro de una epoca o con el mutex de su particion
+ *
+ * @synopsis
+ * @code
+ * 	pCanal buscarCanal(char *nombre, unsigned int cubeta)
+ * @endcode
+ *
+ * @param[in] nombre nombre del canal
+ * @param[in] cubeta cubeta del canal, de cubetaCanal
+ *
+ * @return el canal, o NULL si no tiene miembros
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pCanal buscarCanal(char *nombre, unsigned int cubeta){
+	pCanal canal;
+
+	canal = __atomic_load_n(&tablaCanales[cubeta], __ATOMIC_ACQUIRE);
+	for(; canal != NULL; canal = __atomic_load_n(&canal->siguiente, __ATOMIC_ACQUIRE)){
+		if(strcasecmp(canal->nombre, nombre) == 0){
+			return canal;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Libera un canal retirado junto con su ultima instantanea
+ *
+ * @synopsis
+ * @code
+ * 	void liberarCanalRetirado(void *ptr)
+ * @endcode
+ *
+ * @param[in] ptr el canal
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarCanalRetirado(void *ptr){
+	pCanal canal = (pCanal) ptr;
+
+	free(canal->nombre);
+	free(canal->clave);
+	free(canal->miembros);
+	free(canal);
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Crea una instantanea de miembros
+ *
+ * @synopsis
+ * @code
+ * 	pMiembros crearMiembros(int num)
+ * @endcode
+ *
+ * @param[in] num numero de miembros
+ *
+ * @return la instantanea, con num fijado y los descriptores por rellenar, o NULL
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pMiembros crearMiembros(int num){
+	pMiembros miembros;
+
+	miembros = (pMiembros) malloc(sizeof(Miembros) + num * sizeof(int));
+	if(miembros != NULL){
+		miembros->num = num;
+	}
+
+	return miembros;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Apunta un canal en la lista de canales de una conexion, con el mutex del canal tomado
+ *
+ * @synopsis
+ * @code
+ * 	status apuntarCanal(pConexion conexion, pCanal canal)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ * @param[in] canal el canal
+ *
+ * @return CANAL_OK si todo va bien. CANAL_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status apuntarCanal(pConexion conexion, pCanal canal){
+	pEnlaceCanal canales;
+	int cap;
+
+	pthread_mutex_lock(&conexion->mutex);
+
+	if(conexion->numCanales == conexion->capCanales){
+		cap = conexion->capCanales ? conexion->capCanales * 2 : MIEMBROS_INICIAL;
+		canales = (pEnlaceCanal) realloc(conexion->canales, cap * sizeof(EnlaceCanal));
+		if(canales == NULL){
+			pthread_mutex_unlock(&conexion->mutex);
+			return CANAL_ERROR;
+		}
+		conexion->canales = canales;
+		conexion->capCanales = cap;
+	}
+
+	conexion->canales[conexion->numCanales].canal = canal;
+	conexion->canales[conexion->numCanales].particion = PARTICION(canal->cubeta);
+	conexion->numCanales++;
+
+	pthread_mutex_unlock(&conexion->mutex);
+
+	return CANAL_OK;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Quita a un miembro de un canal y el canal de su conexion, con el mutex del canal tomado
+ *
+ * El canal desaparece del indice cuando se queda vacio, como en el TAD.
+ *
+ * @synopsis
+ * @code
+ * 	void quitarMiembro(pCanal canal, int fd)
+ * @endcode
+ *
+ * @param[in] canal el canal
+ * @param[in] fd descriptor del miembro
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void quitarMiembro(pCanal canal, int fd){
+	pConexion conexion;
+	pMiembros actual, nueva;
+	pCanal *anterior;
+	int i, j, vacio = 0;
+
+	actual = canal->miembros;
+	for(i = 0; i < actual->num && actual->fds[i] != fd; i++);
+
+	if(i < actual->num && actual->num == 1){
+		vacio = 1;
+	} else if(i < actual->num){
+		nueva = crearMiembros(actual->num - 1);
+		if(nueva != NULL){
+			for(j = 0; j < actual->num; j++){
+				if(j != i){
+					nueva->fds[j < i ? j : j - 1] = actual->fds[j];
+				}
+			}
+			__atomic_store_n(&canal->miembros, nueva, __ATOMIC_RELEASE);
+			retirarEpoca(actual, free);
+		} else {
+			/* Sin memoria se quita en el sitio: un lector a medias como mucho repite al ultimo */
+			actual->fds[i] = actual->fds[actual->num - 1];
+			__atomic_store_n(&actual->num, actual->num - 1, __ATOMIC_RELEASE);
+		}
+	}
+
+	conexion = obtenerConexion(fd);
+	if(conexion != NULL){
+		pthread_mutex_lock(&conexion->mutex);
+		for(j = 0; j < conexion->numCanales && conexion->canales[j].canal != canal; j++);
+		if(j < conexion->numCanales){
+			conexion->canales[j] = conexion->canales[--conexion->numCanales];
+		}
+		pthread_mutex_unlock(&conexion->mutex);
+	}
+
+	/* El ultimo miembro se lleva el canal entero */
+	if(vacio){
+		for(anterior = &tablaCanales[canal->cubeta]; *anterior != canal; anterior = &(*anterior)->siguiente);
+		__atomic_store_n(anterior, canal->siguiente, __ATOMIC_RELEASE);
+		retirarEpoca(canal, liberarCanalRetirado);
+	}
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Inicializa la tabla de canales
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarCanales(unsigned int particiones)
+ * @endcode
+ *
+ * @param[in] particiones mutex entre los que se reparten las cubetas, se
+ * redondea a la potencia de 2 inferior; 1 equivale a un mutex global
+ *
+ * @return CANAL_OK si todo va bien. CANAL_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarCanales(unsigned int particiones){
+	unsigned int i;
+
+	memset(tablaCanales, 0, sizeof(tablaCanales));
+
+	if(particiones == 0){
+		particiones = 1;
+	} else if(particiones > MAX_PARTICIONES_CANALES){
+		particiones = MAX_PARTICIONES_CANALES;
+	}
+	for(particionesCanales = 1; particionesCanales * 2 <= particiones; particionesCanales *= 2);
+
+	for(i = 0; i < particionesCanales; i++){
+		if(pthread_mutex_init(&locksCanales[i], NULL) != 0){
+			while(i-- > 0){
+				pthread_mutex_destroy(&locksCanales[i]);
+			}
+			return CANAL_ERROR;
+		}
+	}
+
+	if(pthread_key_create(&claveVecinos, free) != 0){
+		for(i = 0; i < particionesCanales; i++){
+			pthread_mutex_destroy(&locksCanales[i]);
+		}
+		return CANAL_ERROR;
+	}
+
+	return CANAL_OK;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Annade una conexion a los miembros de un canal, creandolo si hace falta
+ *
+ * Se llama cuando el TAD ya ha aceptado el JOIN.
+ *
+ * @synopsis
+ * @code
+ * 	status unirCanal(char *nombre, int fd)
+ * @endcode
+ *
+ * @param[in] nombre nombre del canal
+ * @param[in] fd descriptor de la conexion
+ *
+ * @return CANAL_OK si todo va bien. CANAL_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status unirCanal(char *nombre, int fd){
+	pConexion conexion;
+	pCanal canal;
+	pMiembros actual, nueva;
+	pthread_mutex_t *lock;
+	unsigned int cubeta;
+	int i;
+
+	conexion = obtenerConexion(fd);
+	if(nombre == NULL || conexion == NULL){
+		return CANAL_ERROR;
+	}
+
+	cubeta = cubetaCanal(nombre);
+	lock = &locksCanales[PARTICION(cubeta)];
+	pthread_mutex_lock(lock);
+
+	canal = buscarCanal(nombre, cubeta);
+	if(canal == NULL){
+		/* Se publica ya completo, con su primer miembro */
+		canal = (pCanal) calloc(1, sizeof(Canal));
+		if(canal == NULL || (canal->nombre = strdup(nombre)) == NULL || (canal->miembros = crearMiembros(1)) == NULL){
+			if(canal) free(canal->nombre);
+			free(canal);
+			pthread_mutex_unlock(lock);
+			return CANAL_ERROR;
+		}
+		canal->miembros->fds[0] = fd;
+		canal->cubeta = cubeta;
+		canal->siguiente = tablaCanales[cubeta];
+		__atomic_store_n(&tablaCanales[cubeta], canal, __ATOMIC_RELEASE);
+
+	} else {
+		actual = canal->miembros;
+		for(i = 0; i < actual->num; i++){
+			if(actual->fds[i] == fd){
+				pthread_mutex_unlock(lock);
+				return CANAL_OK;
+			}
+		}
+
+		nueva = crearMiembros(actual->num + 1);
+		if(nueva == NULL){
+			pthread_mutex_unlock(lock);
+			return CANAL_ERROR;
+		}
+		memcpy(nueva->fds, actual->fds, actual->num * sizeof(int));
+		nueva->fds[actual->num] = fd;
+		__atomic_store_n(&canal->miembros, nueva, __ATOMIC_RELEASE);
+		retirarEpoca(actual, free);
+	}
+
+	if(apuntarCanal(conexion, canal) != CANAL_OK){
+		quitarMiembro(canal, fd);
+		pthread_mutex_unlock(lock);
+		return CANAL_ERROR;
+	}
+
+	pthread_mutex_unlock(lock);
+
+	return CANAL_OK;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Quita una conexion de los miembros de un canal
+ *
+ * El canal desaparece del indice cuando se queda vacio, como en el TAD.
+ *
+ * @synopsis
+ * @code
+ * 	status salirCanal(char *nombre, int fd)
+ * @endcode
+ *
+ * @param[in] nombre nombre del canal
+ * @param[in] fd descriptor de la conexion
+ *
+ * @return CANAL_OK si la conexion estaba en el canal. CANAL_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status salirCanal(char *nombre, int fd){
+	pCanal canal;
+	pthread_mutex_t *lock;
+	unsigned int cubeta;
+	int i;
+
+	if(nombre == NULL){
+		return CANAL_ERROR;
+	}
+
+	cubeta = cubetaCanal(nombre);
+	lock = &locksCanales[PARTICION(cubeta)];
+	pthread_mutex_lock(lock);
+
+	canal = buscarCanal(nombre, cubeta);
+	if(canal == NULL){
+		pthread_mutex_unlock(lock);
+		return CANAL_ERROR;
+	}
+
+	for(i = 0; i < canal->miembros->num && canal->miembros->fds[i] != fd; i++);
+	if(i == canal->miembros->num){
+		pthread_mutex_unlock(lock);
+		return CANAL_ERROR;
+	}
+
+	quitarMiembro(canal, fd);
+
+	pthread_mutex_unlock(lock);
+
+	return CANAL_OK;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Quita una conexion de todos los canales a los que esta unida
+ *
+ * Se llama al cerrar la conexion, antes de que el descriptor pueda
+ * reutilizarse para otro cliente. Se recorre particion a particion: con el
+ * mutex de una particion tomado, sus canales de la lista siguen existiendo.
+ * Los lectores que aun tengan el descriptor en una instantanea antigua no
+ * escriben en el siguiente cliente porque el descriptor se cierra con
+ * cerrarTrasLectores, cuando ya no queda ninguno.
+ *
+ * @synopsis
+ * @code
+ * 	void salirTodosCanales(int fd)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void salirTodosCanales(int fd){
+	pConexion conexion;
+	pCanal canal;
+	unsigned int particion;
+	int i;
+
+	conexion = obtenerConexion(fd);
+	if(conexion == NULL){
+		return;
+	}
+
+	for(;;){
+		pthread_mutex_lock(&conexion->mutex);
+		if(conexion->numCanales == 0){
+			pthread_mutex_unlock(&conexion->mutex);
+			break;
+		}
+		particion = conexion->canales[conexion->numCanales - 1].particion;
+		pthread_mutex_unlock(&conexion->mutex);
+
+		pthread_mutex_lock(&locksCanales[particion]);
+		do {
+			canal = NULL;
+			pthread_mutex_lock(&conexion->mutex);
+			for(i = conexion->numCanales - 1; i >= 0; i--){
+				if(conexion->canales[i].particion == particion){
+					canal = conexion->canales[i].canal;
+					break;
+				}
+			}
+			pthread_mutex_unlock(&conexion->mutex);
+
+			if(canal != NULL){
+				quitarMiembro(canal, fd);
+			}
+		} while(canal != NULL);
+		pthread_mutex_unlock(&locksCanales[particion]);
+	}
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Cierra un descriptor retirado, guardado como el descriptor mas uno
+ *
+ * @synopsis
+ * @code
+ * 	void cerrarRetirado(void *fd)
+ * @endcode
+ *
+ * @param[in] fd descriptor mas uno, para que el 0 no sea NULL
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void cerrarRetirado(void *fd){
+	close((int) (long) fd - 1);
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Cierra el descriptor de una conexion liberada cuando ningun lector pueda tenerlo
+ *
+ * Una difusion que empezo antes de salirTodosCanales puede tener aun el
+ * descriptor en su instantanea de miembros. Mientras siga abierto el
+ * kernel no lo da a otro cliente, y la conexion ya liberada rechaza lo
+ * que se le encole. El cliente ve el cierre en el momento por el shutdown;
+ * solo el close se retira con la epoca, sin esperar en el reactor.
+ *
+ * @synopsis
+ * @code
+ * 	void cerrarTrasLectores(int fd)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion, ya fuera de la tabla de conexiones
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void cerrarTrasLectores(int fd){
+	shutdown(fd, SHUT_RDWR);
+	retirarEpoca((void *) (long) (fd + 1), cerrarRetirado);
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Encola un mensaje a todos los miembros de un canal
+ *
+ * El mensaje se copia una vez a un MensajeCompartido y los miembros que no
+ * lo puedan recibir en el momento lo encolan por referencia.
+ *
+ * @synopsis
+ * @code
+ * 	int difundirCanal(char *nombre, char *mensaje, size_t len, int excluido)
+ * @endcode
+ *
+ * @param[in] nombre nombre del canal
+ * @param[in] mensaje mensaje a enviar
+ * @param[in] len longitud del mensaje
+ * @param[in] excluido descriptor que no lo recibe, normalmente el emisor, o -1
+ *
+ * @return numero de miembros a los que se ha enviado, o -1 si el canal no existe
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int difundirCanal(char *nombre, char *mensaje, size_t len, int excluido){
+	pCanal canal;
+	pMiembros miembros;
+	pConexion conexion;
+	pMensajeCompartido compartido;
+	pthread_mutex_t *lock = NULL;
+	unsigned int cubeta;
+	int i, num, enviados = -1;
+
+	if(nombre == NULL || mensaje == NULL){
+		return -1;
+	}
+
+	compartido = crearMensajeCompartido(mensaje, len);
+	if(compartido == NULL){
+		return -1;
+	}
+
+	cubeta = cubetaCanal(nombre);
+
+	/* Sin ranura de epoca libre se lee como un escritor */
+	if(entrarEpoca() != EPOCA_OK){
+		lock = &locksCanales[PARTICION(cubeta)];
+		pthread_mutex_lock(lock);
+	}
+
+	canal = buscarCanal(nombre, cubeta);
+	if(canal != NULL){
+		enviados = 0;
+		miembros = __atomic_load_n(&canal->miembros, __ATOMIC_ACQUIRE);
+		num = __atomic_load_n(&miembros->num, __ATOMIC_ACQUIRE);
+		for(i = 0; i < num; i++){
+			if(miembros->fds[i] == excluido){
+				continue;
+			}
+			conexion = obtenerConexion(miembros->fds[i]);
+			if(conexion != NULL && encolarCompartido(conexion, compartido) >= 0){
+				enviados++;
+			}
+		}
+	}
+
+	if(lock){
+		pthread_mutex_unlock(lock);
+	} else {
+		salirEpoca();
+	}
+
+	/* Las colas que lo guardan tienen su propia referencia */
+	soltarMensajeCompartido(compartido);
+
+	return enviados;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Copia los descriptores de los miembros de un canal, para WHO
+ *
+ * @synopsis
+ * @code
+ * 	int listarMiembrosCanal(char *nombre, pArena arena, int **fds)
+ * @endcode
+ *
+ * @param[in] nombre nombre del canal
+ * @param[in] arena arena del hilo, de la que sale la copia
+ * @param[out] fds copia de los descriptores, valida hasta que se reinicie la arena
+ *
+ * @return numero de miembros, o -1 si el canal no existe o no hay memoria
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int listarMiembrosCanal(char *nombre, pArena arena, int **fds){
+	pCanal canal;
+	pMiembros miembros;
+	pthread_mutex_t *lock = NULL;
+	unsigned int cubeta;
+	int num = -1;
+
+	*fds = NULL;
+	if(nombre == NULL){
+		return -1;
+	}
+
+	cubeta = cubetaCanal(nombre);
+	if(entrarEpoca() != EPOCA_OK){
+		lock = &locksCanales[PARTICION(cubeta)];
+		pthread_mutex_lock(lock);
+	}
+
+	canal = buscarCanal(nombre, cubeta);
+	if(canal != NULL){
+		miembros = __atomic_load_n(&canal->miembros, __ATOMIC_ACQUIRE);
+		num = __atomic_load_n(&miembros->num, __ATOMIC_ACQUIRE);
+		*fds = (int *) reservarArena(arena, num * sizeof(int));
+		if(*fds != NULL){
+			memcpy(*fds, miembros->fds, num * sizeof(int));
+		} else {
+			num = -1;
+		}
+	}
+
+	if(lock){
+		pthread_mutex_unlock(lock);
+	} else {
+		salirEpoca();
+	}
+
+	return num;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Devuelve las marcas de vecinos del hilo que llama, creandolas la primera vez
+ *
+ * Hay una marca por descriptor; cada difusion usa una generacion nueva, por
+ * lo que no hace falta limpiarlas entre una y otra salvo cuando la
+ * generacion da la vuelta.
+ *
+ * @synopsis
+ * @code
+ * 	pMarcasVecinos marcasHilo(void)
+ * @endcode
+ *
+ * @return las marcas, o NULL si no hay memoria
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pMarcasVecinos marcasHilo(void){
+	pMarcasVecinos marcas;
+
+	marcas = (pMarcasVecinos) pthread_getspecific(claveVecinos);
+	if(marcas != NULL){
+		return marcas;
+	}
+
+	marcas = (pMarcasVecinos) calloc(1, sizeof(MarcasVecinos) + maxConexiones * sizeof(unsigned int));
+	if(marcas == NULL){
+		return NULL;
+	}
+	pthread_setspecific(claveVecinos, marcas);
+
+	return marcas;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Encola un mensaje a los miembros de una instantanea que aun no lo tengan
+ *
+ * @synopsis
+ * @code
+ * 	int difundirMarcando(pMiembros miembros, pMarcasVecinos marcas, pMensajeCompartido compartido)
+ * @endcode
+ *
+ * @param[in] miembros instantanea de miembros de un canal
+ * @param[in] marcas marcas del hilo, con la generacion de esta difusion
+ * @param[in] compartido el mensaje
+ *
+ * @return numero de miembros a los que se ha enviado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int difundirMarcando(pMiembros miembros, pMarcasVecinos marcas, pMensajeCompartido compartido){
+	pConexion conexion;
+	int i, fd, num, enviados = 0;
+
+	num = __atomic_load_n(&miembros->num, __ATOMIC_ACQUIRE);
+	for(i = 0; i < num; i++){
+		fd = miembros->fds[i];
+		if(fd < 0 || fd >= maxConexiones || marcas->marcas[fd] == marcas->generacion){
+			continue;
+		}
+		marcas->marcas[fd] = marcas->generacion;
+
+		conexion = obtenerConexion(fd);
+		if(conexion != NULL && encolarCompartido(conexion, compartido) >= 0){
+			enviados++;
+		}
+	}
+
+	return enviados;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Encola un mensaje una sola vez a cada conexion que comparte algun canal con fd
+ *
+ * Para QUIT y NICK. Se recorren los miembros de los canales de la conexion
+ * marcando cada descriptor con la generacion de la difusion, de modo que
+ * quien comparte varios canales lo recibe una vez y el coste es la suma de
+ * los tamannos de los canales, sin pasar por la lista de usuarios del TAD.
+ *
+ * Los canales de la conexion se copian por lotes con su mutex, que no se
+ * puede tener mientras se encola a otras conexiones. Sin ranura de epoca
+ * se toman todas las particiones, como al liberar la tabla.
+ *
+ * @synopsis
+ * @code
+ * 	int difundirVecinos(int fd, char *mensaje, size_t len)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion, que no lo recibe
+ * @param[in] mensaje mensaje a enviar
+ * @param[in] len longitud del mensaje
+ *
+ * @return numero de vecinos a los que se ha enviado, o -1 si hay error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int difundirVecinos(int fd, char *mensaje, size_t len){
+	pConexion conexion;
+	pMarcasVecinos marcas;
+	pMensajeCompartido compartido;
+	pCanal lote[LOTE_VECINOS];
+	unsigned int p;
+	short epoca;
+	int i, n, desde = 0, enviados = 0;
+
+	conexion = obtenerConexion(fd);
+	marcas = marcasHilo();
+	if(conexion == NULL || marcas == NULL || mensaje == NULL){
+		return -1;
+	}
+
+	compartido = crearMensajeCompartido(mensaje, len);
+	if(compartido == NULL){
+		return -1;
+	}
+
+	/* Generacion nueva; al dar la vuelta las marcas viejas podrian coincidir */
+	if(++marcas->generacion == 0){
+		memset(marcas->marcas, 0, maxConexiones * sizeof(unsigned int));
+		marcas->generacion = 1;
+	}
+	marcas->marcas[fd] = marcas->generacion;
+
+	epoca = entrarEpoca() == EPOCA_OK;
+	if(!epoca){
+		for(p = 0; p < particionesCanales; p++){
+			pthread_mutex_lock(&locksCanales[p]);
+		}
+	}
+
+	do {
+		pthread_mutex_lock(&conexion->mutex);
+		for(n = 0; n < LOTE_VECINOS && desde + n < conexion->numCanales; n++){
+			lote[n] = conexion->canales[desde + n].canal;
+		}
+		pthread_mutex_unlock(&conexion->mutex);
+
+		for(i = 0; i < n; i++){
+			enviados += difundirMarcando(__atomic_load_n(&lote[i]->miembros, __ATOMIC_ACQUIRE), marcas, compartido);
+		}
+		desde += n;
+	} while(n == LOTE_VECINOS);
+
+	if(epoca){
+		salirEpoca();
+	} else {
+		for(p = particionesCanales; p-- > 0;){
+			pthread_mutex_unlock(&locksCanales[p]);
+		}
+	}
+
+	soltarMensajeCompartido(compartido);
+
+	return enviados;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Guarda la clave de un canal junto a sus miembros
+ *
+ * Solo la lee el relevo, con el servidor parado, por lo que basta con el
+ * cerrojo de la particion.
+ *
+ * @synopsis
+ * @code
+ * 	status fijarClaveCanal(char *nombre, char *clave)
+ * @endcode
+ *
+ * @param[in] nombre nombre del canal
+ * @param[in] clave la clave, NULL para quitarla
+ *
+ * @return CANAL_OK si el canal existe. CANAL_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status fijarClaveCanal(char *nombre, char *clave){
+	pCanal canal;
+	pthread_mutex_t *lock;
+	unsigned int cubeta;
+	char *nueva = NULL;
+
+	if(nombre == NULL || (clave != NULL && (nueva = strdup(clave)) == NULL)){
+		return CANAL_ERROR;
+	}
+
+	cubeta = cubetaCanal(nombre);
+	lock = &locksCanales[PARTICION(cubeta)];
+	pthread_mutex_lock(lock);
+
+	canal = buscarCanal(nombre, cubeta);
+	if(canal == NULL){
+		pthread_mutex_unlock(lock);
+		free(nueva);
+		return CANAL_ERROR;
+	}
+
+	free(canal->clave);
+	canal->clave = nueva;
+
+	pthread_mutex_unlock(lock);
+
+	return CANAL_OK;
+}
+
+/**
+ * @ingroup Canales
+ *
+ * @brief Libera la tabla de canales
+ *
+ * @synopsis
+ * @code
+ * 	void liberarCanales(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarCanales(void){
+	pCanal canal, siguiente;
+	unsigned int i;
+
+	for(i = 0; i < particionesCanales; i++){
+		pthread_mutex_lock(&locksCanales[i]);
+	}
+	for(i = 0; i < TAM_TABLA_CANALES; i++){
+		for(canal = tablaCanales[i]; canal != NULL; canal = siguiente){
+			siguiente = canal->siguiente;
+			liberarCanalRetirado(canal);
+		}
+		tablaCanales[i] = NULL;
+	}
+	for(i = 0; i < particionesCanales; i++){
+		pthread_mutex_unlock(&locksCanales[i]);
+		pthread_mutex_destroy(&locksCanales[i]);
+	}
+
+	free(pthread_getspecific(claveVecinos));
+	pthread_setspecific(claveVecinos, NULL);
+	pthread_key_delete(claveVecinos);
+}
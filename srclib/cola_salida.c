@@ -0,0 +1,823 @@
+/**
+ * @file cola_salida.c
+ * @brief cola de salida no bloqueante de cada conexion
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup ColaSalida ColaSalida
+ *
+ * <hr>
+ */
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "../includes/cola_salida.h"
+#include "../includes/conexiones.h"
+#include "../includes/reactor.h"
+#include "../includes/ssl.h"
+
+/**
+ * @addtogroup ColaSalida
+ * Comprende las funciones de la cola de salida de cada conexion. Los
+ * mensajes se escriben directamente si la cola esta vacia y el socket lo
+ * admite; lo que no cabe se guarda en bloques que el reactor envia cuando
+ * el socket vuelve a admitir escritura, de modo que un cliente lento nunca
+ * bloquea a un trabajador. Todas las funciones se ejecutan con el mutex de
+ * la conexion.
+ *
+ * Un mensaje que va a muchas conexiones, como un PRIVMSG a un canal, se
+ * crea una sola vez como MensajeCompartido y cada cola que no lo pueda
+ * escribir en el momento guarda una referencia en lugar de una copia. El
+ * mensaje se libera cuando lo suelta el ultimo que lo tenia.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Escribe en el socket sin bloquear
+ *
+ * @synopsis
+ * @code
+ * 	ssize_t escribirDirecto(int fd, char *datos, size_t len)
+ * @endcode
+ *
+ * @param[in] fd el socket
+ * @param[in] datos datos a escribir
+ * @param[in] len numero de bytes
+ *
+ * @return bytes escritos, 0 si el socket no admite mas datos, -1 en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+ssize_t escribirDirecto(int fd, char *datos, size_t len){
+	ssize_t n;
+
+	if(ssl_active){
+		n = enviar_datos_SSL(fd, datos, len);
+		if(n <= 0){
+			return reintentar_SSL(fd, n) ? 0 : -1;
+		}
+		return n;
+	}
+
+	do {
+		n = send(fd, datos, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+	} while(n < 0 && errno == EINTR);
+
+	if(n < 0){
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+	}
+
+	return n;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Devuelve los datos de un bloque, propios o compartidos
+ *
+ * @synopsis
+ * @code
+ * 	char *datosBloque(pBloqueSalida b)
+ * @endcode
+ *
+ * @param[in] b el bloque
+ *
+ * @return los datos del bloque
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char *datosBloque(pBloqueSalida b){
+	return b->compartido ? b->compartido->datos : b->datos;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Libera un bloque y suelta su mensaje compartido si lo tiene
+ *
+ * @synopsis
+ * @code
+ * 	void liberarBloque(pBloqueSalida b)
+ * @endcode
+ *
+ * @param[in] b el bloque
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarBloque(pBloqueSalida b){
+
+	if(b->compartido){
+		soltarMensajeCompartido(b->compartido);
+	}
+	free(b);
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Elimina de la cola los bytes ya enviados
+ *
+ * @synopsis
+ * @code
+ * 	void consumirSalida(pColaSalida cola, size_t n)
+ * @endcode
+ *
+ * @param[in] cola la cola
+ * @param[in] n bytes enviados
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void consumirSalida(pColaSalida cola, size_t n){
+	pBloqueSalida b;
+	size_t resto;
+
+	cola->bytes -= n;
+
+	while(n > 0 && cola->primero){
+		b = cola->primero;
+		resto = b->len - b->enviado;
+		if(n < resto){
+			b->enviado += n;
+			return;
+		}
+		n -= resto;
+		cola->primero = b->sig;
+		liberarBloque(b);
+	}
+
+	if(cola->primero == NULL){
+		cola->ultimo = NULL;
+	}
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Copia en orden los bytes pendientes de una cola sin consumirlos
+ *
+ * @synopsis
+ * @code
+ * 	size_t copiarSalida(pColaSalida cola, char *destino)
+ * @endcode
+ *
+ * @param[in] cola la cola, con el mutex de su conexion cogido
+ * @param[out] destino buffer de al menos cola->bytes bytes
+ *
+ * @return bytes copiados
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t copiarSalida(pColaSalida cola, char *destino){
+	pBloqueSalida b;
+	size_t copiados = 0;
+
+	for(b = cola->primero; b != NULL; b = b->sig){
+		memcpy(destino + copiados, datosBloque(b) + b->enviado, b->len - b->enviado);
+		copiados += b->len - b->enviado;
+	}
+
+	return copiados;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Libera todos los bloques de la cola
+ *
+ * @synopsis
+ * @code
+ * 	void descartarSalida(pColaSalida cola)
+ * @endcode
+ *
+ * @param[in] cola la cola
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void descartarSalida(pColaSalida cola){
+	pBloqueSalida b;
+
+	while(cola->primero){
+		b = cola->primero;
+		cola->primero = b->sig;
+		liberarBloque(b);
+	}
+
+	cola->ultimo = NULL;
+	cola->bytes = 0;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Copia datos al final de la cola, agrupando mensajes cortos en un bloque
+ *
+ * @synopsis
+ * @code
+ * 	status annadirSalida(pColaSalida cola, char *datos, size_t len)
+ * @endcode
+ *
+ * @param[in] cola la cola
+ * @param[in] datos datos a copiar
+ * @param[in] len numero de bytes
+ *
+ * @return SALIDA_OK si todo va bien. SALIDA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status annadirSalida(pColaSalida cola, char *datos, size_t len){
+	pBloqueSalida b = cola->ultimo;
+	size_t cap;
+
+	/* Los bloques compartidos no admiten mas datos */
+	if(b == NULL || b->compartido || b->cap - b->len < len){
+		cap = len > TAM_BLOQUE_SALIDA ? len : TAM_BLOQUE_SALIDA;
+		b = (pBloqueSalida) malloc(sizeof(BloqueSalida) + cap);
+		if(b == NULL){
+			syslog(LOG_ERR, "Error reservando bloque de salida de %zu bytes", cap);
+			return SALIDA_ERROR;
+		}
+		b->sig = NULL;
+		b->compartido = NULL;
+		b->cap = cap;
+		b->len = 0;
+		b->enviado = 0;
+
+		if(cola->ultimo) cola->ultimo->sig = b;
+		else cola->primero = b;
+		cola->ultimo = b;
+	}
+
+	memcpy(b->datos + b->len, datos, len);
+	b->len += len;
+	cola->bytes += len;
+
+	return SALIDA_OK;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Encola por referencia lo que falta por enviar de un mensaje compartido
+ *
+ * Si el resto cabe en el hueco del ultimo bloque se copia, que no cuesta
+ * memoria nueva; si no, se encola un bloque que solo lo referencia.
+ *
+ * @synopsis
+ * @code
+ * 	status annadirCompartido(pColaSalida cola, pMensajeCompartido compartido, size_t enviado)
+ * @endcode
+ *
+ * @param[in] cola la cola
+ * @param[in] compartido el mensaje
+ * @param[in] enviado bytes del mensaje ya escritos en el socket
+ *
+ * @return SALIDA_OK si todo va bien. SALIDA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status annadirCompartido(pColaSalida cola, pMensajeCompartido compartido, size_t enviado){
+	pBloqueSalida b = cola->ultimo;
+	size_t resto = compartido->len - enviado;
+
+	if(b != NULL && b->compartido == NULL && b->cap - b->len >= resto){
+		return annadirSalida(cola, compartido->datos + enviado, resto);
+	}
+
+	b = (pBloqueSalida) malloc(sizeof(BloqueSalida));
+	if(b == NULL){
+		syslog(LOG_ERR, "Error reservando bloque de salida compartido");
+		return SALIDA_ERROR;
+	}
+	__sync_fetch_and_add(&compartido->referencias, 1);
+	__sync_fetch_and_add(&compartidosSalida, 1);
+
+	b->sig = NULL;
+	b->compartido = compartido;
+	b->cap = 0;
+	b->len = compartido->len;
+	b->enviado = enviado;
+
+	if(cola->ultimo) cola->ultimo->sig = b;
+	else cola->primero = b;
+	cola->ultimo = b;
+	cola->bytes += resto;
+
+	return SALIDA_OK;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Actualiza la mayor cola de salida observada
+ *
+ * @synopsis
+ * @code
+ * 	void actualizarPicoSalida(size_t bytes)
+ * @endcode
+ *
+ * @param[in] bytes bytes pendientes de una cola
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void actualizarPicoSalida(size_t bytes){
+	size_t pico;
+
+	while(bytes > (pico = picoSalida)){
+		if(__sync_bool_compare_and_swap(&picoSalida, pico, bytes)){
+			return;
+		}
+	}
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Envia bloques de la cola hasta vaciarla o hasta que el socket no admita mas
+ *
+ * Sin SSL se envian varios bloques por llamada con sendmsg, equivalente a
+ * writev pero con MSG_NOSIGNAL y MSG_DONTWAIT.
+ *
+ * @synopsis
+ * @code
+ * 	int vaciarBloques(pConexion conexion)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ *
+ * @return 0 si la cola queda vacia, 1 si quedan datos, -1 en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int vaciarBloques(pConexion conexion){
+	pColaSalida cola = &conexion->salida;
+	struct iovec iov[MAX_IOV_SALIDA];
+	struct msghdr msg;
+	pBloqueSalida b;
+	ssize_t n;
+	int i;
+
+	while(cola->primero){
+
+		if(ssl_active){
+			/* SSL_write cifra un buffer cada vez */
+			b = cola->primero;
+			n = escribirDirecto(conexion->fd, datosBloque(b) + b->enviado, b->len - b->enviado);
+		} else {
+			for(i = 0, b = cola->primero; b && i < MAX_IOV_SALIDA; b = b->sig, i++){
+				iov[i].iov_base = datosBloque(b) + b->enviado;
+				iov[i].iov_len = b->len - b->enviado;
+			}
+
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = iov;
+			msg.msg_iovlen = i;
+
+			do {
+				n = sendmsg(conexion->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+			} while(n < 0 && errno == EINTR);
+
+			if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				n = 0;
+			}
+		}
+
+		if(n < 0){
+			return -1;
+		} else if(n == 0){
+			return 1;
+		}
+
+		consumirSalida(cola, n);
+	}
+
+	return 0;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Expulsa una conexion que no lee lo que se le envia
+ *
+ * Descarta lo pendiente salvo el bloque a medio enviar, para no cortar una
+ * linea, y encola un ERROR. El socket se cierra para lectura: el reactor
+ * propietario ve el fin de la conexion y la cierra con cerrarConexion en su
+ * propio hilo, como si el cliente se hubiera ido.
+ *
+ * @synopsis
+ * @code
+ * 	void expulsarSalida(pConexion conexion)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void expulsarSalida(pConexion conexion){
+	pColaSalida cola = &conexion->salida;
+	pBloqueSalida primero = cola->primero;
+
+	syslog(LOG_WARNING, "Expulsando el socket %d con %zu bytes sin leer", conexion->fd, cola->bytes);
+	__sync_fetch_and_add(&expulsionesSalida, 1);
+
+	if(primero && primero->enviado > 0){
+		cola->primero = primero->sig;
+		descartarSalida(cola);
+		primero->sig = NULL;
+		cola->primero = primero;
+		cola->ultimo = primero;
+		cola->bytes = primero->len - primero->enviado;
+	} else {
+		descartarSalida(cola);
+	}
+
+	annadirSalida(cola, MENSAJE_EXPULSION, strlen(MENSAJE_EXPULSION));
+	cola->expulsada = 1;
+
+	if(!cola->esperando){
+		cola->esperando = 1;
+		armarEscritura(conexion->fd);
+	}
+
+	shutdown(conexion->fd, SHUT_RD);
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Deja la cola vacia y lista para una conexion nueva
+ *
+ * @synopsis
+ * @code
+ * 	void reiniciarColaSalida(pColaSalida cola)
+ * @endcode
+ *
+ * @param[in] cola la cola
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void reiniciarColaSalida(pColaSalida cola){
+	descartarSalida(cola);
+	cola->esperando = 0;
+	cola->error = 0;
+	cola->expulsada = 0;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Envia un mensaje por una conexion sin bloquear
+ *
+ * Si la cola esta vacia se intenta escribir directamente, salvo que la
+ * conexion siga en el handshake SSL; lo que no se haya podido escribir se
+ * encola, copiado o por referencia si el mensaje es compartido, y se pide al
+ * reactor que avise cuando el socket admita escritura. Si la cola superaria
+ * maxSalida la conexion se expulsa.
+ *
+ * @synopsis
+ * @code
+ * 	status encolarMensaje(pConexion conexion, char *mensaje, size_t len, pMensajeCompartido compartido)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ * @param[in] mensaje el mensaje
+ * @param[in] len longitud del mensaje
+ * @param[in] compartido el mensaje compartido del que sale mensaje, o NULL
+ *
+ * @return SALIDA_OK si todo va bien. SALIDA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status encolarMensaje(pConexion conexion, char *mensaje, size_t len, pMensajeCompartido compartido){
+	pColaSalida cola = &conexion->salida;
+	size_t total = len;
+	ssize_t n;
+	status ret;
+
+	pthread_mutex_lock(&conexion->mutex);
+
+	if(conexion->fd < 0 || cola->error || cola->expulsada){
+		pthread_mutex_unlock(&conexion->mutex);
+		return SALIDA_ERROR;
+	}
+
+	/* Con la cola vacia no hay orden que respetar, escribimos ya */
+	if(cola->primero == NULL && !conexion->handshake){
+		n = escribirDirecto(conexion->fd, mensaje, len);
+		if(n < 0){
+			syslog(LOG_DEBUG, "Error n: %d escribiendo en el socket %d", errno, conexion->fd);
+			cola->error = 1;
+			pthread_mutex_unlock(&conexion->mutex);
+			return SALIDA_ERROR;
+		}
+		mensaje += n;
+		len -= n;
+	}
+
+	if(len > 0){
+		/* Un cliente que no lee no puede hacer crecer la memoria sin limite */
+		if(maxSalida > 0 && cola->bytes + len > maxSalida){
+			expulsarSalida(conexion);
+			pthread_mutex_unlock(&conexion->mutex);
+			return SALIDA_ERROR;
+		}
+
+		if(compartido){
+			ret = annadirCompartido(cola, compartido, total - len);
+		} else {
+			ret = annadirSalida(cola, mensaje, len);
+		}
+		if(ret < 0){
+			pthread_mutex_unlock(&conexion->mutex);
+			return SALIDA_ERROR;
+		}
+		actualizarPicoSalida(cola->bytes);
+
+		/* Durante el handshake el reactor envia la cola al terminarlo */
+		if(!cola->esperando){
+			cola->esperando = 1;
+			if(!conexion->handshake){
+				armarEscritura(conexion->fd);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&conexion->mutex);
+
+	return SALIDA_OK;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Envia un mensaje por una conexion sin bloquear, copiando lo que se encole
+ *
+ * @synopsis
+ * @code
+ * 	status encolarSalida(pConexion conexion, char *mensaje, size_t len)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ * @param[in] mensaje el mensaje
+ * @param[in] len longitud del mensaje
+ *
+ * @return SALIDA_OK si todo va bien. SALIDA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status encolarSalida(pConexion conexion, char *mensaje, size_t len){
+	return encolarMensaje(conexion, mensaje, len, NULL);
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Envia un mensaje compartido por una conexion sin bloquear
+ *
+ * Lo que no se pueda escribir en el momento queda encolado por referencia,
+ * de modo que el mensaje no se copia en cada destinatario.
+ *
+ * @synopsis
+ * @code
+ * 	status encolarCompartido(pConexion conexion, pMensajeCompartido compartido)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ * @param[in] compartido el mensaje
+ *
+ * @return SALIDA_OK si todo va bien. SALIDA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status encolarCompartido(pConexion conexion, pMensajeCompartido compartido){
+
+	if(compartido == NULL){
+		return SALIDA_ERROR;
+	}
+
+	return encolarMensaje(conexion, compartido->datos, compartido->len, compartido);
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Crea un mensaje para encolarlo por referencia en varias conexiones
+ *
+ * Quien lo crea tiene una referencia y debe soltarla cuando termine de
+ * encolarlo; cada cola que lo guarde toma la suya.
+ *
+ * @synopsis
+ * @code
+ * 	pMensajeCompartido crearMensajeCompartido(char *mensaje, size_t len)
+ * @endcode
+ *
+ * @param[in] mensaje el mensaje, que se copia
+ * @param[in] len longitud del mensaje
+ *
+ * @return el mensaje compartido, o NULL si no hay memoria
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pMensajeCompartido crearMensajeCompartido(char *mensaje, size_t len){
+	pMensajeCompartido compartido;
+
+	if(mensaje == NULL){
+		return NULL;
+	}
+
+	compartido = (pMensajeCompartido) malloc(sizeof(MensajeCompartido) + len);
+	if(compartido == NULL){
+		syslog(LOG_ERR, "Error reservando mensaje compartido de %zu bytes", len);
+		return NULL;
+	}
+	compartido->referencias = 1;
+	compartido->len = len;
+	memcpy(compartido->datos, mensaje, len);
+
+	return compartido;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Suelta una referencia a un mensaje compartido, liberandolo si era la ultima
+ *
+ * @synopsis
+ * @code
+ * 	void soltarMensajeCompartido(pMensajeCompartido compartido)
+ * @endcode
+ *
+ * @param[in] compartido el mensaje
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void soltarMensajeCompartido(pMensajeCompartido compartido){
+
+	if(compartido != NULL && __sync_sub_and_fetch(&compartido->referencias, 1) == 0){
+		free(compartido);
+	}
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Envia lo pendiente cuando el reactor detecta que el socket admite escritura
+ *
+ * @synopsis
+ * @code
+ * 	int enviarPendiente(pConexion conexion)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ *
+ * @return 0 si la cola queda vacia, 1 si quedan datos, -1 en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int enviarPendiente(pConexion conexion){
+	pColaSalida cola = &conexion->salida;
+	int ret;
+
+	pthread_mutex_lock(&conexion->mutex);
+
+	if(conexion->fd < 0 || cola->error){
+		cola->esperando = 0;
+		pthread_mutex_unlock(&conexion->mutex);
+		return -1;
+	}
+
+	ret = vaciarBloques(conexion);
+	if(ret < 0){
+		/* La lectura detectara el cierre, descartamos lo pendiente */
+		syslog(LOG_DEBUG, "Error n: %d escribiendo en el socket %d", errno, conexion->fd);
+		descartarSalida(cola);
+		cola->error = 1;
+		cola->esperando = 0;
+	} else if(ret == 0){
+		cola->esperando = 0;
+	} else {
+		armarEscritura(conexion->fd);
+	}
+
+	pthread_mutex_unlock(&conexion->mutex);
+
+	return ret;
+}
+
+/**
+ * @ingroup ColaSalida
+ *
+ * @brief Cierra la salida de una conexion que se va a cerrar
+ *
+ * Intenta enviar lo pendiente sin bloquear, descarta el resto, deja de
+ * admitir mensajes y cierra el canal SSL con el mutex de la conexion, de
+ * modo que ningun otro hilo lo este usando.
+ *
+ * @synopsis
+ * @code
+ * 	void cerrarColaSalida(pConexion conexion)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void cerrarColaSalida(pConexion conexion){
+	pColaSalida cola = &conexion->salida;
+
+	pthread_mutex_lock(&conexion->mutex);
+
+	if(!cola->error && !conexion->handshake){
+		vaciarBloques(conexion);
+	}
+	descartarSalida(cola);
+	cola->error = 1;
+	cola->esperando = 0;
+
+	if(ssl_active){
+		cerrar_canal_SSL(conexion->fd);
+	}
+
+	pthread_mutex_unlock(&conexion->mutex);
+}
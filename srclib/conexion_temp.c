@@ -12,11 +12,16 @@
  */
 
 #include "../includes/conexion_temp.h"
+#include "../includes/conexiones.h"
 
 /**
  * @addtogroup TempUser
  * Comprende funciones para el tratamiento de usuarios que no han sido añadidos a la base de datos de metis
  *
+ * Cada usuario temporal vive en la entrada de su descriptor en la tabla de
+ * conexiones, protegido por el mutex de la conexion, de modo que crearlo,
+ * buscarlo y borrarlo no recorre nada ni compite con las demas conexiones.
+ *
  * <hr>
  */
 
@@ -34,7 +39,7 @@
  * @param[in] ip la direccion ip
  * @param[in] host el host
  *
- * @return CON_OK si todo va bien. CON_ERROR en caso contrario
+ * @return CON_OK si todo va bien. CON_LLENO si hay demasiadas conexiones sin registrar. CON_ERROR en caso contrario
  *
  * @author
  * Pablo Marcos Manchon
@@ -43,22 +48,38 @@
  *<hr>
 */
 status newTempUser(int socket,  char *ip, char *host){
-	pTempUser usuario;
+	pTempUser usuario, anterior;
+	pConexion conexion;
+	unsigned long n;
 
 	if(!ip || !host){
 		return CON_ERROR;
 	}
 
+	conexion = obtenerConexion(socket);
+	if(conexion == NULL){
+		return CON_ERROR;
+	}
+
+	/* Una avalancha de clientes que no se registran no puede agotar el servidor */
+	n = __sync_add_and_fetch(&numTemporales, 1);
+	if(maxTemporales > 0 && n > (unsigned long) maxTemporales){
+		__sync_fetch_and_sub(&numTemporales, 1);
+		__sync_fetch_and_add(&rechazadasTemporales, 1);
+		return CON_LLENO;
+	}
 
 	usuario = (pTempUser) calloc(1, sizeof(TempUser));
 
 	if(usuario == NULL){
+		__sync_fetch_and_sub(&numTemporales, 1);
 		return CON_ERROR;
 	}
 
 	usuario->host = (char*) calloc(strlen(host) + 1, sizeof(char));
 	if(usuario->host == NULL){
 		free(usuario);
+		__sync_fetch_and_sub(&numTemporales, 1);
 		return CON_ERROR;
 	}
 	strcpy(usuario->host, host);
@@ -67,21 +88,16 @@ status newTempUser(int socket,  char *ip, char *host){
 	usuario-> socket = socket;
 
 	strcpy(usuario->IP, ip);
-	usuario->previous = NULL;
-	usuario->next = NULL;
-
-	pthread_mutex_lock(&mutexTempUser);
-
-	if( usuarioPrimero == NULL){
-		usuarioPrimero = usuario;
-		usuarioUltimo = usuario;
-	} else {
-		usuarioUltimo->next = usuario;
-		usuario->previous = usuarioUltimo;
-		usuarioUltimo = usuario;
-	}
 
-	pthread_mutex_unlock(&mutexTempUser);
+	pthread_mutex_lock(&conexion->mutex);
+	anterior = conexion->temporal;
+	conexion->temporal = usuario;
+	pthread_mutex_unlock(&conexion->mutex);
+
+	if(anterior != NULL){
+		__sync_fetch_and_sub(&numTemporales, 1);
+		liberaTempUser(anterior);
+	}
 
 	return CON_OK;
 }
@@ -91,6 +107,9 @@ status newTempUser(int socket,  char *ip, char *host){
  *
  * @brief Modifica el nick del usuario temporal
  *
+ * El cambio se hace con el mutex de la conexion, con el que USER copia el
+ * nick antes de registrar al usuario.
+ *
  * @synopsis
  * @code
  * 	status setNickTemporal(pTempUser usuario, char* nick)
@@ -108,21 +127,30 @@ status newTempUser(int socket,  char *ip, char *host){
  *<hr>
 */
 status setNickTemporal(pTempUser usuario, char* nick){
+	pConexion conexion;
+	char *nuevo, *anterior;
 
 	if(usuario == NULL || nick == NULL){
 		return CON_ERROR;
 	}
 
-	if(usuario->nick){
-		free(usuario->nick);
+	nuevo = (char*) calloc(strlen(nick) + 1,  sizeof(char));
+	if(nuevo == NULL){
+		return CON_ERROR;
 	}
+	strcpy(nuevo, nick);
 
-	usuario->nick = (char*) calloc(strlen(nick) + 1,  sizeof(char));
-	if(usuario->nick == NULL){
-		return CON_ERROR;
+	conexion = obtenerConexion(usuario->socket);
+	if(conexion != NULL){
+		pthread_mutex_lock(&conexion->mutex);
+	}
+	anterior = usuario->nick;
+	usuario->nick = nuevo;
+	if(conexion != NULL){
+		pthread_mutex_unlock(&conexion->mutex);
 	}
 
-	strcpy(usuario->nick, nick);
+	free(anterior);
 
 	return CON_OK;
 }
@@ -130,16 +158,21 @@ status setNickTemporal(pTempUser usuario, char* nick){
 /**
  * @ingroup TempUser
  *
- * @brief Busca por socket un usuario temporal en la lista
+ * @brief Cambia el host de un usuario temporal cuando termina su resolucion inversa
+ *
+ * Solo se cambia si el socket sigue siendo de la misma IP; si el
+ * descriptor se ha reutilizado para otro cliente el resultado se descarta.
  *
  * @synopsis
  * @code
- * 	pTempUser pullTempUser(int socket)
+ * 	status setHostTemporal(int socket, char *ip, char *host)
  * @endcode
  *
  * @param[in] socket el socket
+ * @param[in] ip la IP que se ha resuelto
+ * @param[in] host el nuevo host
  *
- * @return el usuario econtrado, o NULL
+ * @return CON_OK si se ha cambiado. CON_ERROR si el usuario ya no existe
  *
  * @author
  * Pablo Marcos Manchon
@@ -147,24 +180,72 @@ status setNickTemporal(pTempUser usuario, char* nick){
  *
  *<hr>
 */
-pTempUser pullTempUser(int socket){
-
+status setHostTemporal(int socket, char *ip, char *host){
 	pTempUser useri;
+	pConexion conexion;
+	char *nuevo;
 
-	pthread_mutex_lock(&mutexTempUser);
+	if(ip == NULL || host == NULL){
+		return CON_ERROR;
+	}
 
-	useri = usuarioPrimero;
-	while (useri != NULL){
-		if(useri->socket == socket){
-			pthread_mutex_unlock(&mutexTempUser);
-			return useri; 
-		}
+	conexion = obtenerConexion(socket);
+	if(conexion == NULL){
+		return CON_ERROR;
+	}
 
-		useri = useri->next;
+	nuevo = (char*) calloc(strlen(host) + 1, sizeof(char));
+	if(nuevo == NULL){
+		return CON_ERROR;
+	}
+	strcpy(nuevo, host);
 
+	pthread_mutex_lock(&conexion->mutex);
+
+	useri = conexion->temporal;
+	if(useri != NULL && strcmp(useri->IP, ip) == 0){
+		host = useri->host;
+		useri->host = nuevo;
+		pthread_mutex_unlock(&conexion->mutex);
+		free(host);
+		return CON_OK;
 	}
-	pthread_mutex_unlock(&mutexTempUser);
-	return NULL;
+
+	pthread_mutex_unlock(&conexion->mutex);
+	free(nuevo);
+
+	return CON_ERROR;
+}
+
+/**
+ * @ingroup TempUser
+ *
+ * @brief Busca por socket un usuario temporal en la tabla de conexiones
+ *
+ * @synopsis
+ * @code
+ * 	pTempUser pullTempUser(int socket)
+ * @endcode
+ *
+ * @param[in] socket el socket
+ *
+ * @return el usuario econtrado, o NULL
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pTempUser pullTempUser(int socket){
+	pConexion conexion;
+
+	conexion = obtenerConexion(socket);
+	if(conexion == NULL){
+		return NULL;
+	}
+
+	return conexion->temporal;
 }
 
 /**
@@ -188,46 +269,23 @@ pTempUser pullTempUser(int socket){
  *<hr>
 */
 status deleteTempUser(int socket){
-
 	pTempUser tuser;
-	tuser = pullTempUser (socket);
-	
-	if(tuser == NULL) 
-		return CON_ERROR;
-
-	pthread_mutex_lock(&mutexTempUser);
-
-	/* Caso unico */
-	if(tuser->previous == NULL && tuser->next == NULL) {
-
-		usuarioPrimero = NULL;
-		usuarioUltimo = NULL;
-
-		pthread_mutex_unlock(&mutexTempUser);
-		return liberaTempUser(tuser);
+	pConexion conexion;
 
+	conexion = obtenerConexion(socket);
+	if(conexion == NULL){
+		return CON_ERROR;
 	}
 
+	pthread_mutex_lock(&conexion->mutex);
+	tuser = conexion->temporal;
+	conexion->temporal = NULL;
+	pthread_mutex_unlock(&conexion->mutex);
 
-	/* Caso primero o ultimo (no unico)*/
-	if(tuser->previous == NULL || tuser->next == NULL) {
-
-		if(tuser->previous == NULL) { /* Caso primero*/
-			(tuser->next)->previous = NULL;
-			usuarioPrimero = tuser->next;
-		
-		} else { /* Caso último */
-			(tuser->previous)->next = NULL;
-			usuarioUltimo = tuser->previous;
-		}
-		
-	} else { /*Caso medio*/
-		(tuser->previous)->next = tuser->next;
-		(tuser->next)->previous = tuser->previous;
-
-	}
+	if(tuser == NULL)
+		return CON_ERROR;
 
-	pthread_mutex_unlock(&mutexTempUser);
+	__sync_fetch_and_sub(&numTemporales, 1);
 	return liberaTempUser(tuser);
 
 }
@@ -282,24 +340,12 @@ status liberaTempUser(pTempUser usuario) {
  *<hr>
 */
 status liberaTodosTempUser(void){
+	int i;
 
-	pTempUser aux = NULL;
-	pTempUser t = NULL;
-
-	pthread_mutex_lock(&mutexTempUser);
-
-	t = usuarioPrimero;
-
-	while(t != NULL){
-		aux = t->next;
-		liberaTempUser(t);
-		t = aux;
+	for(i = 0; i < maxConexiones; i++){
+		deleteTempUser(i);
 	}
 
-	usuarioPrimero = NULL;
-	usuarioUltimo = NULL;
-
-	pthread_mutex_unlock(&mutexTempUser);
 	return CON_OK;
 
 }
@@ -324,12 +370,15 @@ status liberaTodosTempUser(void){
  *<hr>
 */
 status printDebugUsers(void){
-	pTempUser aux = NULL;
-	pTempUser t = usuarioPrimero;
+	pTempUser t;
+	int i;
 
 	printf("Temp users:\n");
-	while(t != NULL){
-		aux = t->next;
+	for(i = 0; i < maxConexiones; i++){
+		t = tablaConexiones[i].temporal;
+		if(t == NULL){
+			continue;
+		}
 		printf("Socket: %d ", t->socket);
 		if(t->nick)
 			printf("Nick: %s ", t->nick);	
@@ -337,8 +386,6 @@ status printDebugUsers(void){
 			printf("Host: %s", t->host);
 
 		printf("\n");
-
-		t = aux;
 	}
 
 	return CON_OK;
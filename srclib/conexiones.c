@@ -0,0 +1,218 @@
+/**
+ * @file conexiones.c
+ * @brief tabla de conexiones del servidor indexada por descriptor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Conexiones Conexiones
+ *
+ * <hr>
+ */
+
+#include <sys/resource.h>
+
+#include "../includes/conexiones.h"
+
+/**
+ * @addtogroup Conexiones
+ * Comprende las funciones de la tabla de conexiones, con una entrada por
+ * descriptor para acceder al estado de cada conexion en O(1)
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Conexiones
+ *
+ * @brief Reserva la tabla de conexiones segun el limite de descriptores
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarConexiones(void)
+ * @endcode
+ *
+ * @return CONEX_OK si todo va bien. CONEX_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarConexiones(void){
+	struct rlimit lim;
+	int i;
+
+	maxConexiones = getdtablesize();
+	if(getrlimit(RLIMIT_NOFILE, &lim) == 0){
+		/* Subimos el limite blando para aguantar reconexiones masivas */
+		if(lim.rlim_cur < LIMITE_DESCRIPTORES && lim.rlim_cur < lim.rlim_max){
+			lim.rlim_cur = lim.rlim_max < LIMITE_DESCRIPTORES ? lim.rlim_max : LIMITE_DESCRIPTORES;
+			if(setrlimit(RLIMIT_NOFILE, &lim) < 0){
+				getrlimit(RLIMIT_NOFILE, &lim);
+			}
+		}
+		if(lim.rlim_cur != RLIM_INFINITY){
+			maxConexiones = (int) lim.rlim_cur;
+		}
+	}
+
+	tablaConexiones = (pConexion) calloc(maxConexiones, sizeof(Conexion));
+	if(tablaConexiones == NULL){
+		syslog(LOG_ERR, "Error reservando tabla de %d conexiones", maxConexiones);
+		maxConexiones = 0;
+		return CONEX_ERROR;
+	}
+
+	for(i = 0; i < maxConexiones; i++){
+		tablaConexiones[i].fd = -1;
+		pthread_mutex_init(&tablaConexiones[i].mutex, NULL);
+	}
+
+	return CONEX_OK;
+}
+
+/**
+ * @ingroup Conexiones
+ *
+ * @brief Devuelve la entrada de la tabla de un descriptor
+ *
+ * @synopsis
+ * @code
+ * 	pConexion obtenerConexion(int fd)
+ * @endcode
+ *
+ * @param[in] fd el descriptor
+ *
+ * @return la conexion, o NULL si el descriptor no esta registrado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pConexion obtenerConexion(int fd){
+
+	if(fd < 0 || fd >= maxConexiones || tablaConexiones[fd].fd != fd){
+		return NULL;
+	}
+
+	return &tablaConexiones[fd];
+}
+
+/**
+ * @ingroup Conexiones
+ *
+ * @brief Registra una conexion recien aceptada y su reactor propietario
+ *
+ * @synopsis
+ * @code
+ * 	status registrarConexion(int fd, struct _Reactor *reactor)
+ * @endcode
+ *
+ * @param[in] fd el descriptor
+ * @param[in] reactor reactor que atendera la conexion
+ *
+ * @return CONEX_OK si todo va bien. CONEX_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status registrarConexion(int fd, struct _Reactor *reactor){
+	pSesion sesion;
+
+	if(fd < 0 || fd >= maxConexiones){
+		syslog(LOG_ERR, "Descriptor %d fuera de la tabla de conexiones", fd);
+		return CONEX_ERROR;
+	}
+
+	/* Los buffers se reutilizan entre conexiones con el mismo descriptor */
+	deleteTempUser(fd);
+	pthread_mutex_lock(&tablaConexiones[fd].mutex);
+	reiniciarColaSalida(&tablaConexiones[fd].salida);
+	tablaConexiones[fd].fd = fd;
+	tablaConexiones[fd].reactor = reactor;
+	tablaConexiones[fd].handshake = 0;
+	sesion = tablaConexiones[fd].sesion;
+	tablaConexiones[fd].sesion = NULL;
+	pthread_mutex_unlock(&tablaConexiones[fd].mutex);
+	vaciarBufferEntrada(&tablaConexiones[fd].entrada);
+	liberarSesion(sesion);
+
+	return CONEX_OK;
+}
+
+/**
+ * @ingroup Conexiones
+ *
+ * @brief Marca como libre la entrada de un descriptor y libera su usuario temporal y su sesion
+ *
+ * @synopsis
+ * @code
+ * 	void liberarConexion(int fd)
+ * @endcode
+ *
+ * @param[in] fd el descriptor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarConexion(int fd){
+	pSesion sesion;
+
+	if(fd < 0 || fd >= maxConexiones){
+		return;
+	}
+
+	deleteTempUser(fd);
+	pthread_mutex_lock(&tablaConexiones[fd].mutex);
+	tablaConexiones[fd].fd = -1;
+	tablaConexiones[fd].reactor = NULL;
+	sesion = tablaConexiones[fd].sesion;
+	tablaConexiones[fd].sesion = NULL;
+	pthread_mutex_unlock(&tablaConexiones[fd].mutex);
+
+	liberarSesion(sesion);
+}
+
+/**
+ * @ingroup Conexiones
+ *
+ * @brief Libera la tabla de conexiones
+ *
+ * @synopsis
+ * @code
+ * 	void liberarConexiones(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarConexiones(void){
+	int i;
+
+	for(i = 0; i < maxConexiones; i++){
+		liberarBufferEntrada(&tablaConexiones[i].entrada);
+		reiniciarColaSalida(&tablaConexiones[i].salida);
+		liberaTempUser(tablaConexiones[i].temporal);
+		liberarSesion(tablaConexiones[i].sesion);
+		free(tablaConexiones[i].canales);
+		pthread_mutex_destroy(&tablaConexiones[i].mutex);
+	}
+
+	free(tablaConexiones);
+	tablaConexiones = NULL;
+	maxConexiones = 0;
+}
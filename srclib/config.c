@@ -10,11 +10,17 @@
  *
  */
 
+#include <sys/signalfd.h>
+
 #include "../includes/config.h"
 #include "../includes/funciones_servidor.h"
 #include "../includes/red_servidor.h"
 #include "../includes/conexion_temp.h"
 #include "../includes/ssl.h"
+#include "../includes/pool.h"
+#include "../includes/reactor.h"
+#include "../includes/resolvedor.h"
+#include "../includes/canales.h"
 
 /**
  * @addtogroup Config
@@ -100,7 +106,7 @@ void daemonizar(char *servicio, int logLevel){
  *<hr>
 */
 void cerrarDescriptores(void){
-	unsigned short i;
+	int i;
 
 	/* Cerramos descriptores abiertos */
 	for(i=0; i < getdtablesize(); i++)
@@ -135,70 +141,18 @@ void abrirLog(char * identificacion, int logLevel){
 	openlog (identificacion, LOG_CONS | LOG_PID | LOG_NDELAY, LOG_USER);
 }
 
-/**
- * @ingroup Config
- *
- * @brief Manejador de la sennal SIGUSR1
- *
- * @synopsis
- * @code
- * 	void manejadorSIGUSR1(int sennal)
- * @endcode
- *
- * @param[in] sennal sennal
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-void manejadorSIGUSR1(int sennal){
-
-	if(signal(SIGUSR1, manejadorSIGUSR1) == SIG_ERR){
-		syslog(LOG_WARNING, "No se ha podido montar manejador SIGUSR1(%d)", sennal);
-	}
-}
-
-/**
- * @ingroup Config
- *
- * @brief Manejador de la sennal SIGALARM
- *
- * @synopsis
- * @code
- * 	void manejadorSIGALRM(int sennal)
- * @endcode
- *
- * @param[in] sennal sennal
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-void manejadorSIGALRM(int sennal){
-
-	/* Llamamos a la rutina del ping pong */
-	rutinaPingPong();
-
-	if(signal(SIGALRM, manejadorSIGALRM) == SIG_ERR){
-		syslog(LOG_WARNING, "No se ha podido montar manejador SIGALRM(%d)", sennal);
-	}
-
-	alarm(ALARMPINGPONG);
-}
-
-
 /**
  * @ingroup Config
  *
  * @brief Inicializa el servidor
  *
+ * SIGINT, SIGTERM y SIGUSR2 se bloquean antes de crear ningun hilo, de
+ * modo que todos los heredan bloqueados y solo llegan por senalFD, que
+ * atiende el reactor 0 desde su bucle de eventos.
+ *
  * @synopsis
  * @code
- * 	void manejadorSIGALRM(int sennal)
+ * 	status inicializarServidor(void)
  * @endcode
  *
  * @author
@@ -208,35 +162,63 @@ void manejadorSIGALRM(int sennal){
  *<hr>
 */
 status inicializarServidor(void){
-
-	if(signal(SIGINT, manejadorSigint) == SIG_ERR){
-		syslog(LOG_WARNING, "No se ha podido montar manejador SIGINT");
+	sigset_t senales;
+
+	sigemptyset(&senales);
+	sigaddset(&senales, SIGINT);
+	sigaddset(&senales, SIGTERM);
+	sigaddset(&senales, SIGUSR2);
+	if(pthread_sigmask(SIG_BLOCK, &senales, NULL) != 0){
+		syslog(LOG_ERR, "No se han podido bloquear SIGINT, SIGTERM y SIGUSR2");
+		return SERV_ERROR;
 	}
 
-	if(signal(SIGUSR1, manejadorSIGUSR1) == SIG_ERR){
-		syslog(LOG_WARNING, "No se ha podido montar manejador SIGUSR1");
+	senalFD = signalfd(-1, &senales, SFD_NONBLOCK | SFD_CLOEXEC);
+	if(senalFD < 0){
+		syslog(LOG_ERR, "Error creando signalfd en llamada a signalfd()");
+		return SERV_ERROR;
 	}
 
-	if(signal(SIGALRM, manejadorSIGALRM) == SIG_ERR){
-		syslog(LOG_WARNING, "No se ha podido montar manejador SIGALRM");
+	/* Un cliente que cierra mientras le escribimos no debe terminar el servidor */
+	if(signal(SIGPIPE, SIG_IGN) == SIG_ERR){
+		syslog(LOG_WARNING, "No se ha podido ignorar SIGPIPE");
 	}
 
+	/* Los usuarios temporales viven en la tabla de conexiones */
+	numTemporales = 0;
+	rechazadasTemporales = 0;
 
-	pid = getpid();
-
-	/* Mutex conjunto de descriptores */
-	pthread_mutex_init(&mutexDescr, NULL);
+	/* Tabla de conexiones indexada por descriptor */
+	if(inicializarConexiones() < 0){
+		return SERV_ERROR;
+	}
 
-	/* Mutex lista usuarios temporales */
-	pthread_mutex_init(&mutexTempUser, NULL);
+	/* Indice de miembros de cada canal por descriptor, leido sin cerrojos */
+	if(inicializarEpocas() != EPOCA_OK || inicializarCanales(PARTICIONES_CANALES) != CANAL_OK){
+		return SERV_ERROR;
+	}
 
-	/* Inicializamos listas temporales */
-	usuarioPrimero = NULL;
-	usuarioUltimo = NULL;
+	/* Cada hilo saca los temporales de sus comandos de su propia arena */
+	if(inicializarArenas() != ARENA_OK){
+		return SERV_ERROR;
+	}
 
 	/* Inicializamos array de comandos */
 	crea_comandos();
 
+	/* Lanzamos los hilos que procesaran los mensajes */
+	thpool = crearPool(hilosPool, colaPool);
+	if(thpool == NULL){
+		syslog(LOG_ERR, "No se ha podido crear el pool de hilos");
+		return SERV_ERROR;
+	}
+
+	/* Sin resolvedor los clientes se quedan con su IP como host */
+	resolvedor = crearResolvedor(DEFAULT_HILOS_DNS, servidorDNS);
+	if(resolvedor == NULL){
+		syslog(LOG_WARNING, "No se ha podido crear el resolvedor DNS");
+	}
+
 	return SERV_OK;
 }
 
@@ -246,7 +228,7 @@ status inicializarServidor(void){
  * @brief Cierra el servidor
  * @synopsis
  * @code
- * 	void manejadorSIGALRM(int sennal)
+ * 	void cerrarServidor(void)
  * @endcode
  *
  * @author
@@ -257,162 +239,23 @@ status inicializarServidor(void){
 */
 void cerrarServidor(void){
 	syslog(LOG_INFO, "Cerrando el servidor...");
-	cerrarDescriptores(); 	
+	/* Tras una parada forzada el pool puede tener trabajo, se termina antes de cerrar sus descriptores */
+	destruirPool(thpool);
+	thpool = NULL;
+	destruirResolvedor(resolvedor);
+	resolvedor = NULL;
+	cerrarDescriptores();
 	closelog();
 	liberarEstructuras();
-	/* thpool_destroy(thpool); */
+	liberarCanales();
+	liberarEpocas();
+	liberarArenas();
+	liberarConexiones();
 	if(ssl_active){
 		liberar_nivel_SSL();
 	}
 }
 
-/**
- * @ingroup Config
- *
- * @brief Manejador de la sennal SIGINT
- *
- * @synopsis
- * @code
- * 	void manejadorSigint(int sennal)
- * @endcode
- *
- * @param[in] sennal sennal
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-void manejadorSigint(int signal){
-
-	syslog(LOG_INFO, "Terminado por recepcion de sigint(%d)", signal);
-	cerrarServidor();
-	exit(EXIT_SUCCESS);
-}
-
-/**
- * @ingroup Config
- *
- * @brief Inicializa descriptor del socket dado
- *
- * @synopsis
- * @code
- * 	status inicializarFD(int sckt)
- * @endcode
- *
- * @param[in] sckt el socket
- *
- * @return SERV_OK
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-status inicializarFD(int sckt){
-
-	pthread_mutex_lock(&mutexDescr);
-	FD_ZERO(&activeFD);
-  	FD_SET(sckt, &activeFD);
-	pthread_mutex_unlock(&mutexDescr);
-
-	return SERV_OK;
-
-}
-
-/**
- * @ingroup Config
- *
- * @brief Annade descriptor al conjunto de descriptores activos
- *
- * @synopsis
- * @code
- * 	status addFd(int sckt)
- * @endcode
- *
- * @param[in] sckt el socket
- *
- * @return SERV_OK
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-status addFd(int sckt){
-
-	pthread_mutex_lock(&mutexDescr);
-	FD_SET (sckt, &activeFD);
-	pthread_mutex_unlock(&mutexDescr);
-
-
-	/* Enviamos señal para actualizar fd_set */
-	kill(pid, SIGUSR1);
-
-	return SERV_OK;
-}
-
-/**
- * @ingroup Config
- *
- * @brief Elimina descriptor del socket dado 
- *
- * @synopsis
- * @code
- * 	status deleteFd(int sckt)
- * @endcode
- *
- * @param[in] sckt el socket
- *
- * @return SERV_OK
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-status deleteFd(int sckt){
-
-	pthread_mutex_lock(&mutexDescr);
-	FD_CLR (sckt, &activeFD);
-	pthread_mutex_unlock(&mutexDescr);
-
-	return SERV_OK;
-}
-
-/**
- * @ingroup Config
- *
- * @brief Pone como leido el socket dado
- *
- * @synopsis
- * @code
- * 	status setReadFD(fd_set * readFD)
- * @endcode
- *
- * @param[in] readFD el descriptor
- *
- * @return SERV_OK
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-status setReadFD(fd_set * readFD){
-
-	pthread_mutex_lock(&mutexDescr);
-	*readFD = activeFD;
-	pthread_mutex_unlock(&mutexDescr);
-
-	return SERV_OK;
-}
-
 /**
  * @ingroup Config
  *
@@ -436,105 +279,8 @@ status setReadFD(fd_set * readFD){
 */
 status lanzarServidor(unsigned int puerto, short pingpong){
 
-	int sckt, i, desc;
-	ssize_t tam;
-	status ret;
-	pthread_t auxt;
-	fd_set readFD;
-	struct sockaddr_in address;
-	pDatosMensaje datos;
-	char buffer[MAX_BUFFER] = {0};
-
-	/* Creamos socket TCP */
-	if((ret = crearSocketTCP(&sckt, puerto)) < 0){
-		return ret;
-	}
-
-	/* Inicializamos conjunto de sockets */
-	inicializarFD(sckt);
-
-	running = 1;
-
-	/* Alarma para la rutina ping pong */
-	if(pingpong)
-		alarm(ALARMPINGPONG);
-
-	while(running){
-
-		/* Igualamos sockets leidos a los activos */
-		setReadFD(&readFD);
-
-		/* LLamada select bloqueante */
-		ret = select(FD_SETSIZE, &readFD, NULL, NULL, NULL);
-
-		if(ret < 0) {
-			/* Informacion de debugeo */
-			syslog(LOG_DEBUG, "Restaurando set_fd por recepcion de signal");
-			continue;
-		}
-
-
-      	/* Bucle para procesar sockets pendientes */
-      	for (i = 0; i < FD_SETSIZE; ++i){
-
-			/* Solo procesamos sockets marcados */
-		    if (FD_ISSET(i, &readFD)){
-
-				/* Caso conexion nueva */		        
-				if (i == sckt){
-
-					/* Aceptamos conexion */
-		            if(aceptarConexion(sckt, &desc, &address)  < 0){
-		                syslog(LOG_WARNING, "No se ha podido procesar nueva conexion");
-
-		            } else {
-						/* Creamos nueva conexion */
-						if(nuevaConexion(desc, &address) < 0){
-							syslog(LOG_WARNING, "Error en llamada a nuevaConexion()");
-						}
-					}
-				
-				/* Caso ya aceptado */		       
-				} else {
-
-					tam = recv(i, (void*) buffer, MAX_BUFFER, 0);
-					if(tam == -1){
-						syslog(LOG_ERR, "Error n: %d al recibir mensaje del socket %d", errno, i);
-						continue;
-
-					} else if(tam <= 0){ /* Caso socket cerrado */
-						cerrarConexion(i);
-						continue;
-					}
-
-					/* Empaquetamos el mensaje */
-					datos = (pDatosMensaje) calloc (1, sizeof(DatosMensaje));
-					if(datos == NULL){
-						syslog(LOG_ERR, "Error reservando memoria para datos");
-						return SERV_ERROR;
-					}
-
-					datos->sckfd = i;
-					datos->len = tam;
-					/* +1 para evitar que funciones de eloy no hagan accesos invalidos si 
-						acaba en \n unicamente */
-					datos->msg = (char *) calloc(tam+1, sizeof(char));
-					memcpy(datos->msg, buffer, tam);
-					deleteFd(i);
-					memset((void*)buffer, 0, tam);
-
-					/* Lanzamos hilo para procesar el mensaje */
-		         	if (pthread_create(&auxt , NULL, manejaMensaje, (void *) datos)  < 0) {
-						liberaDatosMensaje(datos);
- 						syslog(LOG_WARNING, "Error lanzando hilo para procesar mensaje");
-						addFd(i);
-					}
-				}
-			}
-		}	
-	}
-
-	return SERV_OK;
+	/* Cada reactor crea su socket TCP */
+	return lanzarReactores(puerto, pingpong);
 }
 
 /**
@@ -560,121 +306,14 @@ status lanzarServidor(unsigned int puerto, short pingpong){
 */
 status lanzarServidorSSL(unsigned int puerto, short pingpong){
 
-	int sckt, i, desc;
-	ssize_t tam;
-	status ret;
-	pthread_t auxt;
-	fd_set readFD;
-	struct sockaddr_in address;
-	pDatosMensaje datos;
-	char buffer[MAX_BUFFER] = {0};
-
-	/* Creamos socket TCP */
-	if((ret = crearSocketTCP(&sckt, puerto)) < 0){
-		return ret;
-	}
-
 	/* Inicializamos libreria SSL */
 	inicializar_nivel_SSL();
  
 	if(fijar_contexto_SSL(PATH_SERV_CERT, PATH_SERV_PKEY) < 0){
-		close(sckt);
 		liberar_nivel_SSL();
 		return SERV_ERROR;
 	}
 
-	/* Inicializamos conjunto de sockets */
-	inicializarFD(sckt);
-
-	running = 1;
-
-	/* Alarma para la rutina ping pong */
-	if(pingpong)
-		alarm(ALARMPINGPONG);
-
-	while(running){
-
-		/* Igualamos sockets leidos a los activos */
-		setReadFD(&readFD);
-
-		/* LLamada select bloqueante */
-		ret = select(FD_SETSIZE, &readFD, NULL, NULL, NULL);
-
-		if(ret < 0) {
-			/* Informacion de debugeo */
-			syslog(LOG_DEBUG, "Restaurando set_fd por recepcion de signal");
-			continue;
-		}
-
-
-      	/* Bucle para procesar sockets pendientes */
-      	for (i = 0; i < FD_SETSIZE; ++i){
-
-			/* Solo procesamos sockets marcados */
-		    if (FD_ISSET(i, &readFD)){
-
-				/* Caso conexion nueva */		        
-				if (i == sckt){
-
-					/* Aceptamos conexion */
-		            if(aceptarConexion(sckt, &desc, &address)  < 0){
-		                syslog(LOG_WARNING, "No se ha podido procesar nueva conexion");
-
-		            } else {
-						/* Aceptamos canal seguro */
-						if(aceptar_canal_seguro_SSL(desc) < 0){
-							cerrar_canal_SSL(desc);
-							close(desc);
-							syslog(LOG_ERR, "Error aceptando canal seguro");
-							continue;
-						}
-
-						/* Creamos nueva conexion */
-						if(nuevaConexion(desc, &address) < 0){
-							syslog(LOG_WARNING, "Error en llamada a nuevaConexion()");
-						}
-					}
-				
-				/* Caso ya aceptado */		       
-				} else {
-
-					tam = recibir_datos_SSL(i, buffer, MAX_BUFFER);
-					if(tam == -1){
-						syslog(LOG_ERR, "Error n: %d al recibir mensaje del socket %d", errno, i);
-						continue;
-
-					} else if(tam == 0){ /* Caso socket cerrado */
-						cerrarConexion(i);
-						continue;
-					}
-
-					/* Empaquetamos el mensaje */
-					datos = (pDatosMensaje) calloc (1, sizeof(DatosMensaje));
-					if(datos == NULL){
-						syslog(LOG_ERR, "Error reservando memoria para datos");
-						return SERV_ERROR;
-					}
-
-					datos->sckfd = i;
-					datos->len = tam;
-					/* +1 para evitar que funciones de eloy no hagan accesos invalidos si 
-						acaba en \n unicamente */
-					datos->msg = (char *) calloc(tam+1, sizeof(char));
-					memcpy(datos->msg, buffer, tam);
-					deleteFd(i);
-					memset((void*)buffer, 0, tam);
-
-					/* Lanzamos hilo para procesar el mensaje */
-		         	if (pthread_create(&auxt , NULL, manejaMensaje, (void *) datos)  < 0) {
-						liberaDatosMensaje(datos);
- 						syslog(LOG_WARNING, "Error lanzando hilo para procesar mensaje");
-						addFd(i);
-					}
-				}
-			}
-		}	
-	}
-
-	return SERV_OK;
+	/* Mismos reactores que sin SSL, cada uno crea su socket TCP */
+	return lanzarReactores(puerto, pingpong);
 }
-
@@ -0,0 +1,74 @@
+/**
+ * @file despacho.c
+ * @brief despacho de comandos por verbo empaquetado, generado de crea_comandos()
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Despacho Despacho
+ *
+ * <hr>
+ */
+
+#include <redes2/irc.h>
+
+#include "../includes/despacho.h"
+#include "../includes/despacho_gen.h"
+
+/**
+ * @addtogroup Despacho
+ * Sustituye a IRC_CommandQuery, que compara el verbo con toda la tabla de
+ * comandos de la libreria. El verbo se empaqueta en una palabra de 64 bits,
+ * pasado a mayusculas, y un switch por longitud y palabra da el comando.
+ *
+ * El switch (despacho_gen.h) lo genera misc/gen_despacho.bash al compilar,
+ * con los comandos registrados en crea_comandos(): registrar uno nuevo basta
+ * para que se despache. Los demas verbos van a comandoVacio como antes.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Despacho
+ *
+ * @brief Devuelve el comando de un verbo
+ *
+ * @synopsis
+ * @code
+ * 	long despacharComando(Vista verbo)
+ * @endcode
+ *
+ * @param[in] verbo el verbo de la linea analizada
+ *
+ * @return el indice del comando en comandos[], DESPACHO_NUMERICO si es una
+ * respuesta numerica o DESPACHO_DESCONOCIDO si no tiene manejador
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+long despacharComando(Vista verbo){
+	unsigned long long palabra = 0;
+	unsigned char *p;
+	size_t i;
+
+	if(verbo.ptr == NULL || verbo.len == 0 || verbo.len > MAX_VERBO){
+		return DESPACHO_DESCONOCIDO;
+	}
+	p = (unsigned char *) verbo.ptr;
+
+	/* Las numericas son siempre tres cifras (RFC 2812, 2.4); su valor no se usa */
+	if(verbo.len == 3 && (unsigned) (p[0] - '0') < 10 && (unsigned) (p[1] - '0') < 10 && (unsigned) (p[2] - '0') < 10){
+		return DESPACHO_NUMERICO;
+	}
+
+	/* Quitar el bit 0x20 pasa las minusculas a mayusculas y nada mas cae en A-Z */
+	for(i = 0; i < verbo.len; i++){
+		palabra |= (unsigned long long) (p[i] & 0xDF) << (8 * i);
+	}
+
+	return verboGenerado(palabra, verbo.len);
+}
@@ -0,0 +1,406 @@
+/**
+ * @file epocas.c
+ * @brief liberacion diferida por epocas de estructuras que se leen sin cerrojos
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Epocas Epocas
+ *
+ * <hr>
+ */
+
+#include <sched.h>
+
+#include "../includes/epocas.h"
+
+/**
+ * @addtogroup Epocas
+ * Comprende las funciones de liberacion por epocas. Un lector anuncia en su
+ * ranura la epoca global al empezar a leer y la borra al terminar, sin tomar
+ * ningun cerrojo. Quien sustituye una estructura publicada la retira con la
+ * epoca del momento, y solo se libera cuando la epoca global ha avanzado
+ * dos veces: para entonces ningun lector que pudiera verla sigue dentro.
+ *
+ * La epoca global solo avanza cuando todos los lectores dentro de una
+ * epoca estan en la actual. Las lecturas no se anidan.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Devuelve la ranura de un hilo que termina
+ *
+ * @synopsis
+ * @code
+ * 	void soltarRanura(void *ranura)
+ * @endcode
+ *
+ * @param[in] ranura indice de la ranura mas uno, como se guarda en claveEpoca
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void soltarRanura(void *ranura){
+	int i = (int) (long) ranura - 1;
+
+	__atomic_store_n(&ranurasEpoca[i].epoca, EPOCA_FUERA, __ATOMIC_RELEASE);
+	__atomic_store_n(&ranurasEpoca[i].ocupada, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Devuelve la ranura del hilo que llama, asignandole una la primera vez
+ *
+ * @synopsis
+ * @code
+ * 	int ranuraHilo(void)
+ * @endcode
+ *
+ * @return el indice de la ranura, o -1 si no quedan libres
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int ranuraHilo(void){
+	long ranura;
+	int i, usadas;
+
+	ranura = (long) pthread_getspecific(claveEpoca);
+	if(ranura > 0){
+		return (int) ranura - 1;
+	}
+
+	for(i = 0; i < MAX_HILOS_EPOCA; i++){
+		if(__sync_bool_compare_and_swap(&ranurasEpoca[i].ocupada, 0, 1)){
+			break;
+		}
+	}
+	if(i == MAX_HILOS_EPOCA){
+		return -1;
+	}
+
+	/* Quien avanza la epoca solo recorre las ranuras usadas alguna vez */
+	do {
+		usadas = __atomic_load_n(&numRanurasEpoca, __ATOMIC_ACQUIRE);
+	} while(usadas < i + 1 && !__sync_bool_compare_and_swap(&numRanurasEpoca, usadas, i + 1));
+
+	pthread_setspecific(claveEpoca, (void *) (long) (i + 1));
+
+	return i;
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Intenta avanzar la epoca global, con mutexEpocas tomado
+ *
+ * @synopsis
+ * @code
+ * 	void avanzarEpoca(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void avanzarEpoca(void){
+	unsigned long actual, epoca;
+	int i, usadas;
+
+	actual = __atomic_load_n(&epocaGlobal, __ATOMIC_ACQUIRE);
+	usadas = __atomic_load_n(&numRanurasEpoca, __ATOMIC_ACQUIRE);
+
+	for(i = 0; i < usadas; i++){
+		epoca = __atomic_load_n(&ranurasEpoca[i].epoca, __ATOMIC_ACQUIRE);
+		if(epoca != EPOCA_FUERA && epoca != actual){
+			return;
+		}
+	}
+
+	__atomic_store_n(&epocaGlobal, actual + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Inicializa las epocas
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarEpocas(void)
+ * @endcode
+ *
+ * @return EPOCA_OK si todo va bien. EPOCA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarEpocas(void){
+
+	memset(ranurasEpoca, 0, sizeof(ranurasEpoca));
+	numRanurasEpoca = 0;
+	epocaGlobal = 1;
+	retiradosEpoca = NULL;
+	pendientesEpoca = 0;
+	liberadosEpoca = 0;
+
+	if(pthread_key_create(&claveEpoca, soltarRanura) != 0){
+		return EPOCA_ERROR;
+	}
+
+	if(pthread_mutex_init(&mutexEpocas, NULL) != 0){
+		pthread_key_delete(claveEpoca);
+		return EPOCA_ERROR;
+	}
+
+	return EPOCA_OK;
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Empieza una lectura sin cerrojos
+ *
+ * Mientras el hilo no llame a salirEpoca, nada de lo que lea de una
+ * estructura publicada se libera.
+ *
+ * @synopsis
+ * @code
+ * 	status entrarEpoca(void)
+ * @endcode
+ *
+ * @return EPOCA_OK si todo va bien. EPOCA_ERROR si no quedan ranuras, y
+ * entonces el lector debe tomar el cerrojo de los escritores
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status entrarEpoca(void){
+	unsigned long epoca;
+	int i;
+
+	i = ranuraHilo();
+	if(i < 0){
+		return EPOCA_ERROR;
+	}
+
+	/* Si la epoca avanza mientras la anunciamos volvemos a anunciar la nueva */
+	do {
+		epoca = __atomic_load_n(&epocaGlobal, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&ranurasEpoca[i].epoca, epoca, __ATOMIC_SEQ_CST);
+	} while(epoca != __atomic_load_n(&epocaGlobal, __ATOMIC_SEQ_CST));
+
+	return EPOCA_OK;
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Termina una lectura empezada con entrarEpoca
+ *
+ * @synopsis
+ * @code
+ * 	void salirEpoca(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void salirEpoca(void){
+	long ranura;
+
+	ranura = (long) pthread_getspecific(claveEpoca);
+	if(ranura > 0){
+		__atomic_store_n(&ranurasEpoca[ranura - 1].epoca, EPOCA_FUERA, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Entrega una estructura que ya no es alcanzable para liberarla cuando sea seguro
+ *
+ * @synopsis
+ * @code
+ * 	status retirarEpoca(void *ptr, void (*liberar)(void *))
+ * @endcode
+ *
+ * @param[in] ptr la estructura, ya despublicada
+ * @param[in] liberar funcion que la libera
+ *
+ * @return EPOCA_OK si todo va bien. EPOCA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status retirarEpoca(void *ptr, void (*liberar)(void *)){
+	pRetirado retirado;
+
+	if(ptr == NULL || liberar == NULL){
+		return EPOCA_ERROR;
+	}
+
+	retirado = (pRetirado) malloc(sizeof(Retirado));
+	if(retirado == NULL){
+		/* Sin memoria para apuntarlo esperamos a que no quede ningun lector */
+		esperarEpoca();
+		liberar(ptr);
+		return EPOCA_OK;
+	}
+
+	retirado->ptr = ptr;
+	retirado->liberar = liberar;
+
+	pthread_mutex_lock(&mutexEpocas);
+	retirado->epoca = __atomic_load_n(&epocaGlobal, __ATOMIC_ACQUIRE);
+	retirado->siguiente = retiradosEpoca;
+	retiradosEpoca = retirado;
+	pendientesEpoca++;
+	pthread_mutex_unlock(&mutexEpocas);
+
+	recogerEpoca();
+
+	return EPOCA_OK;
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Avanza la epoca si puede y libera lo retirado hace dos epocas o mas
+ *
+ * @synopsis
+ * @code
+ * 	void recogerEpoca(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void recogerEpoca(void){
+	pRetirado *anterior, retirado, liberables = NULL;
+	unsigned long epoca;
+
+	pthread_mutex_lock(&mutexEpocas);
+
+	avanzarEpoca();
+	epoca = __atomic_load_n(&epocaGlobal, __ATOMIC_ACQUIRE);
+
+	anterior = &retiradosEpoca;
+	while(*anterior != NULL){
+		retirado = *anterior;
+		if(retirado->epoca + 2 <= epoca){
+			*anterior = retirado->siguiente;
+			retirado->siguiente = liberables;
+			liberables = retirado;
+			pendientesEpoca--;
+			liberadosEpoca++;
+		} else {
+			anterior = &retirado->siguiente;
+		}
+	}
+
+	pthread_mutex_unlock(&mutexEpocas);
+
+	while(liberables != NULL){
+		retirado = liberables;
+		liberables = retirado->siguiente;
+		retirado->liberar(retirado->ptr);
+		free(retirado);
+	}
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Espera a que termine cualquier lectura que empezase antes de la llamada
+ *
+ * No se puede llamar desde dentro de una epoca.
+ *
+ * @synopsis
+ * @code
+ * 	void esperarEpoca(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void esperarEpoca(void){
+	unsigned long objetivo;
+
+	objetivo = __atomic_load_n(&epocaGlobal, __ATOMIC_ACQUIRE) + 2;
+
+	for(;;){
+		pthread_mutex_lock(&mutexEpocas);
+		avanzarEpoca();
+		pthread_mutex_unlock(&mutexEpocas);
+
+		if(__atomic_load_n(&epocaGlobal, __ATOMIC_ACQUIRE) >= objetivo){
+			return;
+		}
+		sched_yield();
+	}
+}
+
+/**
+ * @ingroup Epocas
+ *
+ * @brief Libera todo lo pendiente, cuando ya no queda ningun lector
+ *
+ * @synopsis
+ * @code
+ * 	void liberarEpocas(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarEpocas(void){
+	pRetirado retirado;
+
+	pthread_mutex_lock(&mutexEpocas);
+	while(retiradosEpoca != NULL){
+		retirado = retiradosEpoca;
+		retiradosEpoca = retirado->siguiente;
+		retirado->liberar(retirado->ptr);
+		free(retirado);
+	}
+	pendientesEpoca = 0;
+	pthread_mutex_unlock(&mutexEpocas);
+
+	pthread_mutex_destroy(&mutexEpocas);
+	pthread_key_delete(claveEpoca);
+}
@@ -12,6 +12,10 @@
 
 #include "../includes/funciones_servidor.h"
 #include "../includes/conexion_temp.h"
+#include "../includes/sesiones.h"
+#include "../includes/conexiones.h"
+#include "../includes/canales.h"
+#include "../includes/respuestas.h"
 
 #include <redes2/irc.h>
 
@@ -55,6 +59,9 @@ status nick(char* comando, pDatosMensaje datos){
 	long creationTS, actionTS;
 	int sock;	
 	pTempUser usuarioTemporal = NULL;
+	long id1 = 0;
+	char *user1 = NULL, *real1 = NULL, *host1 = NULL, *ip1 = NULL, *away1 = NULL;
+	Respuesta respuesta;
 
 	if(!datos || !comando){
 		return COM_ERROR;
@@ -63,18 +70,7 @@ status nick(char* comando, pDatosMensaje datos){
 	sock =  datos->sckfd;
 
 	/* Comprobamos si el socket esta utilizado */
-	ret = IRCTADUser_GetData (&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-	
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error Nick NOENOUGHMEMORY");
-		if(prefijo) free(prefijo);
-		if(nickk) free(nickk);
-		if(msg) free(msg);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* Parseamos respuesta */
 	switch(IRCParse_Nick(comando,&prefijo,&nickk, &msg)){
@@ -82,17 +78,10 @@ status nick(char* comando, pDatosMensaje datos){
 		case IRCERR_ERRONEUSCOMMAND:
 			syslog(LOG_ERR, "Error en IRCParse_NICK");
 
-			if(unknown_nick)
-				IRCMsg_ErrNeedMoreParams(&mensajeRespuesta, SERVICIO, unknown_nick, comando);
-			else
-				IRCMsg_ErrNeedMoreParams(&mensajeRespuesta, SERVICIO, "*", comando);
-
-			enviar(datos->sckfd, mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick ? unknown_nick : "*", comando);
 
 			if(prefijo) {free(prefijo); prefijo=NULL;}
 			if(msg) {free(msg); msg=NULL;}
-			if(mensajeRespuesta) free(mensajeRespuesta);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 			return COM_OK;
 	}
@@ -102,15 +91,17 @@ status nick(char* comando, pDatosMensaje datos){
 
 		sock = 0;
 		/* Comprobar si el NICK esta utilizado */
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		ret = IRCTADUser_GetData (&unknown_id, &unknown_user, &nickk, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-		
-		if(unknown_id != 0){
+		ret = IRCTADUser_GetData (&id1, &user1, &nickk, &real1, &host1, &ip1, &sock, &creationTS, &actionTS, &away1);
+		liberarUserData(user1, NULL, real1, host1, ip1, away1);
+
+		if(id1 != 0){
 			syslog(LOG_DEBUG, "NICK NAME IN USE");
 			IRCMsg_ErrNickNameInUse(&mensajeRespuesta, SERVICIO, "*", nickk);
 			enviar(datos->sckfd, mensajeRespuesta);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			if(mensajeRespuesta) free(mensajeRespuesta);
+			if(prefijo) free(prefijo);
+			if(nickk) free(nickk);
+			if(msg) free(msg);
 			return COM_OK;
 		}
 
@@ -120,7 +111,6 @@ status nick(char* comando, pDatosMensaje datos){
 		 /* Caso no se encuentra usuario temporal */
 		 if(usuarioTemporal == NULL) {
 			syslog(LOG_ERR, "Usuario %d temporal no encontrado", datos->sckfd);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			return COM_ERROR;
 		}
 
@@ -153,6 +143,11 @@ status nick(char* comando, pDatosMensaje datos){
 
 			case IRC_OK:
 
+				/* Los vecinos lo reciben firmado con el nick anterior, una vez cada uno */
+				respuestaNick(&respuesta, prefijoSesion(datos->sckfd), nickk);
+				difundirVecinos(datos->sckfd, respuesta.datos, respuesta.len);
+
+				cambiarNickSesion(datos->sckfd, nickk);
 				IRCMsg_Nick(&mensajeRespuesta, SERVICIO, NULL, nickk);
 				enviar(datos->sckfd, mensajeRespuesta);
 				break;
@@ -164,7 +159,6 @@ status nick(char* comando, pDatosMensaje datos){
 	if(prefijo) free(prefijo);
 	if(nickk) free(nickk);
 	if(msg) free(msg);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	syslog(LOG_DEBUG, "Comando nick completado");
 
@@ -200,22 +194,16 @@ status user(char* comando, pDatosMensaje datos){
 	char * mensajeRespuesta = NULL;
 	long unknown_id = 0;
 	unsigned long ret = 0;
-	long creationTS, actionTS;
 	int sock;	
 	pTempUser usuarioTemporal = NULL;
+	pConexion conexion;
+	char *nickTemporal = NULL;
 
 	if(!datos || !comando){
 		return COM_ERROR;
 	}
 	sock = datos->sckfd;
-	ret = IRCTADUser_GetData (&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error Nick NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ErrAlreadyRegistred */
 	if(unknown_id!= 0){
@@ -226,21 +214,16 @@ status user(char* comando, pDatosMensaje datos){
 		IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
 
 		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 		return COM_OK;
 	}
 
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-
 	/* Parseamos comando */
 	switch(IRCParse_User(comando,&prefijo,&user,&modehost,&server,&realname)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
 			syslog(LOG_ERR, "Error en IRCParse_User");
-			IRCMsg_ErrNeedMoreParams (&mensajeRespuesta, SERVICIO ,"*", comando);
-			enviar(datos->sckfd, mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, "*", comando);
 
-			if(mensajeRespuesta) free(mensajeRespuesta);
 			if(prefijo) free(prefijo);
 			if(user) free(user);
 			if(modehost) free(modehost);
@@ -257,11 +240,19 @@ status user(char* comando, pDatosMensaje datos){
 		return COM_ERROR;
 	}
 
+	/* El resolvedor inverso puede estar cambiando el host en este momento y
+	   un NICK el nick: se copia con el mutex y el TAD copia el resto */
+	conexion = obtenerConexion(datos->sckfd);
+	pthread_mutex_lock(&conexion->mutex);
+	nickTemporal = usuarioTemporal->nick ? strdup(usuarioTemporal->nick) : NULL;
+	if(nickTemporal != NULL){
+		ret = IRCTADUser_New(user,nickTemporal,realname,NULL,usuarioTemporal->host, usuarioTemporal->IP, datos->sckfd);
+	}
+	pthread_mutex_unlock(&conexion->mutex);
+
 	/* Caso NoNickNameGiven */
-	if(usuarioTemporal->nick == NULL){
-		IRCMsg_ErrNoNickNameGiven(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
+	if(nickTemporal == NULL){
+		enviarError(datos->sckfd, RESP_NONICKNAMEGIVEN, "*", NULL);
 		if(prefijo) free(prefijo);
 		if(user) free(user);
 		if(modehost) free(modehost);
@@ -271,7 +262,6 @@ status user(char* comando, pDatosMensaje datos){
 		return COM_OK;
 	}
 
-	ret = IRCTADUser_New(user,usuarioTemporal->nick,realname,NULL,usuarioTemporal->host, usuarioTemporal->IP, datos->sckfd);
 	switch(ret){
 		case IRCERR_NOENOUGHMEMORY:
 		case IRCERR_INVALIDHOST:
@@ -281,10 +271,10 @@ status user(char* comando, pDatosMensaje datos){
 		case IRCERR_NOMUTEX:
 
 			syslog(LOG_ERR,"Error interno al incluir usuario en comando USER");
-			return COM_OK;
+			break;
 
 		case IRCERR_NICKUSED:
-			IRCMsg_ErrNickNameInUse(&mensajeRespuesta, SERVICIO ,"*", usuarioTemporal->nick);
+			IRCMsg_ErrNickNameInUse(&mensajeRespuesta, SERVICIO ,"*", nickTemporal);
 			enviar(datos->sckfd, mensajeRespuesta);
 			break;
 
@@ -294,7 +284,7 @@ status user(char* comando, pDatosMensaje datos){
 			break;
 
 		case IRCERR_INVALIDNICK:
-			IRCMsg_ErrErroneusNickName (&mensajeRespuesta, SERVICIO, "*", usuarioTemporal->nick);
+			IRCMsg_ErrErroneusNickName (&mensajeRespuesta, SERVICIO, "*", nickTemporal);
 			enviar(datos->sckfd, mensajeRespuesta);
 			break;
 		case IRCERR_INVALIDREALNAME:
@@ -304,10 +294,14 @@ status user(char* comando, pDatosMensaje datos){
 
 		case IRC_OK:
 
-			IRCMsg_RplWelcome(&mensajeRespuesta, SERVICIO, usuarioTemporal->nick, realname, user, SERVICIO);
+			IRCMsg_RplWelcome(&mensajeRespuesta, SERVICIO, nickTemporal, realname, user, SERVICIO);
 			enviar(datos->sckfd, mensajeRespuesta);
 			usuarioTemporal = NULL;
 			deleteTempUser(datos->sckfd);
+			/* Desde aqui los comandos leen su identidad de la sesion */
+			if(abrirSesion(datos->sckfd) != SESION_OK){
+				syslog(LOG_ERR, "No se ha podido abrir la sesion de %d", datos->sckfd);
+			}
 			/* Mandamos motd inicio de conexion */
 			/*motd("motd", datos);*/
 
@@ -320,6 +314,7 @@ status user(char* comando, pDatosMensaje datos){
 	if(modehost) free(modehost);
 	if(server) free(server);
 	if(realname) free(realname);
+	if(nickTemporal) free(nickTemporal);
 
 	syslog(LOG_DEBUG, "Comando user completado");
 
@@ -348,54 +343,44 @@ status user(char* comando, pDatosMensaje datos){
  *<hr>
 */
 status join(char *comando, pDatosMensaje datos){
-	char *prefijo = NULL, *prefijo2=NULL, *comandonames=NULL;
+	char *prefijo2=NULL, *comandonames=NULL;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	char * mensajeRespuesta = NULL;
-	unsigned long ret = 0;
-	char *canal, *clave, *msg;
+	char *canal = NULL, *clave = NULL;
 	long unknown_id = 0;
-	long creationTS, actionTS;
 	int sock;	
+	Respuesta r;
+	LineaIRC local;
+	pLineaIRC linea;
+	pArena arena;
 
 
 	sock = datos->sckfd;	
 
-	ret = IRCTADUser_GetData (&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error JOIN NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
 	/* Actualizamos tiempo action ts */
 	IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
 
-	switch(IRCParse_Join(comando, &prefijo, &canal, &clave, &msg)){
-		case IRCERR_NOSTRING:
-		case IRCERR_ERRONEUSCOMMAND:
-			syslog(LOG_ERR, "Error en IRCParse_Join");
-			IRCMsg_ErrNeedMoreParams (&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
+	/* JOIN <canal> [<clave>] */
+	linea = lineaComando(comando, datos, &local);
+	arena = arenaHilo();
+	if(linea == NULL || linea->numParams < 1
+		|| (canal = copiarVista(arena, linea->params[0])) == NULL){
+		syslog(LOG_ERR, "Error analizando JOIN");
+		enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
+		return COM_OK;
+	}
 
-			if(mensajeRespuesta) free(mensajeRespuesta);
-			if(prefijo) free(prefijo);
-			if(canal) free(canal);
-			if(msg) free(msg);	
-			if(clave) free(clave);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-			return COM_OK;
+	if(linea->numParams > 1){
+		clave = copiarVista(arena, linea->params[1]);
 	}
 
 	
@@ -403,15 +388,10 @@ status join(char *comando, pDatosMensaje datos){
 
 		case IRCERR_NOENOUGHMEMORY:
 			syslog(LOG_ERR, "Error IRCTAD_JOIN NOENOUGHMEMORY");
-			if(prefijo) free(prefijo);
-			if(canal) free(canal);
-			if(msg) free(msg);	
-			if(clave) free(clave);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			return COM_ERROR;
 
 		case IRCERR_NOVALIDCHANNEL:
-			IRCMsg_ErrNoSuchChannel(&mensajeRespuesta, SERVICIO, unknown_nick, canal);
+			enviarError(datos->sckfd, RESP_NOSUCHCHANNEL, unknown_nick, canal);
 			break;
 
 		case IRCERR_USERSLIMITEXCEEDED:
@@ -439,27 +419,26 @@ status join(char *comando, pDatosMensaje datos){
 
 		case IRC_OK:
 
-			IRC_ComplexUser(&prefijo2, unknown_nick, unknown_real, host, SERVICIO);
+			prefijo2 = prefijoSesion(datos->sckfd);
+			if(unirCanal(canal, datos->sckfd) != CANAL_OK){
+				syslog(LOG_ERR, "No se ha podido indexar el canal %s", canal);
+			}
 
 			/* Primero respondemos JOIN */
-			IRCMsg_Join(&mensajeRespuesta,prefijo2, NULL, NULL, canal);
-			enviarMensajeACanal(datos->sckfd, mensajeRespuesta, canal, unknown_nick);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta){ free(mensajeRespuesta); mensajeRespuesta=NULL; }
+			respuestaJoin(&r, prefijo2, canal);
+			enviarMensajeACanal(datos->sckfd, r.datos, r.len, canal, unknown_nick, datos->sckfd);
+			enviarRespuesta(datos->sckfd, &r);
 			/* Mandamos names al usuario tras unirse */
 			IRCMsg_Names(&comandonames,prefijo2,canal,"*");
 			names(comandonames, datos);
 			free(comandonames); comandonames=NULL;
-			free(prefijo2); prefijo2=NULL;
 			break;
 	}
 
-	enviar(datos->sckfd, mensajeRespuesta);
-	if(prefijo) free(prefijo);
-	if(canal) free(canal);
-	if(msg) free(msg);	
-	if(clave) free(clave);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+	if(mensajeRespuesta){
+		enviar(datos->sckfd, mensajeRespuesta);
+		free(mensajeRespuesta);
+	}
 	return COM_OK;
 
 }
@@ -471,12 +450,11 @@ status join(char *comando, pDatosMensaje datos){
  *
  * @synopsis
  * @code
- * 	void listarCanalesUsuario(char *canal, int sckfd, char *prefijo, char *nicku) 
+ * 	void listarCanalesUsuario(char *canal, int sckfd, char *nicku) 
  * @endcode
  *
  * @param[in] canal canal sobre el que trabajar
  * @param[in] sckfd socket desde el que enviar respuesta
- * @param[in] prefijo prefijo del usuario
  * @param[in] nicku nick del usuario
  *
  * @author
@@ -485,8 +463,8 @@ status join(char *comando, pDatosMensaje datos){
  *
  *<hr>
 */
-void listarCanalesUsuario(char *canal, int sckfd, char *prefijo, char *nicku) {
-	char *mensajeRespuesta = NULL;
+void listarCanalesUsuario(char *canal, int sckfd, char *nicku) {
+	Respuesta r;
 	char *topico = NULL;
 	char *mode=NULL;
 	int modeInt=0;
@@ -499,11 +477,10 @@ void listarCanalesUsuario(char *canal, int sckfd, char *prefijo, char *nicku) {
 
 	mode = IRCTADChan_GetModeChar(canal);
 	IRCTAD_GetTopic(canal, &topico);
-	IRCMsg_RplList(&mensajeRespuesta, prefijo, nicku, canal, mode, topico?topico:"");
-	enviar(sckfd, mensajeRespuesta);
+	respuestaList(&r, nicku, canal, mode, topico);
+	enviarRespuesta(sckfd, &r);
 	
 	if(mode) free(mode);
-	if(mensajeRespuesta) free(mensajeRespuesta);
 	if(topico) free(topico);
 
 }
@@ -533,34 +510,22 @@ status list(char *comando, pDatosMensaje datos){
 	char *prefijo = NULL;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
-	char * mensajeRespuesta = NULL;
+	Respuesta r;
 	long unknown_id = 0;
-	long creationTS=0, actionTS=0;
 	int sock=0;	
 	char *canal=NULL, *objetivo=NULL;
 	char **lista = NULL;
 	long num=0;
     int i = 0;
-	unsigned long ret = 0;
-	char *next=NULL;
+	char *next=NULL, *guardado=NULL;
 
 	sock = datos->sckfd;	
 
-	ret = IRCTADUser_GetData (&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error JOIN NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -570,13 +535,10 @@ status list(char *comando, pDatosMensaje datos){
 	switch(IRCParse_List(comando, &prefijo, &canal, &objetivo)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams (&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
 			if(prefijo) free(prefijo);
 			if(canal) free(canal);
 			if(objetivo) free(objetivo);	
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 			return COM_OK;
 	}
@@ -586,7 +548,7 @@ status list(char *comando, pDatosMensaje datos){
 
     	IRCTADChan_GetList(&lista, &num, NULL);
 		for(i=0; i<num; i++){
-			listarCanalesUsuario(lista[i], datos->sckfd, SERVICIO, unknown_nick);
+			listarCanalesUsuario(lista[i], datos->sckfd, unknown_nick);
 		}
     
 		/* Liberamos lista y mensaje respuesta */
@@ -600,21 +562,19 @@ status list(char *comando, pDatosMensaje datos){
 	/* Caso una lista de canales */
     } else {
     
-		next = strtok(canal,",");
+		next = strtok_r(canal, ",", &guardado);
 		while(next != NULL){
-			listarCanalesUsuario(next, datos->sckfd, SERVICIO, unknown_nick);
-			next = strtok(NULL,",");
+			listarCanalesUsuario(next, datos->sckfd, unknown_nick);
+			next = strtok_r(NULL, ",", &guardado);
 		}
 		free(canal);
 	}
 
-		IRCMsg_RplListEnd(&mensajeRespuesta, SERVICIO,unknown_nick);
-		enviar(datos->sckfd, mensajeRespuesta);
+		respuestaListEnd(&r, unknown_nick);
+		enviarRespuesta(datos->sckfd, &r);
 
-		if(mensajeRespuesta) free(mensajeRespuesta);
 		if(prefijo) free(prefijo);
 		if(objetivo) free(objetivo);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 	return COM_OK;
 }
 
@@ -640,58 +600,42 @@ status list(char *comando, pDatosMensaje datos){
  *<hr>
 */
 status who(char *comando, pDatosMensaje datos){
-	char *prefijo = NULL;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
-	char * mensajeRespuesta = NULL;
+	Respuesta r;
 	long unknown_id = 0;
-	long creationTS=0, actionTS=0;
 	int sock=0;	
-	char *canal=NULL, *objetivo=NULL;
-	char **lista = NULL;
-	long num=0;
+	char *canal=NULL;
+	int *miembros = NULL;
+	int num=0;
     int i = 0;
-	unsigned long ret = 0;
-	int sock1=0;
-	long id1=0;
-	char *user1=NULL,*real1=NULL,*host1=NULL,*ip1=NULL,*away1=NULL;
+	pConexion conexion;
+	LineaIRC local;
+	pLineaIRC linea;
+	pArena arena;
 
 	sock = datos->sckfd;	
 
-	ret = IRCTADUser_GetData (&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error JOIN NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
 	/* Actualizamos tiempo action ts */
 	IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
 
-	switch(IRCParse_Who(comando, &prefijo, &canal, &objetivo)){
-		case IRCERR_NOSTRING:
-		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams (&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
-			if(prefijo) free(prefijo);
-			if(canal) free(canal);
-			if(objetivo) free(objetivo);	
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+	/* WHO <mascara> [o] */
+	linea = lineaComando(comando, datos, &local);
+	arena = arenaHilo();
+	if(linea == NULL || linea->numParams < 1){
+		enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
 
-			return COM_OK;
+		return COM_OK;
 	}
+	canal = copiarVista(arena, linea->params[0]);
 
 	/* No hacemos nada */
 	if(canal == NULL){
@@ -703,35 +647,29 @@ status who(char *comando, pDatosMensaje datos){
 	/* Caso una lista de canales */
     } else {
     
-			IRCTAD_ListNicksOnChannelArray(canal, &lista, &num);
+			/* Los miembros salen de la instantanea del canal y sus datos de su sesion */
+			num = listarMiembrosCanal(canal, arena, &miembros);
 	
 			for(i=0; i< num; i++){
-				id1 =0;
-				user1 = NULL;
-				real1 = NULL;
-				host1 = NULL;
-				ip1 = NULL;
-				sock1 = 0;
-				creationTS = 0;
-				actionTS = 0;
-				away1 = NULL;
-
-				/* Sacamos informacion del usuario especifico */
-				IRCTADUser_GetData(&id1, &user1, &(lista[i]), &real1, &host1, &ip1, &sock1, &creationTS, &actionTS, &away1);
-				IRCMsg_RplWhoReply(&mensajeRespuesta, SERVICIO, lista[i], canal, user1, host1,"*", "*", "*", 0, real1);
-				enviar(datos->sckfd, mensajeRespuesta);
-				if(mensajeRespuesta) {free(mensajeRespuesta); mensajeRespuesta=NULL; }
-				liberarUserData(user1, NULL, real1, host1, ip1, away1);
+				conexion = obtenerConexion(miembros[i]);
+				if(conexion == NULL){
+					continue;
+				}
+
+				r.len = 0;
+				pthread_mutex_lock(&conexion->mutex);
+				if(conexion->sesion){
+					respuestaWhoReply(&r, unknown_nick, canal, conexion->sesion->user, conexion->sesion->host, conexion->sesion->nick, conexion->sesion->real);
+				}
+				pthread_mutex_unlock(&conexion->mutex);
+
+				if(r.len > 0){
+					enviarRespuesta(datos->sckfd, &r);
+				}
 			}
 	}
-		IRCTADUser_FreeList(lista,num);
-		IRCMsg_RplEndOfWho(&mensajeRespuesta, SERVICIO,unknown_nick, canal);
-		enviar(datos->sckfd, mensajeRespuesta);
-		free(canal);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		if(prefijo) free(prefijo);
-		if(objetivo) free(objetivo);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		respuestaEndOfWho(&r, unknown_nick, canal);
+		enviarRespuesta(datos->sckfd, &r);
 	return COM_OK;
 }
 
@@ -13,6 +13,15 @@
 #include "../includes/funciones_servidor.h"
 #include "../includes/conexion_temp.h"
 #include "../includes/ssl.h"
+#include "../includes/pool.h"
+#include "../includes/reactor.h"
+#include "../includes/resolvedor.h"
+#include "../includes/sesiones.h"
+#include "../includes/canales.h"
+#include "../includes/epocas.h"
+#include "../includes/arena.h"
+#include "../includes/despacho.h"
+#include "../includes/respuestas.h"
 
 #include <redes2/irc.h>
 
@@ -42,8 +51,6 @@
 void liberarEstructuras(void){
 
 	liberaTodosTempUser();
-	pthread_mutex_destroy(&mutexDescr);
-	pthread_mutex_destroy(&mutexTempUser);
 
 }
 
@@ -68,38 +75,40 @@ void liberarEstructuras(void){
 void *manejaMensaje(void* pdesc){
 
 	pDatosMensaje datos;
-	char *next;
-	char *comando;
-
-	pthread_detach(pthread_self());
+	pArena arena;
+	LineaIRC linea;
+	char *comando, *fin;
+	size_t len;
 
 	datos = (pDatosMensaje) pdesc;
+	arena = arenaHilo();
 
-	next = datos->msg;
-	while(next != NULL) {
-        next = IRC_UnPipelineCommands(next, &comando);
+	/* Cada linea acaba en CRLF y '\0' y se analiza sin copiarla */
+	fin = datos->msg + datos->len;
+	for(comando = datos->msg; comando < fin; comando += len + 1) {
+		len = strlen(comando);
+		datos->linea = analizarLinea(comando, len, &linea) == ANALIZADOR_OK ? &linea : NULL;
 
         if(procesaComando(comando, datos) == COM_QUIT) {
 			/* Se cierra la conexion */
-		    if(comando!= NULL) {
-				free(comando);
-			}
+			datos->linea = NULL;
+			reiniciarArena(arena);
 			cerrarConexion(datos->sckfd);
+			liberaDatosMensaje(datos);
 			return NULL;
 		}
-		/* Libera memoria reservada comando */
-        if(comando!= NULL) {
-			free(comando);
-		}
+		/* Los temporales del comando salen de la arena */
+		reiniciarArena(arena);
     }
+	datos->linea = NULL;
 	
-	/* Incluimos el descriptor de nuevo y mandamos SIGUSR1 */
-	addFd(datos->sckfd);
+	/* Volvemos a armar el descriptor para recibir el siguiente mensaje */
+	rearmarFd(datos->sckfd);
 
 	/* Liberamos estructura de datos */
     liberaDatosMensaje(datos);
 
-	pthread_exit(NULL);
+	return NULL;
 }
 
 /**
@@ -107,6 +116,8 @@ void *manejaMensaje(void* pdesc){
  *
  * @brief Selecciona comando del array a ejecutar
  *
+ * El indice sale del despacho generado a partir de crea_comandos().
+ *
  * @synopsis
  * @code
  * 	status procesaComando(char *comando, pDatosMensaje datos)
@@ -126,16 +137,19 @@ void *manejaMensaje(void* pdesc){
 status procesaComando(char *comando, pDatosMensaje datos){
 	
 	long dev;	
+	status ret;
+	pArena arena;
+	unsigned long arenaAntes, heapAntes;
+	LineaIRC local;
+	pLineaIRC linea;
 
-	dev = IRC_CommandQuery(comando);
+	/* El verbo se despacha sin pasar por IRC_CommandQuery */
+	linea = lineaComando(comando, datos, &local);
+	dev = linea ? despacharComando(linea->comando) : DESPACHO_DESCONOCIDO;
 
-	switch(dev){
-		case IRCERR_NOCOMMAND:
-		case IRCERR_NOPARAMS:
-		case IRCERR_UNKNOWNCOMMAND:
-			return comandoVacio(comando,datos);
-		
-		return COM_OK;
+	/* Las numericas las envian servidores, no clientes */
+	if(dev == DESPACHO_NUMERICO || dev == DESPACHO_DESCONOCIDO){
+		return comandoVacio(comando,datos);
 	}
 
 	/* Comprobacion extra por si acaso */
@@ -143,10 +157,59 @@ status procesaComando(char *comando, pDatosMensaje datos){
 		return COM_ERROR;
 	}
 
-	return comandos[dev](comando, datos);
+	/* Contamos lo que reserva cada comando, de la arena y del heap */
+	arena = arenaHilo();
+	arenaAntes = arena ? arena->reservas : 0;
+	heapAntes = reservasHeapHilo();
+
+	ret = comandos[dev](comando, datos);
+
+	__sync_fetch_and_add(&reservasComandos[dev].veces, 1);
+	__sync_fetch_and_add(&reservasComandos[dev].arena, (arena ? arena->reservas : 0) - arenaAntes);
+	__sync_fetch_and_add(&reservasComandos[dev].heap, reservasHeapHilo() - heapAntes);
+
+	return ret;
+}
+
+/**
+ * @ingroup ComandosResto
+ *
+ * @brief Devuelve la linea analizada de un comando
+ *
+ * Los comandos que se llaman desde otro con una linea construida, como
+ * NAMES desde JOIN, no tienen la linea analizada en datos y se analiza aqui.
+ *
+ * @synopsis
+ * @code
+ * 	pLineaIRC lineaComando(char *comando, pDatosMensaje datos, pLineaIRC local)
+ * @endcode
+ *
+ * @param[in] comando comando a ejecutar
+ * @param[in] datos estructura con la informacion del mensaje
+ * @param[out] local donde analizar el comando si no es la linea de datos
+ *
+ * @return la linea analizada, o NULL si no tiene comando
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pLineaIRC lineaComando(char *comando, pDatosMensaje datos, pLineaIRC local){
+
+	if(datos->linea != NULL && datos->linea->linea == comando){
+		return datos->linea;
+	}
+
+	if(analizarLinea(comando, comando ? strlen(comando) : 0, local) != ANALIZADOR_OK){
+		return NULL;
+	}
+
+	return local;
 }
 
-void enviarMensajePrivado(int sckfd, char *mensaje, char *nick, char * nickorigin, int sndaway);
+void enviarMensajePrivado(int sckfd, char *mensaje, size_t len, char *nick, char * nickorigin, int sndaway);
 
 /**
  * @ingroup ComandosResto
@@ -171,21 +234,40 @@ void enviarMensajePrivado(int sckfd, char *mensaje, char *nick, char * nickorigi
 */
 status nuevaConexion(int desc, struct sockaddr_in * address){
 	status ret;
-	struct hostent * host;
-	char * ip_a = NULL;	
+	char ip_a[INET_ADDRSTRLEN], host[MAX_HOST_DNS];
+	short enCache;
+	pConexion conexion;
 
 	deleteTempUser(desc);
 
-	ip_a = inet_ntoa(address->sin_addr);
-	if(ip_a == NULL){
+	if(inet_ntop(AF_INET, &address->sin_addr, ip_a, sizeof(ip_a)) == NULL){
 		return COM_ERROR;
 	}
 
-	host = gethostbyaddr(address, sizeof(struct sockaddr_in), AF_INET);
-	ret = newTempUser(desc,  ip_a, host ? host->h_name : "*");
+	/* El cliente entra con su IP como host hasta que el resolvedor conteste */
+	snprintf(host, sizeof(host), "%s", ip_a);
+	enCache = buscarCacheDNS(resolvedor, address->sin_addr, host, sizeof(host));
+	ret = newTempUser(desc,  ip_a, host);
+
+	/* Sin hueco para otro cliente sin registrar se le avisa y se cierra antes de escucharle */
+	if(ret == CON_LLENO){
+		syslog(LOG_WARNING, "Demasiadas conexiones sin registrar, se rechaza %s", ip_a);
+		enviar(desc, "ERROR :Closing Link: demasiadas conexiones sin registrar\r\n");
+		conexion = obtenerConexion(desc);
+		if(conexion != NULL){
+			cerrarColaSalida(conexion);
+		}
+		liberarConexion(desc);
+		close(desc);
+		return COM_ERROR;
+	}
 
 	addFd(desc);
 
+	if(!enCache && ret == CON_OK){
+		pedirResolucion(resolvedor, desc, address->sin_addr);
+	}
+
 	return ret;
 }
 
@@ -211,83 +293,82 @@ status cerrarConexion(int socket){
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	long creationTS=0, actionTS=0;
 	int sock =socket;
+	pConexion conexion;
+	Respuesta respuesta;
+	char *prefijo;
 
-	#ifdef PRUEBAS_IRC
-	char **lista=NULL, *mensajequit=NULL, *prefijo=NULL;
-	long num;
-	int i;
-	#endif
-
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/*
-		Documentado en la memoria
-		Problema en algunos ordenadores, creemos que por saturacion
-		kernel: [ 2901.143828] ieee80211 phy0: rt2x00queue_flush_queue: Warning - Queue 2 failed to flush
-		Para compilar añadir a flags de gcc -D PRUEBAS_IRC
-	*/
-	#ifdef PRUEBAS_IRC
-	if(unknown_user) { /* Version por usuarios */
-		IRC_ComplexUser(&prefijo, unknown_nick, unknown_real, host, SERVICIO);
-		IRCMsg_Quit(&mensajequit, prefijo,"Abandono el servidor");
-
-		IRCTADUser_GetUserList (&lista, &num);
-	
-		for(i=0; i<num; i++){
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
-			if(strcmp(unknown_user,lista[i])){
-				/* printf("%s -- (%s)\n",lista[i], unknown_user); */
-				enviarMensajePrivado(socket, mensajequit, lista[i], NULL, 0);
-			}
-		}
-
-		free(prefijo);
-		free(mensajequit);
-		IRCTADUser_FreeList(lista,num);
+	/* Quien comparte algun canal recibe el QUIT una sola vez, antes de sacarlo de los canales */
+	prefijo = prefijoSesion(sock);
+	if(prefijo != NULL){
+		respuestaQuit(&respuesta, prefijo, "Abandono el servidor");
+		difundirVecinos(sock, respuesta.datos, respuesta.len);
 	}
 
-	/* // Version canales compartidos, problema que si comparte varios canales llega varias veces
-	if(unknown_id) {
-		IRC_ComplexUser(&prefijo, unknown_nick, unknown_real, host, SERVICIO);
-		IRCMsg_Quit(&mensajequit, prefijo,"Abandono el servidor");
-
-		IRCTAD_ListChannelsOfUserArray (unknown_user, unknown_nick, &lista, &num);
-	
-		for(i=0; i<num; i++){
-			printf("Canal: %s\n", lista[i]);
-			printf("Mensaje %s\n", mensajequit);
-
-			enviarMensajeACanal(socket, mensajequit, lista[i], NULL);
-		}
-
-		free(prefijo);
-		free(mensajequit);
-		IRCTADUser_FreeList(lista,num);
-
-	} */
-	#endif
-
-	/* Eliminamos de la base de datos */
+	/* Sacamos la conexion del indice de canales y de la base de datos */
+	salirTodosCanales(socket);
 	if(unknown_nick)
 		IRCTAD_Quit(unknown_nick);
 
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	deleteTempUser(socket);
-	
-	if(ssl_active){
-		cerrar_canal_SSL(socket);
 
+	/* Vaciamos lo que se pueda de la cola de salida y cerramos el canal SSL */
+	conexion = obtenerConexion(socket);
+	if(conexion != NULL){
+		cerrarColaSalida(conexion);
+	} else if(ssl_active){
+		cerrar_canal_SSL(socket);
 	}
 
-	close(socket);
+	/* Lo sacamos de epoll y de la tabla antes de cerrar para no borrar un descriptor reutilizado */
 	deleteFd(socket);
+	liberarConexion(socket);
+	cerrarTrasLectores(socket);
 
 	return COM_OK;
 }
 
+/**
+ * @ingroup ComandosResto
+ *
+ * @brief Empaqueta las lineas recibidas para pasarlas al pool
+ *
+ * @synopsis
+ * @code
+ * 	pDatosMensaje crearDatosMensaje(int sckfd, char *msg, size_t len)
+ * @endcode
+ *
+ * @param[in] sckfd socket del que se ha recibido
+ * @param[in] msg lineas completas terminadas en '\0', pasan a ser de la estructura
+ * @param[in] len longitud de msg
+ *
+ * @return la estructura creada, o NULL en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pDatosMensaje crearDatosMensaje(int sckfd, char *msg, size_t len){
+	pDatosMensaje datos;
+
+	datos = (pDatosMensaje) calloc (1, sizeof(DatosMensaje));
+	if(datos == NULL){
+		free(msg);
+		return NULL;
+	}
+
+	datos->sckfd = sckfd;
+	datos->len = len;
+	datos->msg = msg;
+
+	return datos;
+}
+
 /**
  * @ingroup ComandosResto
  *
@@ -335,6 +416,9 @@ status crea_comandos(void) {
         comandos[i] = comandoVacio; 
 	}
 
+    memset(nombresComandos, 0, sizeof(nombresComandos));
+    memset(reservasComandos, 0, sizeof(reservasComandos));
+
     comandos[NICK] = nick;
     comandos[USER] = user; 
 	comandos[JOIN] = join;
@@ -352,58 +436,30 @@ status crea_comandos(void) {
 	comandos[MOTD] = motd;
 	comandos[PONG] = pong;
 	comandos[WHO] = who;
+	comandos[STATS] = stats;
+
+	nombresComandos[NICK] = "NICK";
+	nombresComandos[USER] = "USER";
+	nombresComandos[JOIN] = "JOIN";
+	nombresComandos[LIST] = "LIST";
+	nombresComandos[WHOIS] = "WHOIS";
+	nombresComandos[NAMES] = "NAMES";
+	nombresComandos[PRIVMSG] = "PRIVMSG";
+	nombresComandos[PING] = "PING";
+	nombresComandos[PART] = "PART";
+	nombresComandos[TOPIC] = "TOPIC";
+	nombresComandos[KICK] = "KICK";
+	nombresComandos[AWAY] = "AWAY";
+	nombresComandos[MODE] = "MODE";
+	nombresComandos[QUIT] = "QUIT";
+	nombresComandos[MOTD] = "MOTD";
+	nombresComandos[PONG] = "PONG";
+	nombresComandos[WHO] = "WHO";
+	nombresComandos[STATS] = "STATS";
 
 	return COM_OK;   
 }
 
-/**
- * @ingroup ComandosResto
- *
- * @brief Inicializa rutina ping-pong
- *
- * @synopsis
- * @code
- * 	status rutinaPingPong(void)
- * @endcodeje
- *
- * @author
- * Pablo Marcos Manchon
- * Dionisio Perez Alvear
- *
- *<hr>
-*/
-status rutinaPingPong(void){
-
-	long nelements = 0;
-	long *ids = NULL;
-	char **users = NULL;
-	char **nicks = NULL;
-	char **realnames = NULL;
-	char **passwords = NULL;
-	char **hosts = NULL;
-	char **IPs = NULL;
-	int *sockets = NULL;
-	long *modes = NULL;
-	long *creationTSs = NULL;
-	long *actionTSs = NULL;
-	long i=0;
-
-
-	
-	/* printf("LLAMADA A RUTINA PING PONG\n"); */
-	IRCTADUser_GetAllLists (&nelements,&ids,&users,&nicks,&realnames,&passwords,&hosts,&IPs,&sockets,&modes,&creationTSs,&actionTSs);
-
-	for(i=0; i< nelements; i++){
-
-		/* printf("socket %d -> %ld\n", sockets[i], actionTSs[i]); */
-
-	}
-
-	IRCTADUser_FreeAllLists (nelements,ids,users,nicks,realnames,passwords,hosts,IPs,sockets,modes,creationTSs,actionTSs);
-
-	return COM_OK;
-}
-
 /**
  * @ingroup ComandosResto
  *
@@ -533,11 +589,10 @@ status whois(char *comando, pDatosMensaje datos){
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
 	long creationTS=0, actionTS=0;
 	int sock;
 	char *prefijo=NULL,*target=NULL,*mask=NULL;
-	char *next;
+	char *next, *guardado = NULL;
 	int sock1;
 	long id1;
 	char *user1=NULL,*real1=NULL,*host1=NULL,*ip1=NULL,*away1=NULL;
@@ -549,21 +604,11 @@ status whois(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error WHOIS NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -574,18 +619,15 @@ status whois(char *comando, pDatosMensaje datos){
 	switch(IRCParse_Whois (comando, &prefijo, &target, &mask)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNoNickNameGiven(&mensajeRespuesta, SERVICIO, unknown_nick);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NONICKNAMEGIVEN, unknown_nick, NULL);
 			if(prefijo) free(prefijo);
 			if(target) free(target);
 			if(mask) free(mask);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			return COM_OK;
 			break;
 	}
 
-	next = strtok(mask,",");
+	next = strtok_r(mask, ",", &guardado);
 	while(next != NULL){
 
 		id1 =0;
@@ -601,9 +643,7 @@ status whois(char *comando, pDatosMensaje datos){
 		/* Sacamos informacion del usuario especifico */
 		IRCTADUser_GetData(&id1, &user1, &next, &real1, &host1, &ip1, &sock1, &creationTS, &actionTS, &away1);
 		if(id1 == 0){
-			IRCMsg_ErrNoSuchNick (&mensajeRespuesta, SERVICIO, unknown_nick, next);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) { free(mensajeRespuesta); mensajeRespuesta=NULL;}
+			enviarError(datos->sckfd, RESP_NOSUCHNICK, unknown_nick, next);
 		} else {
 			/* Envio whois channels */
 			whoischannels(datos->sckfd, unknown_nick, next, user1, target);
@@ -624,13 +664,12 @@ status whois(char *comando, pDatosMensaje datos){
 		if(mensajeRespuesta) {free(mensajeRespuesta); mensajeRespuesta=NULL; }
 		liberarUserData(user1, NULL, real1, host1, ip1, away1);
 
-		next = strtok(NULL, ",");
+		next = strtok_r(NULL, ",", &guardado);
 	}
 	
 	if(prefijo) free(prefijo);
 	if(target) free(target);
 	if(mask) free(mask);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	return COM_OK;
 }
@@ -642,12 +681,11 @@ status whois(char *comando, pDatosMensaje datos){
  *
  * @synopsis
  * @code
- * 	void listarNamesCanal(char *canal, int sckfd, char *prefijo, char *nicku)
+ * 	void listarNamesCanal(char *canal, int sckfd, char *nicku)
  * @endcode
  *
  * @param[in] canal canal del que obtener users
  * @param[in] sckfd socket desde el que enviar
- * @param[in] prefijo prefijo a utilizar
  * @param[in] nicku nick del user
  *
  * @author
@@ -656,16 +694,13 @@ status whois(char *comando, pDatosMensaje datos){
  *
  *<hr>
 */
-void listarNamesCanal(char *canal, int sckfd, char *prefijo, char *nicku) {
-	char *mensajeRespuesta = NULL;
+void listarNamesCanal(char *canal, int sckfd, char *nicku) {
 	char *lista = NULL;
 	long num=0;
 
 	if(IRCTAD_ListNicksOnChannel(canal, &lista, &num) == IRC_OK){
-		IRCMsg_RplNamReply (&mensajeRespuesta, prefijo, nicku, "=", canal, lista);
-		enviar(sckfd, mensajeRespuesta);
+		enviarNombres(sckfd, nicku, canal, lista);
 	}
-	if(mensajeRespuesta) free(mensajeRespuesta);
 	if(lista) free(lista);
 
 }
@@ -692,17 +727,15 @@ void listarNamesCanal(char *canal, int sckfd, char *prefijo, char *nicku) {
  *<hr>
 */
 status names(char *comando, pDatosMensaje datos){
-	char *mensajeRespuesta = NULL;
+	Respuesta r;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 	char *canal=NULL, *prefijo=NULL, *objetivo=NULL;
 	char **lista =NULL;
 	int i;
-	char *next = NULL;
+	char *next = NULL, *guardado = NULL;
 	long num;
 
 	if(!comando || !datos){
@@ -712,21 +745,11 @@ status names(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error NAMES NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -736,13 +759,10 @@ status names(char *comando, pDatosMensaje datos){
 	switch(IRCParse_Names (comando, &prefijo, &canal, &objetivo)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams (&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
 			if(prefijo) free(prefijo);
 			if(canal) free(canal);
 			if(objetivo) free(objetivo);	
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 			return COM_OK;
 	}
@@ -752,7 +772,7 @@ status names(char *comando, pDatosMensaje datos){
 
     	IRCTADChan_GetList(&lista, &num, NULL);
 		for(i=0; i<num; i++){
-			listarNamesCanal(lista[i], datos->sckfd, SERVICIO, unknown_nick);
+			listarNamesCanal(lista[i], datos->sckfd, unknown_nick);
 		}
     
 		/* Liberamos lista y mensaje respuesta */
@@ -763,29 +783,25 @@ status names(char *comando, pDatosMensaje datos){
 			free(lista);
 		}
 
-		IRCMsg_RplEndOfNames (&mensajeRespuesta, SERVICIO, unknown_nick, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) { free(mensajeRespuesta); mensajeRespuesta=NULL;}
+		respuestaEndOfNames(&r, unknown_nick, "*");
+		enviarRespuesta(datos->sckfd, &r);
 
 	/* Caso una lista de canales */
     } else {
     
-		next = strtok(canal,",");
+		next = strtok_r(canal, ",", &guardado);
 		while(next != NULL){
-			listarNamesCanal(next, datos->sckfd, SERVICIO, unknown_nick);
-			IRCMsg_RplEndOfNames (&mensajeRespuesta, SERVICIO, unknown_nick, next);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) { free(mensajeRespuesta); mensajeRespuesta=NULL;}
+			listarNamesCanal(next, datos->sckfd, unknown_nick);
+			respuestaEndOfNames(&r, unknown_nick, next);
+			enviarRespuesta(datos->sckfd, &r);
 
-			next = strtok(NULL,",");
+			next = strtok_r(NULL, ",", &guardado);
 		}
 		free(canal);
 	}
 
-		if(mensajeRespuesta) free(mensajeRespuesta);
 		if(prefijo) free(prefijo);
 		if(objetivo) free(objetivo);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 	return COM_OK;
 }
 
@@ -796,11 +812,12 @@ status names(char *comando, pDatosMensaje datos){
  *
  * @synopsis
  * @code
- * 	void enviarMensajePrivado(int sckfd, char *mensaje, char *nick, char * nickorigin, int sndaway)
+ * 	void enviarMensajePrivado(int sckfd, char *mensaje, size_t len, char *nick, char * nickorigin, int sndaway)
  * @endcode
  *
  * @param[in] sckfd socket desde el que enviar
  * @param[in] mensaje mensaje a enviar
+ * @param[in] len longitud del mensaje
  * @param[in] nick nick del usuario
  * @param[in] nickorig nick original
  * @param[in] sndaway send away del usuario
@@ -811,8 +828,7 @@ status names(char *comando, pDatosMensaje datos){
  *
  *<hr>
 */
-void enviarMensajePrivado(int sckfd, char *mensaje, char *nick, char * nickorigin, int sndaway){
-	char *mensajeError = NULL;
+void enviarMensajePrivado(int sckfd, char *mensaje, size_t len, char *nick, char * nickorigin, int sndaway){
 	char *unknown_user = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
@@ -822,11 +838,9 @@ void enviarMensajePrivado(int sckfd, char *mensaje, char *nick, char * nickorigi
 	/* Obtenemos datos usuario target con el nick */
 	IRCTADUser_GetData(&unknown_id, &unknown_user, &nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
 	if(unknown_id == 0 && nickorigin){
-		IRCMsg_ErrNoSuchNick (&mensajeError, SERVICIO, nickorigin, nick);
-		enviar(sckfd, mensajeError);	
-		if(mensajeError) free(mensajeError);
+		enviarError(sckfd, RESP_NOSUCHNICK, nickorigin, nick);
 	} else {
-		enviar(sock, mensaje);
+		enviarDatos(sock, mensaje, len);
 		if(away!=NULL && sndaway!=0){
 			sendAway(sckfd, away, nick, nickorigin);
 		}
@@ -834,20 +848,59 @@ void enviarMensajePrivado(int sckfd, char *mensaje, char *nick, char * nickorigi
 	liberarUserData(unknown_user, NULL, unknown_real, host, IP, away);
 }
 
+/**
+ * @ingroup ComandosResto
+ *
+ * @brief Funcion auxilar del comando KICK, devuelve el socket de un nick
+ *
+ * @synopsis
+ * @code
+ * 	int socketDeNick(char *nick)
+ * @endcode
+ *
+ * @param[in] nick nick del usuario
+ *
+ * @return el socket del usuario, o -1 si el nick no existe
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int socketDeNick(char *nick){
+	char *unknown_user = NULL, *unknown_real = NULL;
+	char *host = NULL, *IP = NULL, *away = NULL;
+	long unknown_id = 0;
+	long creationTS=0, actionTS=0;
+	int sock = 0;
+
+	IRCTADUser_GetData(&unknown_id, &unknown_user, &nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
+	liberarUserData(unknown_user, NULL, unknown_real, host, IP, away);
+
+	return unknown_id == 0 ? -1 : sock;
+}
+
 /**
  * @ingroup ComandosResto
  *
  * @brief Funcion auxilar del comando PRIVMSG
  *
+ * Difunde el mensaje por el indice de miembros del canal: se encola
+ * directamente en la conexion de cada miembro, sin pedir al TAD la lista de
+ * nicks ni el socket de cada uno.
+ *
  * @synopsis
  * @code
- * 	void enviarMensajeACanal(int sckfd, char *mensaje, char *canal, char * nickorigin)
+ * 	void enviarMensajeACanal(int sckfd, char *mensaje, size_t len, char *canal, char * nickorigin, int excluido)
  * @endcode
  *
  * @param[in] sckfd socket desde el que enviar
  * @param[in] mensaje mensaje a enviar
+ * @param[in] len longitud del mensaje
  * @param[in] canal canal al que enviar el mensaje
  * @param[in] nickorig nick original
+ * @param[in] excluido descriptor del miembro que no lo recibe, -1 para ninguno
  *
  * @author
  * Pablo Marcos Manchon
@@ -855,40 +908,11 @@ void enviarMensajePrivado(int sckfd, char *mensaje, char *nick, char * nickorigi
  *
  *<hr>
 */
-void enviarMensajeACanal(int sckfd, char *mensaje, char *canal, char * nickorigin){
-	char *mensajeError = NULL;
-	char **lista = NULL;
-	long num = 0;
-	long i;
+void enviarMensajeACanal(int sckfd, char *mensaje, size_t len, char *canal, char * nickorigin, int excluido){
 
-	/* Obtenemos datos usuario target con el nick */
-	if(IRCTAD_ListNicksOnChannelArray(canal, &lista, &num) != IRC_OK){
-
-		IRCMsg_ErrNoSuchNick (&mensajeError, SERVICIO, nickorigin, canal);
-		enviar(sckfd, mensajeError);
-		if(mensajeError) free(mensajeError);
-		return;	
-	}
-
-	/* Enviamos mensajes a usuarios del canal */	
-	for(i=0; i<num; i++) {
-		/* No volvemos a mandarselo al que lo ha enviado */
-		if(nickorigin){
-			if(!strcmp(nickorigin,lista[i])){
-				continue;
-			}
-		}
-
-
-		enviarMensajePrivado(sckfd, mensaje, lista[i], nickorigin,0);
-	}
-
-	/* Liberamos la lista de usuarios */
-	if(lista){
-		for(i=0; i<num; i++){
-			if(lista[i]) free(lista[i]);
-		}
-		free(lista);
+	/* Sin nick de origen, como en PART o QUIT, no se avisa del error */
+	if(difundirCanal(canal, mensaje, len, excluido) < 0 && nickorigin != NULL){
+		enviarError(sckfd, RESP_NOSUCHNICK, nickorigin, canal);
 	}
 }
 
@@ -914,15 +938,16 @@ void enviarMensajeACanal(int sckfd, char *mensaje, char *canal, char * nickorigi
  *<hr>
 */
 status privmsg(char *comando, pDatosMensaje datos){
-	char *mensajeRespuesta = NULL;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
-	char *msgtarget=NULL, *msg=NULL,*prefijo=NULL, *target=NULL;
-	char *mensaje=NULL, *prefijo2=NULL;
+	char *msgtarget=NULL, *msg=NULL, *target=NULL, *guardado=NULL;
+	char *prefijo2=NULL;
+	Respuesta r;
+	LineaIRC local;
+	pLineaIRC linea;
+	pArena arena;
 
 	if(!comando || !datos){
 		return COM_ERROR;
@@ -931,65 +956,47 @@ status privmsg(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error WHOIS NOPRIV");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
 	/* Actualizamos tiempo action ts */
 	IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
 
-	switch(IRCParse_Privmsg (comando, &prefijo, &msgtarget, &msg)){
-		case IRCERR_NOSTRING:
-		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNoTextToSend(&mensajeRespuesta, SERVICIO ,unknown_nick);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
-			if(prefijo) free(prefijo);
-			if(msgtarget) free(msgtarget);
-			if(msg) free(msg);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+	/* PRIVMSG <destinos> :<texto>, los destinos y el texto salen a la arena;
+	   un final vacio (PRIVMSG #c :) es como no mandar texto */
+	linea = lineaComando(comando, datos, &local);
+	arena = arenaHilo();
+	if(linea == NULL || linea->numParams < 2 || linea->params[1].len == 0
+		|| (msgtarget = copiarVista(arena, linea->params[0])) == NULL
+		|| (msg = copiarVista(arena, linea->params[1])) == NULL){
+		enviarError(datos->sckfd, RESP_NOTEXTTOSEND, unknown_nick, NULL);
 
-			return COM_OK;
+		return COM_OK;
 	}
 
 
-	IRC_ComplexUser(&prefijo2, unknown_nick, unknown_real, host, SERVICIO);
+	prefijo2 = prefijoSesion(datos->sckfd);
 		
-	target = strtok(msgtarget,",");
+	target = strtok_r(msgtarget, ",", &guardado);
 	while(target != NULL){
 
 		/* Creamos el mensaje */
-		IRCMsg_Privmsg (&mensaje, prefijo2, target, msg);
+		respuestaPrivmsg(&r, prefijo2, target, msg);
 
 		/* Caso mensaje a canal */
 		if(*target == '#' || *target == '&'){
-			enviarMensajeACanal(datos->sckfd, mensaje, target,unknown_nick );
+			enviarMensajeACanal(datos->sckfd, r.datos, r.len, target,unknown_nick, datos->sckfd);
 		} else { /* Caso mensaje a usuario */
-			enviarMensajePrivado(datos->sckfd, mensaje, target,unknown_nick,1);
+			enviarMensajePrivado(datos->sckfd, r.datos, r.len, target,unknown_nick,1);
 		}
 
-		target = strtok(NULL,",");
-		if(mensaje) { free(mensaje); mensaje=NULL;}
+		target = strtok_r(NULL, ",", &guardado);
 	}
-	if(prefijo) free(prefijo);
-	if(prefijo2) free(prefijo2);
-	if(msgtarget) free(msgtarget);
-	if(msg) free(msg);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	return COM_OK;
 }
@@ -1016,14 +1023,15 @@ status privmsg(char *comando, pDatosMensaje datos){
  *<hr>
 */
 status ping(char *comando, pDatosMensaje datos){
-	char *mensajeRespuesta = NULL;
+	Respuesta r;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
-	char *prefijo=NULL, *server=NULL, *server2=NULL,*msg=NULL;
+	char *server=NULL, *msg=NULL;
+	LineaIRC local;
+	pLineaIRC linea;
+	pArena arena;
 
 	if(!comando || !datos){
 		return COM_ERROR;
@@ -1032,45 +1040,33 @@ status ping(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error WHOIS NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
 	/* Actualizamos tiempo action ts */
 	IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
 
-	/* Parseamos el comando */
-	switch(IRCParse_Ping (comando,&prefijo, &server, &server2, &msg)){
-		case IRCERR_NOSTRING:
-		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNoOrigin(&mensajeRespuesta, SERVICIO, unknown_nick, "No origin specified");
-			break;
-		default:	
-			IRCMsg_Pong (&mensajeRespuesta, SERVICIO, SERVICIO, msg, server);
-		break;
+	/* PING <origen> [<destino>], el origen vuelve en el PONG */
+	linea = lineaComando(comando, datos, &local);
+	arena = arenaHilo();
+	if(linea != NULL && linea->numParams > 0){
+		server = copiarVista(arena, linea->params[0]);
+		if(linea->numParams > 1){
+			msg = copiarVista(arena, linea->params[1]);
+		}
 	}
 
-	enviar(datos->sckfd, mensajeRespuesta);
-	if(mensajeRespuesta) free(mensajeRespuesta);
-	if(prefijo) free(prefijo);
-	if(server) free(server);
-	if(server2) free(server2);
-	if(msg) free(msg);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+	if(server == NULL){
+		enviarError(datos->sckfd, RESP_NOORIGIN, unknown_nick, NULL);
+	} else {
+		respuestaPong(&r, msg, server);
+		enviarRespuesta(datos->sckfd, &r);
+	}
 
 	return COM_OK;
 }
@@ -1100,8 +1096,6 @@ status pong(char *comando, pDatosMensaje datos){
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 
 	if(!comando || !datos){
@@ -1111,25 +1105,16 @@ status pong(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error PONG NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 		return COM_OK;
 	}
 
 	/* Actualizamos tiempo action ts */
 	IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
 
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	return COM_OK;
 }
@@ -1141,13 +1126,12 @@ status pong(char *comando, pDatosMensaje datos){
  *
  * @synopsis
  * @code
- * 	void partirCanal(int sckfd, char * canal, char *nick, char *real, char *msg)
+ * 	void partirCanal(int sckfd, char * canal, char *nick, char *msg)
  * @endcode
  *
  * @param[in] sckfd socket desde el que enviar
  * @param[in] canal canal a abandonar
  * @param[in] nick nick del usuario
- * @param[in] real realname del usuario
  * @param[in] msg mensaje a enviar
  *
  * @author
@@ -1156,30 +1140,32 @@ status pong(char *comando, pDatosMensaje datos){
  *
  *<hr>
 */
-void partirCanal(int sckfd, char * canal, char *nick, char *real, char *msg){
+void partirCanal(int sckfd, char * canal, char *nick, char *msg){
 
-	char *mensaje=NULL, *prefijo2=NULL;
+	Respuesta r;
+	char *prefijo2;
 
 	switch(IRCTAD_Part (canal, nick)){
 		case IRCERR_NOVALIDUSER:
-			IRCMsg_ErrNotOnChannel (&mensaje, SERVICIO, nick, real, canal);
+			enviarError(sckfd, RESP_NOTONCHANNEL, nick, canal);
 			break;
 		case IRCERR_NOVALIDCHANNEL:
-			IRCMsg_ErrNoSuchChannel (&mensaje, SERVICIO, nick, canal);
+			enviarError(sckfd, RESP_NOSUCHCHANNEL, nick, canal);
 			break;
 		case IRCERR_UNDELETABLECHANNEL:
 			syslog(LOG_INFO, "No se ha podido borrar el canal %s", canal);
 		case IRC_OK:
-			IRC_ComplexUser(&prefijo2,nick, real, "*", SERVICIO);
-			IRCMsg_Part (&mensaje, prefijo2, canal, msg);
-			free(prefijo2);
+			salirCanal(canal, sckfd);
+			/* El mismo prefijo que en JOIN y PRIVMSG, sin construirlo cada vez */
+			prefijo2 = prefijoSesion(sckfd);
+			respuestaPart(&r, prefijo2 ? prefijo2 : nick, canal, msg);
+
+			/* Los errores solo los recibe quien hace PART */
+			enviarRespuesta(sckfd, &r);
+			enviarMensajeACanal(sckfd, r.datos, r.len, canal, NULL, -1);
 			break;
 	}
 
-	enviar(sckfd, mensaje);
-	enviarMensajeACanal(sckfd,mensaje,canal, NULL);
-	if(mensaje) free(mensaje);
-
 }
 
 /**
@@ -1204,14 +1190,14 @@ void partirCanal(int sckfd, char * canal, char *nick, char *real, char *msg){
  *<hr>
 */
 status part(char *comando, pDatosMensaje datos){
-	char *mensajeRespuesta = NULL;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
-	char *prefijo=NULL, *canal=NULL, *mensaje=NULL, *next=NULL;
+	char *canal=NULL, *mensaje=NULL, *next=NULL, *guardado=NULL;
+	LineaIRC local;
+	pLineaIRC linea;
+	pArena arena;
 
 
 	if(!comando || !datos){
@@ -1221,49 +1207,36 @@ status part(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error PART NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
 	/* Actualizamos tiempo action ts */
 	IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
 
-	switch(IRCParse_Part(comando, &prefijo, &canal, &mensaje)){
-		case IRCERR_NOSTRING:
-		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams(&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
-			break;
+	/* PART <canales> [:<mensaje>] */
+	linea = lineaComando(comando, datos, &local);
+	arena = arenaHilo();
+	if(linea == NULL || linea->numParams < 1
+		|| (canal = copiarVista(arena, linea->params[0])) == NULL){
+		enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
+		return COM_OK;
+	}
 
-		case IRC_OK:
-		default:			
-			next = strtok(canal,",");
-			while(next != NULL){
-				partirCanal(datos->sckfd, next, unknown_nick, unknown_real, mensaje);
-				next = strtok(NULL,",");
-			}
-			break;
+	if(linea->numParams > 1){
+		mensaje = copiarVista(arena, linea->params[1]);
+	}
+
+	next = strtok_r(canal, ",", &guardado);
+	while(next != NULL){
+		partirCanal(datos->sckfd, next, unknown_nick, mensaje);
+		next = strtok_r(NULL, ",", &guardado);
 	}
 
-	if(prefijo) free(prefijo);
-	if(canal) free(canal);
-	if(mensaje) free(mensaje);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 	return COM_OK;
 }
 
@@ -1294,7 +1267,6 @@ status topic(char *comando, pDatosMensaje datos){
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
 	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 	char *prefijo=NULL, *canal=NULL, *topico=NULL;
 
@@ -1305,21 +1277,11 @@ status topic(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error TOPIC NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -1329,13 +1291,10 @@ status topic(char *comando, pDatosMensaje datos){
 	switch(IRCParse_Topic (comando, &prefijo, &canal, &topico)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams(&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
 			if(canal)free(canal);
 			if(prefijo)free(prefijo);
 			if(topico)free(topico);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			return COM_OK;
 			
 	}
@@ -1352,15 +1311,16 @@ status topic(char *comando, pDatosMensaje datos){
 		if(ret == IRC_OK) /* Cambio realizado */
 			IRCMsg_Topic (&mensajeRespuesta, SERVICIO, canal, topico);
 		else /* Error al cambiar topico */
-			IRCMsg_ErrChanOPrivsNeeded(&mensajeRespuesta, SERVICIO, unknown_nick, canal);
+			enviarError(datos->sckfd, RESP_CHANOPRIVSNEEDED, unknown_nick, canal);
 	}
 
-	enviar(datos->sckfd, mensajeRespuesta);
-	if(mensajeRespuesta) free(mensajeRespuesta);
+	if(mensajeRespuesta){
+		enviar(datos->sckfd, mensajeRespuesta);
+		free(mensajeRespuesta);
+	}
 	if(canal)free(canal);
 	if(prefijo)free(prefijo);
 	if(topico)free(topico);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 	return COM_OK;
 }
 
@@ -1391,7 +1351,6 @@ status kick(char *comando, pDatosMensaje datos){
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
 	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 	char *prefijo=NULL, *canal=NULL, *usuario=NULL,*comentario=NULL;
 	char *prefijo2=NULL;
@@ -1404,21 +1363,11 @@ status kick(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error KICK NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -1428,51 +1377,46 @@ status kick(char *comando, pDatosMensaje datos){
 	switch(IRCParse_Kick (comando, &prefijo, &canal, &usuario, &comentario)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams(&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
 			if(canal)free(canal);
 			if(prefijo)free(prefijo);
 			if(usuario)free(usuario);
 			if(comentario) free(comentario);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			return COM_OK;
 	}
 
-	IRC_ComplexUser(&prefijo2, unknown_nick, unknown_real, host, SERVICIO);
+	prefijo2 = prefijoSesion(datos->sckfd);
 	ret = IRCTAD_GetUserModeOnChannel(canal, unknown_nick);
 
 	if(ret == IRCERR_NOVALIDCHANNEL) { /* Canal no valido */
-			IRCMsg_ErrNoSuchChannel(&mensajeRespuesta, SERVICIO, unknown_nick, canal);
-			enviar(datos->sckfd, mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NOSUCHCHANNEL, unknown_nick, canal);
 
 	/* No privilegios suficientes */
 	} else if (!(ret&(IRCUMODE_CREATOR|IRCUMODE_OPERATOR|IRCUMODE_LOCALOPERATOR))){
-		IRCMsg_ErrChanOPrivsNeeded(&mensajeRespuesta, SERVICIO, unknown_nick, canal);
-		enviar(datos->sckfd, mensajeRespuesta);
+		enviarError(datos->sckfd, RESP_CHANOPRIVSNEEDED, unknown_nick, canal);
 
 
 	} else { /* Caso se puede kickear al usuario */
 		switch(IRCTAD_KickUserFromChannel (canal, usuario)){
 			case IRCERR_NOVALIDUSER:
-				IRCMsg_ErrNotOnChannel (&mensajeRespuesta, SERVICIO, usuario, unknown_real, canal);
-				enviar(datos->sckfd, mensajeRespuesta);
+				enviarError(datos->sckfd, RESP_NOTONCHANNEL, usuario, canal);
 				break;
 			case IRCERR_NOVALIDCHANNEL:
-				IRCMsg_ErrNoSuchChannel (&mensajeRespuesta, SERVICIO, usuario, canal);
-				enviar(datos->sckfd, mensajeRespuesta);
+				enviarError(datos->sckfd, RESP_NOSUCHCHANNEL, usuario, canal);
 				break;
 			case IRCERR_UNDELETABLECHANNEL:
 				syslog(LOG_INFO, "No se ha podido borrar el canal %s", canal);
+				salirCanal(canal, socketDeNick(usuario));
 				IRCMsg_Kick (&mensajeRespuesta, prefijo2, canal,usuario, comentario);
 				enviar(datos->sckfd, mensajeRespuesta);
-				enviarMensajePrivado(datos->sckfd, mensajeRespuesta, canal, unknown_nick,0);
+				enviarMensajePrivado(datos->sckfd, mensajeRespuesta, strlen(mensajeRespuesta), canal, unknown_nick,0);
 				break;
 
 			case IRC_OK:
+				salirCanal(canal, socketDeNick(usuario));
 				IRCMsg_Kick (&mensajeRespuesta, prefijo2, canal,usuario, comentario);
-				enviarMensajeACanal(datos->sckfd, mensajeRespuesta, canal, usuario);
-				enviarMensajePrivado(datos->sckfd, mensajeRespuesta, usuario, usuario,0);
+				enviarMensajeACanal(datos->sckfd, mensajeRespuesta, strlen(mensajeRespuesta), canal, usuario, -1);
+				enviarMensajePrivado(datos->sckfd, mensajeRespuesta, strlen(mensajeRespuesta), usuario, usuario,0);
 
 				break;
 		}
@@ -1481,10 +1425,8 @@ status kick(char *comando, pDatosMensaje datos){
 	if(mensajeRespuesta) free(mensajeRespuesta);
 	if(canal)free(canal);
 	if(prefijo)free(prefijo);
-	if(prefijo2)free(prefijo2);
 	if(usuario)free(usuario);
 	if(comentario) free(comentario);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	return COM_OK;
 }
@@ -1515,8 +1457,6 @@ status away(char *comando, pDatosMensaje datos){
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 	char *prefijo=NULL, *mensaje=NULL;
 
@@ -1527,21 +1467,11 @@ status away(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error AWAY NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -1551,28 +1481,27 @@ status away(char *comando, pDatosMensaje datos){
 	switch(IRCParse_Away(comando,&prefijo, &mensaje)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams(&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
 			if(mensaje) free(mensaje);
 			if(prefijo)free(prefijo);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			return COM_OK;
 	}
 
 	/* Caso Poner away */
 	if(mensaje){
 		IRCTADUser_SetAway(unknown_id,unknown_user, unknown_nick, unknown_real, mensaje);
+		cambiarAwaySesion(datos->sckfd, mensaje);
 		IRCMsg_RplNowAway(&mensajeRespuesta,SERVICIO, unknown_nick);
 
 	} else { /* Caso salir de away */
 		IRCTADUser_SetAway(unknown_id,unknown_user, unknown_nick, unknown_real, NULL);
+		cambiarAwaySesion(datos->sckfd, NULL);
 		IRCMsg_RplUnaway(&mensajeRespuesta,SERVICIO, unknown_nick);
 	}
 
 	enviar(datos->sckfd, mensajeRespuesta);
 	if(mensaje) free(mensaje);
 	if(prefijo)free(prefijo);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	return COM_OK;
 }
@@ -1604,7 +1533,6 @@ status mode(char *comando, pDatosMensaje datos){
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
 	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 	char *canal=NULL,*mode=NULL,*user=NULL,*prefijo=NULL, *mcanal=NULL;
 
@@ -1615,21 +1543,11 @@ status mode(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error MODE NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -1639,14 +1557,11 @@ status mode(char *comando, pDatosMensaje datos){
 	switch(IRCParse_Mode(comando, &prefijo, &canal, &mode, &user)){
 		case IRCERR_NOSTRING:
 		case IRCERR_ERRONEUSCOMMAND:
-			IRCMsg_ErrNeedMoreParams(&mensajeRespuesta, SERVICIO ,unknown_nick, comando);
-			enviar(datos->sckfd, mensajeRespuesta);
-			if(mensajeRespuesta) free(mensajeRespuesta);
+			enviarError(datos->sckfd, RESP_NEEDMOREPARAMS, unknown_nick, comando);
 			if(canal)free(canal);
 			if(prefijo)free(prefijo);
 			if(user)free(user);
 			if(mode) free(mode);
-			liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 			return COM_OK;
 	}
 
@@ -1654,15 +1569,15 @@ status mode(char *comando, pDatosMensaje datos){
 			ret = IRCTAD_GetUserModeOnChannel(canal, unknown_nick);	
 
 			if(ret == IRCERR_NOVALIDCHANNEL) { /* Canal no valido */
-				IRCMsg_ErrNoSuchChannel(&mensajeRespuesta, SERVICIO, unknown_nick, canal);
-	
+				enviarError(datos->sckfd, RESP_NOSUCHCHANNEL, unknown_nick, canal);
 
 			} else if (!(ret&(IRCUMODE_CREATOR|IRCUMODE_OPERATOR|IRCUMODE_LOCALOPERATOR))){
-				IRCMsg_ErrChanOPrivsNeeded(&mensajeRespuesta, SERVICIO, unknown_nick, canal);
+				enviarError(datos->sckfd, RESP_CHANOPRIVSNEEDED, unknown_nick, canal);
 
 			} else if(mode) { /* Caso comandos necesitan permisos */
 				if(!strcmp("\\+k", mode)){
 					IRCTADChan_SetPassword(canal,user);
+					fijarClaveCanal(canal, user);
 				}
 
 				IRCTAD_Mode(canal, unknown_nick, mode);
@@ -1673,16 +1588,17 @@ status mode(char *comando, pDatosMensaje datos){
 				free(mcanal);
 			}
 	} else {
-		IRCMsg_ErrChanOPrivsNeeded(&mensajeRespuesta, SERVICIO, unknown_nick, "*");
+		enviarError(datos->sckfd, RESP_CHANOPRIVSNEEDED, unknown_nick, "*");
 	}
 
-	enviar(datos->sckfd, mensajeRespuesta);
-	if(mensajeRespuesta) free(mensajeRespuesta);
+	if(mensajeRespuesta){
+		enviar(datos->sckfd, mensajeRespuesta);
+		free(mensajeRespuesta);
+	}
 	if(canal)free(canal);
 	if(prefijo)free(prefijo);
 	if(user)free(user);
 	if(mode) free(mode);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	return COM_OK;
 }
@@ -1713,7 +1629,6 @@ status quit(char *comando, pDatosMensaje datos){
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 
 	if(!comando || !datos){
@@ -1721,14 +1636,13 @@ status quit(char *comando, pDatosMensaje datos){
 	}
 
 	sock = datos->sckfd;
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 	IRCMsg_Notice(&mensajeRespuesta, SERVICIO, unknown_nick, "Me piro vampiro");
 	enviar(datos->sckfd, mensajeRespuesta);
 	if(mensajeRespuesta) free(mensajeRespuesta);
 
 	/* Se cierra la conexion */
 	/*IRCTAD_Quit(unknown_nick);*/
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
 
 	return COM_QUIT;
 }
@@ -1788,8 +1702,6 @@ status motd(char *comando, pDatosMensaje datos){
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	unsigned long ret = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 	char *prefijo=NULL, *target=NULL;
 	char *mtd=NULL;
@@ -1804,21 +1716,11 @@ status motd(char *comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
-
-	/* Caso no hay suficiente memoria */
-	if(ret == IRCERR_NOENOUGHMEMORY) {
-		syslog(LOG_ERR, "Error MOTD NOENOUGHMEMORY");
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
-		return COM_ERROR;
-	}
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
 
 	/* ERRNOTREGISTERD */
 	if(unknown_id == 0){
-		IRCMsg_ErrNotRegisterd(&mensajeRespuesta, SERVICIO, "*");
-		enviar(datos->sckfd, mensajeRespuesta);
-		if(mensajeRespuesta) free(mensajeRespuesta);
-		liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
 		return COM_OK;
 	}
 
@@ -1855,7 +1757,148 @@ status motd(char *comando, pDatosMensaje datos){
 	if(mtd) free(mtd);
 	if(prefijo) free(prefijo);
 	if(target) free(target);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+
+	return COM_OK;
+}
+
+/**
+ * @ingroup ComandosResto
+ *
+ * @brief Envia una linea de estadisticas como NOTICE
+ *
+ * @synopsis
+ * @code
+ * 	void enviarEstadistica(int sckfd, char *nick, char *texto)
+ * @endcode
+ *
+ * @param[in] sckfd socket al que enviar
+ * @param[in] nick nick del usuario que pide las estadisticas
+ * @param[in] texto linea a enviar
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void enviarEstadistica(int sckfd, char *nick, char *texto){
+	char *mensajeRespuesta = NULL;
+
+	IRCMsg_Notice(&mensajeRespuesta, SERVICIO, nick, texto);
+	enviar(sckfd, mensajeRespuesta);
+	if(mensajeRespuesta) free(mensajeRespuesta);
+}
+
+/**
+ * @ingroup ComandosResto
+ *
+ * @brief Ejecuta el comando STATS, devuelve contadores internos del servidor
+ *
+ * @synopsis
+ * @code
+ * 	status stats(char *comando, pDatosMensaje datos)
+ * @endcode
+ *
+ * @param[in] comando comando a ejecutar
+ * @param[in] datos estructura con la informacion del mensaje
+ *
+ * @return COM_OK si todo va bien. Error en otro caso
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status stats(char *comando, pDatosMensaje datos){
+	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
+	char *host = NULL, *IP = NULL, *away = NULL;
+	long unknown_id = 0;
+	unsigned long programados;
+	int sock, i;
+	char linea[256];
+	EstadisticasPool est;
+
+	if(!comando || !datos){
+		return COM_ERROR;
+	}
+
+	sock = datos->sckfd;
+
+	/* Obtenemos identificador del usuario */
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
+
+	/* ERRNOTREGISTERD */
+	if(unknown_id == 0){
+		enviarError(datos->sckfd, RESP_NOTREGISTERED, "*", NULL);
+		return COM_OK;
+	}
+
+	/* Actualizamos tiempo action ts */
+	IRCTADUser_SetActionTS(unknown_id, unknown_user, unknown_nick, unknown_real);
+
+	/* Estadisticas del pool de hilos */
+	if(estadisticasPool(thpool, &est) == POOL_OK){
+		snprintf(linea, sizeof(linea), "pool: hilos=%d cola=%d/%d max=%d bloqueos=%lu",
+			est.hilos, est.profundidad, est.capacidad, est.maxProfundidad, est.bloqueos);
+		enviarEstadistica(datos->sckfd, unknown_nick, linea);
+		snprintf(linea, sizeof(linea), "pool: encolados=%lu procesados=%lu espera_media=%lldus espera_max=%lldus",
+			est.encolados, est.procesados, est.esperaMediaUs, est.esperaMaxUs);
+		enviarEstadistica(datos->sckfd, unknown_nick, linea);
+	}
+
+	/* Estadisticas de entrada */
+	snprintf(linea, sizeof(linea), "entrada: lineas_truncadas=%lu lineas_nulas=%lu", lineasTruncadas, lineasNulas);
+	enviarEstadistica(datos->sckfd, unknown_nick, linea);
+
+	/* Estadisticas de salida */
+	snprintf(linea, sizeof(linea), "salida: limite=%zu pico=%zu expulsiones=%lu compartidos=%lu respuestas_truncadas=%lu",
+		maxSalida, picoSalida, expulsionesSalida, compartidosSalida, respuestasTruncadas);
+	enviarEstadistica(datos->sckfd, unknown_nick, linea);
+
+	/* Estadisticas de conexiones sin registrar */
+	snprintf(linea, sizeof(linea), "temporales: actuales=%lu limite=%d rechazadas=%lu plazo_registro=%d inactividad=%d caducadas_registro=%lu caducadas_inactividad=%lu",
+		numTemporales, maxTemporales, rechazadasTemporales, plazoRegistro, inactividadRegistro,
+		caducadasRegistro, caducadasInactividad);
+	enviarEstadistica(datos->sckfd, unknown_nick, linea);
+
+	/* Estadisticas de la vigilancia de las conexiones */
+	programados = 0;
+	for(i = 0; reactores && i < numReactores; i++){
+		programados += reactores[i].rueda.programados;
+	}
+	snprintf(linea, sizeof(linea), "ping: activo=%d espera=%d plazo=%d enviados=%lu caidas=%lu",
+		pingActivo, ESPERA_PING, PLAZO_PONG, pingsEnviados, caidasPing);
+	enviarEstadistica(datos->sckfd, unknown_nick, linea);
+	snprintf(linea, sizeof(linea), "vigilancia: temporizadores=%lu lote_max=%d lotes=%lu aplazadas=%lu",
+		programados, LOTE_CADUCADAS, lotesCaducadas, aplazadasCaducadas);
+	enviarEstadistica(datos->sckfd, unknown_nick, linea);
+
+	/* Estadisticas de las instantaneas de canales */
+	snprintf(linea, sizeof(linea), "epocas: epoca=%lu pendientes=%lu liberadas=%lu",
+		__atomic_load_n(&epocaGlobal, __ATOMIC_ACQUIRE), pendientesEpoca, liberadosEpoca);
+	enviarEstadistica(datos->sckfd, unknown_nick, linea);
+
+	/* Reservas de memoria por comando, de media */
+	for(i = 0; i < IRC_MAX_COMMANDS; i++){
+		if(nombresComandos[i] == NULL || reservasComandos[i].veces == 0){
+			continue;
+		}
+		snprintf(linea, sizeof(linea), "reservas: %s veces=%lu arena=%.1f heap=%.1f", nombresComandos[i],
+			reservasComandos[i].veces,
+			(double) reservasComandos[i].arena / reservasComandos[i].veces,
+			(double) reservasComandos[i].heap / reservasComandos[i].veces);
+		enviarEstadistica(datos->sckfd, unknown_nick, linea);
+	}
+
+	/* Estadisticas del resolvedor */
+	if(resolvedor){
+		snprintf(linea, sizeof(linea), "dns: resueltas=%lu sin_nombre=%lu caducadas=%lu cache=%lu descartadas=%lu",
+			resolvedor->resueltas, resolvedor->sinNombre, resolvedor->caducadas,
+			resolvedor->aciertosCache, resolvedor->descartadas);
+		enviarEstadistica(datos->sckfd, unknown_nick, linea);
+	}
+
 
 	return COM_OK;
 }
@@ -1882,11 +1925,9 @@ status motd(char *comando, pDatosMensaje datos){
  *<hr>
 */
 status comandoVacio(char* comando, pDatosMensaje datos){
-	char *mensajeRespuesta = NULL;
 	char *unknown_user = NULL, *unknown_nick = NULL, *unknown_real = NULL;
 	char *host = NULL, *IP = NULL, *away = NULL;
 	long unknown_id = 0;
-	long creationTS=0, actionTS=0;
 	int sock;
 
 	if(!comando || !datos){
@@ -1896,7 +1937,7 @@ status comandoVacio(char* comando, pDatosMensaje datos){
 	sock = datos->sckfd;
 
 	/* Obtenemos identificador del usuario */
-	IRCTADUser_GetData(&unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &sock, &creationTS, &actionTS, &away);
+	leerSesion(sock, &unknown_id, &unknown_user, &unknown_nick, &unknown_real, &host, &IP, &away);
     syslog(LOG_DEBUG, "Comando No reconocido %s", comando);
 	
 	if(unknown_id != 0) {
@@ -1905,12 +1946,7 @@ status comandoVacio(char* comando, pDatosMensaje datos){
 	}
 
 	/* Variante si el usuario esta registrado */
-   	IRCMsg_ErrUnKnownCommand (&mensajeRespuesta, SERVICIO, unknown_nick ? unknown_nick : "*", comando);
-    enviar(datos->sckfd, mensajeRespuesta);
-
-	/* Liberamos estructuras */
-    if(mensajeRespuesta) free(mensajeRespuesta);
-	liberarUserData(unknown_user, unknown_nick, unknown_real, host, IP, away);
+	enviarError(datos->sckfd, RESP_UNKNOWNCOMMAND, unknown_nick ? unknown_nick : "*", comando);
 
 	return COM_OK;
 }
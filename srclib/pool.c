@@ -0,0 +1,320 @@
+/**
+ * @file pool.c
+ * @brief pool fijo de hilos trabajadores con cola acotada de mensajes
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup PoolHilos PoolHilos
+ *
+ * <hr>
+ */
+
+#include "../includes/pool.h"
+
+/**
+ * @addtogroup PoolHilos
+ * Comprende las funciones del pool de hilos que procesa los mensajes recibidos
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup PoolHilos
+ *
+ * @brief Diferencia en nanosegundos entre dos instantes
+ *
+ * @synopsis
+ * @code
+ * 	long long diferenciaNs(struct timespec *desde, struct timespec *hasta)
+ * @endcode
+ *
+ * @param[in] desde instante inicial
+ * @param[in] hasta instante final
+ *
+ * @return nanosegundos transcurridos
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+long long diferenciaNs(struct timespec *desde, struct timespec *hasta){
+	return (long long)(hasta->tv_sec - desde->tv_sec) * 1000000000LL + (hasta->tv_nsec - desde->tv_nsec);
+}
+
+/**
+ * @ingroup PoolHilos
+ *
+ * @brief Bucle de cada hilo trabajador
+ *
+ * @synopsis
+ * @code
+ * 	void *hiloTrabajador(void *arg)
+ * @endcode
+ *
+ * @param[in] arg el pool al que pertenece el hilo
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+void *hiloTrabajador(void *arg){
+	pThPool pool = (pThPool) arg;
+	pDatosMensaje datos;
+	struct timespec ahora;
+	long long espera;
+
+	while(1){
+
+		pthread_mutex_lock(&pool->mutex);
+		while(pool->num == 0 && pool->activo){
+			pthread_cond_wait(&pool->noVacia, &pool->mutex);
+		}
+
+		/* Pool parado y sin trabajo pendiente */
+		if(pool->num == 0){
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+
+		/* Sacamos trabajo de la cabeza de la cola */
+		datos = pool->cola[pool->cabeza];
+		clock_gettime(CLOCK_MONOTONIC, &ahora);
+		espera = diferenciaNs(&pool->encolado[pool->cabeza], &ahora);
+		pool->cabeza = (pool->cabeza + 1) % pool->capacidad;
+		pool->num--;
+
+		pool->procesados++;
+		pool->esperaTotalNs += espera;
+		if(espera > pool->esperaMaxNs)
+			pool->esperaMaxNs = espera;
+
+		pthread_cond_signal(&pool->noLlena);
+		pthread_mutex_unlock(&pool->mutex);
+
+		manejaMensaje((void *) datos);
+	}
+
+	return NULL;
+}
+
+/**
+ * @ingroup PoolHilos
+ *
+ * @brief Crea el pool y lanza los hilos trabajadores
+ *
+ * @synopsis
+ * @code
+ * 	pThPool crearPool(int nHilos, int capacidad)
+ * @endcode
+ *
+ * @param[in] nHilos numero de hilos trabajadores
+ * @param[in] capacidad numero maximo de trabajos encolados
+ *
+ * @return el pool creado, o NULL en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+pThPool crearPool(int nHilos, int capacidad){
+	pThPool pool;
+	int i;
+
+	if(nHilos <= 0 || capacidad <= 0){
+		return NULL;
+	}
+
+	pool = (pThPool) calloc(1, sizeof(ThPool));
+	if(pool == NULL){
+		return NULL;
+	}
+
+	pool->hilos = (pthread_t *) calloc(nHilos, sizeof(pthread_t));
+	pool->cola = (pDatosMensaje *) calloc(capacidad, sizeof(pDatosMensaje));
+	pool->encolado = (struct timespec *) calloc(capacidad, sizeof(struct timespec));
+	if(!pool->hilos || !pool->cola || !pool->encolado){
+		free(pool->hilos);
+		free(pool->cola);
+		free(pool->encolado);
+		free(pool);
+		return NULL;
+	}
+
+	pool->capacidad = capacidad;
+	pool->activo = 1;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->noVacia, NULL);
+	pthread_cond_init(&pool->noLlena, NULL);
+
+	for(i = 0; i < nHilos; i++){
+		if(pthread_create(&pool->hilos[i], NULL, hiloTrabajador, (void *) pool) != 0){
+			syslog(LOG_ERR, "Error lanzando hilo trabajador %d", i);
+			break;
+		}
+		pool->nHilos++;
+	}
+
+	if(pool->nHilos == 0){
+		destruirPool(pool);
+		return NULL;
+	}
+
+	syslog(LOG_DEBUG, "Pool creado con %d hilos y cola de %d trabajos", pool->nHilos, capacidad);
+
+	return pool;
+}
+
+/**
+ * @ingroup PoolHilos
+ *
+ * @brief Encola un mensaje para que lo procese un trabajador
+ *
+ * Si la cola esta llena el productor se bloquea hasta que haya hueco, de
+ * modo que el bucle de eventos deja de leer y el cliente nota la presion.
+ *
+ * @synopsis
+ * @code
+ * 	status encolarTrabajo(pThPool pool, pDatosMensaje datos)
+ * @endcode
+ *
+ * @param[in] pool el pool
+ * @param[in] datos mensaje a procesar
+ *
+ * @return POOL_OK si todo va bien. POOL_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+status encolarTrabajo(pThPool pool, pDatosMensaje datos){
+	int pos;
+
+	if(pool == NULL || datos == NULL){
+		return POOL_ERROR;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if(pool->num == pool->capacidad){
+		pool->bloqueos++;
+		while(pool->num == pool->capacidad && pool->activo){
+			pthread_cond_wait(&pool->noLlena, &pool->mutex);
+		}
+	}
+
+	if(!pool->activo){
+		pthread_mutex_unlock(&pool->mutex);
+		return POOL_ERROR;
+	}
+
+	pos = (pool->cabeza + pool->num) % pool->capacidad;
+	pool->cola[pos] = datos;
+	clock_gettime(CLOCK_MONOTONIC, &pool->encolado[pos]);
+	pool->num++;
+	pool->encolados++;
+	if(pool->num > pool->maxProfundidad)
+		pool->maxProfundidad = pool->num;
+
+	pthread_cond_signal(&pool->noVacia);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return POOL_OK;
+}
+
+/**
+ * @ingroup PoolHilos
+ *
+ * @brief Copia las estadisticas de la cola del pool
+ *
+ * @synopsis
+ * @code
+ * 	status estadisticasPool(pThPool pool, pEstadisticasPool est)
+ * @endcode
+ *
+ * @param[in] pool el pool
+ * @param[out] est estructura donde se copian las estadisticas
+ *
+ * @return POOL_OK si todo va bien. POOL_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+status estadisticasPool(pThPool pool, pEstadisticasPool est){
+
+	if(pool == NULL || est == NULL){
+		return POOL_ERROR;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	est->hilos = pool->nHilos;
+	est->capacidad = pool->capacidad;
+	est->profundidad = pool->num;
+	est->maxProfundidad = pool->maxProfundidad;
+	est->encolados = pool->encolados;
+	est->procesados = pool->procesados;
+	est->bloqueos = pool->bloqueos;
+	est->esperaMediaUs = pool->procesados ? pool->esperaTotalNs / (long long) pool->procesados / 1000 : 0;
+	est->esperaMaxUs = pool->esperaMaxNs / 1000;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return POOL_OK;
+}
+
+/**
+ * @ingroup PoolHilos
+ *
+ * @brief Para el pool, espera a los trabajadores y libera memoria
+ *
+ * Los trabajos que quedan en la cola se procesan antes de terminar.
+ *
+ * @synopsis
+ * @code
+ * 	void destruirPool(pThPool pool)
+ * @endcode
+ *
+ * @param[in] pool el pool
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+void destruirPool(pThPool pool){
+	int i;
+
+	if(pool == NULL){
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->activo = 0;
+	pthread_cond_broadcast(&pool->noVacia);
+	pthread_cond_broadcast(&pool->noLlena);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for(i = 0; i < pool->nHilos; i++){
+		pthread_join(pool->hilos[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->noVacia);
+	pthread_cond_destroy(&pool->noLlena);
+	free(pool->hilos);
+	free(pool->cola);
+	free(pool->encolado);
+	free(pool);
+}
@@ -0,0 +1,1528 @@
+/**
+ * @file reactor.c
+ * @brief reactores epoll del servidor, uno por hilo
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Reactor Reactor
+ *
+ * <hr>
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include "../includes/reactor.h"
+#include "../includes/funciones_servidor.h"
+#include "../includes/red_servidor.h"
+#include "../includes/pool.h"
+#include "../includes/ssl.h"
+#include "../includes/relevo.h"
+#include "../includes/epocas.h"
+
+#ifdef USE_IO_URING
+#include "../includes/reactor_uring.h"
+#endif
+
+/**
+ * @addtogroup Reactor
+ * Comprende las funciones de los reactores: cada uno tiene su hilo, su
+ * instancia epoll y su socket de escucha, y atiende sus conexiones de
+ * principio a fin
+ *
+ * Cada reactor lleva ademas una rueda de temporizadores que avanza un tick
+ * por segundo con un timerfd, dentro de su propio bucle de eventos. Cada
+ * conexion tiene en ella un temporizador que vigila sus plazos: el de
+ * registro, el de inactividad antes de registrarse y, con -p, el PING a las
+ * conexiones inactivas.
+ *
+ * SIGINT y SIGTERM llegan al reactor 0 por un signalfd y piden una parada
+ * ordenada: los reactores dejan de aceptar y de pasar mensajes al pool,
+ * el ultimo en hacerlo termina el pool, y cada uno avisa a sus clientes y
+ * les da PLAZO_PARADA segundos para vaciar su cola de salida antes de
+ * cerrar. Una segunda sennal para el servidor sin esperar.
+ *
+ * <hr>
+ */
+
+/** Conexion que contiene un temporizador de vigilancia */
+#define CONEXION_VIGILADA(t) ((pConexion) ((char *) (t) - offsetof(Conexion, vigilancia)))
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Crea las instancias epoll del reactor, su eventfd y annade el reloj, el signalfd y el socket de escucha
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarFD(pReactor reactor, int sckt, short propio)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] sckt socket de escucha
+ * @param[in] propio 0 si el socket de escucha se comparte con otros reactores
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarFD(pReactor reactor, int sckt, short propio){
+	struct epoll_event ev;
+
+	reactor->sckt = sckt;
+	reactor->propio = propio;
+
+	reactor->epollFD = epoll_create1(EPOLL_CLOEXEC);
+	if(reactor->epollFD < 0){
+		syslog(LOG_ERR, "Error creando instancia epoll en llamada a epoll_create1()");
+		return REACTOR_ERROR;
+	}
+
+	/* Descriptor con el que otros hilos despiertan al reactor */
+	reactor->eventoFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(reactor->eventoFD < 0){
+		syslog(LOG_ERR, "Error creando eventfd en llamada a eventfd()");
+		close(reactor->epollFD);
+		reactor->epollFD = -1;
+		return REACTOR_ERROR;
+	}
+
+	/* Las esperas de escritura van aparte para no tocar el EPOLLONESHOT de la lectura */
+	reactor->epollSalida = epoll_create1(EPOLL_CLOEXEC);
+	if(reactor->epollSalida < 0){
+		syslog(LOG_ERR, "Error creando instancia epoll de salida en llamada a epoll_create1()");
+		return REACTOR_ERROR;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+
+	/* El socket de escucha, el eventfd y el epoll de salida se quedan siempre armados */
+	ev.data.fd = reactor->eventoFD;
+	if(epoll_ctl(reactor->epollFD, EPOLL_CTL_ADD, reactor->eventoFD, &ev) < 0){
+		syslog(LOG_ERR, "Error n: %d annadiendo eventfd a epoll", errno);
+		return REACTOR_ERROR;
+	}
+
+	ev.data.fd = reactor->epollSalida;
+	if(epoll_ctl(reactor->epollFD, EPOLL_CTL_ADD, reactor->epollSalida, &ev) < 0){
+		syslog(LOG_ERR, "Error n: %d annadiendo epoll de salida a epoll", errno);
+		return REACTOR_ERROR;
+	}
+
+	ev.data.fd = reactor->relojFD;
+	if(epoll_ctl(reactor->epollFD, EPOLL_CTL_ADD, reactor->relojFD, &ev) < 0){
+		syslog(LOG_ERR, "Error n: %d annadiendo reloj a epoll", errno);
+		return REACTOR_ERROR;
+	}
+
+	/* Las sennales de parada solo las atiende el primer reactor */
+	if(reactor->id == 0){
+		ev.data.fd = senalFD;
+		if(epoll_ctl(reactor->epollFD, EPOLL_CTL_ADD, senalFD, &ev) < 0){
+			syslog(LOG_ERR, "Error n: %d annadiendo signalfd a epoll", errno);
+			return REACTOR_ERROR;
+		}
+	}
+
+	/* Si el socket se comparte solo despertamos a uno de los reactores */
+	ev.events = propio ? EPOLLIN : (EPOLLIN | EPOLLEXCLUSIVE);
+	ev.data.fd = sckt;
+	if(epoll_ctl(reactor->epollFD, EPOLL_CTL_ADD, sckt, &ev) < 0){
+		syslog(LOG_ERR, "Error n: %d annadiendo socket de escucha a epoll", errno);
+		return REACTOR_ERROR;
+	}
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Inicializa un reactor con io_uring si se ha pedido, o con epoll
+ *
+ * io_uring necesita un kernel con accept y recv multishot y anillos de
+ * buffers; si no esta disponible o se usa SSL el reactor usa epoll.
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarReactor(pReactor reactor, int sckt, short propio)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] sckt socket de escucha
+ * @param[in] propio 0 si el socket de escucha se comparte con otros reactores
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarReactor(pReactor reactor, int sckt, short propio){
+
+	/* El reloj es el mismo con epoll y con io_uring */
+	if(inicializarReloj(reactor) < 0){
+		return REACTOR_ERROR;
+	}
+
+#ifdef USE_IO_URING
+	if(usarUring && !ssl_active){
+		if(inicializarUring(reactor, sckt, propio) == REACTOR_OK){
+			return REACTOR_OK;
+		}
+		syslog(LOG_WARNING, "io_uring no disponible en el reactor %d, se usa epoll", reactor->id);
+	}
+#endif
+
+	return inicializarFD(reactor, sckt, propio);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Crea la rueda de temporizadores del reactor y el timerfd que la avanza
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarReloj(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarReloj(pReactor reactor){
+	struct itimerspec tick;
+
+	if(inicializarRueda(&reactor->rueda, vigilarConexion) != RUEDA_OK){
+		return REACTOR_ERROR;
+	}
+
+	reactor->relojFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(reactor->relojFD < 0){
+		syslog(LOG_ERR, "Error creando reloj en llamada a timerfd_create()");
+		liberarRueda(&reactor->rueda);
+		return REACTOR_ERROR;
+	}
+
+	memset(&tick, 0, sizeof(tick));
+	tick.it_value.tv_sec = 1;
+	tick.it_interval.tv_sec = 1;
+	if(timerfd_settime(reactor->relojFD, 0, &tick, NULL) < 0){
+		syslog(LOG_ERR, "Error n: %d armando el reloj del reactor %d", errno, reactor->id);
+		close(reactor->relojFD);
+		reactor->relojFD = -1;
+		liberarRueda(&reactor->rueda);
+		return REACTOR_ERROR;
+	}
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Avanza la rueda del reactor los ticks que han pasado desde la ultima vez
+ *
+ * Si el reactor se ha retrasado el timerfd acumula los ticks, y la rueda
+ * los recupera todos de una vez. Las conexiones que caducan en la llamada
+ * forman un lote que se anota de una vez en el log y en los contadores.
+ * Durante la parada cada tick cierra ademas las conexiones ya vaciadas, y
+ * en el primer reactor vence el plazo del nuevo binario de un relevo.
+ *
+ * @synopsis
+ * @code
+ * 	void avanzarReloj(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void avanzarReloj(pReactor reactor){
+	uint64_t ticks;
+
+	if(read(reactor->relojFD, &ticks, sizeof(ticks)) != sizeof(ticks)){
+		return;
+	}
+
+	avanzarRueda(&reactor->rueda, ticks);
+
+	/* Sin cambios en los canales nadie mas recoge los descriptores retirados */
+	if(reactor->id == 0 && __atomic_load_n(&pendientesEpoca, __ATOMIC_RELAXED) > 0){
+		recogerEpoca();
+	}
+
+	/* El nuevo binario no ha avisado a tiempo */
+	if(reactor->id == 0 && socketRelevo >= 0 && !relevoPedido && reactor->rueda.ahora >= reactor->plazoRelevo){
+		epoll_ctl(reactor->epollFD, EPOLL_CTL_DEL, socketRelevo, NULL);
+		abandonarRelevo();
+	}
+
+	if(reactor->parada == PARADA_VACIANDO){
+		vaciarConexiones(reactor);
+	}
+
+	if(reactor->lote == 0){
+		return;
+	}
+
+	syslog(LOG_INFO, "Reactor %d: cerradas %d conexiones caducadas (registro=%d inactividad=%d ping=%d)",
+		reactor->id, reactor->lote, reactor->caducadas[CADUCA_REGISTRO],
+		reactor->caducadas[CADUCA_INACTIVIDAD], reactor->caducadas[CADUCA_PING]);
+
+	__sync_fetch_and_add(&caducadasRegistro, reactor->caducadas[CADUCA_REGISTRO]);
+	__sync_fetch_and_add(&caducadasInactividad, reactor->caducadas[CADUCA_INACTIVIDAD]);
+	__sync_fetch_and_add(&caidasPing, reactor->caducadas[CADUCA_PING]);
+	__sync_fetch_and_add(&lotesCaducadas, 1);
+
+	memset(reactor->caducadas, 0, sizeof(reactor->caducadas));
+	reactor->lote = 0;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Devuelve el primer tick en el que hay que mirar una conexion recien aceptada
+ *
+ * @synopsis
+ * @code
+ * 	unsigned long primeraVigilancia(unsigned long ahora)
+ * @endcode
+ *
+ * @param[in] ahora tick en el que se acepta
+ *
+ * @return el tick, 0 si la conexion no se vigila
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+unsigned long primeraVigilancia(unsigned long ahora){
+	unsigned long plazo = 0;
+
+	if(plazoRegistro > 0){
+		plazo = plazoRegistro;
+	}
+	if(inactividadRegistro > 0 && (plazo == 0 || (unsigned long) inactividadRegistro < plazo)){
+		plazo = inactividadRegistro;
+	}
+	if(pingActivo && (plazo == 0 || ESPERA_PING < plazo)){
+		plazo = ESPERA_PING;
+	}
+
+	return plazo ? ahora + plazo : 0;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Cierra una conexion caducada como parte del lote de su reactor
+ *
+ * La conexion no se cierra aqui, porque puede tener un mensaje en un
+ * trabajador: se le manda un ERROR y se cierra el socket para lectura, y el
+ * reactor ve el fin de la conexion y la cierra en su hilo, como con las
+ * expulsiones de la cola de salida. Si el lote esta lleno el cierre se deja
+ * para el siguiente tick, para no parar el bucle de eventos cuando caducan
+ * muchas a la vez.
+ *
+ * @synopsis
+ * @code
+ * 	unsigned long caducarConexion(pConexion conexion, int motivo, unsigned long ahora)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ * @param[in] motivo CADUCA_REGISTRO, CADUCA_INACTIVIDAD o CADUCA_PING
+ * @param[in] ahora tick actual
+ *
+ * @return 0 si se cierra, o el tick en el que volver a intentarlo
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+unsigned long caducarConexion(pConexion conexion, int motivo, unsigned long ahora){
+	pReactor reactor = conexion->reactor;
+
+	if(reactor->lote >= LOTE_CADUCADAS){
+		__sync_fetch_and_add(&aplazadasCaducadas, 1);
+		return ahora + 1;
+	}
+	reactor->lote++;
+	reactor->caducadas[motivo]++;
+
+	switch(motivo){
+		case CADUCA_REGISTRO:
+			encolarSalida(conexion, MENSAJE_CADUCA_REGISTRO, sizeof(MENSAJE_CADUCA_REGISTRO) - 1);
+			break;
+		case CADUCA_INACTIVIDAD:
+			encolarSalida(conexion, MENSAJE_CADUCA_INACTIVIDAD, sizeof(MENSAJE_CADUCA_INACTIVIDAD) - 1);
+			break;
+		default:
+			encolarSalida(conexion, MENSAJE_CAIDA_PING, sizeof(MENSAJE_CAIDA_PING) - 1);
+			break;
+	}
+
+	/* A medias del handshake puede estar esperando para escribir, no para leer */
+	shutdown(conexion->fd, conexion->handshake ? SHUT_RDWR : SHUT_RD);
+
+	return 0;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Disparo del temporizador de una conexion
+ *
+ * Mientras no se registra la conexion tiene plazoRegistro segundos desde
+ * que se acepta y no puede pasar inactividadRegistro segundos sin enviar
+ * nada. Con -p ademas se le manda PING tras ESPERA_PING segundos sin enviar
+ * nada y se cierra si en PLAZO_PONG segundos mas sigue sin enviar nada. Una
+ * conexion registrada sin -p deja de vigilarse.
+ *
+ * Se llama desde el hilo del reactor con el mutex de la rueda cogido.
+ *
+ * @synopsis
+ * @code
+ * 	unsigned long vigilarConexion(pTemporizador temporizador, unsigned long ahora)
+ * @endcode
+ *
+ * @param[in] temporizador el temporizador de vigilancia de la conexion
+ * @param[in] ahora tick actual
+ *
+ * @return el tick en el que volver a mirar la conexion, 0 si no hace falta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+unsigned long vigilarConexion(pTemporizador temporizador, unsigned long ahora){
+	pConexion conexion = CONEXION_VIGILADA(temporizador);
+	unsigned long siguiente = 0, vence;
+	short registrada;
+
+	pthread_mutex_lock(&conexion->mutex);
+	registrada = conexion->sesion != NULL;
+	pthread_mutex_unlock(&conexion->mutex);
+
+	if(!registrada){
+		if(plazoRegistro > 0){
+			if(ahora - conexion->aceptada >= (unsigned long) plazoRegistro){
+				return caducarConexion(conexion, CADUCA_REGISTRO, ahora);
+			}
+			siguiente = conexion->aceptada + plazoRegistro;
+		}
+
+		if(inactividadRegistro > 0){
+			if(ahora - conexion->actividad >= (unsigned long) inactividadRegistro){
+				return caducarConexion(conexion, CADUCA_INACTIVIDAD, ahora);
+			}
+			vence = conexion->actividad + inactividadRegistro;
+			if(siguiente == 0 || vence < siguiente){
+				siguiente = vence;
+			}
+		}
+	}
+
+	if(!pingActivo){
+		return siguiente;
+	}
+
+	/* Lo que haya enviado despues del PING cuenta como respuesta */
+	if(conexion->ping && conexion->actividad >= conexion->ping){
+		conexion->ping = 0;
+	}
+
+	if(conexion->ping){
+		if(ahora - conexion->ping >= PLAZO_PONG){
+			return caducarConexion(conexion, CADUCA_PING, ahora);
+		}
+	} else if(ahora - conexion->actividad >= ESPERA_PING){
+		conexion->ping = ahora;
+		__sync_fetch_and_add(&pingsEnviados, 1);
+		encolarSalida(conexion, MENSAJE_PING, sizeof(MENSAJE_PING) - 1);
+	}
+
+	vence = conexion->ping ? conexion->ping + PLAZO_PONG : conexion->actividad + ESPERA_PING;
+	if(siguiente == 0 || vence < siguiente){
+		siguiente = vence;
+	}
+
+	return siguiente;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Annade una conexion al epoll de su reactor
+ *
+ * La conexion se registra con EPOLLONESHOT: tras notificar un evento queda
+ * desarmada hasta que el trabajador que procesa el mensaje llama a rearmarFd.
+ * Se programa ademas su temporizador de vigilancia. Se llama desde el hilo
+ * del reactor.
+ *
+ * @synopsis
+ * @code
+ * 	status addFd(int sckt)
+ * @endcode
+ *
+ * @param[in] sckt el socket, ya registrado en la tabla de conexiones
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status addFd(int sckt){
+	struct epoll_event ev;
+	pConexion conexion;
+	unsigned long vence;
+
+	conexion = obtenerConexion(sckt);
+	if(conexion == NULL || conexion->reactor == NULL){
+		return REACTOR_ERROR;
+	}
+
+	/* La vigilancia empieza contando desde que se acepta */
+	conexion->aceptada = conexion->reactor->rueda.ahora;
+	conexion->actividad = conexion->aceptada;
+	conexion->ping = 0;
+	vence = primeraVigilancia(conexion->aceptada);
+	if(vence){
+		programarTemporizador(&conexion->reactor->rueda, &conexion->vigilancia, vence);
+	}
+
+#ifdef USE_IO_URING
+	if(conexion->reactor->anillo){
+		return addFdUring(conexion->reactor, sckt);
+	}
+#endif
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.fd = sckt;
+
+	if(epoll_ctl(conexion->reactor->epollFD, EPOLL_CTL_ADD, sckt, &ev) < 0){
+		syslog(LOG_ERR, "Error n: %d annadiendo el socket %d a epoll", errno, sckt);
+		return REACTOR_ERROR;
+	}
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Vuelve a armar una conexion tras procesar su mensaje
+ *
+ * epoll_ctl es seguro entre hilos y surte efecto aunque el reactor este
+ * bloqueado en epoll_wait, por lo que no hace falta despertarlo.
+ *
+ * @synopsis
+ * @code
+ * 	status rearmarFd(int sckt)
+ * @endcode
+ *
+ * @param[in] sckt el socket
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status rearmarFd(int sckt){
+	struct epoll_event ev;
+	pConexion conexion;
+
+	conexion = obtenerConexion(sckt);
+	if(conexion == NULL || conexion->reactor == NULL){
+		return REACTOR_ERROR;
+	}
+
+#ifdef USE_IO_URING
+	/* El reactor entrega el siguiente mensaje que haya recibido */
+	if(conexion->reactor->anillo){
+		return rearmarUring(conexion->reactor, sckt);
+	}
+#endif
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.fd = sckt;
+
+	if(epoll_ctl(conexion->reactor->epollFD, EPOLL_CTL_MOD, sckt, &ev) < 0){
+		syslog(LOG_DEBUG, "Error n: %d rearmando el socket %d", errno, sckt);
+		return REACTOR_ERROR;
+	}
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Pide al reactor que avise cuando una conexion admita escritura
+ *
+ * La conexion se arma con EPOLLONESHOT en el epoll de salida; cuando el
+ * socket admite escritura el reactor envia su cola de salida.
+ *
+ * @synopsis
+ * @code
+ * 	status armarEscritura(int sckt)
+ * @endcode
+ *
+ * @param[in] sckt el socket
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status armarEscritura(int sckt){
+	struct epoll_event ev;
+	pConexion conexion;
+
+	conexion = obtenerConexion(sckt);
+	if(conexion == NULL || conexion->reactor == NULL){
+		return REACTOR_ERROR;
+	}
+
+#ifdef USE_IO_URING
+	if(conexion->reactor->anillo){
+		return avisarReactorUring(conexion->reactor, sckt, AVISO_ESCRIBIR);
+	}
+#endif
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLOUT | EPOLLONESHOT;
+	ev.data.fd = sckt;
+
+	/* La primera espera de cada conexion la annade, las siguientes la rearman */
+	if(epoll_ctl(conexion->reactor->epollSalida, EPOLL_CTL_MOD, sckt, &ev) < 0){
+		if(errno != ENOENT || epoll_ctl(conexion->reactor->epollSalida, EPOLL_CTL_ADD, sckt, &ev) < 0){
+			syslog(LOG_ERR, "Error n: %d armando escritura del socket %d", errno, sckt);
+			return REACTOR_ERROR;
+		}
+	}
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Elimina una conexion del epoll y de la rueda de su reactor
+ *
+ * @synopsis
+ * @code
+ * 	status deleteFd(int sckt)
+ * @endcode
+ *
+ * @param[in] sckt el socket
+ *
+ * @return REACTOR_OK
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status deleteFd(int sckt){
+	pConexion conexion;
+
+	conexion = obtenerConexion(sckt);
+	if(conexion == NULL || conexion->reactor == NULL){
+		return REACTOR_OK;
+	}
+
+	/* Al volver el temporizador no se esta disparando y la entrada se puede reutilizar */
+	cancelarTemporizador(&conexion->reactor->rueda, &conexion->vigilancia);
+
+#ifdef USE_IO_URING
+	/* El reactor cancela la recepcion y descarta los mensajes pendientes */
+	if(conexion->reactor->anillo){
+		return avisarReactorUring(conexion->reactor, sckt, AVISO_CERRAR);
+	}
+#endif
+
+	/* Si el socket ya se cerro epoll lo ha eliminado, ignoramos el error */
+	epoll_ctl(conexion->reactor->epollFD, EPOLL_CTL_DEL, sckt, NULL);
+	epoll_ctl(conexion->reactor->epollSalida, EPOLL_CTL_DEL, sckt, NULL);
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Despierta a todos los reactores desde otro hilo
+ *
+ * @synopsis
+ * @code
+ * 	void despertarServidor(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void despertarServidor(void){
+	uint64_t uno = 1;
+	int i;
+
+	for(i = 0; reactores && i < numReactores; i++){
+		if(write(reactores[i].eventoFD, &uno, sizeof(uno)) < 0 && errno != EAGAIN){
+			syslog(LOG_WARNING, "Error n: %d despertando al reactor %d", errno, i);
+		}
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Pide a los reactores que terminen
+ *
+ * @synopsis
+ * @code
+ * 	void pararServidor(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void pararServidor(void){
+	running = 0;
+	despertarServidor();
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Pide a los reactores una parada ordenada
+ *
+ * @synopsis
+ * @code
+ * 	void pedirParada(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void pedirParada(void){
+	if(__sync_bool_compare_and_swap(&estadoParada, PARADA_NO, PARADA_PEDIDA)){
+		despertarServidor();
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Vigila el extremo del relevo en el epoll del reactor
+ *
+ * El reactor sigue atendiendo sus conexiones mientras arranca el nuevo
+ * binario; si no avisa en PLAZO_RELEVO segundos lo abandona avanzarReloj.
+ *
+ * @synopsis
+ * @code
+ * 	void vigilarRelevo(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor, el primero
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void vigilarRelevo(pReactor reactor){
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = socketRelevo;
+
+	if(epoll_ctl(reactor->epollFD, EPOLL_CTL_ADD, socketRelevo, &ev) < 0){
+		syslog(LOG_ERR, "Error n: %d annadiendo el extremo del relevo a epoll", errno);
+		abandonarRelevo();
+		return;
+	}
+
+	reactor->plazoRelevo = reactor->rueda.ahora + PLAZO_RELEVO;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Atiende el aviso del nuevo binario y, si esta listo, pide la parada para el relevo
+ *
+ * Si mientras tanto se ha pedido una parada normal el relevo se abandona
+ * y las conexiones se vacian como siempre.
+ *
+ * @synopsis
+ * @code
+ * 	void atenderRelevo(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor, el primero
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void atenderRelevo(pReactor reactor){
+
+	epoll_ctl(reactor->epollFD, EPOLL_CTL_DEL, socketRelevo, NULL);
+
+	if(estadoParada != PARADA_NO){
+		abandonarRelevo();
+	} else if(confirmarRelevo() == RELEVO_OK){
+		relevoPedido = 1;
+		pedirParada();
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Lee las sennales pendientes del signalfd y actua sobre ellas
+ *
+ * La primera pide la parada ordenada; si llega otra mientras tanto se
+ * para sin esperar a que se vacien las colas. SIGUSR2 lanza el nuevo
+ * binario y vigila su aviso; la parada para pasarle las conexiones se
+ * pide al recibirlo, en atenderRelevo.
+ *
+ * @synopsis
+ * @code
+ * 	void atenderSenal(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void atenderSenal(void){
+	struct signalfd_siginfo info;
+
+	while(read(senalFD, &info, sizeof(info)) == sizeof(info)){
+		if(info.ssi_signo == SIGUSR2){
+			if(ssl_active || reactores[0].anillo != NULL || estadoParada != PARADA_NO || socketRelevo >= 0){
+				syslog(LOG_WARNING, "Relevo del binario no disponible con SSL, io_uring, durante la parada o con otro en marcha");
+			} else if(lanzarRelevo() == RELEVO_OK){
+				vigilarRelevo(&reactores[0]);
+			}
+		} else if(estadoParada == PARADA_NO){
+			syslog(LOG_INFO, "Recibida sennal %u, parando el servidor", info.ssi_signo);
+			pedirParada();
+		} else {
+			syslog(LOG_INFO, "Recibida sennal %u durante la parada, se cierra sin vaciar las colas", info.ssi_signo);
+			pararServidor();
+		}
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Deja de atender el socket de escucha del reactor
+ *
+ * El socket se cierra con el resto al terminar el reactor; hasta entonces
+ * el kernel puede seguir completando conexiones en su cola, que nadie
+ * acepta.
+ *
+ * @synopsis
+ * @code
+ * 	void dejarDeAceptar(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void dejarDeAceptar(pReactor reactor){
+
+#ifdef USE_IO_URING
+	if(reactor->anillo){
+		dejarDeAceptarUring(reactor);
+		return;
+	}
+#endif
+
+	epoll_ctl(reactor->epollFD, EPOLL_CTL_DEL, reactor->sckt, NULL);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Encola el aviso de parada en todas las conexiones del reactor
+ *
+ * Como todos los usuarios se van a la vez no se reparten QUIT entre
+ * vecinos; cada cliente recibe solo su ERROR.
+ *
+ * @synopsis
+ * @code
+ * 	void avisarParada(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void avisarParada(pReactor reactor){
+	int i;
+
+	for(i = 0; i < maxConexiones; i++){
+		if(tablaConexiones[i].fd == i && tablaConexiones[i].reactor == reactor){
+			encolarSalida(&tablaConexiones[i], MENSAJE_PARADA, sizeof(MENSAJE_PARADA) - 1);
+		}
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Cierra las conexiones del reactor que ya han vaciado su cola de salida
+ *
+ * Pasado el plazo de la parada se cierran todas, se haya enviado lo
+ * pendiente o no.
+ *
+ * @synopsis
+ * @code
+ * 	int vaciarConexiones(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @return conexiones que siguen abiertas
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int vaciarConexiones(pReactor reactor){
+	int i, quedan = 0, cerradas = 0, sinVaciar = 0;
+	short pendiente, vencido;
+	pConexion conexion;
+
+	vencido = reactor->rueda.ahora >= reactor->plazoParada;
+
+	for(i = 0; i < maxConexiones; i++){
+		conexion = &tablaConexiones[i];
+		if(conexion->fd != i || conexion->reactor != reactor){
+			continue;
+		}
+
+		pthread_mutex_lock(&conexion->mutex);
+		pendiente = conexion->salida.bytes > 0 && !conexion->salida.error && !conexion->handshake;
+		pthread_mutex_unlock(&conexion->mutex);
+
+		if(pendiente && !vencido){
+			quedan++;
+			continue;
+		}
+
+		if(pendiente){
+			sinVaciar++;
+		}
+		cerrarConexion(i);
+		cerradas++;
+	}
+
+	if(cerradas > 0){
+		syslog(LOG_INFO, "Reactor %d: cerradas %d conexiones por la parada (%d sin vaciar su cola), quedan %d",
+			reactor->id, cerradas, sinVaciar, quedan);
+	}
+
+	if(quedan == 0){
+		reactor->parada = PARADA_TERMINADA;
+	}
+
+	return quedan;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Lleva al reactor a la fase de parada en la que esta el servidor
+ *
+ * Cuando todos los reactores han dejado de pasar mensajes, el ultimo
+ * termina el pool; los trabajos que quedaban en su cola se procesan y sus
+ * respuestas se encolan antes que el aviso de parada.
+ *
+ * @synopsis
+ * @code
+ * 	void avanzarParada(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void avanzarParada(pReactor reactor){
+
+	if(reactor->parada == PARADA_NO && estadoParada >= PARADA_PEDIDA){
+		dejarDeAceptar(reactor);
+		reactor->parada = PARADA_PEDIDA;
+
+		if(__sync_add_and_fetch(&reactoresParados, 1) == numReactores){
+			destruirPool(thpool);
+			thpool = NULL;
+			estadoParada = PARADA_VACIANDO;
+			despertarServidor();
+		}
+	}
+
+	/* En un relevo las conexiones siguen abiertas para el nuevo proceso */
+	if(reactor->parada == PARADA_PEDIDA && estadoParada >= PARADA_VACIANDO && relevoPedido){
+		reactor->parada = PARADA_TERMINADA;
+		return;
+	}
+
+	if(reactor->parada == PARADA_PEDIDA && estadoParada >= PARADA_VACIANDO){
+		reactor->parada = PARADA_VACIANDO;
+		reactor->plazoParada = reactor->rueda.ahora + PLAZO_PARADA;
+		avisarParada(reactor);
+		vaciarConexiones(reactor);
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Acepta todas las conexiones pendientes del socket de escucha
+ *
+ * Cuando muchos clientes reconectan a la vez aceptar una sola conexion por
+ * evento deja la cola de escucha llena; se acepta hasta que accept4
+ * devuelve EAGAIN. Con SSL la conexion se registra sin esperar al handshake,
+ * que avanza con avanzarHandshake.
+ *
+ * @synopsis
+ * @code
+ * 	void aceptarConexiones(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void aceptarConexiones(pReactor reactor){
+	struct sockaddr_in address;
+	int desc;
+
+	while(running){
+
+		/* Aceptamos conexion, otro reactor puede habernosla quitado */
+		if(aceptarConexionNoBloqueante(reactor->sckt, &desc, &address)  < 0){
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				syslog(LOG_WARNING, "No se ha podido procesar nueva conexion");
+			return;
+		}
+
+		/* La conexion pertenece a este reactor hasta que se cierre */
+		if(registrarConexion(desc, reactor) < 0){
+			close(desc);
+			continue;
+		}
+
+		/* El handshake del canal seguro lo avanza el bucle de eventos */
+		if(ssl_active){
+			if(iniciar_canal_seguro_SSL(desc) < 0){
+				cerrar_canal_SSL(desc);
+				liberarConexion(desc);
+				close(desc);
+				syslog(LOG_ERR, "Error aceptando canal seguro");
+				continue;
+			}
+			obtenerConexion(desc)->handshake = 1;
+		}
+
+		/* Creamos nueva conexion, su vigilancia cuenta desde ya aunque el handshake no acabe */
+		if(nuevaConexion(desc, &address) < 0){
+			syslog(LOG_WARNING, "Error en llamada a nuevaConexion()");
+		}
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Avanza el handshake SSL de una conexion cuando su socket esta listo
+ *
+ * Segun lo que pida SSL_accept la conexion se arma para lectura o para
+ * escritura; al terminar se envia lo que se encolo mientras tanto y la
+ * conexion pasa a leer mensajes. Un handshake que no termina caduca con la
+ * vigilancia del registro, que empieza al aceptar. Se llama desde el hilo
+ * del reactor.
+ *
+ * @synopsis
+ * @code
+ * 	void avanzarHandshake(pConexion conexion)
+ * @endcode
+ *
+ * @param[in] conexion la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void avanzarHandshake(pConexion conexion){
+	int fd = conexion->fd, ret;
+
+	/* Los trabajadores consultan el estado con el mutex para decidir si escriben */
+	pthread_mutex_lock(&conexion->mutex);
+	ret = avanzar_handshake_SSL(fd);
+	if(ret == SSL_OK){
+		conexion->handshake = 0;
+	}
+	pthread_mutex_unlock(&conexion->mutex);
+
+	switch(ret){
+		case SSL_OK:
+			enviarPendiente(conexion);
+			rearmarFd(fd);
+			break;
+		case SSL_LEER:
+			rearmarFd(fd);
+			break;
+		case SSL_ESCRIBIR:
+			armarEscritura(fd);
+			break;
+		default:
+			syslog(LOG_ERR, "Error aceptando canal seguro en el socket %d", fd);
+			cerrarConexion(fd);
+			break;
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Bucle de eventos de un reactor, comun a los servidores con y sin SSL
+ *
+ * @synopsis
+ * @code
+ * 	void *bucleReactor(void *arg)
+ * @endcode
+ *
+ * @param[in] arg el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void *bucleReactor(void *arg){
+
+	pReactor reactor = (pReactor) arg;
+	int i, j, fd, nfds, nsal;
+	ssize_t tam;
+	uint64_t avisos;
+	struct epoll_event eventos[MAX_EVENTOS];
+	struct epoll_event salidas[MAX_EVENTOS];
+	pDatosMensaje datos;
+	pConexion conexion;
+	char *msg;
+	size_t len;
+	char lectura[TAM_LECTURA];
+
+#ifdef USE_IO_URING
+	if(reactor->anillo){
+		return bucleReactorUring(arg);
+	}
+#endif
+
+	while(running && reactor->parada != PARADA_TERMINADA){
+
+		/* LLamada epoll bloqueante, solo devuelve descriptores listos */
+		nfds = epoll_wait(reactor->epollFD, eventos, MAX_EVENTOS, -1);
+
+		if(nfds < 0) {
+			/* Informacion de debugeo */
+			syslog(LOG_DEBUG, "epoll_wait interrumpido por recepcion de signal");
+			continue;
+		}
+
+		/* Bucle para procesar sockets listos */
+		for (i = 0; i < nfds; ++i){
+
+			fd = eventos[i].data.fd;
+
+			/* Caso aviso de otro hilo, vaciamos el contador */
+			if (fd == reactor->eventoFD){
+				while(read(reactor->eventoFD, &avisos, sizeof(avisos)) > 0);
+				continue;
+			}
+
+			/* Caso tick del reloj, avanzamos la rueda de temporizadores */
+			if (fd == reactor->relojFD){
+				avanzarReloj(reactor);
+				continue;
+			}
+
+			/* Caso SIGINT o SIGTERM, solo en el primer reactor */
+			if (reactor->id == 0 && fd == senalFD){
+				atenderSenal();
+				continue;
+			}
+
+			/* Caso aviso del nuevo binario tras SIGUSR2, solo en el primer reactor */
+			if (reactor->id == 0 && fd == socketRelevo){
+				atenderRelevo(reactor);
+				continue;
+			}
+
+			/* Caso conexiones que admiten escritura, enviamos sus colas de salida */
+			if (fd == reactor->epollSalida){
+				nsal = epoll_wait(reactor->epollSalida, salidas, MAX_EVENTOS, 0);
+				for(j = 0; j < nsal; j++){
+					conexion = obtenerConexion(salidas[j].data.fd);
+					if(conexion != NULL && conexion->handshake){
+						avanzarHandshake(conexion);
+					} else if(conexion != NULL){
+						enviarPendiente(conexion);
+					}
+				}
+				continue;
+			}
+
+			/* Caso conexion nueva */
+			if (fd == reactor->sckt){
+
+				aceptarConexiones(reactor);
+
+			/* Caso ya aceptado */
+			} else {
+
+				/* Parando ya no hay pool, la conexion se queda desarmada hasta cerrarla */
+				if(reactor->parada != PARADA_NO){
+					continue;
+				}
+
+				conexion = obtenerConexion(fd);
+				if(conexion == NULL){
+					continue;
+				}
+
+				if(conexion->handshake){
+					avanzarHandshake(conexion);
+					continue;
+				}
+
+				if(ssl_active){
+					/* El objeto SSL se comparte con los trabajadores que escriben */
+					pthread_mutex_lock(&conexion->mutex);
+					tam = recibir_datos_SSL(fd, lectura, TAM_LECTURA);
+					if(tam <= 0 && reintentar_SSL(fd, tam)){
+						tam = -1;
+						errno = EAGAIN;
+					}
+					pthread_mutex_unlock(&conexion->mutex);
+				} else {
+					tam = recv(fd, (void*) lectura, TAM_LECTURA, 0);
+				}
+
+				if(tam < 0){
+					if(errno == EINTR || errno == EAGAIN){
+						rearmarFd(fd);
+						continue;
+					}
+					/* Con epoll un socket con error seguiria listo siempre, lo cerramos */
+					syslog(LOG_ERR, "Error n: %d al recibir mensaje del socket %d", errno, fd);
+					cerrarConexion(fd);
+					continue;
+
+				} else if(tam == 0){ /* Caso socket cerrado */
+					cerrarConexion(fd);
+					continue;
+				}
+
+				conexion->actividad = reactor->rueda.ahora;
+
+				/* Solo pasamos lineas completas, el resto espera a la siguiente lectura */
+				msg = ensamblarLineas(&conexion->entrada, lectura, tam, &len);
+				if(msg == NULL){
+					rearmarFd(fd);
+					continue;
+				}
+
+				/* Empaquetamos el mensaje */
+				datos = crearDatosMensaje(fd, msg, len);
+				if(datos == NULL){
+					syslog(LOG_ERR, "Error reservando memoria para datos");
+					rearmarFd(fd);
+					continue;
+				}
+
+				/* Pasamos el mensaje al pool, se bloquea si la cola esta llena */
+				if (encolarTrabajo(thpool, datos) < 0) {
+					liberaDatosMensaje(datos);
+					syslog(LOG_WARNING, "Error encolando mensaje en el pool de hilos");
+					rearmarFd(fd);
+				}
+			}
+		}
+
+		if(estadoParada > reactor->parada){
+			avanzarParada(reactor);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Relanza los reactores para vaciar las conexiones que no ha tomado el nuevo binario
+ *
+ * Los reactores han terminado sin cerrar nada para pasar las conexiones;
+ * si el relevo falla vuelven a la parada en el punto en que la dejaron y
+ * siguen el camino normal: cada cliente recibe el aviso de parada y se
+ * cierra al vaciar su cola o al vencer PLAZO_PARADA.
+ *
+ * @synopsis
+ * @code
+ * 	void vaciarTrasRelevo(int lanzados)
+ * @endcode
+ *
+ * @param[in] lanzados numero de reactores que estaban en marcha
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void vaciarTrasRelevo(int lanzados){
+	int i, relanzados = 0;
+
+	syslog(LOG_ERR, "El relevo ha fallado, se cierran las conexiones como en una parada normal");
+	relevoPedido = 0;
+
+	for(i = 0; i < lanzados; i++){
+		reactores[i].parada = PARADA_PEDIDA;
+	}
+	despertarServidor();
+
+	for(i = 0; i < lanzados; i++){
+		if(pthread_create(&reactores[i].hilo, NULL, bucleReactor, (void *) &reactores[i]) != 0){
+			syslog(LOG_ERR, "Error relanzando hilo del reactor %d, sus clientes se pierden", i);
+			break;
+		}
+		relanzados++;
+	}
+
+	for(i = 0; i < relanzados; i++){
+		pthread_join(reactores[i].hilo, NULL);
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Crea los reactores con sus sockets de escucha y espera a que terminen
+ *
+ * Cada reactor abre su propio socket de escucha con SO_REUSEPORT, de modo
+ * que el kernel reparte las conexiones entrantes entre ellos. Si el sistema
+ * no lo permite, los reactores comparten el socket del primero.
+ *
+ * @synopsis
+ * @code
+ * 	status lanzarReactores(unsigned int puerto, short pingpong)
+ * @endcode
+ *
+ * @param[in] puerto puerto para el que crear los sockets
+ * @param[in] pingpong para mandar PING a las conexiones inactivas
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status lanzarReactores(unsigned int puerto, short pingpong){
+	int i, sckt, inicializados = 0, lanzados = 0;
+	short propio;
+
+	if(numReactores <= 0){
+		numReactores = DEFAULT_REACTORES;
+	}
+
+#ifndef USE_IO_URING
+	if(usarUring){
+		syslog(LOG_WARNING, "Servidor compilado sin io_uring (make IO_URING=1), se usa epoll");
+	}
+#endif
+
+	reactores = (pReactor) calloc(numReactores, sizeof(Reactor));
+	if(reactores == NULL){
+		syslog(LOG_ERR, "Error reservando memoria para los reactores");
+		return REACTOR_ERROR;
+	}
+
+	for(i = 0; i < numReactores; i++){
+		reactores[i].id = i;
+		reactores[i].epollFD = -1;
+		reactores[i].eventoFD = -1;
+		reactores[i].epollSalida = -1;
+		reactores[i].relojFD = -1;
+	}
+
+	pingActivo = pingpong;
+	estadoParada = PARADA_NO;
+	reactoresParados = 0;
+	running = 1;
+
+	for(i = 0; i < numReactores; i++){
+
+		/* Socket propio por reactor, o el del primero si no hay SO_REUSEPORT */
+		propio = 1;
+		if((sckt = escuchaRelevo(i)) >= 0){
+			syslog(LOG_INFO, "El reactor %d usa el socket de escucha heredado", i);
+		} else if(crearSocketTCPCompartido(&sckt, puerto) < 0){
+			if(i == 0){
+				break;
+			}
+			syslog(LOG_WARNING, "Sin SO_REUSEPORT, el reactor %d comparte socket de escucha", i);
+			sckt = reactores[0].sckt;
+			propio = 0;
+		}
+
+		/* El accept no debe bloquear si otro reactor se adelanta */
+		fcntl(sckt, F_SETFL, fcntl(sckt, F_GETFL, 0) | O_NONBLOCK);
+
+		if(inicializarReactor(&reactores[i], sckt, propio) < 0){
+			if(propio) close(sckt);
+			reactores[i].propio = 0;
+			break;
+		}
+		inicializados++;
+	}
+
+	/* Los clientes del proceso anterior, antes de que nadie nuevo pueda coger sus nicks o sus canales */
+	if(relevo != NULL && restaurarRelevo(inicializados) != RELEVO_OK){
+		liberarRelevo();
+	}
+
+	for(i = 0; i < inicializados; i++){
+		if(pthread_create(&reactores[i].hilo, NULL, bucleReactor, (void *) &reactores[i]) != 0){
+			syslog(LOG_ERR, "Error lanzando hilo del reactor %d", i);
+			break;
+		}
+		lanzados++;
+	}
+
+	/* Si alguno ha fallado paramos los que ya estaban en marcha */
+	if(lanzados < numReactores){
+		pararServidor();
+	}
+
+	syslog(LOG_INFO, "Lanzados %d reactores en el puerto %u", lanzados, puerto);
+
+	/* Esperamos a que terminen los reactores */
+	for(i = 0; i < lanzados; i++){
+		pthread_join(reactores[i].hilo, NULL);
+	}
+
+	/* Se pasan los sockets antes de cerrar los de escucha */
+	if(relevoPedido && entregarRelevo() != RELEVO_OK){
+		vaciarTrasRelevo(lanzados);
+	} else if(socketRelevo >= 0){
+		abandonarRelevo();
+	}
+
+	for(i = 0; i < numReactores; i++){
+#ifdef USE_IO_URING
+		liberarUring(&reactores[i]);
+#endif
+		if(reactores[i].propio) close(reactores[i].sckt);
+		if(reactores[i].eventoFD >= 0) close(reactores[i].eventoFD);
+		if(reactores[i].epollSalida >= 0) close(reactores[i].epollSalida);
+		if(reactores[i].epollFD >= 0) close(reactores[i].epollFD);
+		if(reactores[i].relojFD >= 0){
+			close(reactores[i].relojFD);
+			liberarRueda(&reactores[i].rueda);
+		}
+	}
+
+	free(reactores);
+	reactores = NULL;
+
+	return lanzados == numReactores ? REACTOR_OK : REACTOR_ERROR;
+}
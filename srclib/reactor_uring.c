@@ -0,0 +1,1188 @@
+/**
+ * @file reactor_uring.c
+ * @brief reactores del servidor sobre io_uring (compilar con make IO_URING=1)
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "../includes/reactor_uring.h"
+#include "../includes/pool.h"
+
+/**
+ * @addtogroup Reactor
+ * Los reactores io_uring aceptan con accept multishot y reciben con recv
+ * multishot sobre un anillo de buffers, de modo que una sola peticion sirve
+ * para todos los mensajes de una conexion. Como el kernel sigue recibiendo
+ * mientras un trabajador procesa el mensaje anterior, el reactor guarda los
+ * siguientes y los entrega en orden cuando el trabajador rearma la conexion.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Obtiene una entrada libre de la cola de envio del anillo
+ *
+ * @synopsis
+ * @code
+ * 	struct io_uring_sqe *obtenerSqe(pAnillo anillo)
+ * @endcode
+ *
+ * @param[in] anillo el anillo del reactor
+ *
+ * @return la entrada, o NULL si la cola sigue llena
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+struct io_uring_sqe *obtenerSqe(pAnillo anillo){
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(&anillo->ring);
+	if(sqe == NULL){
+		/* Cola llena, enviamos lo pendiente al kernel y reintentamos */
+		io_uring_submit(&anillo->ring);
+		sqe = io_uring_get_sqe(&anillo->ring);
+	}
+
+	if(sqe == NULL){
+		syslog(LOG_ERR, "Cola de envio de io_uring llena");
+	}
+
+	return sqe;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Arma el accept multishot sobre el socket de escucha del reactor
+ *
+ * @synopsis
+ * @code
+ * 	status armarAceptar(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status armarAceptar(pReactor reactor){
+	struct io_uring_sqe *sqe;
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return REACTOR_ERROR;
+	}
+
+	/* Las conexiones nunca bloquean al escribir, la cola de salida espera al poll */
+	io_uring_prep_multishot_accept(sqe, reactor->sckt, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_ACEPTAR, 0, reactor->sckt));
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Arma el poll multishot sobre el eventfd del reactor
+ *
+ * @synopsis
+ * @code
+ * 	status armarAviso(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status armarAviso(pReactor reactor){
+	struct io_uring_sqe *sqe;
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return REACTOR_ERROR;
+	}
+
+	io_uring_prep_poll_multishot(sqe, reactor->eventoFD, POLLIN);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_AVISO, 0, reactor->eventoFD));
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Arma el poll multishot sobre el reloj del reactor
+ *
+ * @synopsis
+ * @code
+ * 	status armarReloj(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status armarReloj(pReactor reactor){
+	struct io_uring_sqe *sqe;
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return REACTOR_ERROR;
+	}
+
+	io_uring_prep_poll_multishot(sqe, reactor->relojFD, POLLIN);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_RELOJ, 0, reactor->relojFD));
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Arma el poll multishot sobre el signalfd, solo en el reactor 0
+ *
+ * @synopsis
+ * @code
+ * 	status armarSenal(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status armarSenal(pReactor reactor){
+	struct io_uring_sqe *sqe;
+
+	if(reactor->id != 0){
+		return REACTOR_OK;
+	}
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return REACTOR_ERROR;
+	}
+
+	io_uring_prep_poll_multishot(sqe, senalFD, POLLIN);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_SENAL, 0, senalFD));
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Cancela el accept multishot del reactor al empezar la parada
+ *
+ * @synopsis
+ * @code
+ * 	void dejarDeAceptarUring(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void dejarDeAceptarUring(pReactor reactor){
+	struct io_uring_sqe *sqe;
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return;
+	}
+
+	io_uring_prep_cancel64(sqe, DATO_URING(OP_ACEPTAR, 0, reactor->sckt), 0);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_CANCELAR, 0, reactor->sckt));
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Arma el recv multishot de una conexion sobre el anillo de buffers
+ *
+ * @synopsis
+ * @code
+ * 	status armarRecepcion(pReactor reactor, int fd)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] fd la conexion
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status armarRecepcion(pReactor reactor, int fd){
+	struct io_uring_sqe *sqe;
+	pEstadoUring estado = &reactor->anillo->estados[fd];
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return REACTOR_ERROR;
+	}
+
+	/* Sin buffer propio, el kernel toma uno del grupo en cada recepcion */
+	io_uring_prep_recv_multishot(sqe, fd, NULL, 0, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = GRUPO_BUFFERS_URING;
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_RECIBIR, estado->generacion, fd));
+
+	estado->recibiendo = 1;
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Cancela el recv multishot de una conexion
+ *
+ * @synopsis
+ * @code
+ * 	void cancelarRecepcion(pReactor reactor, int fd)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] fd la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void cancelarRecepcion(pReactor reactor, int fd){
+	struct io_uring_sqe *sqe;
+	pEstadoUring estado = &reactor->anillo->estados[fd];
+
+	if(!estado->recibiendo){
+		return;
+	}
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return;
+	}
+
+	io_uring_prep_cancel64(sqe, DATO_URING(OP_RECIBIR, estado->generacion, fd), 0);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_CANCELAR, 0, fd));
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Arma un poll para enviar la cola de salida cuando el socket admita escritura
+ *
+ * @synopsis
+ * @code
+ * 	void armarEscrituraUring(pReactor reactor, int fd)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] fd la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void armarEscrituraUring(pReactor reactor, int fd){
+	struct io_uring_sqe *sqe;
+	pEstadoUring estado = &reactor->anillo->estados[fd];
+
+	if(estado->escribiendo){
+		return;
+	}
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return;
+	}
+
+	io_uring_prep_poll_add(sqe, fd, POLLOUT);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_ESCRIBIR, estado->generacion, fd));
+
+	estado->escribiendo = 1;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Cancela el poll de escritura de una conexion
+ *
+ * El poll mantiene una referencia al socket, sin cancelarlo el socket de un
+ * cliente que no lee no se liberaria al cerrarlo.
+ *
+ * @synopsis
+ * @code
+ * 	void cancelarEscritura(pReactor reactor, int fd)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] fd la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void cancelarEscritura(pReactor reactor, int fd){
+	struct io_uring_sqe *sqe;
+	pEstadoUring estado = &reactor->anillo->estados[fd];
+
+	if(!estado->escribiendo){
+		return;
+	}
+
+	sqe = obtenerSqe(reactor->anillo);
+	if(sqe == NULL){
+		return;
+	}
+
+	io_uring_prep_cancel64(sqe, DATO_URING(OP_ESCRIBIR, estado->generacion, fd), 0);
+	io_uring_sqe_set_data64(sqe, DATO_URING(OP_CANCELAR, 0, fd));
+	estado->escribiendo = 0;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Devuelve un buffer de recepcion al anillo de buffers
+ *
+ * @synopsis
+ * @code
+ * 	void devolverBuffer(pAnillo anillo, unsigned short bid)
+ * @endcode
+ *
+ * @param[in] anillo el anillo del reactor
+ * @param[in] bid identificador del buffer
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void devolverBuffer(pAnillo anillo, unsigned short bid){
+	io_uring_buf_ring_add(anillo->bufRing, anillo->buffers + (size_t) bid * TAM_LECTURA, TAM_LECTURA,
+		bid, io_uring_buf_ring_mask(BUFFERS_URING), 0);
+	io_uring_buf_ring_advance(anillo->bufRing, 1);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Libera los mensajes que una conexion tenia pendientes
+ *
+ * @synopsis
+ * @code
+ * 	void vaciarPendientes(pEstadoUring estado)
+ * @endcode
+ *
+ * @param[in] estado el estado de la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void vaciarPendientes(pEstadoUring estado){
+	pMensajeUring m;
+
+	while(estado->primero){
+		m = estado->primero;
+		estado->primero = m->sig;
+		liberaDatosMensaje(m->datos);
+		free(m);
+	}
+
+	estado->ultimo = NULL;
+	estado->nPendientes = 0;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Vuelve a armar la recepcion de una conexion pausada
+ *
+ * Solo se rearma cuando el kernel ha terminado la peticion cancelada y el
+ * trabajador ha consumido la mitad de los mensajes pendientes.
+ *
+ * @synopsis
+ * @code
+ * 	void reanudarRecepcion(pReactor reactor, int fd)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] fd la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void reanudarRecepcion(pReactor reactor, int fd){
+	pAnillo anillo = reactor->anillo;
+	pEstadoUring estado = &anillo->estados[fd];
+	short reanudar;
+
+	pthread_mutex_lock(&anillo->mutex);
+	reanudar = estado->pausado && !estado->recibiendo && !estado->fin
+		&& estado->nPendientes <= MAX_PENDIENTES_URING / 2;
+	if(reanudar)
+		estado->pausado = 0;
+	pthread_mutex_unlock(&anillo->mutex);
+
+	if(reanudar)
+		armarRecepcion(reactor, fd);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Entrega un mensaje recibido al pool o lo guarda si la conexion esta ocupada
+ *
+ * @synopsis
+ * @code
+ * 	void entregarMensaje(pReactor reactor, int fd, pDatosMensaje datos)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] fd la conexion
+ * @param[in] datos el mensaje
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void entregarMensaje(pReactor reactor, int fd, pDatosMensaje datos){
+	pAnillo anillo = reactor->anillo;
+	pEstadoUring estado = &anillo->estados[fd];
+	pMensajeUring m;
+	short pausar = 0;
+
+	/* Parando ya no hay pool, lo que llegue se descarta */
+	if(reactor->parada != PARADA_NO){
+		liberaDatosMensaje(datos);
+		return;
+	}
+
+	pthread_mutex_lock(&anillo->mutex);
+
+	/* Un trabajador tiene el mensaje anterior, respetamos el orden */
+	if(estado->ocupado){
+		m = (pMensajeUring) calloc(1, sizeof(MensajeUring));
+		if(m == NULL){
+			pthread_mutex_unlock(&anillo->mutex);
+			syslog(LOG_ERR, "Error reservando memoria para mensaje pendiente");
+			liberaDatosMensaje(datos);
+			return;
+		}
+		m->datos = datos;
+		if(estado->ultimo) estado->ultimo->sig = m;
+		else estado->primero = m;
+		estado->ultimo = m;
+		estado->nPendientes++;
+
+		/* Demasiados mensajes sin procesar, dejamos de recibir */
+		if(estado->nPendientes >= MAX_PENDIENTES_URING && !estado->pausado){
+			estado->pausado = 1;
+			pausar = 1;
+		}
+		pthread_mutex_unlock(&anillo->mutex);
+
+		if(pausar)
+			cancelarRecepcion(reactor, fd);
+		return;
+	}
+
+	estado->ocupado = 1;
+	pthread_mutex_unlock(&anillo->mutex);
+
+	/* Pasamos el mensaje al pool, se bloquea si la cola esta llena */
+	if(encolarTrabajo(thpool, datos) < 0){
+		liberaDatosMensaje(datos);
+		syslog(LOG_WARNING, "Error encolando mensaje en el pool de hilos");
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Atiende el rearme de una conexion cuyo trabajador ha terminado
+ *
+ * @synopsis
+ * @code
+ * 	void siguienteMensaje(pReactor reactor, int fd)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] fd la conexion
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void siguienteMensaje(pReactor reactor, int fd){
+	pAnillo anillo = reactor->anillo;
+	pEstadoUring estado = &anillo->estados[fd];
+	pMensajeUring m = NULL;
+	short cerrar;
+
+	pthread_mutex_lock(&anillo->mutex);
+
+	if(!estado->ocupado){
+		pthread_mutex_unlock(&anillo->mutex);
+		return;
+	}
+
+	/* Parando, los mensajes que esperaban ya no llegan al pool */
+	if(reactor->parada != PARADA_NO){
+		vaciarPendientes(estado);
+	}
+
+	/* La conexion sigue ocupada con el siguiente mensaje */
+	if(estado->primero){
+		m = estado->primero;
+		estado->primero = m->sig;
+		if(estado->primero == NULL) estado->ultimo = NULL;
+		estado->nPendientes--;
+	} else {
+		estado->ocupado = 0;
+	}
+	cerrar = m == NULL && estado->fin;
+
+	pthread_mutex_unlock(&anillo->mutex);
+
+	reanudarRecepcion(reactor, fd);
+
+	if(m){
+		if(encolarTrabajo(thpool, m->datos) < 0){
+			liberaDatosMensaje(m->datos);
+			syslog(LOG_WARNING, "Error encolando mensaje en el pool de hilos");
+		}
+		free(m);
+	}
+
+	/* El cliente cerro mientras se procesaba su ultimo mensaje */
+	if(cerrar){
+		cerrarConexion(fd);
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Procesa los avisos que los trabajadores han dejado al reactor
+ *
+ * @synopsis
+ * @code
+ * 	void procesarAvisos(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void procesarAvisos(pReactor reactor){
+	pAnillo anillo = reactor->anillo;
+	pEstadoUring estado;
+	pAviso avisos;
+	int i, n;
+
+	/* Nos quedamos con la lista para no bloquear a los trabajadores */
+	pthread_mutex_lock(&anillo->mutex);
+	avisos = anillo->avisos;
+	n = anillo->nAvisos;
+	anillo->avisos = NULL;
+	anillo->nAvisos = 0;
+	anillo->capAvisos = 0;
+	pthread_mutex_unlock(&anillo->mutex);
+
+	for(i = 0; i < n; i++){
+		estado = &anillo->estados[avisos[i].fd];
+		if(!estado->activo){
+			continue;
+		}
+
+		if(avisos[i].tipo == AVISO_CERRAR){
+			cancelarRecepcion(reactor, avisos[i].fd);
+			cancelarEscritura(reactor, avisos[i].fd);
+			pthread_mutex_lock(&anillo->mutex);
+			vaciarPendientes(estado);
+			estado->activo = 0;
+			estado->ocupado = 0;
+			pthread_mutex_unlock(&anillo->mutex);
+		} else if(avisos[i].tipo == AVISO_ESCRIBIR){
+			armarEscrituraUring(reactor, avisos[i].fd);
+		} else {
+			siguienteMensaje(reactor, avisos[i].fd);
+		}
+	}
+
+	free(avisos);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Procesa una conexion aceptada por el accept multishot
+ *
+ * @synopsis
+ * @code
+ * 	void procesarAceptar(pReactor reactor, struct io_uring_cqe *cqe)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] cqe el evento completado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void procesarAceptar(pReactor reactor, struct io_uring_cqe *cqe){
+	struct sockaddr_in address;
+	socklen_t len = sizeof(address);
+	int desc = cqe->res;
+
+	if(desc < 0){
+		if(desc != -EAGAIN && desc != -ECANCELED)
+			syslog(LOG_WARNING, "Error n: %d aceptando conexion en io_uring", -desc);
+	} else if(reactor->parada != PARADA_NO){
+		/* Aceptada antes de que se cancelase el accept */
+		close(desc);
+	} else {
+		/* Los cierres pendientes van antes por si el descriptor se ha reutilizado */
+		procesarAvisos(reactor);
+
+		/* El accept multishot no devuelve la direccion */
+		if(getpeername(desc, (struct sockaddr *) &address, &len) < 0){
+			memset(&address, 0, sizeof(address));
+		}
+
+		if(registrarConexion(desc, reactor) < 0){
+			close(desc);
+		} else if(nuevaConexion(desc, &address) < 0){
+			syslog(LOG_WARNING, "Error en llamada a nuevaConexion()");
+		}
+	}
+
+	if(!(cqe->flags & IORING_CQE_F_MORE) && running && reactor->parada == PARADA_NO){
+		armarAceptar(reactor);
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Procesa un evento del recv multishot de una conexion
+ *
+ * @synopsis
+ * @code
+ * 	void procesarRecibir(pReactor reactor, struct io_uring_cqe *cqe)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] cqe el evento completado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void procesarRecibir(pReactor reactor, struct io_uring_cqe *cqe){
+	pAnillo anillo = reactor->anillo;
+	__u64 dato = io_uring_cqe_get_data64(cqe);
+	int fd = FD_DATO_URING(dato);
+	pEstadoUring estado = &anillo->estados[fd];
+	pConexion conexion = obtenerConexion(fd);
+	pDatosMensaje datos = NULL;
+	char *msg;
+	size_t len;
+	unsigned short bid;
+	short actual, cerrar;
+
+	/* Descartamos eventos de conexiones cerradas o de otro reactor */
+	actual = estado->activo && estado->generacion == GEN_DATO_URING(dato)
+		&& conexion != NULL && conexion->reactor == reactor;
+
+	/* Copiamos los datos y devolvemos el buffer al kernel cuanto antes */
+	if(cqe->flags & IORING_CQE_F_BUFFER){
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		if(actual && cqe->res > 0){
+			/* Solo pasamos lineas completas, el resto espera a la siguiente lectura */
+			msg = ensamblarLineas(&conexion->entrada, anillo->buffers + (size_t) bid * TAM_LECTURA, cqe->res, &len);
+			if(msg){
+				datos = crearDatosMensaje(fd, msg, len);
+				if(datos == NULL)
+					syslog(LOG_ERR, "Error reservando memoria para datos");
+			}
+		}
+		devolverBuffer(anillo, bid);
+	}
+
+	if(!actual){
+		return;
+	}
+
+	if(!(cqe->flags & IORING_CQE_F_MORE)){
+		estado->recibiendo = 0;
+	}
+
+	if(cqe->res > 0){
+		conexion->actividad = reactor->rueda.ahora;
+		if(datos) entregarMensaje(reactor, fd, datos);
+
+	} else if(cqe->res == 0 || (cqe->res != -ENOBUFS && cqe->res != -ECANCELED)){
+		/* Caso socket cerrado o con error */
+		if(cqe->res < 0)
+			syslog(LOG_ERR, "Error n: %d al recibir mensaje del socket %d", -cqe->res, fd);
+		pthread_mutex_lock(&anillo->mutex);
+		estado->fin = 1;
+		cerrar = !estado->ocupado;
+		pthread_mutex_unlock(&anillo->mutex);
+		if(cerrar){
+			cerrarConexion(fd);
+		}
+		return;
+	}
+
+	/* La peticion ha terminado (sin buffers libres o cancelada), la renovamos */
+	if(!estado->recibiendo){
+		if(estado->pausado) reanudarRecepcion(reactor, fd);
+		else armarRecepcion(reactor, fd);
+	}
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Envia la cola de salida de una conexion cuyo socket admite escritura
+ *
+ * @synopsis
+ * @code
+ * 	void procesarEscribir(pReactor reactor, struct io_uring_cqe *cqe)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] cqe el evento completado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void procesarEscribir(pReactor reactor, struct io_uring_cqe *cqe){
+	__u64 dato = io_uring_cqe_get_data64(cqe);
+	int fd = FD_DATO_URING(dato);
+	pEstadoUring estado = &reactor->anillo->estados[fd];
+	pConexion conexion = obtenerConexion(fd);
+
+	/* Descartamos eventos de conexiones cerradas o canceladas */
+	if(!estado->activo || estado->generacion != GEN_DATO_URING(dato)
+		|| conexion == NULL || conexion->reactor != reactor){
+		return;
+	}
+
+	/* Si quedan datos enviarPendiente vuelve a pedir el poll */
+	estado->escribiendo = 0;
+	enviarPendiente(conexion);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Crea el anillo io_uring del reactor con su anillo de buffers y su eventfd
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarUring(pReactor reactor, int sckt, short propio)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ * @param[in] sckt socket de escucha
+ * @param[in] propio 0 si el socket de escucha se comparte con otros reactores
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR si el kernel no lo soporta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarUring(pReactor reactor, int sckt, short propio){
+	pAnillo anillo;
+	int i, ret;
+
+	reactor->sckt = sckt;
+	reactor->propio = propio;
+	reactor->epollFD = -1;
+	reactor->epollSalida = -1;
+
+	anillo = (pAnillo) calloc(1, sizeof(Anillo));
+	if(anillo == NULL){
+		return REACTOR_ERROR;
+	}
+	pthread_mutex_init(&anillo->mutex, NULL);
+
+	if((ret = io_uring_queue_init(ENTRADAS_URING, &anillo->ring, 0)) < 0){
+		syslog(LOG_WARNING, "Error n: %d creando anillo en llamada a io_uring_queue_init()", -ret);
+		pthread_mutex_destroy(&anillo->mutex);
+		free(anillo);
+		return REACTOR_ERROR;
+	}
+	reactor->anillo = anillo;
+
+	/* Las paginas de la tabla solo se reservan al tocarlas */
+	anillo->estados = (pEstadoUring) calloc(maxConexiones, sizeof(EstadoUring));
+	anillo->buffers = (char *) malloc((size_t) BUFFERS_URING * TAM_LECTURA);
+	anillo->bufRing = io_uring_setup_buf_ring(&anillo->ring, BUFFERS_URING, GRUPO_BUFFERS_URING, 0, &ret);
+	if(!anillo->estados || !anillo->buffers || !anillo->bufRing){
+		syslog(LOG_WARNING, "Error n: %d creando anillo de buffers de recepcion", -ret);
+		liberarUring(reactor);
+		return REACTOR_ERROR;
+	}
+
+	for(i = 0; i < BUFFERS_URING; i++){
+		io_uring_buf_ring_add(anillo->bufRing, anillo->buffers + (size_t) i * TAM_LECTURA, TAM_LECTURA,
+			i, io_uring_buf_ring_mask(BUFFERS_URING), i);
+	}
+	io_uring_buf_ring_advance(anillo->bufRing, BUFFERS_URING);
+
+	/* Descriptor con el que otros hilos despiertan al reactor */
+	reactor->eventoFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(reactor->eventoFD < 0){
+		syslog(LOG_ERR, "Error creando eventfd en llamada a eventfd()");
+		liberarUring(reactor);
+		return REACTOR_ERROR;
+	}
+
+	if(armarAviso(reactor) < 0 || armarReloj(reactor) < 0 || armarSenal(reactor) < 0
+		|| armarAceptar(reactor) < 0 || io_uring_submit(&anillo->ring) < 0){
+		close(reactor->eventoFD);
+		reactor->eventoFD = -1;
+		liberarUring(reactor);
+		return REACTOR_ERROR;
+	}
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Libera el anillo io_uring del reactor y los mensajes pendientes
+ *
+ * @synopsis
+ * @code
+ * 	void liberarUring(pReactor reactor)
+ * @endcode
+ *
+ * @param[in] reactor el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarUring(pReactor reactor){
+	pAnillo anillo = reactor->anillo;
+	int i;
+
+	if(anillo == NULL){
+		return;
+	}
+
+	if(anillo->estados){
+		for(i = 0; i < maxConexiones; i++){
+			vaciarPendientes(&anillo->estados[i]);
+		}
+	}
+
+	if(anillo->bufRing){
+		io_uring_free_buf_ring(&anillo->ring, anillo->bufRing, BUFFERS_URING, GRUPO_BUFFERS_URING);
+	}
+	io_uring_queue_exit(&anillo->ring);
+
+	pthread_mutex_destroy(&anillo->mutex);
+	free(anillo->estados);
+	free(anillo->buffers);
+	free(anillo->avisos);
+	free(anillo);
+	reactor->anillo = NULL;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Empieza a recibir de una conexion recien aceptada
+ *
+ * Se llama desde el hilo del reactor, a traves de nuevaConexion.
+ *
+ * @synopsis
+ * @code
+ * 	status addFdUring(pReactor reactor, int sckt)
+ * @endcode
+ *
+ * @param[in] reactor el reactor propietario
+ * @param[in] sckt el socket
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status addFdUring(pReactor reactor, int sckt){
+	pAnillo anillo = reactor->anillo;
+	pEstadoUring estado = &anillo->estados[sckt];
+
+	pthread_mutex_lock(&anillo->mutex);
+	vaciarPendientes(estado);
+	estado->generacion++;
+	estado->activo = 1;
+	estado->recibiendo = 0;
+	estado->escribiendo = 0;
+	estado->ocupado = 0;
+	estado->fin = 0;
+	estado->pausado = 0;
+	pthread_mutex_unlock(&anillo->mutex);
+
+	return armarRecepcion(reactor, sckt);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Libera una conexion cuyo trabajador ha terminado
+ *
+ * Si no hay mensajes pendientes el propio trabajador marca la conexion como
+ * libre, sin despertar al reactor: el recv multishot sigue armado.
+ *
+ * @synopsis
+ * @code
+ * 	status rearmarUring(pReactor reactor, int sckt)
+ * @endcode
+ *
+ * @param[in] reactor el reactor propietario
+ * @param[in] sckt el socket
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status rearmarUring(pReactor reactor, int sckt){
+	pAnillo anillo = reactor->anillo;
+	pEstadoUring estado = &anillo->estados[sckt];
+
+	pthread_mutex_lock(&anillo->mutex);
+	if(estado->ocupado && estado->primero == NULL && !estado->fin && !estado->pausado){
+		estado->ocupado = 0;
+		pthread_mutex_unlock(&anillo->mutex);
+		return REACTOR_OK;
+	}
+	pthread_mutex_unlock(&anillo->mutex);
+
+	return avisarReactorUring(reactor, sckt, AVISO_REARMAR);
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Deja un aviso al reactor propietario de una conexion y lo despierta
+ *
+ * El anillo solo lo toca el hilo del reactor, por lo que los trabajadores
+ * no pueden rearmar ni cancelar peticiones directamente.
+ *
+ * @synopsis
+ * @code
+ * 	status avisarReactorUring(pReactor reactor, int sckt, short tipo)
+ * @endcode
+ *
+ * @param[in] reactor el reactor propietario
+ * @param[in] sckt el socket
+ * @param[in] tipo AVISO_REARMAR o AVISO_CERRAR
+ *
+ * @return REACTOR_OK si todo va bien. REACTOR_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status avisarReactorUring(pReactor reactor, int sckt, short tipo){
+	pAnillo anillo = reactor->anillo;
+	pAviso nuevos;
+	uint64_t uno = 1;
+	int cap;
+
+	pthread_mutex_lock(&anillo->mutex);
+
+	if(anillo->nAvisos == anillo->capAvisos){
+		cap = anillo->capAvisos ? 2 * anillo->capAvisos : 16;
+		nuevos = (pAviso) realloc(anillo->avisos, cap * sizeof(Aviso));
+		if(nuevos == NULL){
+			pthread_mutex_unlock(&anillo->mutex);
+			syslog(LOG_ERR, "Error reservando memoria para avisos del reactor %d", reactor->id);
+			return REACTOR_ERROR;
+		}
+		anillo->avisos = nuevos;
+		anillo->capAvisos = cap;
+	}
+
+	anillo->avisos[anillo->nAvisos].fd = sckt;
+	anillo->avisos[anillo->nAvisos].tipo = tipo;
+	anillo->nAvisos++;
+
+	pthread_mutex_unlock(&anillo->mutex);
+
+	if(write(reactor->eventoFD, &uno, sizeof(uno)) < 0 && errno != EAGAIN){
+		syslog(LOG_WARNING, "Error n: %d despertando al reactor %d", errno, reactor->id);
+	}
+
+	return REACTOR_OK;
+}
+
+/**
+ * @ingroup Reactor
+ *
+ * @brief Bucle de eventos de un reactor io_uring
+ *
+ * @synopsis
+ * @code
+ * 	void *bucleReactorUring(void *arg)
+ * @endcode
+ *
+ * @param[in] arg el reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void *bucleReactorUring(void *arg){
+
+	pReactor reactor = (pReactor) arg;
+	pAnillo anillo = reactor->anillo;
+	struct io_uring_cqe *cqe;
+	unsigned int head, vistos;
+	uint64_t avisos;
+	int ret;
+
+	while(running && reactor->parada != PARADA_TERMINADA){
+
+		/* Una sola llamada envia las peticiones nuevas y espera eventos */
+		ret = io_uring_submit_and_wait(&anillo->ring, 1);
+		if(ret < 0 && ret != -EINTR){
+			syslog(LOG_ERR, "Error n: %d en io_uring_submit_and_wait()", -ret);
+			continue;
+		}
+
+		vistos = 0;
+		io_uring_for_each_cqe(&anillo->ring, head, cqe){
+
+			switch(TIPO_DATO_URING(io_uring_cqe_get_data64(cqe))){
+				case OP_ACEPTAR:
+					procesarAceptar(reactor, cqe);
+					break;
+				case OP_RECIBIR:
+					procesarRecibir(reactor, cqe);
+					break;
+				case OP_ESCRIBIR:
+					procesarEscribir(reactor, cqe);
+					break;
+				case OP_AVISO: /* Aviso de otro hilo, vaciamos el contador */
+					while(read(reactor->eventoFD, &avisos, sizeof(avisos)) > 0);
+					procesarAvisos(reactor);
+					if(!(cqe->flags & IORING_CQE_F_MORE))
+						armarAviso(reactor);
+					break;
+				case OP_RELOJ:
+					avanzarReloj(reactor);
+					if(!(cqe->flags & IORING_CQE_F_MORE))
+						armarReloj(reactor);
+					break;
+				case OP_SENAL:
+					atenderSenal();
+					if(!(cqe->flags & IORING_CQE_F_MORE))
+						armarSenal(reactor);
+					break;
+				default: /* Resultado de una cancelacion */
+					break;
+			}
+			vistos++;
+		}
+		io_uring_cq_advance(&anillo->ring, vistos);
+
+		if(estadoParada > reactor->parada){
+			avanzarParada(reactor);
+		}
+	}
+
+	return NULL;
+}
@@ -12,6 +12,7 @@
  */
 	
 #include "../includes/red_servidor.h"
+#include "../includes/conexiones.h"
 #include "../includes/ssl.h"
 
 /**
@@ -24,15 +25,16 @@
 /**
  * @ingroup RedServidorIRC
  *
- * @brief crea un socket TCP
+ * @brief crea un socket TCP de escucha
  *
  * @synopsis
  * @code
- * 	status crearSocketTCP(int * sckfd, unsigned short port)
+ * 	status crearSocketEscucha(int * sckfd, unsigned short port, short compartido)
  * @endcode
  *
  * @param[in] sckfd el socket
  * @param[in] port el puerto
+ * @param[in] compartido 1 para activar SO_REUSEPORT
  *
  * @author
  * Pablo Marcos Manchon
@@ -40,7 +42,7 @@
  *
  *<hr>
  */
-status crearSocketTCP(int * sckfd, unsigned short port){
+status crearSocketEscucha(int * sckfd, unsigned short port, short compartido){
 
 	struct sockaddr_in direccion;
 	int optval = 1;
@@ -61,18 +63,29 @@ status crearSocketTCP(int * sckfd, unsigned short port){
 	/* Permitimos reutilizar el socket */
      if (setsockopt(*sckfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int)) < 0) { 
 		syslog (LOG_ERR, "Error creando socket TCP en llamada a setsockopt()");
+		close(*sckfd);
         return RED_ERROR;
      }  
 
+	/* Varios sockets en el mismo puerto, el kernel reparte las conexiones */
+	if (compartido && setsockopt(*sckfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(int)) < 0) {
+		syslog (LOG_ERR, "Error activando SO_REUSEPORT en llamada a setsockopt()");
+		close(*sckfd);
+		return RED_ERROR;
+	}
+
 	/* Ligamos socket al puerto correspondiente */
 	if(bind(*sckfd, (struct sockaddr *) &direccion, sizeof(direccion)) < 0){
 		syslog (LOG_ERR, "Error creando socket TCP en llamada a bind()");
+		close(*sckfd);
 		return RED_ERROR;
 	}
 
 	/* Ponemos a escuchar el socket */
-	if (listen(*sckfd, MAX_QUEUE)<0){ /* MAX_QUEUE definida en red_servidor.h */
+	/* Una cola corta pierde SYN cuando muchos clientes reconectan a la vez */
+	if (listen(*sckfd, backlogEscucha > 0 ? backlogEscucha : DEFAULT_BACKLOG)<0){
 		syslog(LOG_ERR, "Error creando socket TCP en llamada a listen()");
+		close(*sckfd);
 		return RED_ERROR;
 	}
 
@@ -82,6 +95,52 @@ status crearSocketTCP(int * sckfd, unsigned short port){
 	return RED_OK;
 }
 
+/**
+ * @ingroup RedServidorIRC
+ *
+ * @brief crea un socket TCP
+ *
+ * @synopsis
+ * @code
+ * 	status crearSocketTCP(int * sckfd, unsigned short port)
+ * @endcode
+ *
+ * @param[in] sckfd el socket
+ * @param[in] port el puerto
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+status crearSocketTCP(int * sckfd, unsigned short port){
+	return crearSocketEscucha(sckfd, port, 0);
+}
+
+/**
+ * @ingroup RedServidorIRC
+ *
+ * @brief crea un socket TCP que comparte puerto con otros (SO_REUSEPORT)
+ *
+ * @synopsis
+ * @code
+ * 	status crearSocketTCPCompartido(int * sckfd, unsigned short port)
+ * @endcode
+ *
+ * @param[in] sckfd el socket
+ * @param[in] port el puerto
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+status crearSocketTCPCompartido(int * sckfd, unsigned short port){
+	return crearSocketEscucha(sckfd, port, 1);
+}
+
 /**
  * @ingroup RedServidorIRC
  *
@@ -107,9 +166,50 @@ status aceptarConexion(int sockval,int *sckfd, struct sockaddr_in * address){
 	size_t c = sizeof(struct sockaddr_in);
 
 	/* Aceptamos conexion guardando valores en estructura Redinf */
-	*sckfd = accept(sockval, (struct sockaddr *) address,(socklen_t*) &c);
+	*sckfd = accept4(sockval, (struct sockaddr *) address,(socklen_t*) &c, SOCK_CLOEXEC);
+	if((*sckfd) < 0 ){
+		syslog(LOG_ERR, "Error aceptando conexion en llamada a accept4()");
+		return RED_ERROR;
+	}
+
+	/* Informacion de debugeo */
+	syslog (LOG_DEBUG, "Conexion aceptada correctamente");
+
+	return RED_OK;
+}
+
+/**
+ * @ingroup RedServidorIRC
+ *
+ * @brief Acepta conexion entrante en un socket que nace no bloqueante
+ *
+ * La usan los reactores, que nunca deben bloquearse en la conexion: con SSL
+ * el handshake tambien avanza desde el bucle de eventos.
+ *
+ * @synopsis
+ * @code
+ * 	status aceptarConexionNoBloqueante(int sockval,int *sckfd, struct sockaddr_in * address)
+ * @endcode
+ *
+ * @param[in] sockval socket del que extraer la conexion
+ * @param[in] sockfd nuevo socket para manejar la conexion
+ * @param[in] address estructura que almacena informacion de la direccion de internet
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+status aceptarConexionNoBloqueante(int sockval,int *sckfd, struct sockaddr_in * address){
+
+	size_t c = sizeof(struct sockaddr_in);
+
+	*sckfd = accept4(sockval, (struct sockaddr *) address,(socklen_t*) &c, SOCK_CLOEXEC | SOCK_NONBLOCK);
 	if((*sckfd) < 0 ){
-		syslog(LOG_ERR, "Error aceptando conexion en llamada a accept()");
+		/* Socket no bloqueante sin conexiones pendientes, no es un error */
+		if(errno != EAGAIN && errno != EWOULDBLOCK)
+			syslog(LOG_ERR, "Error aceptando conexion en llamada a accept4()");
 		return RED_ERROR;
 	}
 
@@ -124,6 +224,9 @@ status aceptarConexion(int sockval,int *sckfd, struct sockaddr_in * address){
  *
  * @brief Envia mensaje desde el socket especificado
  *
+ * Si el socket es una conexion del servidor el mensaje pasa por su cola de
+ * salida y nunca bloquea.
+ *
  * @synopsis
  * @code
  * 	status enviar(int sockfd, char *mensaje)
@@ -139,15 +242,53 @@ status aceptarConexion(int sockval,int *sckfd, struct sockaddr_in * address){
  *<hr>
  */
 status enviar(int sockfd, char *mensaje){
+
+	if(mensaje == NULL){
+		syslog(LOG_INFO,"Error en el envio de paquete");
+		return RED_ERROR;
+	}
+
+	return enviarDatos(sockfd, mensaje, strlen(mensaje));
+}
+
+/**
+ * @ingroup RedServidorIRC
+ *
+ * @brief Envia un mensaje de longitud conocida desde el socket especificado
+ *
+ * @synopsis
+ * @code
+ * 	status enviarDatos(int sockfd, char *mensaje, size_t len)
+ * @endcode
+ *
+ * @param[in] sockfd el socket 
+ * @param[in] mensaje el mensaje, no hace falta que termine en '\0'
+ * @param[in] len longitud del mensaje
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+status enviarDatos(int sockfd, char *mensaje, size_t len){
+	pConexion conexion;
+
 	if(sockfd < 0 || mensaje==NULL){
 		syslog(LOG_INFO,"Error en el envio de paquete");
 		return RED_ERROR;
 	}
 
+	/* Las conexiones del servidor nunca bloquean al trabajador, lo que no cabe se encola */
+	conexion = obtenerConexion(sockfd);
+	if(conexion != NULL){
+		return encolarSalida(conexion, mensaje, len) < 0 ? RED_ERROR : RED_OK;
+	}
+
 	if(ssl_active){
-		enviar_datos_SSL(sockfd, mensaje, strlen(mensaje));
+		enviar_datos_SSL(sockfd, mensaje, len);
 	} else {
-		send(sockfd, mensaje, strlen(mensaje), 0);
+		send(sockfd, mensaje, len, MSG_NOSIGNAL);
 	}
 	
 	return RED_OK;
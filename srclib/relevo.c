@@ -0,0 +1,1435 @@
+/**
+ * @file relevo.c
+ * @brief relevo en caliente del binario pasando los sockets al nuevo proceso
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Relevo Relevo
+ *
+ * <hr>
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "../includes/relevo.h"
+#include "../includes/reactor.h"
+#include "../includes/canales.h"
+#include "../includes/funciones_servidor.h"
+
+/**
+ * @addtogroup Relevo
+ * Con SIGUSR2 el servidor lanza de nuevo su binario con --relevo y un
+ * extremo de un socketpair SOCK_SEQPACKET. Cuando el nuevo proceso avisa de
+ * que esta inicializado, el anterior para como en un SIGINT pero sin cerrar
+ * a nadie: deja de aceptar y de leer, termina el pool y le pasa por
+ * SCM_RIGHTS los sockets de escucha y los de los clientes, junto con el
+ * estado que los reconstruye (usuarios, canales, lineas a medio recibir y
+ * colas de salida). Los clientes no notan el cambio: lo que envian mientras
+ * tanto espera en el kernel, y las conexiones nuevas en la cola de escucha.
+ *
+ * Solo con epoll y sin SSL: io_uring ya ha leido datos que no ha procesado
+ * y el estado de SSL no sale de OpenSSL.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Annade bytes al final de una serie, creciendo si hace falta
+ *
+ * @synopsis
+ * @code
+ * 	void serieBytes(pSerieRelevo serie, void *datos, size_t len)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ * @param[in] datos los bytes
+ * @param[in] len numero de bytes
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void serieBytes(pSerieRelevo serie, void *datos, size_t len){
+	size_t cap;
+	char *nuevos;
+
+	if(serie->error){
+		return;
+	}
+
+	if(serie->len + len > serie->cap){
+		for(cap = serie->cap ? serie->cap : TAM_PAQUETE_RELEVO; cap < serie->len + len; cap *= 2);
+		nuevos = (char *) realloc(serie->datos, cap);
+		if(nuevos == NULL){
+			serie->error = 1;
+			return;
+		}
+		serie->datos = nuevos;
+		serie->cap = cap;
+	}
+
+	memcpy(serie->datos + serie->len, datos, len);
+	serie->len += len;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Annade un entero a una serie
+ *
+ * @synopsis
+ * @code
+ * 	void serieEntero(pSerieRelevo serie, int64_t valor)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ * @param[in] valor el entero
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void serieEntero(pSerieRelevo serie, int64_t valor){
+	serieBytes(serie, &valor, sizeof(valor));
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Annade un bloque de bytes precedido de su longitud
+ *
+ * @synopsis
+ * @code
+ * 	void serieBloque(pSerieRelevo serie, char *datos, size_t len)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ * @param[in] datos los bytes, NULL se guarda como ausente
+ * @param[in] len numero de bytes
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void serieBloque(pSerieRelevo serie, char *datos, size_t len){
+
+	if(datos == NULL){
+		serieEntero(serie, -1);
+		return;
+	}
+
+	serieEntero(serie, (int64_t) len);
+	serieBytes(serie, datos, len);
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Annade una cadena, o su ausencia, a una serie
+ *
+ * @synopsis
+ * @code
+ * 	void serieCadena(pSerieRelevo serie, char *cadena)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ * @param[in] cadena la cadena, puede ser NULL
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void serieCadena(pSerieRelevo serie, char *cadena){
+	serieBloque(serie, cadena, cadena ? strlen(cadena) : 0);
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Lee un entero de una serie
+ *
+ * @synopsis
+ * @code
+ * 	int64_t leerEntero(pSerieRelevo serie)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ *
+ * @return el entero, 0 si la serie se ha acabado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int64_t leerEntero(pSerieRelevo serie){
+	int64_t valor = 0;
+
+	if(serie->error || serie->len - serie->pos < sizeof(valor)){
+		serie->error = 1;
+		return 0;
+	}
+
+	memcpy(&valor, serie->datos + serie->pos, sizeof(valor));
+	serie->pos += sizeof(valor);
+
+	return valor;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Lee un bloque de bytes de una serie sin copiarlo
+ *
+ * @synopsis
+ * @code
+ * 	char *leerBloque(pSerieRelevo serie, size_t *len)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ * @param[out] len numero de bytes del bloque
+ *
+ * @return puntero al bloque dentro de la serie, NULL si estaba ausente
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char *leerBloque(pSerieRelevo serie, size_t *len){
+	int64_t tam;
+	char *datos;
+
+	*len = 0;
+	tam = leerEntero(serie);
+	if(tam < 0 || serie->error){
+		return NULL;
+	}
+
+	if(serie->len - serie->pos < (uint64_t) tam){
+		serie->error = 1;
+		return NULL;
+	}
+
+	datos = serie->datos + serie->pos;
+	serie->pos += tam;
+	*len = tam;
+
+	return datos;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Lee una cadena de una serie
+ *
+ * @synopsis
+ * @code
+ * 	char *leerCadena(pSerieRelevo serie)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ *
+ * @return copia de la cadena que hay que liberar, NULL si estaba ausente
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char *leerCadena(pSerieRelevo serie){
+	char *datos;
+	size_t len;
+
+	datos = leerBloque(serie, &len);
+	if(datos == NULL){
+		return NULL;
+	}
+
+	return strndup(datos, len);
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Espera a que el otro proceso mande algo, como mucho PLAZO_RELEVO segundos
+ *
+ * @synopsis
+ * @code
+ * 	status esperarRelevo(int socket)
+ * @endcode
+ *
+ * @param[in] socket extremo del socketpair
+ *
+ * @return RELEVO_OK si hay algo que leer. RELEVO_ERROR si se acaba el plazo
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status esperarRelevo(int socket){
+	struct pollfd p;
+	int ret;
+
+	p.fd = socket;
+	p.events = POLLIN;
+	p.revents = 0;
+
+	do {
+		ret = poll(&p, 1, PLAZO_RELEVO * 1000);
+	} while(ret < 0 && errno == EINTR);
+
+	return ret > 0 ? RELEVO_OK : RELEVO_ERROR;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Envia un paquete, con descriptores adjuntos si los hay
+ *
+ * @synopsis
+ * @code
+ * 	status enviarPaquete(int socket, void *datos, size_t len, int *fds, int nfds)
+ * @endcode
+ *
+ * @param[in] socket extremo del socketpair
+ * @param[in] datos contenido del paquete
+ * @param[in] len bytes del paquete
+ * @param[in] fds descriptores a adjuntar
+ * @param[in] nfds numero de descriptores, como mucho MAX_FDS_RELEVO
+ *
+ * @return RELEVO_OK si todo va bien. RELEVO_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status enviarPaquete(int socket, void *datos, size_t len, int *fds, int nfds){
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(MAX_FDS_RELEVO * sizeof(int))];
+	ssize_t ret;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = datos;
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if(nfds > 0){
+		memset(control, 0, sizeof(control));
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+	}
+
+	do {
+		ret = sendmsg(socket, &msg, MSG_NOSIGNAL);
+	} while(ret < 0 && errno == EINTR);
+
+	if(ret != (ssize_t) len){
+		syslog(LOG_ERR, "Error n: %d enviando paquete del relevo", errno);
+		return RELEVO_ERROR;
+	}
+
+	return RELEVO_OK;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Recibe un paquete y los descriptores que traiga
+ *
+ * @synopsis
+ * @code
+ * 	ssize_t recibirPaquete(int socket, void *datos, size_t len, int *fds, int *nfds)
+ * @endcode
+ *
+ * @param[in] socket extremo del socketpair
+ * @param[out] datos donde dejar el contenido
+ * @param[in] len tamanno de datos
+ * @param[out] fds donde dejar los descriptores, NULL si no se esperan
+ * @param[out] nfds numero de descriptores recibidos
+ *
+ * @return bytes recibidos, -1 si hay error o se acaba el plazo
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+ssize_t recibirPaquete(int socket, void *datos, size_t len, int *fds, int *nfds){
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(MAX_FDS_RELEVO * sizeof(int))];
+	ssize_t ret;
+	int n;
+
+	if(nfds) *nfds = 0;
+
+	if(esperarRelevo(socket) < 0){
+		syslog(LOG_ERR, "Plazo agotado esperando al otro proceso del relevo");
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = datos;
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	do {
+		ret = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+	} while(ret < 0 && errno == EINTR);
+
+	if(ret <= 0 || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))){
+		syslog(LOG_ERR, "Error n: %d recibiendo paquete del relevo", ret < 0 ? errno : 0);
+		/* Si recvmsg falla no toca el control, que no tiene descriptores */
+		if(ret < 0) msg.msg_controllen = 0;
+		ret = -1;
+	}
+
+	for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+		if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS){
+			continue;
+		}
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		if(fds && nfds && ret >= 0){
+			memcpy(fds, CMSG_DATA(cmsg), n * sizeof(int));
+			*nfds = n;
+		} else {
+			/* Descriptores que nadie esperaba, no se pueden quedar abiertos */
+			while(n-- > 0) close(((int *) CMSG_DATA(cmsg))[n]);
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Cierra los descriptores heredados del proceso anterior salvo el del relevo
+ *
+ * Los sockets de los clientes llegan por SCM_RIGHTS; una copia heredada
+ * por exec mantendria abierta la conexion despues de que el cliente se
+ * fuera.
+ *
+ * @synopsis
+ * @code
+ * 	void cerrarHeredados(int conservar)
+ * @endcode
+ *
+ * @param[in] conservar descriptor que no se cierra
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void cerrarHeredados(int conservar){
+	int i;
+
+	for(i = STDERR_FILENO + 1; i < getdtablesize(); i++){
+		if(i != conservar){
+			close(i);
+		}
+	}
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Prepara los argumentos del nuevo binario: los mismos mas --relevo
+ *
+ * @synopsis
+ * @code
+ * 	char **argumentosRelevo(int fd)
+ * @endcode
+ *
+ * @param[in] fd extremo del socketpair que hereda el nuevo proceso
+ *
+ * @return el array terminado en NULL, NULL si no hay memoria
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char **argumentosRelevo(int fd){
+	char **args, numero[16];
+	int i, n = 0, argc;
+
+	for(argc = 0; argvServidor[argc]; argc++);
+
+	args = (char **) calloc(argc + 3, sizeof(char *));
+	if(args == NULL){
+		return NULL;
+	}
+
+	/* Un relevo anterior dejo su propio --relevo, no se repite */
+	for(i = 0; i < argc; i++){
+		if(!strcmp(argvServidor[i], "--relevo") || !strcmp(argvServidor[i], "-H")){
+			i++;
+			continue;
+		}
+		if(!strncmp(argvServidor[i], "--relevo=", 9)){
+			continue;
+		}
+		args[n++] = argvServidor[i];
+	}
+
+	snprintf(numero, sizeof(numero), "%d", fd);
+	args[n++] = "--relevo";
+	args[n] = strdup(numero);
+	if(args[n] == NULL){
+		free(args);
+		return NULL;
+	}
+
+	return args;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Lanza el nuevo binario sin esperar a que este inicializado
+ *
+ * Se llama desde el reactor 0 al recibir SIGUSR2. El nuevo proceso avisa
+ * por socketRelevo cuando esta listo; el reactor vigila ese extremo en su
+ * epoll y llama a confirmarRelevo, o a abandonarRelevo si pasan
+ * PLAZO_RELEVO segundos sin aviso, de modo que sigue atendiendo a sus
+ * conexiones mientras tanto.
+ *
+ * @synopsis
+ * @code
+ * 	status lanzarRelevo(void)
+ * @endcode
+ *
+ * @return RELEVO_OK si el nuevo proceso esta arrancando. RELEVO_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status lanzarRelevo(void){
+	int par[2], i;
+	char **args;
+	pid_t pid;
+
+	if(argvServidor == NULL){
+		return RELEVO_ERROR;
+	}
+
+	if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, par) < 0){
+		syslog(LOG_ERR, "Error n: %d creando el socketpair del relevo", errno);
+		return RELEVO_ERROR;
+	}
+
+	args = argumentosRelevo(par[1]);
+	if(args == NULL){
+		close(par[0]);
+		close(par[1]);
+		return RELEVO_ERROR;
+	}
+
+	pid = fork();
+	if(pid == 0){
+		/* Solo llamadas seguras tras fork en un proceso con hilos. El daemon
+		   trabaja en /, las rutas relativas son desde donde se lanzo */
+		fcntl(par[1], F_SETFD, 0);
+		if(chdir(abspath) == 0){
+			execvp(args[0], args);
+		}
+		_exit(127);
+	}
+
+	close(par[1]);
+	for(i = 0; args[i]; i++);
+	free(args[i - 1]);
+	free(args);
+
+	if(pid < 0){
+		syslog(LOG_ERR, "Error n: %d lanzando el nuevo binario", errno);
+		close(par[0]);
+		return RELEVO_ERROR;
+	}
+
+	socketRelevo = par[0];
+	pidRelevo = pid;
+
+	return RELEVO_OK;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Lee el aviso del nuevo binario cuando su extremo tiene algo que leer
+ *
+ * Si el aviso no es LISTO, o el nuevo proceso ha muerto, se abandona el
+ * relevo y el servidor sigue como estaba.
+ *
+ * @synopsis
+ * @code
+ * 	status confirmarRelevo(void)
+ * @endcode
+ *
+ * @return RELEVO_OK si el nuevo proceso espera el estado. RELEVO_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status confirmarRelevo(void){
+	char listo[sizeof(MENSAJE_LISTO)];
+
+	memset(listo, 0, sizeof(listo));
+	if(recibirPaquete(socketRelevo, listo, sizeof(listo) - 1, NULL, NULL) < 0 || strcmp(listo, MENSAJE_LISTO)){
+		abandonarRelevo();
+		return RELEVO_ERROR;
+	}
+
+	syslog(LOG_INFO, "Nuevo binario %s listo con pid %d, se le pasan las conexiones", argvServidor[0], (int) pidRelevo);
+
+	return RELEVO_OK;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Mata el nuevo binario que no ha llegado a tomar el relevo
+ *
+ * @synopsis
+ * @code
+ * 	void abandonarRelevo(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void abandonarRelevo(void){
+	if(pidRelevo > 0){
+		syslog(LOG_ERR, "El nuevo binario %s no ha tomado el relevo, se sigue con el actual", argvServidor[0]);
+		kill(pidRelevo, SIGKILL);
+		waitpid(pidRelevo, NULL, 0);
+	}
+	if(socketRelevo >= 0){
+		close(socketRelevo);
+	}
+	socketRelevo = -1;
+	pidRelevo = -1;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Serializa una conexion
+ *
+ * @synopsis
+ * @code
+ * 	status serializarConexion(pSerieRelevo serie, pConexion conexion)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ * @param[in] conexion la conexion
+ *
+ * @return RELEVO_OK si se pasa al nuevo proceso. RELEVO_ERROR si se queda
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status serializarConexion(pSerieRelevo serie, pConexion conexion){
+	pSesion sesion = conexion->sesion;
+	pTempUser temporal = conexion->temporal;
+	char *salida;
+
+	/* Las que se estan cerrando no se pasan */
+	if(conexion->salida.error || (sesion == NULL && temporal == NULL)){
+		return RELEVO_ERROR;
+	}
+
+	salida = (char *) malloc(conexion->salida.bytes + 1);
+	if(salida == NULL){
+		serie->error = 1;
+		return RELEVO_ERROR;
+	}
+	copiarSalida(&conexion->salida, salida);
+
+	serieEntero(serie, conexion->fd);
+	if(sesion){
+		serieEntero(serie, RELEVO_REGISTRADA);
+		serieCadena(serie, sesion->user);
+		serieCadena(serie, sesion->nick);
+		serieCadena(serie, sesion->real);
+		serieCadena(serie, sesion->host);
+		serieCadena(serie, sesion->IP);
+		serieCadena(serie, sesion->away);
+	} else {
+		serieEntero(serie, RELEVO_TEMPORAL);
+		serieCadena(serie, temporal->IP);
+		serieCadena(serie, temporal->host);
+		serieCadena(serie, temporal->nick);
+	}
+	serieBloque(serie, conexion->entrada.datos ? conexion->entrada.datos : "", conexion->entrada.len);
+	serieBloque(serie, salida, conexion->salida.bytes);
+
+	free(salida);
+
+	return RELEVO_OK;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Serializa los canales del indice con su estado en el TAD
+ *
+ * @synopsis
+ * @code
+ * 	void serializarCanales(pSerieRelevo serie)
+ * @endcode
+ *
+ * @param[in] serie la serie
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void serializarCanales(pSerieRelevo serie){
+	pCanal canal;
+	pSesion sesion;
+	char *topico, *modos;
+	int i, j, num = 0;
+
+	for(i = 0; i < TAM_TABLA_CANALES; i++){
+		for(canal = tablaCanales[i]; canal != NULL; canal = canal->siguiente){
+			num++;
+		}
+	}
+	serieEntero(serie, num);
+
+	for(i = 0; i < TAM_TABLA_CANALES; i++){
+		for(canal = tablaCanales[i]; canal != NULL; canal = canal->siguiente){
+			topico = NULL;
+			IRCTAD_GetTopic(canal->nombre, &topico);
+			modos = IRCTADChan_GetModeChar(canal->nombre);
+
+			serieCadena(serie, canal->nombre);
+			serieCadena(serie, topico);
+			serieCadena(serie, modos);
+			serieCadena(serie, canal->clave);
+
+			serieEntero(serie, canal->miembros ? canal->miembros->num : 0);
+			for(j = 0; canal->miembros && j < canal->miembros->num; j++){
+				sesion = obtenerSesion(canal->miembros->fds[j]);
+				serieEntero(serie, canal->miembros->fds[j]);
+				serieEntero(serie, sesion ? IRCTAD_GetUserModeOnChannel(canal->nombre, sesion->nick) : 0);
+			}
+
+			if(topico) free(topico);
+			if(modos) free(modos);
+		}
+	}
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Pasa los sockets y el estado al nuevo proceso
+ *
+ * Se llama con los reactores y el pool ya terminados, por lo que nada
+ * cambia mientras se serializa. Si algo falla se mata al nuevo proceso,
+ * que puede haber recibido ya parte de los sockets, y las conexiones
+ * siguen siendo de este.
+ *
+ * @synopsis
+ * @code
+ * 	status entregarRelevo(void)
+ * @endcode
+ *
+ * @return RELEVO_OK si el nuevo proceso ha tomado el relevo. RELEVO_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status entregarRelevo(void){
+	SerieRelevo serie;
+	CabeceraRelevo cabecera;
+	int *fds, *anteriores, n = 0, i, enviados, lote;
+	size_t pos, tam;
+	char hecho[sizeof(MENSAJE_HECHO)];
+	int64_t cuenta;
+	status ret = RELEVO_ERROR;
+
+	memset(&serie, 0, sizeof(serie));
+	fds = (int *) malloc((numReactores + maxConexiones) * sizeof(int));
+	if(fds == NULL){
+		return RELEVO_ERROR;
+	}
+	anteriores = fds;
+
+	memset(&cabecera, 0, sizeof(cabecera));
+	cabecera.magia = MAGIA_RELEVO;
+
+	/* Primero los sockets de escucha, sin repetir el compartido */
+	for(i = 0; i < numReactores; i++){
+		if(reactores[i].propio){
+			fds[n++] = reactores[i].sckt;
+		}
+	}
+	cabecera.numEscuchas = n;
+
+	/* Las conexiones en el orden en que se serializan */
+	serieEntero(&serie, 0);
+	for(i = 0; i < maxConexiones; i++){
+		if(tablaConexiones[i].fd == i && serializarConexion(&serie, &tablaConexiones[i]) == RELEVO_OK){
+			fds[n++] = i;
+		}
+	}
+	cabecera.numConexiones = n - cabecera.numEscuchas;
+	serializarCanales(&serie);
+
+	if(serie.error){
+		syslog(LOG_ERR, "Sin memoria para serializar el estado del relevo");
+		goto fin;
+	}
+	cuenta = cabecera.numConexiones;
+	memcpy(serie.datos, &cuenta, sizeof(cuenta));
+	cabecera.tamEstado = serie.len;
+
+	if(enviarPaquete(socketRelevo, &cabecera, sizeof(cabecera), NULL, 0) < 0){
+		goto fin;
+	}
+
+	/* Cada paquete lleva sus descriptores y el numero que tenian aqui */
+	for(enviados = 0; enviados < n; enviados += lote){
+		lote = n - enviados < MAX_FDS_RELEVO ? n - enviados : MAX_FDS_RELEVO;
+		if(enviarPaquete(socketRelevo, anteriores + enviados, lote * sizeof(int), fds + enviados, lote) < 0){
+			goto fin;
+		}
+	}
+
+	for(pos = 0; pos < serie.len; pos += tam){
+		tam = serie.len - pos < TAM_PAQUETE_RELEVO ? serie.len - pos : TAM_PAQUETE_RELEVO;
+		if(enviarPaquete(socketRelevo, serie.datos + pos, tam, NULL, 0) < 0){
+			goto fin;
+		}
+	}
+
+	memset(hecho, 0, sizeof(hecho));
+	if(recibirPaquete(socketRelevo, hecho, sizeof(hecho) - 1, NULL, NULL) < 0 || strcmp(hecho, MENSAJE_HECHO)){
+		syslog(LOG_ERR, "El nuevo proceso no ha confirmado el relevo");
+		goto fin;
+	}
+
+	syslog(LOG_INFO, "Relevo completado: %d sockets de escucha y %d conexiones, %lu bytes de estado",
+		cabecera.numEscuchas, cabecera.numConexiones, (unsigned long) serie.len);
+	ret = RELEVO_OK;
+
+fin:
+	free(serie.datos);
+	free(fds);
+
+	/* Si no lo ha tomado no debe quedarse con ninguna conexion */
+	if(ret == RELEVO_OK){
+		close(socketRelevo);
+		socketRelevo = -1;
+		pidRelevo = -1;
+	} else {
+		abandonarRelevo();
+	}
+
+	return ret;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Avisa al proceso anterior y recibe de el los sockets y el estado
+ *
+ * @synopsis
+ * @code
+ * 	status recibirRelevo(int socket)
+ * @endcode
+ *
+ * @param[in] socket extremo heredado del socketpair
+ *
+ * @return RELEVO_OK si todo va bien. RELEVO_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status recibirRelevo(int socket){
+	CabeceraRelevo cabecera;
+	pRelevo nuevo;
+	int total, recibidos = 0, n;
+	ssize_t len;
+
+	fcntl(socket, F_SETFD, FD_CLOEXEC);
+
+	if(enviarPaquete(socket, MENSAJE_LISTO, strlen(MENSAJE_LISTO), NULL, 0) < 0
+		|| recibirPaquete(socket, &cabecera, sizeof(cabecera), NULL, NULL) != sizeof(cabecera)
+		|| cabecera.magia != MAGIA_RELEVO || cabecera.numEscuchas < 0 || cabecera.numConexiones < 0){
+		syslog(LOG_ERR, "No se ha recibido la cabecera del relevo");
+		return RELEVO_ERROR;
+	}
+
+	nuevo = (pRelevo) calloc(1, sizeof(Relevo));
+	total = cabecera.numEscuchas + cabecera.numConexiones;
+	if(nuevo == NULL || (nuevo->fds = (int *) calloc(total + 1, sizeof(int))) == NULL
+		|| (nuevo->anteriores = (int *) calloc(total + 1, sizeof(int))) == NULL
+		|| (nuevo->estado.datos = (char *) malloc(cabecera.tamEstado + 1)) == NULL){
+		if(nuevo){
+			free(nuevo->fds);
+			free(nuevo->anteriores);
+			free(nuevo);
+		}
+		return RELEVO_ERROR;
+	}
+	nuevo->socket = socket;
+	nuevo->numEscuchas = cabecera.numEscuchas;
+	relevo = nuevo;
+
+	while(recibidos < total){
+		len = recibirPaquete(socket, relevo->anteriores + recibidos, (total - recibidos) * sizeof(int),
+			relevo->fds + recibidos, &n);
+		if(len < 0 || (size_t) len != n * sizeof(int) || n == 0){
+			syslog(LOG_ERR, "Descriptores del relevo incompletos");
+			return RELEVO_ERROR;
+		}
+		recibidos += n;
+		relevo->numConexiones = recibidos - relevo->numEscuchas;
+	}
+
+	relevo->estado.cap = cabecera.tamEstado;
+	while(relevo->estado.len < cabecera.tamEstado){
+		len = recibirPaquete(socket, relevo->estado.datos + relevo->estado.len,
+			cabecera.tamEstado - relevo->estado.len, NULL, NULL);
+		if(len <= 0){
+			syslog(LOG_ERR, "Estado del relevo incompleto");
+			return RELEVO_ERROR;
+		}
+		relevo->estado.len += len;
+	}
+
+	return RELEVO_OK;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Devuelve el socket de escucha heredado para un reactor
+ *
+ * @synopsis
+ * @code
+ * 	int escuchaRelevo(int i)
+ * @endcode
+ *
+ * @param[in] i numero del reactor
+ *
+ * @return el socket, -1 si no se ha heredado ninguno para ese reactor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+int escuchaRelevo(int i){
+	int sckt;
+
+	if(relevo == NULL || i >= relevo->numEscuchas){
+		return -1;
+	}
+
+	sckt = relevo->fds[i];
+	relevo->fds[i] = -1;
+
+	return sckt;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Reconstruye una conexion recibida sin armarla todavia en su reactor
+ *
+ * Lo que quedaba en su cola de salida no se escribe aun: se devuelve para
+ * encolarlo cuando se sabe que el estado esta entero, ya que si no el
+ * proceso anterior lo vuelve a enviar al vaciar sus conexiones.
+ *
+ * @synopsis
+ * @code
+ * 	status restaurarConexion(pSerieRelevo serie, int fd, pReactor reactor, char **salida, size_t *lenSalida)
+ * @endcode
+ *
+ * @param[in] serie el estado, en la posicion de la conexion
+ * @param[in] fd descriptor de la conexion en este proceso
+ * @param[in] reactor reactor al que pasa la conexion
+ * @param[out] salida cola de salida pendiente, dentro de la serie
+ * @param[out] lenSalida bytes de la cola de salida pendiente
+ *
+ * @return RELEVO_OK si todo va bien. RELEVO_ERROR si la conexion se descarta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status restaurarConexion(pSerieRelevo serie, int fd, pReactor reactor, char **salida, size_t *lenSalida){
+	char *user, *nick, *real, *host, *IP, *away = NULL, *entrada;
+	size_t lenEntrada;
+	pConexion conexion;
+	pSesion sesion;
+	status ret = RELEVO_OK;
+	long tipo;
+
+	tipo = leerEntero(serie);
+	if(tipo == RELEVO_REGISTRADA){
+		user = leerCadena(serie);
+		nick = leerCadena(serie);
+		real = leerCadena(serie);
+		host = leerCadena(serie);
+		IP = leerCadena(serie);
+		away = leerCadena(serie);
+	} else {
+		user = real = NULL;
+		IP = leerCadena(serie);
+		host = leerCadena(serie);
+		nick = leerCadena(serie);
+	}
+	entrada = leerBloque(serie, &lenEntrada);
+	*salida = leerBloque(serie, lenSalida);
+
+	if(serie->error || fd < 0 || registrarConexion(fd, reactor) < 0){
+		ret = RELEVO_ERROR;
+		goto fin;
+	}
+	conexion = obtenerConexion(fd);
+
+	if(tipo == RELEVO_REGISTRADA){
+		if(IRCTADUser_New(user, nick, real, NULL, host, IP, fd) != IRC_OK || abrirSesion(fd) != SESION_OK){
+			syslog(LOG_ERR, "No se ha podido restaurar al usuario %s", nick ? nick : "");
+			ret = RELEVO_ERROR;
+			goto fin;
+		}
+		if(away){
+			sesion = obtenerSesion(fd);
+			IRCTADUser_SetAway(sesion->id, sesion->user, sesion->nick, sesion->real, away);
+			cambiarAwaySesion(fd, away);
+		}
+	} else {
+		if(IP == NULL || host == NULL || newTempUser(fd, IP, host) != CON_OK){
+			ret = RELEVO_ERROR;
+			goto fin;
+		}
+		if(nick){
+			setNickTemporal(conexion->temporal, nick);
+		}
+	}
+
+	if(lenEntrada){
+		annadirPendiente(&conexion->entrada, entrada, lenEntrada);
+	}
+
+fin:
+	free(user);
+	free(nick);
+	free(real);
+	free(host);
+	free(IP);
+	free(away);
+
+	return ret;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Reduce los modos de un usuario en un canal a los que se restauran
+ *
+ * El creador cuenta como operador: solo uno de los miembros puede volver
+ * a serlo, y es el primero que entra.
+ *
+ * @synopsis
+ * @code
+ * 	long privilegiosCanal(long modos)
+ * @endcode
+ *
+ * @param[in] modos modos del usuario segun IRCTAD_GetUserModeOnChannel
+ *
+ * @return IRCUMODE_OPERATOR y/o IRCUMODE_VOICE
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+long privilegiosCanal(long modos){
+	long ret = 0;
+
+	if(modos & (IRCUMODE_CREATOR | IRCUMODE_OPERATOR)){
+		ret |= IRCUMODE_OPERATOR;
+	}
+	if(modos & IRCUMODE_VOICE){
+		ret |= IRCUMODE_VOICE;
+	}
+
+	return ret;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Reconstruye un canal con sus miembros, su topic y sus modos
+ *
+ * Primero entra el creador, que recibe los privilegios como al abrir el
+ * canal, y despues el resto; cada miembro recupera luego su +o o su +v y
+ * se avisa por syslog si el TAD no los refleja. Los modos del canal se
+ * ponen al final para que una clave no deje fuera a nadie. De los que
+ * llevan argumento solo se conserva la clave: el TAD no devuelve el valor
+ * de +l, asi que el limite de usuarios se pierde en el relevo.
+ *
+ * @synopsis
+ * @code
+ * 	void restaurarCanal(pSerieRelevo serie, int *mapa, int maxAnterior)
+ * @endcode
+ *
+ * @param[in] serie el estado, en la posicion del canal
+ * @param[in] mapa descriptor en este proceso de cada descriptor anterior, -1 si no se ha restaurado
+ * @param[in] maxAnterior tamanno de mapa
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void restaurarCanal(pSerieRelevo serie, int *mapa, int maxAnterior){
+	char *nombre, *topico, *modos, *clave, *c, modo[4];
+	int num, i, j, anterior, *fds, creador = -1, primero = -1;
+	long *privilegios, esperado, actual;
+	pSesion sesion;
+
+	nombre = leerCadena(serie);
+	topico = leerCadena(serie);
+	modos = leerCadena(serie);
+	clave = leerCadena(serie);
+	num = leerEntero(serie);
+
+	fds = (int *) calloc(num > 0 ? num : 1, sizeof(int));
+	privilegios = (long *) calloc(num > 0 ? num : 1, sizeof(long));
+	if(fds == NULL || privilegios == NULL || nombre == NULL || serie->error){
+		num = 0;
+	}
+
+	for(i = 0; i < num; i++){
+		anterior = leerEntero(serie);
+		privilegios[i] = leerEntero(serie);
+		fds[i] = anterior >= 0 && anterior < maxAnterior ? mapa[anterior] : -1;
+		if(creador < 0 && fds[i] >= 0 && (privilegios[i] & (IRCUMODE_CREATOR | IRCUMODE_OPERATOR))){
+			creador = i;
+		}
+	}
+	if(creador < 0){
+		creador = 0;
+	}
+
+	for(i = 0; i < num; i++){
+		j = (i == 0) ? creador : (i <= creador ? i - 1 : i);
+		sesion = fds[j] >= 0 ? obtenerSesion(fds[j]) : NULL;
+		if(sesion && IRCTAD_Join(nombre, sesion->nick, NULL, NULL) == IRC_OK){
+			unirCanal(nombre, fds[j]);
+			if(primero < 0) primero = fds[j];
+		} else {
+			fds[j] = -1;
+		}
+	}
+
+	/* El resto de operadores y los que tienen voz los recuperan uno a uno */
+	for(i = 0; i < num; i++){
+		sesion = fds[i] >= 0 && fds[i] != primero ? obtenerSesion(fds[i]) : NULL;
+		if(sesion == NULL){
+			continue;
+		}
+		esperado = privilegiosCanal(privilegios[i]);
+		if(esperado & IRCUMODE_OPERATOR){
+			IRCTAD_Mode(nombre, sesion->nick, "\\+o");
+		}
+		if(esperado & IRCUMODE_VOICE){
+			IRCTAD_Mode(nombre, sesion->nick, "\\+v");
+		}
+		actual = IRCTAD_GetUserModeOnChannel(nombre, sesion->nick);
+		if(actual < 0 || privilegiosCanal(actual) != esperado){
+			syslog(LOG_WARNING, "%s no conserva sus privilegios en %s tras el relevo", sesion->nick, nombre);
+		}
+	}
+
+	/* Topic y modos en nombre del primero que ha entrado, que tiene privilegios */
+	sesion = primero >= 0 ? obtenerSesion(primero) : NULL;
+	if(sesion){
+		if(topico){
+			IRCTAD_SetTopic(nombre, sesion->nick, topico);
+		}
+		for(c = modos; c && *c; c++){
+			if(*c == '+' || *c == '-' || *c == 'l'){
+				continue;
+			}
+			if(*c == 'k'){
+				if(clave == NULL){
+					continue;
+				}
+				IRCTADChan_SetPassword(nombre, clave);
+				fijarClaveCanal(nombre, clave);
+			}
+			snprintf(modo, sizeof(modo), "\\+%c", *c);
+			IRCTAD_Mode(nombre, sesion->nick, modo);
+		}
+	}
+
+	free(fds);
+	free(privilegios);
+	free(nombre);
+	free(topico);
+	free(modos);
+	free(clave);
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Deshace una conexion restaurada sin escribir nada en su socket
+ *
+ * El cliente sigue siendo del proceso anterior, asi que no recibe QUIT ni
+ * se vacia su cola; el descriptor lo cierra liberarRelevo.
+ *
+ * @synopsis
+ * @code
+ * 	void descartarRestaurada(int fd)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion en este proceso
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void descartarRestaurada(int fd){
+	pSesion sesion;
+
+	salirTodosCanales(fd);
+	sesion = obtenerSesion(fd);
+	if(sesion && sesion->nick){
+		IRCTAD_Quit(sesion->nick);
+	}
+	liberarConexion(fd);
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Reconstruye las conexiones y los canales recibidos y los arma en los reactores
+ *
+ * Se llama con los reactores inicializados pero antes de lanzar sus hilos,
+ * de modo que ningun cliente nuevo puede coger el nick de un restaurado ni
+ * crear antes uno de sus canales. Cada conexion se reparte en turno entre
+ * los reactores y se arma al final, cuando todo el estado esta restaurado.
+ * Si el estado esta corrupto se deshace todo y no se manda HECHO: el
+ * proceso anterior conserva los clientes y los vacia como en una parada.
+ *
+ * @synopsis
+ * @code
+ * 	status restaurarRelevo(int inicializados)
+ * @endcode
+ *
+ * @param[in] inicializados numero de reactores inicializados
+ *
+ * @return RELEVO_OK si los clientes pasan a este proceso. RELEVO_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status restaurarRelevo(int inicializados){
+	pSerieRelevo serie;
+	int *mapa, *conexiones, i, fd, anterior, maxAnterior = 0, num, numCanales, restauradas = 0;
+	char **salidas;
+	size_t *lenSalidas;
+	status ret = RELEVO_OK;
+
+	if(relevo == NULL || inicializados <= 0){
+		return RELEVO_ERROR;
+	}
+	serie = &relevo->estado;
+
+	/* Los sockets de escucha que no ha tomado ningun reactor no aceptarian a nadie */
+	for(i = 0; i < relevo->numEscuchas; i++){
+		if(relevo->fds[i] >= 0){
+			close(relevo->fds[i]);
+			relevo->fds[i] = -1;
+		}
+	}
+
+	for(i = relevo->numEscuchas; i < relevo->numEscuchas + relevo->numConexiones; i++){
+		if(relevo->anteriores[i] >= maxAnterior){
+			maxAnterior = relevo->anteriores[i] + 1;
+		}
+	}
+
+	mapa = (int *) malloc((maxAnterior + 1) * sizeof(int));
+	conexiones = (int *) malloc((relevo->numConexiones + 1) * sizeof(int));
+	salidas = (char **) malloc((relevo->numConexiones + 1) * sizeof(char *));
+	lenSalidas = (size_t *) malloc((relevo->numConexiones + 1) * sizeof(size_t));
+	if(mapa == NULL || conexiones == NULL || salidas == NULL || lenSalidas == NULL){
+		free(mapa);
+		free(conexiones);
+		free(salidas);
+		free(lenSalidas);
+		return RELEVO_ERROR;
+	}
+	for(i = 0; i < maxAnterior; i++){
+		mapa[i] = -1;
+	}
+	for(i = relevo->numEscuchas; i < relevo->numEscuchas + relevo->numConexiones; i++){
+		mapa[relevo->anteriores[i]] = relevo->fds[i];
+	}
+
+	num = leerEntero(serie);
+	for(i = 0; i < num && !serie->error; i++){
+		anterior = leerEntero(serie);
+		fd = anterior >= 0 && anterior < maxAnterior ? mapa[anterior] : -1;
+		if(restaurarConexion(serie, fd, &reactores[i % inicializados], &salidas[restauradas], &lenSalidas[restauradas]) == RELEVO_OK){
+			conexiones[restauradas++] = fd;
+		} else if(fd >= 0){
+			liberarConexion(fd);
+			mapa[anterior] = -1;
+		}
+	}
+
+	numCanales = leerEntero(serie);
+	for(i = 0; i < numCanales && !serie->error; i++){
+		restaurarCanal(serie, mapa, maxAnterior);
+	}
+
+	if(serie->error){
+		/* Los clientes siguen siendo del proceso anterior, que los vacia al no recibir HECHO */
+		syslog(LOG_ERR, "Estado del relevo corrupto, se devuelven %d conexiones al proceso anterior", relevo->numConexiones);
+		for(i = 0; i < restauradas; i++){
+			descartarRestaurada(conexiones[i]);
+		}
+		ret = RELEVO_ERROR;
+	} else {
+		for(i = 0; i < restauradas; i++){
+			if(lenSalidas[i]){
+				encolarSalida(obtenerConexion(conexiones[i]), salidas[i], lenSalidas[i]);
+			}
+			addFd(conexiones[i]);
+		}
+		syslog(LOG_INFO, "Relevo recibido: %d conexiones y %d canales", restauradas, numCanales);
+		enviarPaquete(relevo->socket, MENSAJE_HECHO, strlen(MENSAJE_HECHO), NULL, 0);
+	}
+
+	free(mapa);
+	free(conexiones);
+	free(salidas);
+	free(lenSalidas);
+	liberarRelevo();
+
+	return ret;
+}
+
+/**
+ * @ingroup Relevo
+ *
+ * @brief Libera el estado recibido, cierra el extremo del relevo y los clientes no restaurados
+ *
+ * @synopsis
+ * @code
+ * 	void liberarRelevo(void)
+ * @endcode
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarRelevo(void){
+	int i;
+
+	if(relevo == NULL){
+		return;
+	}
+
+	/* Los de escucha que no se han usado */
+	for(i = 0; i < relevo->numEscuchas; i++){
+		if(relevo->fds[i] >= 0) close(relevo->fds[i]);
+	}
+
+	/* Los clientes que no se han restaurado no los atiende nadie */
+	for(i = relevo->numEscuchas; i < relevo->numEscuchas + relevo->numConexiones; i++){
+		if(relevo->fds[i] >= 0 && obtenerConexion(relevo->fds[i]) == NULL) close(relevo->fds[i]);
+	}
+
+	close(relevo->socket);
+	free(relevo->fds);
+	free(relevo->anteriores);
+	free(relevo->estado.datos);
+	free(relevo);
+	relevo = NULL;
+}
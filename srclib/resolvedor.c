@@ -0,0 +1,473 @@
+/**
+ * @file resolvedor.c
+ * @brief resolucion inversa de las IPs de los clientes en segundo plano
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Resolvedor Resolvedor
+ *
+ * <hr>
+ */
+
+#include <ctype.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+#include "../includes/resolvedor.h"
+#include "../includes/conexion_temp.h"
+
+/* Despues de config.h: nameser_compat.h define STATUS */
+#include <arpa/nameser.h>
+#include <resolv.h>
+
+/**
+ * @addtogroup Resolvedor
+ * Comprende las funciones del resolvedor inverso. Una consulta PTR lenta no
+ * debe parar al reactor que acepta la conexion: el cliente entra con su IP
+ * como host y unos hilos propios consultan el nombre, que sustituye a la IP
+ * en el usuario temporal cuando llega. Los resultados, tambien los
+ * negativos, se guardan en una cache con caducidad.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Comprueba que un nombre resuelto se puede usar como host IRC
+ *
+ * @synopsis
+ * @code
+ * 	short hostValido(char *host)
+ * @endcode
+ *
+ * @param[in] host el nombre
+ *
+ * @return 1 si solo tiene letras, digitos, '-' y '.', 0 en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+short hostValido(char *host){
+	char *c;
+
+	if(host == NULL || *host == '\0' || *host == '.' || *host == '-'){
+		return 0;
+	}
+
+	for(c = host; *c; c++){
+		if(!isalnum((unsigned char) *c) && *c != '-' && *c != '.'){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Consulta el registro PTR de una IP en el servidor DNS propio
+ *
+ * @synopsis
+ * @code
+ * 	status consultarPTR(res_state estado, struct in_addr addr, char *host, size_t tam)
+ * @endcode
+ *
+ * @param[in] estado estado del resolvedor del hilo, apuntando al servidor propio
+ * @param[in] addr la IP
+ * @param[out] host el nombre
+ * @param[in] tam tamanno de host
+ *
+ * @return DNS_OK si se ha obtenido un nombre. DNS_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status consultarPTR(res_state estado, struct in_addr addr, char *host, size_t tam){
+	unsigned char respuesta[NS_PACKETSZ];
+	unsigned char *b = (unsigned char *) &addr.s_addr;
+	char nombre[32];
+	ns_msg msg;
+	ns_rr rr;
+	int i, n;
+
+	snprintf(nombre, sizeof(nombre), "%u.%u.%u.%u.in-addr.arpa", b[3], b[2], b[1], b[0]);
+
+	n = res_nquery(estado, nombre, ns_c_in, ns_t_ptr, respuesta, sizeof(respuesta));
+	if(n < 0 || ns_initparse(respuesta, n, &msg) < 0){
+		return DNS_ERROR;
+	}
+
+	for(i = 0; i < ns_msg_count(msg, ns_s_an); i++){
+		if(ns_parserr(&msg, ns_s_an, i, &rr) < 0){
+			break;
+		}
+		if(ns_rr_type(rr) == ns_t_ptr &&
+			dn_expand(ns_msg_base(msg), ns_msg_end(msg), ns_rr_rdata(rr), host, tam) >= 0){
+			return DNS_OK;
+		}
+	}
+
+	return DNS_ERROR;
+}
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Guarda el resultado de una resolucion en la cache
+ *
+ * @synopsis
+ * @code
+ * 	void guardarCacheDNS(pResolvedor r, struct in_addr addr, char *host)
+ * @endcode
+ *
+ * @param[in] r el resolvedor
+ * @param[in] addr la IP
+ * @param[in] host el nombre, o NULL si la IP no tiene nombre
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void guardarCacheDNS(pResolvedor r, struct in_addr addr, char *host){
+	pEntradaDNS entrada = &r->cache[ntohl(addr.s_addr) & (TAM_CACHE_DNS - 1)];
+
+	pthread_mutex_lock(&r->mutexCache);
+	entrada->addr = addr.s_addr;
+	entrada->caduca = time(NULL) + (host ? TTL_DNS : TTL_DNS_NEGATIVO);
+	snprintf(entrada->host, sizeof(entrada->host), "%s", host ? host : "");
+	pthread_mutex_unlock(&r->mutexCache);
+}
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Busca una IP en la cache del resolvedor
+ *
+ * @synopsis
+ * @code
+ * 	short buscarCacheDNS(pResolvedor r, struct in_addr addr, char *host, size_t tam)
+ * @endcode
+ *
+ * @param[in] r el resolvedor
+ * @param[in] addr la IP
+ * @param[out] host el nombre si esta en cache; si se sabe que no tiene nombre no se toca
+ * @param[in] tam tamanno de host
+ *
+ * @return 1 si la cache tiene la respuesta, 0 si hay que resolver
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+short buscarCacheDNS(pResolvedor r, struct in_addr addr, char *host, size_t tam){
+	pEntradaDNS entrada;
+	short encontrado = 0;
+
+	if(r == NULL){
+		return 0;
+	}
+
+	entrada = &r->cache[ntohl(addr.s_addr) & (TAM_CACHE_DNS - 1)];
+
+	pthread_mutex_lock(&r->mutexCache);
+	if(entrada->caduca > time(NULL) && entrada->addr == addr.s_addr){
+		if(entrada->host[0]){
+			snprintf(host, tam, "%s", entrada->host);
+		}
+		encontrado = 1;
+	}
+	pthread_mutex_unlock(&r->mutexCache);
+
+	if(encontrado){
+		__sync_fetch_and_add(&r->aciertosCache, 1);
+	}
+
+	return encontrado;
+}
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Hilo del resolvedor: consulta los nombres y actualiza los usuarios temporales
+ *
+ * Si la respuesta llega despues de TIMEOUT_DNS se guarda en cache pero el
+ * cliente se queda con su IP.
+ *
+ * @synopsis
+ * @code
+ * 	void *hiloResolvedor(void *arg)
+ * @endcode
+ *
+ * @param[in] arg el resolvedor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void *hiloResolvedor(void *arg){
+	pResolvedor r = (pResolvedor) arg;
+	struct __res_state estado;
+	struct sockaddr_in sa;
+	struct timespec ahora;
+	PeticionDNS peticion;
+	char host[MAX_HOST_DNS], ip[INET_ADDRSTRLEN];
+	status ret;
+
+	/* Con servidor propio cada hilo tiene su estado apuntando a el */
+	if(r->propio){
+		memset(&estado, 0, sizeof(estado));
+		res_ninit(&estado);
+		estado.nsaddr_list[0] = r->servidor;
+		estado.nscount = 1;
+		estado.retrans = TIMEOUT_DNS;
+		estado.retry = 1;
+	}
+
+	while(1){
+
+		pthread_mutex_lock(&r->mutex);
+		while(r->num == 0 && r->activo){
+			pthread_cond_wait(&r->noVacia, &r->mutex);
+		}
+
+		/* Al parar se descartan las pendientes, los clientes se quedan con su IP */
+		if(!r->activo){
+			pthread_mutex_unlock(&r->mutex);
+			break;
+		}
+
+		peticion = r->cola[r->cabeza];
+		r->cabeza = (r->cabeza + 1) % COLA_DNS;
+		r->num--;
+		pthread_mutex_unlock(&r->mutex);
+
+		if(r->propio){
+			ret = consultarPTR(&estado, peticion.addr, host, sizeof(host));
+		} else {
+			memset(&sa, 0, sizeof(sa));
+			sa.sin_family = AF_INET;
+			sa.sin_addr = peticion.addr;
+			ret = getnameinfo((struct sockaddr *) &sa, sizeof(sa), host, sizeof(host), NULL, 0, NI_NAMEREQD) == 0 ? DNS_OK : DNS_ERROR;
+		}
+
+		if(ret == DNS_OK && !hostValido(host)){
+			ret = DNS_ERROR;
+		}
+
+		guardarCacheDNS(r, peticion.addr, ret == DNS_OK ? host : NULL);
+
+		if(ret != DNS_OK){
+			__sync_fetch_and_add(&r->sinNombre, 1);
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &ahora);
+		if(ahora.tv_sec - peticion.inicio.tv_sec >= TIMEOUT_DNS){
+			__sync_fetch_and_add(&r->caducadas, 1);
+			continue;
+		}
+
+		/* Si el cliente ya se ha registrado conserva la IP con la que entro */
+		inet_ntop(AF_INET, &peticion.addr, ip, sizeof(ip));
+		if(setHostTemporal(peticion.fd, ip, host) == CON_OK){
+			__sync_fetch_and_add(&r->resueltas, 1);
+		} else {
+			__sync_fetch_and_add(&r->caducadas, 1);
+		}
+	}
+
+	if(r->propio){
+		res_nclose(&estado);
+	}
+
+	return NULL;
+}
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Crea el resolvedor y lanza sus hilos
+ *
+ * @synopsis
+ * @code
+ * 	pResolvedor crearResolvedor(int nHilos, char *servidor)
+ * @endcode
+ *
+ * @param[in] nHilos numero de hilos
+ * @param[in] servidor servidor DNS con formato ip[:puerto], o NULL para usar el del sistema
+ *
+ * @return el resolvedor creado, o NULL en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pResolvedor crearResolvedor(int nHilos, char *servidor){
+	pResolvedor r;
+	char ip[INET_ADDRSTRLEN], *puerto;
+	int i;
+
+	if(nHilos <= 0){
+		return NULL;
+	}
+
+	r = (pResolvedor) calloc(1, sizeof(Resolvedor));
+	if(r == NULL){
+		return NULL;
+	}
+
+	/* Servidor propio, util para probar contra un DNS local */
+	if(servidor){
+		snprintf(ip, sizeof(ip), "%s", servidor);
+		puerto = strchr(ip, ':');
+		if(puerto) *puerto++ = '\0';
+
+		r->servidor.sin_family = AF_INET;
+		r->servidor.sin_port = htons(puerto ? atoi(puerto) : NS_DEFAULTPORT);
+		if(inet_pton(AF_INET, ip, &r->servidor.sin_addr) != 1){
+			syslog(LOG_ERR, "Servidor DNS no valido: %s", servidor);
+			free(r);
+			return NULL;
+		}
+		r->propio = 1;
+	}
+
+	r->hilos = (pthread_t *) calloc(nHilos, sizeof(pthread_t));
+	if(r->hilos == NULL){
+		free(r);
+		return NULL;
+	}
+
+	r->activo = 1;
+	pthread_mutex_init(&r->mutex, NULL);
+	pthread_mutex_init(&r->mutexCache, NULL);
+	pthread_cond_init(&r->noVacia, NULL);
+
+	for(i = 0; i < nHilos; i++){
+		if(pthread_create(&r->hilos[i], NULL, hiloResolvedor, (void *) r) != 0){
+			syslog(LOG_ERR, "Error lanzando hilo resolvedor %d", i);
+			break;
+		}
+		r->nHilos++;
+	}
+
+	if(r->nHilos == 0){
+		destruirResolvedor(r);
+		return NULL;
+	}
+
+	return r;
+}
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Pide el nombre de la IP de una conexion sin bloquear
+ *
+ * El usuario temporal de la conexion debe existir ya con su IP como host.
+ * Si la cola esta llena no se espera: el cliente se queda con su IP.
+ *
+ * @synopsis
+ * @code
+ * 	status pedirResolucion(pResolvedor r, int fd, struct in_addr addr)
+ * @endcode
+ *
+ * @param[in] r el resolvedor
+ * @param[in] fd la conexion
+ * @param[in] addr su IP
+ *
+ * @return DNS_OK si se ha encolado. DNS_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status pedirResolucion(pResolvedor r, int fd, struct in_addr addr){
+	pPeticionDNS peticion;
+
+	if(r == NULL){
+		return DNS_ERROR;
+	}
+
+	pthread_mutex_lock(&r->mutex);
+
+	if(!r->activo || r->num == COLA_DNS){
+		pthread_mutex_unlock(&r->mutex);
+		__sync_fetch_and_add(&r->descartadas, 1);
+		return DNS_ERROR;
+	}
+
+	peticion = &r->cola[(r->cabeza + r->num) % COLA_DNS];
+	peticion->fd = fd;
+	peticion->addr = addr;
+	clock_gettime(CLOCK_MONOTONIC, &peticion->inicio);
+	r->num++;
+
+	pthread_cond_signal(&r->noVacia);
+	pthread_mutex_unlock(&r->mutex);
+
+	return DNS_OK;
+}
+
+/**
+ * @ingroup Resolvedor
+ *
+ * @brief Para el resolvedor, espera a sus hilos y libera memoria
+ *
+ * Las consultas en curso terminan como mucho tras TIMEOUT_DNS.
+ *
+ * @synopsis
+ * @code
+ * 	void destruirResolvedor(pResolvedor r)
+ * @endcode
+ *
+ * @param[in] r el resolvedor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void destruirResolvedor(pResolvedor r){
+	int i;
+
+	if(r == NULL){
+		return;
+	}
+
+	pthread_mutex_lock(&r->mutex);
+	r->activo = 0;
+	pthread_cond_broadcast(&r->noVacia);
+	pthread_mutex_unlock(&r->mutex);
+
+	for(i = 0; i < r->nHilos; i++){
+		pthread_join(r->hilos[i], NULL);
+	}
+
+	pthread_mutex_destroy(&r->mutex);
+	pthread_mutex_destroy(&r->mutexCache);
+	pthread_cond_destroy(&r->noVacia);
+	free(r->hilos);
+	free(r);
+}
@@ -0,0 +1,750 @@
+/**
+ * @file respuestas.c
+ * @brief formateo de las respuestas frecuentes del servidor sin reservar memoria
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Respuestas Respuestas
+ *
+ * <hr>
+ */
+
+#include "../includes/respuestas.h"
+#include "../includes/red_servidor.h"
+
+/**
+ * @addtogroup Respuestas
+ * Sustituye a los IRCMsg_* en las respuestas de cada comando frecuente:
+ * cada una se escribe en una Respuesta, normalmente en la pila del
+ * trabajador, y se envia con su longitud, sin malloc, strlen ni free. Las
+ * partes fijas de cada formato son literales cuya longitud se calcula al
+ * compilar. Una respuesta nunca pasa de MAX_RESPUESTA: si un campo no cabe
+ * se recorta y la linea sigue terminando en CRLF.
+ *
+ * <hr>
+ */
+
+typedef struct _TextoError {
+
+	int numerica;
+	char *codigo; /**< La numerica como texto, siempre tres cifras */
+	char *texto; /**< Parametro final, con los dos puntos */
+	size_t len;
+
+} TextoError;
+
+#define TEXTO_ERROR(numerica, codigo, texto) {numerica, codigo, texto, sizeof(texto) - 1}
+
+TextoError textosError[] = {
+	TEXTO_ERROR(RESP_NOSUCHNICK, "401", ":No such nick/channel"),
+	TEXTO_ERROR(RESP_NOSUCHCHANNEL, "403", ":No such channel"),
+	TEXTO_ERROR(RESP_NOORIGIN, "409", ":No origin specified"),
+	TEXTO_ERROR(RESP_NOTEXTTOSEND, "412", ":No text to send"),
+	TEXTO_ERROR(RESP_UNKNOWNCOMMAND, "421", ":Unknown command"),
+	TEXTO_ERROR(RESP_NONICKNAMEGIVEN, "431", ":No nickname given"),
+	TEXTO_ERROR(RESP_NOTONCHANNEL, "442", ":You're not on that channel"),
+	TEXTO_ERROR(RESP_NOTREGISTERED, "451", ":You have not registered"),
+	TEXTO_ERROR(RESP_NEEDMOREPARAMS, "461", ":Not enough parameters"),
+	TEXTO_ERROR(RESP_CHANOPRIVSNEEDED, "482", ":You're not channel operator"),
+};
+
+#define NUM_TEXTOS_ERROR ((int) (sizeof(textosError) / sizeof(textosError[0])))
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Escribe un campo intermedio, un asterisco si no lo hay
+ *
+ * @synopsis
+ * @code
+ * 	void escribirCampo(pRespuesta r, char *campo)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] campo el campo
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void escribirCampo(pRespuesta r, char *campo){
+
+	if(campo == NULL || *campo == '\0'){
+		ESCRIBIR_LITERAL(r, "*");
+	} else {
+		escribirCadena(r, campo);
+	}
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Empieza una respuesta con el prefijo de quien la firma
+ *
+ * @synopsis
+ * @code
+ * 	void iniciarRespuesta(pRespuesta r, char *prefijo)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] prefijo prefijo sin los dos puntos, NULL para el del servidor
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void iniciarRespuesta(pRespuesta r, char *prefijo){
+
+	r->len = 0;
+	r->truncada = 0;
+
+	if(prefijo == NULL){
+		ESCRIBIR_LITERAL(r, CABECERA_SERVICIO);
+	} else {
+		ESCRIBIR_LITERAL(r, ":");
+		escribirCadena(r, prefijo);
+		ESCRIBIR_LITERAL(r, " ");
+	}
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Cierra la respuesta con CRLF y '\\0'
+ *
+ * @synopsis
+ * @code
+ * 	size_t terminarRespuesta(pRespuesta r)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ *
+ * @return la longitud de la respuesta, CRLF incluido
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t terminarRespuesta(pRespuesta r){
+
+	if(r->truncada){
+		__sync_fetch_and_add(&respuestasTruncadas, 1);
+	}
+
+	r->datos[r->len++] = '\r';
+	r->datos[r->len++] = '\n';
+	r->datos[r->len] = '\0';
+
+	return r->len;
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea una numerica de error
+ *
+ * :servidor <numerica> <nick> [<parametro>] :<texto>
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaError(pRespuesta r, int numerica, char *nick, char *parametro)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] numerica una de las RESP_*
+ * @param[in] nick destinatario, "*" si no esta registrado
+ * @param[in] parametro comando, nick o canal al que se refiere el error, o
+ * NULL. Se escribe hasta el primer espacio o fin de linea
+ *
+ * @return la longitud de la respuesta, 0 si la numerica no se formatea aqui
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaError(pRespuesta r, int numerica, char *nick, char *parametro){
+	TextoError *t = NULL;
+	int i;
+
+	for(i = 0; i < NUM_TEXTOS_ERROR; i++){
+		if(textosError[i].numerica == numerica){
+			t = &textosError[i];
+			break;
+		}
+	}
+	if(t == NULL){
+		r->len = 0;
+		return 0;
+	}
+
+	iniciarRespuesta(r, NULL);
+	escribirRespuesta(r, t->codigo, 3);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, nick);
+	if(parametro != NULL){
+		/* Es un parametro intermedio: de una linea entera solo queda el verbo */
+		ESCRIBIR_LITERAL(r, " ");
+		escribirRespuesta(r, parametro, strcspn(parametro, " \r\n"));
+	}
+	ESCRIBIR_LITERAL(r, " ");
+	escribirRespuesta(r, t->texto, t->len);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea un PRIVMSG para reenviarlo
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaPrivmsg(pRespuesta r, char *prefijo, char *destino, char *texto)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] prefijo prefijo del emisor
+ * @param[in] destino nick o canal
+ * @param[in] texto el mensaje
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaPrivmsg(pRespuesta r, char *prefijo, char *destino, char *texto){
+
+	iniciarRespuesta(r, prefijo);
+	ESCRIBIR_LITERAL(r, "PRIVMSG ");
+	escribirCadena(r, destino);
+	ESCRIBIR_LITERAL(r, " :");
+	escribirCadena(r, texto);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea el PONG que responde a un PING
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaPong(pRespuesta r, char *destino, char *origen)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] destino segundo parametro del PING, o NULL
+ * @param[in] origen primer parametro del PING, que vuelve como final
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaPong(pRespuesta r, char *destino, char *origen){
+
+	iniciarRespuesta(r, NULL);
+	ESCRIBIR_LITERAL(r, "PONG " SERVICIO);
+	if(destino != NULL){
+		ESCRIBIR_LITERAL(r, " ");
+		escribirCadena(r, destino);
+	}
+	ESCRIBIR_LITERAL(r, " :");
+	escribirCadena(r, origen);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea el JOIN que reciben los miembros de un canal
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaJoin(pRespuesta r, char *prefijo, char *canal)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] prefijo prefijo de quien entra
+ * @param[in] canal el canal
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaJoin(pRespuesta r, char *prefijo, char *canal){
+
+	iniciarRespuesta(r, prefijo);
+	ESCRIBIR_LITERAL(r, "JOIN ");
+	escribirCadena(r, canal);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea el PART que reciben los miembros de un canal
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaPart(pRespuesta r, char *prefijo, char *canal, char *texto)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] prefijo prefijo de quien sale
+ * @param[in] canal el canal
+ * @param[in] texto mensaje de despedida, o NULL
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaPart(pRespuesta r, char *prefijo, char *canal, char *texto){
+
+	iniciarRespuesta(r, prefijo);
+	ESCRIBIR_LITERAL(r, "PART ");
+	escribirCadena(r, canal);
+	if(texto != NULL){
+		ESCRIBIR_LITERAL(r, " :");
+		escribirCadena(r, texto);
+	}
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea el QUIT que reciben los vecinos de quien se va
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaQuit(pRespuesta r, char *prefijo, char *texto)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] prefijo prefijo de quien se va
+ * @param[in] texto motivo de la salida, o NULL
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaQuit(pRespuesta r, char *prefijo, char *texto){
+
+	iniciarRespuesta(r, prefijo);
+	ESCRIBIR_LITERAL(r, "QUIT");
+	if(texto != NULL){
+		ESCRIBIR_LITERAL(r, " :");
+		escribirCadena(r, texto);
+	}
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea el NICK que reciben los vecinos de quien cambia de nick
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaNick(pRespuesta r, char *prefijo, char *nick)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] prefijo prefijo con el nick anterior
+ * @param[in] nick el nick nuevo
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaNick(pRespuesta r, char *prefijo, char *nick){
+
+	iniciarRespuesta(r, prefijo);
+	ESCRIBIR_LITERAL(r, "NICK :");
+	escribirCadena(r, nick);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea una RPL_NAMREPLY (353) con parte de los nicks de un canal
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaNamReply(pRespuesta r, char *nick, char *canal, char *nombres, size_t len)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] nick destinatario
+ * @param[in] canal el canal
+ * @param[in] nombres nicks separados por espacios
+ * @param[in] len bytes de nombres que van en esta respuesta
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaNamReply(pRespuesta r, char *nick, char *canal, char *nombres, size_t len){
+
+	INICIAR_NUMERICA(r, "353");
+	escribirCampo(r, nick);
+	ESCRIBIR_LITERAL(r, " = ");
+	escribirCadena(r, canal);
+	ESCRIBIR_LITERAL(r, " :");
+	escribirRespuesta(r, nombres, len);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea una RPL_ENDOFNAMES (366)
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaEndOfNames(pRespuesta r, char *nick, char *canal)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] nick destinatario
+ * @param[in] canal el canal, "*" si se listaban todos
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaEndOfNames(pRespuesta r, char *nick, char *canal){
+
+	INICIAR_NUMERICA(r, "366");
+	escribirCampo(r, nick);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, canal);
+	ESCRIBIR_LITERAL(r, " :End of NAMES list");
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea una RPL_WHOREPLY (352) de un miembro de un canal
+ *
+ * :servidor 352 <nick> <canal> <user> <host> <servidor> <nick miembro> H :0 <nombre real>
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaWhoReply(pRespuesta r, char *nick, char *canal, char *user, char *host, char *nickMiembro, char *real)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] nick destinatario
+ * @param[in] canal el canal
+ * @param[in] user usuario del miembro
+ * @param[in] host host del miembro
+ * @param[in] nickMiembro nick del miembro
+ * @param[in] real nombre real del miembro
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaWhoReply(pRespuesta r, char *nick, char *canal, char *user, char *host, char *nickMiembro, char *real){
+
+	INICIAR_NUMERICA(r, "352");
+	escribirCampo(r, nick);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, canal);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, user);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, host);
+	ESCRIBIR_LITERAL(r, " " SERVICIO " ");
+	escribirCampo(r, nickMiembro);
+	ESCRIBIR_LITERAL(r, " H :0 ");
+	escribirCadena(r, real);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea una RPL_ENDOFWHO (315)
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaEndOfWho(pRespuesta r, char *nick, char *mascara)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] nick destinatario
+ * @param[in] mascara la mascara del WHO
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaEndOfWho(pRespuesta r, char *nick, char *mascara){
+
+	INICIAR_NUMERICA(r, "315");
+	escribirCampo(r, nick);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, mascara);
+	ESCRIBIR_LITERAL(r, " :End of WHO list");
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea una RPL_LIST (322)
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaList(pRespuesta r, char *nick, char *canal, char *visibles, char *topic)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] nick destinatario
+ * @param[in] canal el canal
+ * @param[in] visibles campo de visibles del canal
+ * @param[in] topic el topic, o NULL
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaList(pRespuesta r, char *nick, char *canal, char *visibles, char *topic){
+
+	INICIAR_NUMERICA(r, "322");
+	escribirCampo(r, nick);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, canal);
+	ESCRIBIR_LITERAL(r, " ");
+	escribirCampo(r, visibles);
+	ESCRIBIR_LITERAL(r, " :");
+	escribirCadena(r, topic);
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea una RPL_LISTEND (323)
+ *
+ * @synopsis
+ * @code
+ * 	size_t respuestaListEnd(pRespuesta r, char *nick)
+ * @endcode
+ *
+ * @param[in] r la respuesta
+ * @param[in] nick destinatario
+ *
+ * @return la longitud de la respuesta
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+size_t respuestaListEnd(pRespuesta r, char *nick){
+
+	INICIAR_NUMERICA(r, "323");
+	escribirCampo(r, nick);
+	ESCRIBIR_LITERAL(r, " :End of LIST");
+
+	return terminarRespuesta(r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Envia una respuesta ya formateada
+ *
+ * @synopsis
+ * @code
+ * 	status enviarRespuesta(int sckfd, pRespuesta r)
+ * @endcode
+ *
+ * @param[in] sckfd socket del destinatario
+ * @param[in] r la respuesta
+ *
+ * @return RED_OK si todo va bien. RED_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status enviarRespuesta(int sckfd, pRespuesta r){
+
+	if(r == NULL || r->len == 0){
+		return RED_ERROR;
+	}
+
+	return enviarDatos(sckfd, r->datos, r->len);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Formatea y envia una numerica de error
+ *
+ * @synopsis
+ * @code
+ * 	status enviarError(int sckfd, int numerica, char *nick, char *parametro)
+ * @endcode
+ *
+ * @param[in] sckfd socket del destinatario
+ * @param[in] numerica una de las RESP_*
+ * @param[in] nick destinatario, "*" si no esta registrado
+ * @param[in] parametro comando, nick o canal al que se refiere el error, o NULL
+ *
+ * @return RED_OK si todo va bien. RED_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status enviarError(int sckfd, int numerica, char *nick, char *parametro){
+	Respuesta r;
+
+	if(respuestaError(&r, numerica, nick, parametro) == 0){
+		return RED_ERROR;
+	}
+
+	return enviarRespuesta(sckfd, &r);
+}
+
+/**
+ * @ingroup Respuestas
+ *
+ * @brief Envia los nicks de un canal en tantas RPL_NAMREPLY como hagan falta
+ *
+ * Los nicks se reparten entre respuestas de como mucho MAX_RESPUESTA
+ * bytes, cortando siempre entre dos nicks.
+ *
+ * @synopsis
+ * @code
+ * 	status enviarNombres(int sckfd, char *nick, char *canal, char *nombres)
+ * @endcode
+ *
+ * @param[in] sckfd socket del destinatario
+ * @param[in] nick destinatario
+ * @param[in] canal el canal
+ * @param[in] nombres nicks separados por espacios
+ *
+ * @return RED_OK si todo va bien. RED_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status enviarNombres(int sckfd, char *nick, char *canal, char *nombres){
+	Respuesta r;
+	size_t fijo, libre, len, corte;
+	char *p;
+
+	if(nombres == NULL){
+		return RED_ERROR;
+	}
+
+	/* Lo que ocupa la respuesta sin ningun nick */
+	fijo = respuestaNamReply(&r, nick, canal, "", 0);
+	libre = fijo < MAX_RESPUESTA ? MAX_RESPUESTA - fijo : 0;
+
+	p = nombres;
+	while(*p == ' '){
+		p++;
+	}
+
+	do {
+		len = strlen(p);
+		if(len > libre && libre > 0){
+			/* Se corta en el ultimo espacio que cabe, salvo un nick que no quepa solo */
+			for(corte = libre; corte > 0 && p[corte] != ' '; corte--);
+			len = corte > 0 ? corte : libre;
+		}
+
+		respuestaNamReply(&r, nick, canal, p, len);
+		if(enviarRespuesta(sckfd, &r) != RED_OK){
+			return RED_ERROR;
+		}
+
+		p += len;
+		while(*p == ' '){
+			p++;
+		}
+	} while(*p != '\0');
+
+	return RED_OK;
+}
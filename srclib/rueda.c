@@ -0,0 +1,315 @@
+/**
+ * @file rueda.c
+ * @brief rueda jerarquica de temporizadores de cada reactor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Rueda Rueda
+ *
+ * <hr>
+ */
+
+#include "../includes/rueda.h"
+
+/**
+ * @addtogroup Rueda
+ * Los temporizadores van en la propia estructura que vigilan, por lo que
+ * programar y cancelar no reservan memoria y cuestan O(1).
+ *
+ * El nivel 0 tiene una ranura por tick; cada nivel siguiente cubre
+ * RANURAS_RUEDA veces mas tiempo por ranura. Un temporizador va al nivel
+ * mas bajo que alcanza su vencimiento, y cuando el nivel 0 da la vuelta la
+ * ranura que toca del nivel 1 se reparte en el nivel 0 (y asi hacia
+ * arriba). Cada tick solo mira una ranura, y cada temporizador se mueve
+ * como mucho NIVELES_RUEDA veces, tenga la rueda los que tenga.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Rueda
+ *
+ * @brief Coloca un temporizador en la ranura de su vencimiento
+ *
+ * Lo que ya ha vencido va al siguiente tick y lo que queda fuera de
+ * alcance se recorta al ultimo tick que la rueda puede guardar.
+ *
+ * @synopsis
+ * @code
+ * 	void insertarTemporizador(pRueda rueda, pTemporizador temporizador)
+ * @endcode
+ *
+ * @param[in] rueda la rueda, con su mutex cogido
+ * @param[in] temporizador el temporizador, fuera de la rueda
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void insertarTemporizador(pRueda rueda, pTemporizador temporizador){
+	unsigned long siguiente = rueda->ahora + 1;
+	unsigned long distancia;
+	pTemporizador *ranura;
+	int nivel;
+
+	if(temporizador->vence < siguiente){
+		temporizador->vence = siguiente;
+	}
+
+	distancia = temporizador->vence - siguiente;
+	if(distancia >= ALCANCE_RUEDA){
+		distancia = ALCANCE_RUEDA - 1;
+		temporizador->vence = siguiente + distancia;
+	}
+
+	for(nivel = 0; distancia >= (1UL << (BITS_RUEDA * (nivel + 1))); nivel++);
+
+	ranura = &rueda->ranuras[nivel][(temporizador->vence >> (BITS_RUEDA * nivel)) & MASCARA_RUEDA];
+
+	temporizador->sig = *ranura;
+	if(*ranura){
+		(*ranura)->pant = &temporizador->sig;
+	}
+	temporizador->pant = ranura;
+	*ranura = temporizador;
+}
+
+/**
+ * @ingroup Rueda
+ *
+ * @brief Saca un temporizador de su ranura
+ *
+ * @synopsis
+ * @code
+ * 	void desenlazarTemporizador(pTemporizador temporizador)
+ * @endcode
+ *
+ * @param[in] temporizador el temporizador, programado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void desenlazarTemporizador(pTemporizador temporizador){
+
+	*temporizador->pant = temporizador->sig;
+	if(temporizador->sig){
+		temporizador->sig->pant = temporizador->pant;
+	}
+	temporizador->sig = NULL;
+	temporizador->pant = NULL;
+}
+
+/**
+ * @ingroup Rueda
+ *
+ * @brief Inicializa una rueda vacia en el tick 0
+ *
+ * @synopsis
+ * @code
+ * 	status inicializarRueda(pRueda rueda, DisparoTemporizador disparo)
+ * @endcode
+ *
+ * @param[in] rueda la rueda
+ * @param[in] disparo funcion a la que se llama con cada temporizador que vence
+ *
+ * @return RUEDA_OK si todo va bien. RUEDA_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status inicializarRueda(pRueda rueda, DisparoTemporizador disparo){
+
+	memset(rueda->ranuras, 0, sizeof(rueda->ranuras));
+	rueda->ahora = 0;
+	rueda->disparo = disparo;
+	rueda->programados = 0;
+	rueda->disparados = 0;
+
+	if(pthread_mutex_init(&rueda->mutex, NULL) != 0){
+		syslog(LOG_ERR, "Error inicializando el mutex de la rueda de temporizadores");
+		return RUEDA_ERROR;
+	}
+
+	return RUEDA_OK;
+}
+
+/**
+ * @ingroup Rueda
+ *
+ * @brief Programa un temporizador, o lo reprograma si ya lo estaba
+ *
+ * @synopsis
+ * @code
+ * 	void programarTemporizador(pRueda rueda, pTemporizador temporizador, unsigned long vence)
+ * @endcode
+ *
+ * @param[in] rueda la rueda
+ * @param[in] temporizador el temporizador
+ * @param[in] vence tick en el que vence
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void programarTemporizador(pRueda rueda, pTemporizador temporizador, unsigned long vence){
+
+	pthread_mutex_lock(&rueda->mutex);
+	if(temporizador->pant){
+		desenlazarTemporizador(temporizador);
+	} else {
+		rueda->programados++;
+	}
+	temporizador->vence = vence;
+	insertarTemporizador(rueda, temporizador);
+	pthread_mutex_unlock(&rueda->mutex);
+}
+
+/**
+ * @ingroup Rueda
+ *
+ * @brief Saca un temporizador de la rueda si estaba programado
+ *
+ * Al volver el temporizador no esta disparandose, por lo que la estructura
+ * que lo contiene se puede reutilizar.
+ *
+ * @synopsis
+ * @code
+ * 	void cancelarTemporizador(pRueda rueda, pTemporizador temporizador)
+ * @endcode
+ *
+ * @param[in] rueda la rueda
+ * @param[in] temporizador el temporizador
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void cancelarTemporizador(pRueda rueda, pTemporizador temporizador){
+
+	pthread_mutex_lock(&rueda->mutex);
+	if(temporizador->pant){
+		desenlazarTemporizador(temporizador);
+		rueda->programados--;
+	}
+	pthread_mutex_unlock(&rueda->mutex);
+}
+
+/**
+ * @ingroup Rueda
+ *
+ * @brief Avanza la rueda y dispara los temporizadores que vencen
+ *
+ * Si el disparo devuelve un tick el temporizador se vuelve a programar;
+ * si devuelve uno que ya ha pasado vence en el siguiente tick.
+ *
+ * @synopsis
+ * @code
+ * 	void avanzarRueda(pRueda rueda, unsigned long ticks)
+ * @endcode
+ *
+ * @param[in] rueda la rueda
+ * @param[in] ticks ticks transcurridos desde la ultima llamada
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void avanzarRueda(pRueda rueda, unsigned long ticks){
+	pTemporizador temporizador, vencidos;
+	unsigned long siguiente, vence;
+	int nivel, indice, ranura;
+
+	pthread_mutex_lock(&rueda->mutex);
+
+	while(ticks-- > 0){
+		siguiente = rueda->ahora + 1;
+		indice = siguiente & MASCARA_RUEDA;
+
+		/* El nivel 0 da la vuelta: bajamos la ranura que toca de cada nivel superior */
+		if(indice == 0){
+			for(nivel = 1; nivel < NIVELES_RUEDA; nivel++){
+				ranura = (siguiente >> (BITS_RUEDA * nivel)) & MASCARA_RUEDA;
+				while((temporizador = rueda->ranuras[nivel][ranura]) != NULL){
+					desenlazarTemporizador(temporizador);
+					insertarTemporizador(rueda, temporizador);
+				}
+				if(ranura != 0){
+					break;
+				}
+			}
+		}
+
+		rueda->ahora = siguiente;
+
+		/* Se saca la ranura entera: lo que se reprograme a una vuelta vuelve a caer en ella */
+		vencidos = rueda->ranuras[0][indice];
+		rueda->ranuras[0][indice] = NULL;
+		if(vencidos){
+			vencidos->pant = &vencidos;
+		}
+
+		while((temporizador = vencidos) != NULL){
+			desenlazarTemporizador(temporizador);
+			rueda->disparados++;
+
+			vence = rueda->disparo(temporizador, siguiente);
+			if(vence){
+				temporizador->vence = vence;
+				insertarTemporizador(rueda, temporizador);
+			} else {
+				rueda->programados--;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&rueda->mutex);
+}
+
+/**
+ * @ingroup Rueda
+ *
+ * @brief Libera la rueda; los temporizadores programados se quedan sin disparar
+ *
+ * @synopsis
+ * @code
+ * 	void liberarRueda(pRueda rueda)
+ * @endcode
+ *
+ * @param[in] rueda la rueda
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarRueda(pRueda rueda){
+	int nivel, ranura;
+
+	for(nivel = 0; nivel < NIVELES_RUEDA; nivel++){
+		for(ranura = 0; ranura < RANURAS_RUEDA; ranura++){
+			while(rueda->ranuras[nivel][ranura] != NULL){
+				desenlazarTemporizador(rueda->ranuras[nivel][ranura]);
+			}
+		}
+	}
+	rueda->programados = 0;
+
+	pthread_mutex_destroy(&rueda->mutex);
+}
@@ -0,0 +1,337 @@
+/**
+ * @file sesiones.c
+ * @brief identidad registrada de cada conexion, indexada por descriptor
+ * @author Pablo Marcos  <pablo.marcos@estudiante.uam.es>
+ * @author Dionisio Perez  <dionisio.perez@estudiante.uam.es>
+ */
+
+/**
+ * @defgroup Sesiones Sesiones
+ *
+ * <hr>
+ */
+
+#include "../includes/sesiones.h"
+#include "../includes/conexiones.h"
+#include "../includes/funciones_servidor.h"
+
+#include <redes2/irc.h>
+
+/**
+ * @addtogroup Sesiones
+ * Comprende las funciones de la sesion de cada conexion. Al registrarse el
+ * usuario se copian sus datos del TAD una sola vez y los comandos los leen
+ * por puntero desde la tabla de conexiones, sin pedir copias al TAD.
+ *
+ * Solo el hilo que atiende la conexion modifica su sesion, siempre con el
+ * mutex de la conexion, y una conexion nunca se atiende en dos hilos a la
+ * vez: ese hilo la lee sin bloquear, cualquier otro debe tomar el mutex.
+ *
+ * <hr>
+ */
+
+/**
+ * @ingroup Sesiones
+ *
+ * @brief Crea la sesion de una conexion que acaba de registrarse en el TAD
+ *
+ * @synopsis
+ * @code
+ * 	status abrirSesion(int fd)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion
+ *
+ * @return SESION_OK si todo va bien. SESION_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status abrirSesion(int fd){
+	pConexion conexion;
+	pSesion sesion, anterior;
+	long creationTS = 0, actionTS = 0;
+	int sock = fd;
+
+	conexion = obtenerConexion(fd);
+	if(conexion == NULL){
+		return SESION_ERROR;
+	}
+
+	sesion = (pSesion) calloc(1, sizeof(Sesion));
+	if(sesion == NULL){
+		return SESION_ERROR;
+	}
+
+	/* Las cadenas que devuelve el TAD pasan a ser de la sesion */
+	IRCTADUser_GetData(&sesion->id, &sesion->user, &sesion->nick, &sesion->real, &sesion->host, &sesion->IP, &sock, &creationTS, &actionTS, &sesion->away);
+	if(sesion->id == 0){
+		liberarSesion(sesion);
+		return SESION_ERROR;
+	}
+
+	IRC_ComplexUser(&sesion->prefijo, sesion->nick, sesion->real, sesion->host, SERVICIO);
+	if(sesion->away){
+		sesion->flags |= SESION_AWAY;
+	}
+
+	pthread_mutex_lock(&conexion->mutex);
+	anterior = conexion->sesion;
+	conexion->sesion = sesion;
+	pthread_mutex_unlock(&conexion->mutex);
+
+	liberarSesion(anterior);
+
+	return SESION_OK;
+}
+
+/**
+ * @ingroup Sesiones
+ *
+ * @brief Devuelve la sesion de una conexion
+ *
+ * @synopsis
+ * @code
+ * 	pSesion obtenerSesion(int fd)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion
+ *
+ * @return la sesion, o NULL si la conexion no se ha registrado
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+pSesion obtenerSesion(int fd){
+	pConexion conexion;
+
+	conexion = obtenerConexion(fd);
+	if(conexion == NULL){
+		return NULL;
+	}
+
+	return conexion->sesion;
+}
+
+/**
+ * @ingroup Sesiones
+ *
+ * @brief Obtiene los datos del usuario de una conexion sin reservar memoria
+ *
+ * Sustituye a IRCTADUser_GetData por socket: los punteros devueltos son de
+ * la sesion y no se liberan. Siguen siendo validos mientras el comando se
+ * atiende, salvo los que cambie el propio comando (NICK, AWAY).
+ *
+ * @synopsis
+ * @code
+ * 	long leerSesion(int fd, long *id, char **user, char **nick, char **real, char **host, char **IP, char **away)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion
+ * @param[out] id identificador del usuario, 0 si no esta registrado
+ * @param[out] user user del usuario, NULL si no esta registrado
+ * @param[out] nick nick del usuario, NULL si no esta registrado
+ * @param[out] real realname del usuario, NULL si no esta registrado
+ * @param[out] host host del usuario, NULL si no esta registrado
+ * @param[out] IP IP del usuario, NULL si no esta registrado
+ * @param[out] away mensaje de away, NULL si no esta ausente
+ *
+ * @return IRC_OK
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+long leerSesion(int fd, long *id, char **user, char **nick, char **real, char **host, char **IP, char **away){
+	pSesion sesion;
+
+	sesion = obtenerSesion(fd);
+	if(sesion == NULL){
+		*id = 0;
+		*user = *nick = *real = *host = *IP = *away = NULL;
+		return IRC_OK;
+	}
+
+	*id = sesion->id;
+	*user = sesion->user;
+	*nick = sesion->nick;
+	*real = sesion->real;
+	*host = sesion->host;
+	*IP = sesion->IP;
+	*away = sesion->away;
+
+	return IRC_OK;
+}
+
+/**
+ * @ingroup Sesiones
+ *
+ * @brief Devuelve el prefijo con el que se firman los mensajes de una conexion
+ *
+ * @synopsis
+ * @code
+ * 	char *prefijoSesion(int fd)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion
+ *
+ * @return el prefijo, que no se libera, o NULL si no esta registrada
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+char *prefijoSesion(int fd){
+	pSesion sesion;
+
+	sesion = obtenerSesion(fd);
+	if(sesion == NULL){
+		return NULL;
+	}
+
+	return sesion->prefijo;
+}
+
+/**
+ * @ingroup Sesiones
+ *
+ * @brief Actualiza el nick y el prefijo de una sesion tras un NICK aceptado por el TAD
+ *
+ * @synopsis
+ * @code
+ * 	status cambiarNickSesion(int fd, char *nick)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion
+ * @param[in] nick el nuevo nick
+ *
+ * @return SESION_OK si todo va bien. SESION_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status cambiarNickSesion(int fd, char *nick){
+	pConexion conexion;
+	pSesion sesion;
+	char *nuevo = NULL, *prefijo = NULL;
+
+	conexion = obtenerConexion(fd);
+	if(conexion == NULL || conexion->sesion == NULL || nick == NULL){
+		return SESION_ERROR;
+	}
+	sesion = conexion->sesion;
+
+	nuevo = strdup(nick);
+	if(nuevo == NULL){
+		return SESION_ERROR;
+	}
+	IRC_ComplexUser(&prefijo, nuevo, sesion->real, sesion->host, SERVICIO);
+
+	pthread_mutex_lock(&conexion->mutex);
+	nick = sesion->nick;
+	sesion->nick = nuevo;
+	nuevo = sesion->prefijo;
+	sesion->prefijo = prefijo;
+	pthread_mutex_unlock(&conexion->mutex);
+
+	free(nick);
+	if(nuevo) free(nuevo);
+
+	return SESION_OK;
+}
+
+/**
+ * @ingroup Sesiones
+ *
+ * @brief Actualiza el away de una sesion
+ *
+ * @synopsis
+ * @code
+ * 	status cambiarAwaySesion(int fd, char *away)
+ * @endcode
+ *
+ * @param[in] fd descriptor de la conexion
+ * @param[in] away el mensaje de away, o NULL al volver
+ *
+ * @return SESION_OK si todo va bien. SESION_ERROR en caso contrario
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+status cambiarAwaySesion(int fd, char *away){
+	pConexion conexion;
+	pSesion sesion;
+	char *nuevo = NULL;
+
+	conexion = obtenerConexion(fd);
+	if(conexion == NULL || conexion->sesion == NULL){
+		return SESION_ERROR;
+	}
+	sesion = conexion->sesion;
+
+	if(away){
+		nuevo = strdup(away);
+		if(nuevo == NULL){
+			return SESION_ERROR;
+		}
+	}
+
+	pthread_mutex_lock(&conexion->mutex);
+	away = sesion->away;
+	sesion->away = nuevo;
+	if(nuevo){
+		sesion->flags |= SESION_AWAY;
+	} else {
+		sesion->flags &= ~SESION_AWAY;
+	}
+	pthread_mutex_unlock(&conexion->mutex);
+
+	if(away) free(away);
+
+	return SESION_OK;
+}
+
+/**
+ * @ingroup Sesiones
+ *
+ * @brief Libera una sesion
+ *
+ * @synopsis
+ * @code
+ * 	void liberarSesion(pSesion sesion)
+ * @endcode
+ *
+ * @param[in] sesion la sesion, ya fuera de la tabla de conexiones
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+*/
+void liberarSesion(pSesion sesion){
+
+	if(sesion == NULL){
+		return;
+	}
+
+	liberarUserData(sesion->user, sesion->nick, sesion->real, sesion->host, sesion->IP, sesion->away);
+	if(sesion->prefijo) free(sesion->prefijo);
+	free(sesion);
+}
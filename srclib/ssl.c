@@ -14,6 +14,7 @@
 #include <openssl/bio.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <sys/resource.h>
 
 #include "../includes/ssl.h"
 
@@ -29,9 +30,34 @@
 /* Contexto SSL: var global */
 SSL_CTX *context;
  
-/* Array para almacenar sockets SSL */
+/* Array para almacenar sockets SSL, indexado por descriptor */
 typedef SSL* pSSL;
-pSSL SSL_sockets[MAX_SSL] = {0};
+pSSL *SSL_sockets = NULL;
+int nSSL_sockets = 0;
+
+/**
+ * @ingroup SoporteSSL
+ *
+ * @brief Comprueba que el descriptor cabe en el array de sockets SSL
+ *
+ * @synopsis
+ * @code
+ * 	int descriptor_valido_SSL(int sckfd)
+ * @endcode
+ *
+ * @param[in] sckfd descriptor a comprobar
+ *
+ * @return 1 si es valido, 0 en otro caso
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */
+int descriptor_valido_SSL(int sckfd){
+	return SSL_sockets != NULL && sckfd >= 0 && sckfd < nSSL_sockets;
+}
 
 /**
  * @ingroup SoporteSSL
@@ -74,7 +100,24 @@ void ssl_error(char *msg){
  *<hr>
  */
 int inicializar_nivel_SSL() {
+	struct rlimit lim;
+
 	context = NULL;
+
+	/* Sin limite de FD_SETSIZE el array debe cubrir todos los descriptores posibles */
+	if(SSL_sockets == NULL){
+		nSSL_sockets = MAX_SSL;
+		if(getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur > MAX_SSL){
+			nSSL_sockets = (int) lim.rlim_cur;
+		}
+
+		SSL_sockets = (pSSL *) calloc(nSSL_sockets, sizeof(pSSL));
+		if(SSL_sockets == NULL){
+			nSSL_sockets = 0;
+			return SSL_ERR;
+		}
+	}
+
     SSL_load_error_strings();
     SSL_library_init(); 
 	return SSL_OK;
@@ -159,6 +202,10 @@ int fijar_contexto_SSL(const char *pcert, const char *pkey) {
  */ 
 int conectar_canal_seguro_SSL(int sckfd) {
 
+	if(!descriptor_valido_SSL(sckfd)){
+		return SSL_ERR;
+	}
+
 	/* Guardamos nuevo contexto en array de sockets ssl */
  	SSL_sockets[sckfd] = SSL_new(context);
 
@@ -178,14 +225,14 @@ int conectar_canal_seguro_SSL(int sckfd) {
 /**
  * @ingroup SoporteSSL
  *
- * @brief Permite conexion SSL segura
+ * @brief Prepara el canal SSL de una conexion aceptada sin hacer el handshake
  *
  * @synopsis
  * @code
- * 	int aceptar_canal_seguro_SSL(int sckfd)
+ * 	int iniciar_canal_seguro_SSL(int sckfd)
  * @endcode
  *
- * @param[in] sckfd socket que aceptar
+ * @param[in] sckfd socket aceptado
  *
  * @author
  * Pablo Marcos Manchon
@@ -193,21 +240,112 @@ int conectar_canal_seguro_SSL(int sckfd) {
  *
  *<hr>
  */ 
-int aceptar_canal_seguro_SSL(int sckfd) {
+int iniciar_canal_seguro_SSL(int sckfd) {
+
+	if(!descriptor_valido_SSL(sckfd)){
+		return SSL_ERR;
+	}
 
 	/* Guardamos nuevo contexto en array de sockets ssl */
  	SSL_sockets[sckfd] = SSL_new(context);
+	if(SSL_sockets[sckfd] == NULL){
+		ssl_error("SSL_new");
+		return SSL_ERR;
+	}
 
 	/* Asociamso el socket a la estructura en la posicion */
     if(SSL_set_fd(SSL_sockets[sckfd], sckfd)!=1){
 		ssl_error("SSL_set_fd"); 
 		return SSL_ERR;
 	}
+	SSL_set_accept_state(SSL_sockets[sckfd]);
+
+	/* Con el socket no bloqueante las escrituras parciales se reintentan desde otro buffer */
+	SSL_set_mode(SSL_sockets[sckfd], SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+	return SSL_OK;
+}
+
+/**
+ * @ingroup SoporteSSL
+ *
+ * @brief Avanza el handshake de una conexion no bloqueante
+ *
+ * Cada llamada procesa lo que haya llegado del cliente y devuelve a que hay
+ * que esperar para seguir, sin bloquear nunca en el socket.
+ *
+ * @synopsis
+ * @code
+ * 	int avanzar_handshake_SSL(int sckfd)
+ * @endcode
+ *
+ * @param[in] sckfd socket preparado con iniciar_canal_seguro_SSL
+ *
+ * @return SSL_OK si ha terminado, SSL_LEER o SSL_ESCRIBIR si espera al
+ * socket, SSL_ERR en caso de error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */ 
+int avanzar_handshake_SSL(int sckfd) {
+	int ret, err;
+
+	if(!descriptor_valido_SSL(sckfd) || !SSL_sockets[sckfd]){
+		return SSL_ERR;
+	}
+
+	/* SSL_get_error mira la cola de errores del hilo, no debe quedar nada de antes */
+	ERR_clear_error();
+	ret = SSL_accept(SSL_sockets[sckfd]);
+	if(ret == 1){
+		return SSL_OK;
+	}
+
+	err = SSL_get_error(SSL_sockets[sckfd], ret);
+	if(err == SSL_ERROR_WANT_READ){
+		return SSL_LEER;
+	} else if(err == SSL_ERROR_WANT_WRITE){
+		return SSL_ESCRIBIR;
+	}
+
+	ERR_clear_error();
+	return SSL_ERR;
+}
+
+/**
+ * @ingroup SoporteSSL
+ *
+ * @brief Permite conexion SSL segura
+ *
+ * El handshake es bloqueante; los reactores usan iniciar_canal_seguro_SSL
+ * y avanzar_handshake_SSL.
+ *
+ * @synopsis
+ * @code
+ * 	int aceptar_canal_seguro_SSL(int sckfd)
+ * @endcode
+ *
+ * @param[in] sckfd socket que aceptar
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */ 
+int aceptar_canal_seguro_SSL(int sckfd) {
+
+	if(iniciar_canal_seguro_SSL(sckfd) < 0){
+		return SSL_ERR;
+	}
+
 	/* Esperando handshake cliente */
     if(SSL_accept(SSL_sockets[sckfd]) != 1){
-		ssl_error("SSL_connect"); 
+		ssl_error("SSL_accept"); 
 		return SSL_ERR;
-	}    
+	}
 	return SSL_OK;
 }
  
@@ -230,6 +368,9 @@ int aceptar_canal_seguro_SSL(int sckfd) {
  *<hr>
  */ 
 int evaluar_post_conectar_SSL(int sckfd) {
+	if(!descriptor_valido_SSL(sckfd)){
+		return 0;
+	}
     return SSL_get_peer_certificate(SSL_sockets[sckfd]) && SSL_get_verify_result(SSL_sockets[sckfd]);
 }
  
@@ -254,7 +395,7 @@ int evaluar_post_conectar_SSL(int sckfd) {
  *<hr>
  */ 
 int enviar_datos_SSL(int sckfd, void* mensaje, int tam) {
-	if(!mensaje || tam < 0 || sckfd < 0){
+	if(!mensaje || tam < 0 || !descriptor_valido_SSL(sckfd) || !SSL_sockets[sckfd]){
 		return SSL_ERR;
 	}
   	return SSL_write(SSL_sockets[sckfd], mensaje, tam);
@@ -281,12 +422,47 @@ int enviar_datos_SSL(int sckfd, void* mensaje, int tam) {
  *<hr>
  */ 
 int recibir_datos_SSL(int sckfd, void* mensaje, int max) {
-    if(!SSL_sockets[sckfd]) 
+    if(!descriptor_valido_SSL(sckfd) || !SSL_sockets[sckfd]) 
 		return SSL_ERR;
     memset(mensaje,0, max);
     return SSL_read(SSL_sockets[sckfd], mensaje, max);
 }
  
+/**
+ * @ingroup SoporteSSL
+ *
+ * @brief Indica si una lectura o escritura SSL fallida debe reintentarse
+ *
+ * Con el socket no bloqueante SSL_read y SSL_write devuelven error cuando
+ * necesitan esperar al socket, igual que EAGAIN en recv y send.
+ *
+ * @synopsis
+ * @code
+ * 	int reintentar_SSL(int sckfd, int ret)
+ * @endcode
+ *
+ * @param[in] sckfd socket de la operacion
+ * @param[in] ret valor devuelto por la operacion
+ *
+ * @return 1 si la operacion debe reintentarse, 0 si es un error
+ *
+ * @author
+ * Pablo Marcos Manchon
+ * Dionisio Perez Alvear
+ *
+ *<hr>
+ */ 
+int reintentar_SSL(int sckfd, int ret) {
+	int err;
+
+	if(!descriptor_valido_SSL(sckfd) || !SSL_sockets[sckfd]){
+		return 0;
+	}
+
+	err = SSL_get_error(SSL_sockets[sckfd], ret);
+	return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE;
+}
+
 /**
  * @ingroup SoporteSSL
  *
@@ -306,8 +482,12 @@ int recibir_datos_SSL(int sckfd, void* mensaje, int max) {
  *<hr>
  */ 
 void cerrar_canal_SSL(int sckfd) {
-   if(SSL_sockets[sckfd]){
-		SSL_shutdown(SSL_sockets[sckfd]); 
+   if(descriptor_valido_SSL(sckfd) && SSL_sockets[sckfd]){
+		/* Con el handshake a medias no hay canal que cerrar */
+		if(SSL_is_init_finished(SSL_sockets[sckfd])){
+			SSL_shutdown(SSL_sockets[sckfd]);
+		}
+		ERR_clear_error();
 		SSL_free(SSL_sockets[sckfd]);
 		SSL_sockets[sckfd]=NULL;
 	}
@@ -332,6 +512,9 @@ void cerrar_canal_SSL(int sckfd) {
 void liberar_nivel_SSL() {
     SSL_CTX_free(context);
     context = NULL;
+    free(SSL_sockets);
+    SSL_sockets = NULL;
+    nSSL_sockets = 0;
 }
 
 